@@ -0,0 +1,979 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "nmea_decoder.h"
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+
+static const char *DECODER_TAG = "nmea_parser";
+#else
+#define ESP_LOGD(tag, format, ...) ((void)0)
+#endif
+
+#define NMEA_MAX_STATEMENT_ITEM_LENGTH (16)
+#define NMEA_DECODER_STATEMENT_PARSER_NUM CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM
+#define NMEA_UBX_SYNC_CHAR_1 (0xB5)
+#define NMEA_UBX_SYNC_CHAR_2 (0x62)
+#define NMEA_UBX_MAX_PAYLOAD_LENGTH (1024)
+#define NMEA_MS_PER_DAY (86400000LL)
+
+/**
+ * @brief parse latitude or longitude
+ *              format of latitude in NMEA is ddmm.sss and longitude is dddmm.sss
+ * @param item item string
+ * @return int32_t Latitude or Longitude value (unit: degree without dot)
+ */
+static int32_t parse_lat_long(const char *item)
+{
+    /* Whole minutes are parsed as integer, a float cannot hold ddmm.mmmmm exactly */
+    char *end;
+    long whole = strtol(item, &end, 10);
+    if (whole > 18000 || whole < -18000) {
+        /* Damaged item with a valid checksum, saturate so the result fits and can be negated */
+        return whole > 0 ? 1800000000 : -1800000000;
+    }
+    int32_t deg = whole / 100;
+    int32_t min = whole % 100;
+    /* Fraction of minute in 1e-6 minute, whatever the number of digits */
+    int32_t under_point = 0;
+    if (*end == '.') {
+        end++;
+        for (int32_t unit = 100000; unit; unit /= 10) {
+            if (*end < '0' || *end > '9') {
+                break;
+            }
+            under_point += unit * (*end++ - '0');
+        }
+    }
+    int32_t value = (deg * 10000000) + (min * 10000000 + under_point * 10) / 60;
+    /* Minutes of 60 or more, or a fraction past 180 degrees, are saturated as well */
+    if (value > 1800000000 || value < -1800000000) {
+        return value > 0 ? 1800000000 : -1800000000;
+    }
+    return value;
+}
+
+/**
+ * @brief Converter two continuous numeric character into a uint8_t number
+ *
+ * @param digit_char numeric character
+ * @return uint8_t result of converting
+ */
+static inline uint8_t convert_two_digit2number(const char *digit_char)
+{
+    return 10 * (digit_char[0] - '0') + (digit_char[1] - '0');
+}
+
+/**
+ * @brief Check that an item starts with a number of digits
+ *
+ * Stops at the terminating NUL, so that fixed-width items never read past a short item.
+ *
+ * @param item item string
+ * @param n number of digits
+ * @return true if the first n characters are digits
+ */
+static inline bool check_digits(const char *item, uint8_t n)
+{
+    for (uint8_t i = 0; i < n; i++) {
+        if (item[i] < '0' || item[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a decimal number, damaged values (nan, inf) as 0
+ *
+ * Plain decimals whose digits fit the float mantissa, i.e. every NMEA number, are converted by one division of
+ * two exact floats, which rounds like strtof(). Other items fall back to strtof().
+ *
+ * @param item item string
+ * @return float value
+ */
+static float parse_float(const char *item)
+{
+    static const float pow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+    const char *p = item;
+    bool negative = *p == '-';
+    if (negative || *p == '+') {
+        p++;
+    }
+    uint32_t mantissa = 0;
+    uint8_t digits = 0;
+    uint8_t decimals = 0;
+    bool point = false;
+    for (;; p++) {
+        if (*p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+            decimals += point;
+        } else if (*p == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (*p == '\0' && digits && digits <= 9 && mantissa < (1 << 24) && decimals <= 10) {
+        float value = mantissa / pow10[decimals];
+        return negative ? -value : value;
+    }
+    float value = strtof(item, NULL);
+    return isfinite(value) ? value : 0;
+}
+
+/**
+ * @brief Parse UTC time in GPS statements
+ *
+ * @param item item string, hhmmss.sss, ignored if empty or damaged
+ * @param tim parsed time will be saved in this pointer
+ */
+static void parse_utc_time(const char *item, gps_time_t *tim)
+{
+    if (!check_digits(item, 6)) {
+        return;
+    }
+    tim->hour = convert_two_digit2number(item + 0);
+    tim->minute = convert_two_digit2number(item + 2);
+    tim->second = convert_two_digit2number(item + 4);
+    if (item[6] == '.') {
+        /* Fraction of second in milliseconds, whatever the number of digits */
+        uint16_t tmp = 0;
+        uint8_t i = 7;
+        for (uint16_t unit = 100; unit; unit /= 10) {
+            if (item[i] < '0' || item[i] > '9') {
+                break;
+            }
+            tmp += unit * (item[i++] - '0');
+        }
+        tim->thousand = tmp;
+    }
+}
+
+/**
+ * @brief Decoder kind of a statement item
+ *
+ */
+typedef enum {
+    GPS_FIELD_UTC_TIME,   /*!< hhmmss.sss -> gps_time_t */
+    GPS_FIELD_DATE,       /*!< ddmmyy -> gps_date_t */
+    GPS_FIELD_LAT_LONG,   /*!< (d)ddmm.mmmm -> int32_t, 1e-7 degree */
+    GPS_FIELD_SOUTH_WEST, /*!< N/S or E/W -> negate int32_t on 'S' or 'W' */
+    GPS_FIELD_FLOAT,      /*!< decimal -> float, multiplied by scale */
+    GPS_FIELD_GEOID_SEP,  /*!< decimal -> float geoid separation, also added to altitude */
+    GPS_FIELD_U8,         /*!< decimal -> uint8_t */
+    GPS_FIELD_ENUM,       /*!< decimal -> enum */
+    GPS_FIELD_YEAR,       /*!< yyyy -> uint16_t, years since 2000 */
+    GPS_FIELD_VALID,      /*!< A/V -> bool */
+    GPS_FIELD_SAT_U8,     /*!< decimal -> uint8_t member of satellite in view */
+    GPS_FIELD_SAT_U16,    /*!< decimal -> uint16_t member of satellite in view */
+} gps_field_kind_t;
+
+/**
+ * @brief Schema of one statement item: item number -> decoder kind -> destination
+ *
+ */
+typedef struct {
+    uint8_t item;         /*!< Item number in statement */
+    uint8_t kind;         /*!< Decoder kind, gps_field_kind_t */
+    uint8_t group;        /*!< Field group (nmea_field_group_t) decoded by several statements */
+    uint16_t offset;      /*!< Destination offset in nmea_decoder_t (in gps_satellite_t for satellite kinds) */
+    float scale;          /*!< Scale of float kinds */
+} gps_field_desc_t;
+
+#define GPS_FIELD_GROUP_NONE (0xFF) /* Item decoded by a single statement */
+#define GPS_FIELD(item, kind, member, group) {item, kind, group, offsetof(nmea_decoder_t, member), 1.0f}
+#define GPS_FIELD_SCALED(item, kind, member, scale, group) {item, kind, group, offsetof(nmea_decoder_t, member), scale}
+#define GPS_FIELD_SAT(item, kind, member) {item, kind, GPS_FIELD_GROUP_NONE, offsetof(gps_satellite_t, member), 1.0f}
+#define GPS_FIELD_SAT_DESC(item) \
+    GPS_FIELD_SAT(item, GPS_FIELD_SAT_U8, num), GPS_FIELD_SAT(item + 1, GPS_FIELD_SAT_U8, elevation), \
+    GPS_FIELD_SAT(item + 2, GPS_FIELD_SAT_U16, azimuth), GPS_FIELD_SAT(item + 3, GPS_FIELD_SAT_U8, snr)
+
+#define KNOTS_TO_MPS (0.514444f)
+#define KPH_TO_MPS (1 / 3.6f)
+
+/* Items of each statement, sorted by item number. Items not listed are skipped without conversion */
+#if CONFIG_NMEA_STATEMENT_GGA
+static const gps_field_desc_t gps_gga_fields[] = {
+    GPS_FIELD(1, GPS_FIELD_UTC_TIME, gps.tim, NMEA_FIELD_TIME),
+    GPS_FIELD(2, GPS_FIELD_LAT_LONG, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(3, GPS_FIELD_SOUTH_WEST, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(4, GPS_FIELD_LAT_LONG, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(5, GPS_FIELD_SOUTH_WEST, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(6, GPS_FIELD_ENUM, gps.fix, GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(7, GPS_FIELD_U8, gps.sats_in_use, NMEA_FIELD_SATS_IN_USE),
+    GPS_FIELD(8, GPS_FIELD_FLOAT, gps.dop_h, NMEA_FIELD_HDOP),
+    GPS_FIELD(9, GPS_FIELD_FLOAT, gps.altitude, NMEA_FIELD_ALTITUDE),
+    GPS_FIELD(11, GPS_FIELD_GEOID_SEP, gps.geoid_sep, NMEA_FIELD_ALTITUDE), /* Altitude above ellipsoid */
+};
+#endif
+
+#if CONFIG_NMEA_STATEMENT_GSA
+static const gps_field_desc_t gps_gsa_fields[] = {
+    GPS_FIELD(2, GPS_FIELD_ENUM, gps.fix_mode, GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(3, GPS_FIELD_U8, gps.sats_id_in_use[0], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(4, GPS_FIELD_U8, gps.sats_id_in_use[1], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(5, GPS_FIELD_U8, gps.sats_id_in_use[2], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(6, GPS_FIELD_U8, gps.sats_id_in_use[3], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(7, GPS_FIELD_U8, gps.sats_id_in_use[4], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(8, GPS_FIELD_U8, gps.sats_id_in_use[5], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(9, GPS_FIELD_U8, gps.sats_id_in_use[6], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(10, GPS_FIELD_U8, gps.sats_id_in_use[7], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(11, GPS_FIELD_U8, gps.sats_id_in_use[8], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(12, GPS_FIELD_U8, gps.sats_id_in_use[9], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(13, GPS_FIELD_U8, gps.sats_id_in_use[10], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(14, GPS_FIELD_U8, gps.sats_id_in_use[11], GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(15, GPS_FIELD_FLOAT, gps.dop_p, GPS_FIELD_GROUP_NONE),
+    GPS_FIELD(16, GPS_FIELD_FLOAT, gps.dop_h, NMEA_FIELD_HDOP),
+    GPS_FIELD(17, GPS_FIELD_FLOAT, gps.dop_v, GPS_FIELD_GROUP_NONE),
+};
+#endif
+
+#if CONFIG_NMEA_STATEMENT_GSV
+static const gps_field_desc_t gps_gsv_fields[] = {
+    GPS_FIELD(1, GPS_FIELD_U8, sat_count, GPS_FIELD_GROUP_NONE), /* total GSV numbers */
+    GPS_FIELD(2, GPS_FIELD_U8, sat_num, GPS_FIELD_GROUP_NONE),   /* Current GSV statement number */
+    GPS_FIELD(3, GPS_FIELD_U8, gps.sats_in_view, GPS_FIELD_GROUP_NONE),
+    GPS_FIELD_SAT_DESC(4),
+    GPS_FIELD_SAT_DESC(8),
+    GPS_FIELD_SAT_DESC(12),
+    GPS_FIELD_SAT_DESC(16),
+};
+#endif
+
+#if CONFIG_NMEA_STATEMENT_RMC
+static const gps_field_desc_t gps_rmc_fields[] = {
+    GPS_FIELD(1, GPS_FIELD_UTC_TIME, gps.tim, NMEA_FIELD_TIME),
+    GPS_FIELD(2, GPS_FIELD_VALID, gps.valid, NMEA_FIELD_VALID),
+    GPS_FIELD(3, GPS_FIELD_LAT_LONG, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(4, GPS_FIELD_SOUTH_WEST, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(5, GPS_FIELD_LAT_LONG, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(6, GPS_FIELD_SOUTH_WEST, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD_SCALED(7, GPS_FIELD_FLOAT, gps.speed, KNOTS_TO_MPS, NMEA_FIELD_SPEED),
+    GPS_FIELD(8, GPS_FIELD_FLOAT, gps.cog, NMEA_FIELD_COURSE),
+    GPS_FIELD(9, GPS_FIELD_DATE, gps.date, NMEA_FIELD_DATE),
+    GPS_FIELD(10, GPS_FIELD_FLOAT, gps.variation, NMEA_FIELD_VARIATION),
+};
+#endif
+
+#if CONFIG_NMEA_STATEMENT_GLL
+static const gps_field_desc_t gps_gll_fields[] = {
+    GPS_FIELD(1, GPS_FIELD_LAT_LONG, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(2, GPS_FIELD_SOUTH_WEST, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(3, GPS_FIELD_LAT_LONG, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(4, GPS_FIELD_SOUTH_WEST, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(5, GPS_FIELD_UTC_TIME, gps.tim, NMEA_FIELD_TIME),
+    GPS_FIELD(6, GPS_FIELD_VALID, gps.valid, NMEA_FIELD_VALID),
+};
+#endif
+
+#if CONFIG_NMEA_STATEMENT_VTG
+static const gps_field_desc_t gps_vtg_fields[] = {
+    GPS_FIELD(1, GPS_FIELD_FLOAT, gps.cog, NMEA_FIELD_COURSE),
+    GPS_FIELD(3, GPS_FIELD_FLOAT, gps.variation, NMEA_FIELD_VARIATION),
+    GPS_FIELD_SCALED(7, GPS_FIELD_FLOAT, gps.speed, KPH_TO_MPS, NMEA_FIELD_SPEED), /* Speed in km/h, more digits than knots */
+};
+#endif
+
+#if CONFIG_NMEA_STATEMENT_GNS
+static const gps_field_desc_t gps_gns_fields[] = {
+    GPS_FIELD(1, GPS_FIELD_UTC_TIME, gps.tim, NMEA_FIELD_TIME),
+    GPS_FIELD(2, GPS_FIELD_LAT_LONG, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(3, GPS_FIELD_SOUTH_WEST, gps.latitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(4, GPS_FIELD_LAT_LONG, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(5, GPS_FIELD_SOUTH_WEST, gps.longitude, NMEA_FIELD_POSITION),
+    GPS_FIELD(7, GPS_FIELD_U8, gps.sats_in_use, NMEA_FIELD_SATS_IN_USE),
+    GPS_FIELD(8, GPS_FIELD_FLOAT, gps.dop_h, NMEA_FIELD_HDOP),
+    GPS_FIELD(9, GPS_FIELD_FLOAT, gps.altitude, NMEA_FIELD_ALTITUDE),
+    GPS_FIELD(10, GPS_FIELD_GEOID_SEP, gps.geoid_sep, NMEA_FIELD_ALTITUDE), /* Altitude above ellipsoid */
+};
+#endif
+
+#if CONFIG_NMEA_STATEMENT_ZDA
+static const gps_field_desc_t gps_zda_fields[] = {
+    GPS_FIELD(1, GPS_FIELD_UTC_TIME, gps.tim, NMEA_FIELD_TIME),
+    GPS_FIELD(2, GPS_FIELD_U8, gps.date.day, NMEA_FIELD_DATE),
+    GPS_FIELD(3, GPS_FIELD_U8, gps.date.month, NMEA_FIELD_DATE),
+    GPS_FIELD(4, GPS_FIELD_YEAR, gps.date.year, NMEA_FIELD_DATE),
+};
+#endif
+
+/**
+ * @brief Decode one statement item according to its schema
+ *
+ * @param decoder NMEA decoder
+ * @param field schema of the item
+ * @param item item string
+ */
+static void gps_decode_field(nmea_decoder_t *decoder, const gps_field_desc_t *field, const char *item)
+{
+    uint8_t *dst = (uint8_t *)decoder + field->offset;
+    switch (field->kind) {
+    case GPS_FIELD_UTC_TIME:
+        parse_utc_time(item, (gps_time_t *)dst);
+        break;
+    case GPS_FIELD_DATE:
+        if (!check_digits(item, 6)) {
+            break;
+        }
+        ((gps_date_t *)dst)->day = convert_two_digit2number(item + 0);
+        ((gps_date_t *)dst)->month = convert_two_digit2number(item + 2);
+        ((gps_date_t *)dst)->year = convert_two_digit2number(item + 4);
+        break;
+    case GPS_FIELD_LAT_LONG:
+        *(int32_t *)dst = parse_lat_long(item);
+        break;
+    case GPS_FIELD_SOUTH_WEST:
+        if (item[0] == 'S' || item[0] == 's' || item[0] == 'W' || item[0] == 'w') {
+            *(int32_t *)dst *= -1;
+        }
+        break;
+    case GPS_FIELD_FLOAT:
+        *(float *)dst = parse_float(item) * field->scale;
+        break;
+    case GPS_FIELD_GEOID_SEP:
+        *(float *)dst = parse_float(item);
+        decoder->gps.altitude += *(float *)dst;
+        break;
+    case GPS_FIELD_U8:
+        *dst = (uint8_t)strtol(item, NULL, 10);
+        break;
+    case GPS_FIELD_ENUM:
+        *(int *)dst = (int)strtol(item, NULL, 10);
+        break;
+    case GPS_FIELD_YEAR:
+        *(uint16_t *)dst = (uint16_t)(strtol(item, NULL, 10) - 2000);
+        break;
+    case GPS_FIELD_VALID:
+        *(bool *)dst = (item[0] == 'A');
+        break;
+    case GPS_FIELD_SAT_U8:
+    case GPS_FIELD_SAT_U16: {
+        /* Four satellites per GSV statement, from item 4 */
+        int index = 4 * (decoder->sat_num - 1) + (field->item - 4) / 4;
+        if (index >= 0 && index < GPS_MAX_SATELLITES_IN_VIEW) {
+            dst = (uint8_t *)&decoder->gps.sats_desc_in_view[index] + field->offset;
+            if (field->kind == GPS_FIELD_SAT_U8) {
+                *dst = (uint8_t)strtol(item, NULL, 10);
+            } else {
+                *(uint16_t *)dst = (uint16_t)strtol(item, NULL, 10);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Statement descriptor of dispatch table
+ *
+ */
+typedef struct {
+    const char *name;                      /*!< Statement type, following the talker ID */
+    nmea_statement_t statement;            /*!< Statement ID */
+    const gps_field_desc_t *fields;        /*!< Item schema, sorted by item number */
+    uint8_t field_num;                     /*!< Number of items in schema */
+    uint8_t time_item;                     /*!< Item number of UTC time, 0 if the statement has none */
+} gps_statement_desc_t;
+
+#define GPS_STATEMENT(name, statement, fields, time_item) \
+    {name, statement, fields, sizeof(fields) / sizeof(fields[0]), time_item}
+
+/**
+ * @brief Dispatch table of built-in statements
+ *
+ */
+static const gps_statement_desc_t gps_statements[] = {
+#if CONFIG_NMEA_STATEMENT_GGA
+    GPS_STATEMENT("GGA", STATEMENT_GGA, gps_gga_fields, 1),
+#endif
+#if CONFIG_NMEA_STATEMENT_GSA
+    GPS_STATEMENT("GSA", STATEMENT_GSA, gps_gsa_fields, 0),
+#endif
+#if CONFIG_NMEA_STATEMENT_RMC
+    GPS_STATEMENT("RMC", STATEMENT_RMC, gps_rmc_fields, 1),
+#endif
+#if CONFIG_NMEA_STATEMENT_GSV
+    GPS_STATEMENT("GSV", STATEMENT_GSV, gps_gsv_fields, 0),
+#endif
+#if CONFIG_NMEA_STATEMENT_GLL
+    GPS_STATEMENT("GLL", STATEMENT_GLL, gps_gll_fields, 5),
+#endif
+#if CONFIG_NMEA_STATEMENT_VTG
+    GPS_STATEMENT("VTG", STATEMENT_VTG, gps_vtg_fields, 0),
+#endif
+#if CONFIG_NMEA_STATEMENT_GNS
+    GPS_STATEMENT("GNS", STATEMENT_GNS, gps_gns_fields, 1),
+#endif
+#if CONFIG_NMEA_STATEMENT_ZDA
+    GPS_STATEMENT("ZDA", STATEMENT_ZDA, gps_zda_fields, 1),
+#endif
+};
+
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+/**
+ * @brief Default authoritative statement of each field group, indexed by nmea_field_group_t
+ *
+ */
+static const uint8_t gps_default_authority[NMEA_FIELD_GROUP_MAX] = {
+    [NMEA_FIELD_TIME] = STATEMENT_GGA,
+    [NMEA_FIELD_DATE] = STATEMENT_RMC,
+    [NMEA_FIELD_POSITION] = STATEMENT_GGA,
+    [NMEA_FIELD_ALTITUDE] = STATEMENT_GGA,
+    [NMEA_FIELD_SPEED] = STATEMENT_RMC,
+    [NMEA_FIELD_COURSE] = STATEMENT_RMC,
+    [NMEA_FIELD_VARIATION] = STATEMENT_RMC,
+    [NMEA_FIELD_HDOP] = STATEMENT_GSA,
+    [NMEA_FIELD_SATS_IN_USE] = STATEMENT_GGA,
+    [NMEA_FIELD_VALID] = STATEMENT_RMC,
+};
+
+/**
+ * @brief Start a new epoch if the UTC time of the statement differs from the current epoch
+ *
+ * Called before any item is decoded, so that statements carrying their time after other items (GLL)
+ * are not mistaken for the previous epoch.
+ *
+ * @param decoder NMEA decoder
+ * @param desc statement descriptor
+ */
+static void gps_epoch_check(nmea_decoder_t *decoder, const gps_statement_desc_t *desc)
+{
+    const char *p = decoder->stmt + 1;
+    for (uint8_t item = 0; item < desc->time_item; item++) {
+        while (*p != ',' && *p != '*') {
+            p++;
+        }
+        if (*p++ == '*') {
+            return;
+        }
+    }
+    uint8_t n = 0;
+    while (p[n] != ',' && p[n] != '*' && n < sizeof(decoder->epoch_utc) - 1) {
+        n++;
+    }
+    if (n == 0 || (!strncmp(p, decoder->epoch_utc, n) && decoder->epoch_utc[n] == '\0')) {
+        return;
+    }
+    memcpy(decoder->epoch_utc, p, n);
+    decoder->epoch_utc[n] = '\0';
+    decoder->epoch_filled = 0;
+    decoder->epoch_seen = 0;
+}
+#endif
+
+/**
+ * @brief Check whether the address field of a statement matches a statement name
+ *
+ * Proprietary addresses ('P' + manufacturer) match by prefix (e.g. "PMTK" matches "PMTK001"),
+ * other addresses match either in full (e.g. "GPTXT") or by the type following the talker ID (e.g. "TXT").
+ *
+ * @param addr address field, without '$'
+ * @param addr_len length of address field
+ * @param name statement name
+ * @return true if matched
+ */
+bool nmea_decoder_address_match(const char *addr, size_t addr_len, const char *name)
+{
+    size_t name_len = strlen(name);
+    if (addr[0] == 'P') {
+        return addr_len >= name_len && !memcmp(addr, name, name_len);
+    }
+    if (addr_len == name_len) {
+        return !memcmp(addr, name, name_len);
+    }
+    return addr_len == name_len + 2 && !memcmp(addr + 2, name, name_len);
+}
+
+/**
+ * @brief Convert a float to a fixed-point unsigned 16 bit value, saturated
+ *
+ * @param value value to convert
+ * @param scale number of fixed-point units per unit of value
+ * @return uint16_t fixed-point value
+ */
+static inline uint16_t gps_fixed_u16(float value, float scale)
+{
+    float fixed = value * scale + 0.5f;
+    if (!(fixed > 0)) { /* NaN as well */
+        return 0;
+    }
+    return fixed >= UINT16_MAX ? UINT16_MAX : (uint16_t)fixed;
+}
+
+/**
+ * @brief Convert a float to a fixed-point signed 32 bit value, saturated
+ *
+ * @param value value to convert
+ * @param scale number of fixed-point units per unit of value
+ * @return int32_t fixed-point value, 0 for NaN
+ */
+static inline int32_t gps_fixed_i32(float value, float scale)
+{
+    float fixed = value * scale;
+    if (!(fixed > INT32_MIN && fixed < INT32_MAX)) {
+        return isnan(fixed) ? 0 : fixed > 0 ? INT32_MAX : INT32_MIN;
+    }
+    return (int32_t)lroundf(fixed);
+}
+
+/**
+ * @brief Fill the compact fix from a decoded epoch
+ *
+ * @param gps decoded epoch
+ * @param core compact fix will be saved in this pointer
+ */
+void nmea_decoder_fix_core(const gps_t *gps, gps_fix_core_t *core)
+{
+    core->latitude = gps->latitude;
+    core->longitude = gps->longitude;
+    core->time_ms = ((gps->tim.hour * 60 + gps->tim.minute) * 60 + gps->tim.second) * 1000UL + gps->tim.thousand;
+    core->speed = gps_fixed_u16(gps->speed, 100);
+    core->cog = gps_fixed_u16(gps->cog, 100);
+    core->altitude = gps_fixed_i32(gps->altitude, 100);
+    core->dop_h = gps_fixed_u16(gps->dop_h, 100);
+    core->day = gps->date.day;
+    core->month = gps->date.month;
+    core->year = gps->date.year;
+    core->fix = gps->fix;
+    core->fix_mode = gps->fix_mode;
+    core->sats_in_use = gps->sats_in_use;
+    core->valid = gps->valid;
+}
+
+/**
+ * @brief Quarter wave sine table, one entry per degree (Q15)
+ *
+ */
+static const int16_t nmea_sin_table[91] = {
+    0, 572, 1144, 1715, 2286, 2856, 3425, 3993, 4560, 5126,
+    5690, 6252, 6813, 7371, 7927, 8481, 9032, 9580, 10126, 10668,
+    11207, 11743, 12275, 12803, 13328, 13848, 14364, 14876, 15383, 15886,
+    16383, 16876, 17364, 17846, 18323, 18794, 19260, 19720, 20173, 20621,
+    21062, 21497, 21925, 22347, 22762, 23170, 23571, 23964, 24351, 24730,
+    25101, 25465, 25821, 26169, 26509, 26841, 27165, 27481, 27788, 28087,
+    28377, 28659, 28932, 29196, 29451, 29697, 29934, 30162, 30381, 30591,
+    30791, 30982, 31163, 31335, 31498, 31650, 31794, 31927, 32051, 32165,
+    32269, 32364, 32448, 32523, 32587, 32642, 32687, 32722, 32747, 32762,
+    32767,
+};
+
+/**
+ * @brief Fixed-point sine, linear interpolation of a quarter wave table
+ *
+ * @param cdeg angle (0.01 degree), any value
+ * @return int32_t sine (Q15)
+ */
+int32_t nmea_sin_q15(int32_t cdeg)
+{
+    cdeg %= 36000;
+    if (cdeg < 0) {
+        cdeg += 36000;
+    }
+    int32_t sign = 1;
+    if (cdeg >= 18000) {
+        cdeg -= 18000;
+        sign = -1;
+    }
+    if (cdeg > 9000) {
+        cdeg = 18000 - cdeg;
+    }
+    int32_t deg = cdeg / 100;
+    int32_t frac = cdeg % 100;
+    int32_t value = nmea_sin_table[deg];
+    if (frac) {
+        value += (nmea_sin_table[deg + 1] - value) * frac / 100;
+    }
+    return sign * value;
+}
+
+/**
+ * @brief Fixed-point cosine
+ *
+ * @param cdeg angle (0.01 degree), any value
+ * @return int32_t cosine (Q15)
+ */
+int32_t nmea_cos_q15(int32_t cdeg)
+{
+    return nmea_sin_q15(cdeg + 9000);
+}
+
+/**
+ * @brief Get time of a compact fix
+ *
+ * @param fix compact fix
+ * @return int64_t time of fix (ms since 2000-01-01 UTC), -1 if the date is invalid
+ */
+int64_t nmea_fix_utc_ms(const gps_fix_core_t *fix)
+{
+    static const uint16_t days_before_month[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    if (fix->month < 1 || fix->month > 12 || fix->day < 1) {
+        return -1;
+    }
+    /* Every 4th year is a leap year from 2000 to 2099 */
+    int32_t days = fix->year * 365 + (fix->year + 3) / 4 + days_before_month[fix->month - 1] + fix->day - 1;
+    if (fix->month > 2 && (fix->year % 4) == 0) {
+        days++;
+    }
+    return days * NMEA_MS_PER_DAY + fix->time_ms;
+}
+
+/**
+ * @brief Skip UBX frames found between NMEA statements
+ *
+ * @param decoder NMEA decoder
+ * @param c received byte
+ * @return true if the byte belongs to a UBX frame, false if it has to be decoded as NMEA
+ */
+static inline bool gps_skip_ubx(nmea_decoder_t *decoder, uint8_t c)
+{
+    switch (decoder->ubx_pos) {
+    case 0: /* Sync char 1 */
+        if (c != NMEA_UBX_SYNC_CHAR_1 || decoder->in_statement) {
+            return false;
+        }
+        break;
+    case 1: /* Sync char 2 */
+        if (c != NMEA_UBX_SYNC_CHAR_2) {
+            decoder->lost_bytes++;
+            decoder->ubx_pos = 0;
+            return false;
+        }
+        break;
+    case 2: /* Class */
+    case 3: /* ID */
+        break;
+    case 4: /* Length, low byte */
+        decoder->ubx_remain = c;
+        break;
+    case 5: /* Length, high byte */
+        decoder->ubx_remain |= (uint16_t)c << 8;
+        if (decoder->ubx_remain > NMEA_UBX_MAX_PAYLOAD_LENGTH) {
+            /* Not a real frame, resync on next '$' */
+            decoder->lost_bytes += 6;
+            decoder->ubx_pos = 0;
+            return true;
+        }
+        decoder->ubx_remain += 2; /* Checksum */
+        break;
+    default: /* Payload and checksum */
+        if (--decoder->ubx_remain == 0) {
+            decoder->ubx_pos = 0;
+        }
+        return true;
+    }
+    decoder->ubx_pos++;
+    return true;
+}
+
+/**
+ * @brief Convert one hexadecimal character into a number
+ *
+ * @param c hexadecimal character
+ * @return int value of the character, -1 if it is not a hexadecimal character
+ */
+static inline int convert_hex_char2number(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20; /* to lower case */
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Check checksum of the statement staged in line buffer
+ *
+ * @param decoder NMEA decoder
+ * @return true if the statement ends with "*hh" and hh matches the computed CRC
+ */
+static bool gps_statement_crc_ok(const nmea_decoder_t *decoder)
+{
+    const char *stmt = decoder->stmt;
+    uint16_t n = decoder->stmt_len;
+    if (!decoder->asterisk || n < 4 || stmt[n - 3] != '*') {
+        return false;
+    }
+    int hi = convert_hex_char2number(stmt[n - 2]);
+    int lo = convert_hex_char2number(stmt[n - 1]);
+    return hi >= 0 && lo >= 0 && ((hi << 4) | lo) == decoder->crc;
+}
+
+/**
+ * @brief Decode the fields of a statement that passed its checksum
+ *
+ * @param decoder NMEA decoder
+ * @param data data the statement was received in
+ * @param len number of bytes in data
+ */
+static void gps_decode_statement(nmea_decoder_t *decoder, const uint8_t *data, size_t len)
+{
+    /* Look up the address field in dispatch table */
+    char *p = decoder->stmt + 1;
+    const char *addr = p;
+    while (*p != ',' && *p != '*') {
+        p++;
+    }
+    size_t addr_len = p - addr;
+    const gps_statement_desc_t *desc = NULL;
+    for (size_t i = 0; i < sizeof(gps_statements) / sizeof(gps_statements[0]); i++) {
+        if (nmea_decoder_address_match(addr, addr_len, gps_statements[i].name)) {
+            desc = &gps_statements[i];
+            break;
+        }
+    }
+    const nmea_parser_statement_parser_t *user = NULL;
+#if NMEA_DECODER_STATEMENT_PARSER_NUM
+    for (int i = 0; !desc && i < NMEA_DECODER_STATEMENT_PARSER_NUM; i++) {
+        const char *name = decoder->user_parser[i].name;
+        if (name && nmea_decoder_address_match(addr, addr_len, name)) {
+            user = &decoder->user_parser[i];
+            break;
+        }
+    }
+#endif
+    if (!desc && !user) {
+        /* Nobody parses this statement, drop it without splitting */
+        decoder->unknown++;
+        if (decoder->cb.unknown) {
+            decoder->cb.unknown(decoder->cb.ctx, decoder->stmt, decoder->stmt_len + 1);
+        }
+        return;
+    }
+    /* Reset runtime information */
+    decoder->item_num = 0;
+    decoder->cur_statement = desc ? desc->statement : STATEMENT_UNKNOWN;
+    decoder->sat_count = 0;
+    decoder->sat_num = 0;
+    /* Split statement into items in place, the checksum item is not parsed */
+    const gps_field_desc_t *field = desc ? desc->fields : NULL;
+    const gps_field_desc_t *field_end = desc ? desc->fields + desc->field_num : NULL;
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    /* Field groups already filled in this epoch by another statement are skipped,
+     * unless this statement is their authoritative source */
+    uint32_t skip_mask = 0;
+    uint32_t fill_mask = 0;
+    if (desc) {
+        if (desc->time_item) {
+            gps_epoch_check(decoder, desc);
+        }
+        /* A statement seen again without a new UTC time also starts an epoch: the statements carrying the
+         * time may be lost or have an empty time, filled groups must not be skipped until they come back */
+        if (decoder->epoch_seen & (1 << desc->statement)) {
+            decoder->epoch_filled = 0;
+            decoder->epoch_seen = 0;
+        }
+        skip_mask = decoder->epoch_filled;
+        for (int i = 0; i < NMEA_FIELD_GROUP_MAX; i++) {
+            if (decoder->authority[i] == desc->statement) {
+                skip_mask &= ~(1 << i);
+            }
+        }
+    }
+#endif
+    p = decoder->stmt + 1;
+    while (1) {
+        char *item = p;
+        while (*p != ',' && *p != '*') {
+            p++;
+        }
+        char separator = *p;
+        *p++ = '\0';
+        /* Parse current item, the address is only passed to user parsers */
+        if (desc) {
+            if (field == field_end) {
+                /* No more items in schema */
+                break;
+            }
+            if (field->item == decoder->item_num) {
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+                if (field->group != GPS_FIELD_GROUP_NONE) {
+                    if (skip_mask & (1 << field->group)) {
+                        decoder->field_skipped++;
+                        field++;
+                        goto next_item;
+                    }
+                    fill_mask |= 1 << field->group;
+                }
+                decoder->field_decoded++;
+#endif
+                gps_decode_field(decoder, field++, item);
+            }
+        } else {
+            user->parse_item(user->parser_args, decoder->item_num, item);
+        }
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+next_item:
+#endif
+        if (separator == '*') {
+            break;
+        }
+        /* Start with next item */
+        decoder->item_num++;
+    }
+    if (!desc) {
+        if (user->statement_end) {
+            user->statement_end(user->parser_args);
+        }
+        return;
+    }
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    decoder->epoch_filled |= fill_mask;
+#endif
+#if CONFIG_NMEA_STATEMENT_GSV
+    if (desc->statement == STATEMENT_GSV && decoder->sat_num != decoder->sat_count) {
+        /* Wait for the last GSV statement of the group */
+        return;
+    }
+#endif
+    if (!decoder->parsed_statement && decoder->cb.epoch_start) {
+        decoder->cb.epoch_start(decoder->cb.ctx);
+    }
+    decoder->parsed_statement |= 1 << desc->statement;
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    decoder->epoch_seen |= 1 << desc->statement;
+#endif
+    /* Check if all statements have been parsed */
+    if (((decoder->parsed_statement) & decoder->all_statements) == decoder->all_statements) {
+        decoder->parsed_statement = 0;
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+        decoder->epoch_filled = 0;
+        decoder->epoch_seen = 0;
+#endif
+        decoder->cb.epoch(decoder->cb.ctx, &decoder->gps, data, len);
+    }
+}
+
+/**
+ * @brief Decode bytes received from a GPS receiver
+ *
+ * Each statement is staged in the decoder while its checksum is computed. Fields are decoded
+ * into gps_t only once the checksum passed, damaged statements are rejected without any field decoding.
+ * Bytes outside of a statement (garbage, truncated statements after an overflow) are dropped and
+ * counted, decoding resynchronizes on the next '$' or UBX sync chars.
+ *
+ * @param decoder NMEA decoder
+ * @param data received bytes
+ * @param len number of bytes in data
+ */
+void nmea_decoder_feed(nmea_decoder_t *decoder, const uint8_t *data, size_t len)
+{
+    const uint8_t *d = data;
+    const uint8_t *end = d + len;
+    for (; d < end; d++) {
+        if (gps_skip_ubx(decoder, *d)) {
+            continue;
+        }
+        /* Start of a statement */
+        if (*d == '$') {
+            if (decoder->in_statement) {
+                /* Previous statement was truncated */
+                decoder->lost_bytes += decoder->stmt_len;
+            }
+            decoder->in_statement = 1;
+            decoder->stmt_len = 0;
+            decoder->asterisk = 0;
+            decoder->crc = 0;
+        }
+        /* Outside of a statement, only line endings are expected */
+        else if (!decoder->in_statement) {
+            if (*d != '\n' && *d != '\r') {
+                decoder->lost_bytes++;
+            }
+            continue;
+        }
+        /* End of statement */
+        else if (*d == '\r') {
+            decoder->in_statement = 0;
+            decoder->stmt[decoder->stmt_len] = '\0';
+            if (gps_statement_crc_ok(decoder)) {
+                gps_decode_statement(decoder, data, len);
+            } else {
+                decoder->crc_error++;
+                decoder->lost_bytes += decoder->stmt_len + 1;
+                ESP_LOGD(DECODER_TAG, "CRC Error for statement:%s", decoder->stmt);
+            }
+            continue;
+        }
+        /* End of CRC computation */
+        else if (*d == '*') {
+            decoder->asterisk = 1;
+        }
+        /* Add to CRC */
+        else if (!(decoder->asterisk)) {
+            decoder->crc ^= *d;
+        }
+        /* Stage character in line buffer */
+        if (decoder->stmt_len >= NMEA_MAX_STATEMENT_LENGTH - 1) {
+            /* Too long to be a statement, resync on next '$' */
+            decoder->in_statement = 0;
+            decoder->lost_bytes += decoder->stmt_len + 1;
+            continue;
+        }
+        decoder->stmt[decoder->stmt_len++] = *d;
+    }
+}
+
+/**
+ * @brief Init NMEA decoder
+ *
+ * @param decoder decoder to init, any previous state is discarded
+ * @param statements statements completing an epoch, 0 for all statements enabled in menuconfig
+ * @param cb callbacks, copied
+ */
+void nmea_decoder_init(nmea_decoder_t *decoder, uint32_t statements, const nmea_decoder_cb_t *cb)
+{
+    memset(decoder, 0, sizeof(nmea_decoder_t));
+    if (!statements) {
+#if CONFIG_NMEA_STATEMENT_GSA
+        statements |= (1 << STATEMENT_GSA);
+#endif
+#if CONFIG_NMEA_STATEMENT_GSV
+        statements |= (1 << STATEMENT_GSV);
+#endif
+#if CONFIG_NMEA_STATEMENT_GGA
+        statements |= (1 << STATEMENT_GGA);
+#endif
+#if CONFIG_NMEA_STATEMENT_RMC
+        statements |= (1 << STATEMENT_RMC);
+#endif
+#if CONFIG_NMEA_STATEMENT_GLL
+        statements |= (1 << STATEMENT_GLL);
+#endif
+#if CONFIG_NMEA_STATEMENT_VTG
+        statements |= (1 << STATEMENT_VTG);
+#endif
+#if CONFIG_NMEA_STATEMENT_GNS
+        statements |= (1 << STATEMENT_GNS);
+#endif
+#if CONFIG_NMEA_STATEMENT_ZDA
+        statements |= (1 << STATEMENT_ZDA);
+#endif
+    }
+    decoder->all_statements = statements & ~(1 << STATEMENT_UNKNOWN);
+    decoder->cb = *cb;
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    memcpy(decoder->authority, gps_default_authority, sizeof(decoder->authority));
+#endif
+}
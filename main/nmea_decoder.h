@@ -0,0 +1,318 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+#define GPS_MAX_SATELLITES_IN_USE (12)
+#define GPS_MAX_SATELLITES_IN_VIEW (16)
+
+/**
+ * @brief GPS fix type
+ *
+ */
+typedef enum {
+    GPS_FIX_INVALID, /*!< Not fixed */
+    GPS_FIX_GPS,     /*!< GPS */
+    GPS_FIX_DGPS,    /*!< Differential GPS */
+} gps_fix_t;
+
+/**
+ * @brief GPS fix mode
+ *
+ */
+typedef enum {
+    GPS_MODE_INVALID = 1, /*!< Not fixed */
+    GPS_MODE_2D,          /*!< 2D GPS */
+    GPS_MODE_3D           /*!< 3D GPS */
+} gps_fix_mode_t;
+
+/**
+ * @brief GPS satellite information
+ *
+ */
+typedef struct {
+    uint8_t num;       /*!< Satellite number */
+    uint8_t elevation; /*!< Satellite elevation */
+    uint16_t azimuth;  /*!< Satellite azimuth */
+    uint8_t snr;       /*!< Satellite signal noise ratio */
+} gps_satellite_t;
+
+/**
+ * @brief GPS time
+ *
+ */
+typedef struct {
+    uint8_t hour;      /*!< Hour */
+    uint8_t minute;    /*!< Minute */
+    uint8_t second;    /*!< Second */
+    uint16_t thousand; /*!< Thousand */
+} gps_time_t;
+
+/**
+ * @brief GPS date
+ *
+ */
+typedef struct {
+    uint8_t day;   /*!< Day (start from 1) */
+    uint8_t month; /*!< Month (start from 1) */
+    uint16_t year; /*!< Year (start from 2000) */
+} gps_date_t;
+
+/**
+ * @brief NMEA Statement
+ *
+ */
+typedef enum {
+    STATEMENT_UNKNOWN = 0, /*!< Unknown statement */
+    STATEMENT_GGA,         /*!< GGA */
+    STATEMENT_GSA,         /*!< GSA */
+    STATEMENT_RMC,         /*!< RMC */
+    STATEMENT_GSV,         /*!< GSV */
+    STATEMENT_GLL,         /*!< GLL */
+    STATEMENT_VTG,         /*!< VTG */
+    STATEMENT_GNS,         /*!< GNS */
+    STATEMENT_ZDA          /*!< ZDA */
+} nmea_statement_t;
+
+/**
+ * @brief Field groups of gps_t decoded by several statements
+ *
+ */
+typedef enum {
+    NMEA_FIELD_TIME,        /*!< UTC time (GGA, RMC, GLL, GNS, ZDA) */
+    NMEA_FIELD_DATE,        /*!< UTC date (RMC, ZDA) */
+    NMEA_FIELD_POSITION,    /*!< Latitude, longitude (GGA, RMC, GLL, GNS) */
+    NMEA_FIELD_ALTITUDE,    /*!< Altitude (GGA, GNS) */
+    NMEA_FIELD_SPEED,       /*!< Ground speed (RMC, VTG) */
+    NMEA_FIELD_COURSE,      /*!< Course over ground (RMC, VTG) */
+    NMEA_FIELD_VARIATION,   /*!< Magnetic variation (RMC, VTG) */
+    NMEA_FIELD_HDOP,        /*!< Horizontal dilution of precision (GGA, GSA, GNS) */
+    NMEA_FIELD_SATS_IN_USE, /*!< Number of satellites in use (GGA, GNS) */
+    NMEA_FIELD_VALID,       /*!< GPS validity (RMC, GLL) */
+    NMEA_FIELD_GROUP_MAX,   /*!< Number of field groups */
+} nmea_field_group_t;
+
+/**
+ * @brief GPS object
+ *
+ * Fields read by most consumers (position, speed, time) come first and fill the first 32 bytes,
+ * satellite details come last.
+ */
+typedef struct {
+    int32_t latitude;                                              /*!< Latitude (degrees) */
+    int32_t longitude;                                             /*!< Longitude (degrees) */
+    float altitude;                                                /*!< Altitude above ellipsoid (meters) */
+    float speed;                                                   /*!< Ground speed, unit: m/s */
+    float cog;                                                     /*!< Course over ground */
+    gps_time_t tim;                                                /*!< time in UTC */
+    gps_date_t date;                                               /*!< Fix date */
+    bool valid;                                                    /*!< GPS validity */
+    uint8_t sats_in_use;                                           /*!< Number of satellites in use */
+    gps_fix_t fix;                                                 /*!< Fix status */
+    gps_fix_mode_t fix_mode;                                       /*!< Fix mode */
+    float dop_h;                                                   /*!< Horizontal dilution of precision */
+    float dop_p;                                                   /*!< Position dilution of precision  */
+    float dop_v;                                                   /*!< Vertical dilution of precision  */
+    float variation;                                               /*!< Magnetic variation */
+    float geoid_sep;                                               /*!< Geoid separation (meters), altitude above
+                                                                        mean sea level is altitude - geoid_sep */
+    uint8_t sats_in_view;                                          /*!< Number of satellites in view */
+    uint8_t sats_id_in_use[GPS_MAX_SATELLITES_IN_USE];             /*!< ID list of satellite in use */
+    gps_satellite_t sats_desc_in_view[GPS_MAX_SATELLITES_IN_VIEW]; /*!< Information of satellites in view */
+} gps_t;
+
+/**
+ * @brief Compact fix, hot fields first, integer fixed-point units
+ *
+ * Posted as GPS_FIX event, without the satellite details of gps_t.
+ */
+typedef struct __attribute__((packed)) {
+    int32_t latitude;    /*!< Latitude (degrees * 1e7) */
+    int32_t longitude;   /*!< Longitude (degrees * 1e7) */
+    uint32_t time_ms;    /*!< UTC time of day (ms since midnight) */
+    uint16_t speed;      /*!< Ground speed (cm/s) */
+    uint16_t cog;        /*!< Course over ground (0.01 degree) */
+    int32_t altitude;    /*!< Altitude (cm) */
+    uint16_t dop_h;      /*!< Horizontal dilution of precision (0.01) */
+    uint8_t day;         /*!< Day (start from 1) */
+    uint8_t month;       /*!< Month (start from 1) */
+    uint8_t year;        /*!< Year (start from 2000) */
+    uint8_t fix;         /*!< Fix status, gps_fix_t */
+    uint8_t fix_mode;    /*!< Fix mode, gps_fix_mode_t */
+    uint8_t sats_in_use; /*!< Number of satellites in use */
+    uint8_t valid;       /*!< GPS validity */
+} gps_fix_core_t;
+
+/* Payload of GPS_FIX and record of the history, a change of layout changes both */
+#ifdef __cplusplus
+static_assert(sizeof(gps_fix_core_t) == 29, "gps_fix_core_t must stay 29 bytes");
+#else
+_Static_assert(sizeof(gps_fix_core_t) == 29, "gps_fix_core_t must stay 29 bytes");
+#endif
+
+/**
+ * @brief User defined statement parser
+ *
+ * The parser is plugged into the same tokenizer and dispatch table as the built-in statements:
+ * it is called for every item of each statement that matches its name and passed its checksum.
+ *
+ */
+typedef struct {
+    const char *name;  /*!< Statement name, must stay valid while the parser is added.
+                            Proprietary names match by prefix (e.g. "PMTK", "PUBX"), others match the full
+                            address (e.g. "GPTXT") or the type following any talker ID (e.g. "TXT") */
+    void (*parse_item)(void *parser_args, uint8_t item_num, const char *item); /*!< Called for each item,
+                            item 0 is the address field without '$' */
+    void (*statement_end)(void *parser_args); /*!< Called after the last item, optional */
+    void *parser_args; /*!< Parser specific arguments */
+} nmea_parser_statement_parser_t;
+
+#define NMEA_MAX_STATEMENT_LENGTH (128)
+
+/**
+ * @brief Callbacks of NMEA decoder
+ *
+ */
+typedef struct {
+    void (*epoch)(void *ctx, const gps_t *gps, const uint8_t *data, size_t len); /*!< Called when all statements of
+                            an epoch were decoded, with the data being decoded (as passed to nmea_decoder_feed()) */
+    void (*epoch_start)(void *ctx);                                /*!< Called on the first statement of an epoch, optional */
+    void (*unknown)(void *ctx, const char *statement, size_t len); /*!< Called for each statement nobody parses, with
+                            the NUL terminated statement, optional */
+    void *ctx;                                                     /*!< Context of the callbacks */
+} nmea_decoder_cb_t;
+
+/**
+ * @brief NMEA decoder, state of the decoding of one stream of statements
+ *
+ * The decoder does not allocate memory and has no global state: any number of decoders may be embedded in other
+ * objects or arrays and run concurrently, each one by a single thread at a time. It does not depend on FreeRTOS
+ * or on the UART driver, so that it can also be built for the host. Members are private, except the user
+ * statement parsers and the authoritative statements which may be changed between two calls of
+ * nmea_decoder_feed().
+ */
+typedef struct {
+    uint8_t item_num;                              /*!< Current item number */
+    uint8_t asterisk;                              /*!< Asterisk detected flag */
+    uint8_t crc;                                   /*!< Calculated CRC value */
+    uint8_t sat_num;                               /*!< Satellite number */
+    uint8_t sat_count;                             /*!< Satellite count */
+    uint8_t cur_statement;                         /*!< Current statement ID */
+    uint8_t in_statement;                          /*!< Inside a statement ('$' seen, '\r' not yet) */
+    uint8_t ubx_pos;                               /*!< Position in UBX frame header, 0 if not in a UBX frame */
+    uint16_t ubx_remain;                           /*!< Remaining UBX payload and checksum bytes to skip */
+    uint16_t stmt_len;                             /*!< Bytes received for current statement */
+    uint32_t parsed_statement;                     /*!< OR'd of statements that have been parsed */
+    uint32_t all_statements;                       /*!< Statements completing an epoch */
+    char stmt[NMEA_MAX_STATEMENT_LENGTH];          /*!< Current statement, staged until its checksum passed */
+    gps_t gps;                                     /*!< Decoded epoch */
+    uint32_t lost_bytes;                           /*!< Bytes dropped while resynchronizing */
+    uint32_t crc_error;                            /*!< Statements rejected by checksum */
+    uint32_t unknown;                              /*!< Statements without parser */
+    nmea_decoder_cb_t cb;                          /*!< Callbacks */
+#if CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM
+    nmea_parser_statement_parser_t user_parser[CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM]; /*!< User statement parsers */
+#endif
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    char epoch_utc[12];                            /*!< UTC time item of current epoch */
+    uint32_t epoch_filled;                         /*!< Field groups filled in current epoch */
+    uint32_t epoch_seen;                           /*!< Statements decoded in current epoch */
+    uint8_t authority[NMEA_FIELD_GROUP_MAX];       /*!< Authoritative statement of each field group */
+    uint32_t field_decoded;                        /*!< Items converted */
+    uint32_t field_skipped;                        /*!< Items skipped, already filled in the epoch */
+#endif
+} nmea_decoder_t;
+
+/**
+ * @brief Init NMEA decoder
+ *
+ * @param decoder decoder to init, any previous state is discarded
+ * @param statements statements completing an epoch (OR'd of 1 << nmea_statement_t),
+ *                   0 for all statements enabled in the NMEA Statement support menu
+ * @param cb callbacks, copied
+ */
+void nmea_decoder_init(nmea_decoder_t *decoder, uint32_t statements, const nmea_decoder_cb_t *cb);
+
+/**
+ * @brief Decode bytes received from a GPS receiver
+ *
+ * Statements may be split across calls at any byte. Each statement is staged in the decoder while its
+ * checksum is computed, its fields are decoded into gps_t only once the checksum passed. Bytes outside of
+ * a statement are dropped and counted, decoding resynchronizes on the next '$'. UBX frames found between
+ * statements are skipped. Any byte sequence is safe: damaged items that still pass the checksum (empty or
+ * short times and dates, nan, out of range coordinates) are ignored or saturated, never read past.
+ *
+ * @param decoder NMEA decoder
+ * @param data received bytes
+ * @param len number of bytes in data
+ */
+void nmea_decoder_feed(nmea_decoder_t *decoder, const uint8_t *data, size_t len);
+
+/**
+ * @brief Check whether the address field of a statement matches a statement name
+ *
+ * Proprietary addresses ('P' + manufacturer) match by prefix (e.g. "PMTK" matches "PMTK001"),
+ * other addresses match either in full (e.g. "GPTXT") or by the type following the talker ID (e.g. "TXT").
+ *
+ * @param addr address field, without '$'
+ * @param addr_len length of address field
+ * @param name statement name
+ * @return true if matched
+ */
+bool nmea_decoder_address_match(const char *addr, size_t addr_len, const char *name);
+
+/**
+ * @brief Fill the compact fix from a decoded epoch
+ *
+ * @param gps decoded epoch
+ * @param core compact fix will be saved in this pointer
+ */
+void nmea_decoder_fix_core(const gps_t *gps, gps_fix_core_t *core);
+
+/**
+ * @brief Fixed-point sine, linear interpolation of a quarter wave table
+ *
+ * @param cdeg angle (0.01 degree), any value
+ * @return int32_t sine (Q15)
+ */
+int32_t nmea_sin_q15(int32_t cdeg);
+
+/**
+ * @brief Fixed-point cosine
+ *
+ * @param cdeg angle (0.01 degree), any value
+ * @return int32_t cosine (Q15)
+ */
+int32_t nmea_cos_q15(int32_t cdeg);
+
+/**
+ * @brief Get time of a compact fix
+ *
+ * @param fix compact fix
+ * @return int64_t time of fix (ms since 2000-01-01 UTC), -1 if the date is invalid
+ */
+int64_t nmea_fix_utc_ms(const gps_fix_core_t *fix);
+
+#ifdef __cplusplus
+}
+#endif
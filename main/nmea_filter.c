@@ -0,0 +1,247 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <string.h>
+#include "nmea_filter.h"
+
+#define NMEA_FILTER_MM_PER_DEGREE (111319490LL) /* Length of one degree of latitude */
+#define NMEA_FILTER_RANGE_MM (50000000)        /* The origin follows the filtered position further than this */
+#define NMEA_FILTER_P00_MAX (10000000000LL)    /* Position sigma 100 m, restart beyond (keeps int64 products) */
+#define NMEA_FILTER_P11_MAX (100000000LL)      /* Velocity sigma 10 m/s, restart beyond */
+#define NMEA_FILTER_MS_PER_DAY (86400000)
+
+void nmea_filter_init(nmea_filter_t *filter, const nmea_filter_config_t *config)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->config = *config;
+}
+
+/**
+ * @brief Project a position into the local frame
+ *
+ * @param filter position filter
+ * @param latitude latitude (degrees * 1e7)
+ * @param longitude longitude (degrees * 1e7)
+ * @param local east and north (mm) will be saved in this array
+ */
+static void nmea_filter_local(const nmea_filter_t *filter, int32_t latitude, int32_t longitude, int64_t local[2])
+{
+    int64_t dlon = (int64_t)longitude - filter->origin_lon;
+    if (dlon >= 1800000000) {
+        dlon -= 3600000000LL;
+    } else if (dlon < -1800000000) {
+        dlon += 3600000000LL;
+    }
+    local[0] = (dlon * NMEA_FILTER_MM_PER_DEGREE / 10000000 * filter->cos_lat) >> 15;
+    local[1] = ((int64_t)latitude - filter->origin_lat) * NMEA_FILTER_MM_PER_DEGREE / 10000000;
+}
+
+/**
+ * @brief Write the filtered position to a fix
+ *
+ * @param filter position filter
+ * @param fix latitude and longitude are replaced
+ */
+static void nmea_filter_output(const nmea_filter_t *filter, gps_fix_core_t *fix)
+{
+    int64_t east = (int64_t)filter->axis[0].pos * 32768 / filter->cos_lat;
+    int64_t longitude = filter->origin_lon + east * 10000000 / NMEA_FILTER_MM_PER_DEGREE;
+    if (longitude >= 1800000000) {
+        longitude -= 3600000000LL;
+    } else if (longitude < -1800000000) {
+        longitude += 3600000000LL;
+    }
+    fix->latitude = filter->origin_lat + (int32_t)((int64_t)filter->axis[1].pos * 10000000 /
+                    NMEA_FILTER_MM_PER_DEGREE);
+    fix->longitude = (int32_t)longitude;
+}
+
+/**
+ * @brief Move the origin of the local frame to a position
+ *
+ * @param filter position filter
+ * @param latitude latitude (degrees * 1e7)
+ * @param longitude longitude (degrees * 1e7)
+ */
+static void nmea_filter_origin(nmea_filter_t *filter, int32_t latitude, int32_t longitude)
+{
+    filter->origin_lat = latitude;
+    filter->origin_lon = longitude;
+    /* Clamp near the poles like the track stage, east is then stretched at most 100 times */
+    filter->cos_lat = nmea_cos_q15(latitude / 100000);
+    if (filter->cos_lat < 328) {
+        filter->cos_lat = 328;
+    }
+    filter->axis[0].pos = 0;
+    filter->axis[1].pos = 0;
+}
+
+/**
+ * @brief Restart the filter at a measurement
+ *
+ * @param filter position filter
+ * @param fix valid fix
+ * @param vel measured east and north velocity (mm/s)
+ * @param r position variance of the fix (mm^2)
+ * @param rv velocity variance (mm^2/s^2)
+ */
+static void nmea_filter_restart(nmea_filter_t *filter, const gps_fix_core_t *fix, const int32_t vel[2], int64_t r,
+                                int64_t rv)
+{
+    nmea_filter_origin(filter, fix->latitude, fix->longitude);
+    for (int i = 0; i < 2; i++) {
+        nmea_filter_axis_t *axis = &filter->axis[i];
+        axis->vel = vel[i];
+        axis->p00 = r < NMEA_FILTER_P00_MAX ? r : NMEA_FILTER_P00_MAX;
+        axis->p01 = 0;
+        axis->p11 = rv;
+    }
+    filter->outlier_ms = 0;
+    filter->running = true;
+    filter->settled = false;
+}
+
+/**
+ * @brief Predict one axis over a time step
+ *
+ * @param axis axis state
+ * @param dt_ms time step (ms), NMEA_FILTER_MAX_GAP_MS at most
+ * @param q acceleration variance (mm^2/s^4)
+ */
+static void nmea_filter_predict(nmea_filter_axis_t *axis, int64_t dt_ms, int64_t q)
+{
+    /* Q of white acceleration noise: q * [dt^4/4 dt^3/2; dt^3/2 dt^2] */
+    int64_t q11 = q * dt_ms * dt_ms / 1000000;
+    axis->pos += (int32_t)((int64_t)axis->vel * dt_ms / 1000);
+    axis->p00 += 2 * axis->p01 * dt_ms / 1000 + axis->p11 * dt_ms * dt_ms / 1000000 + q11 * dt_ms * dt_ms / 4000000;
+    axis->p01 += axis->p11 * dt_ms / 1000 + q11 * dt_ms / 2000;
+    axis->p11 += q11;
+}
+
+/**
+ * @brief Update one axis with a measured velocity
+ *
+ * @param axis axis state
+ * @param vel measured velocity (mm/s)
+ * @param rv velocity variance (mm^2/s^2)
+ */
+static void nmea_filter_velocity(nmea_filter_axis_t *axis, int32_t vel, int64_t rv)
+{
+    int64_t y = (int64_t)vel - axis->vel;
+    int64_t s = axis->p11 + rv;
+    axis->pos += (int32_t)(axis->p01 * y / s);
+    axis->vel += (int32_t)(axis->p11 * y / s);
+    axis->p00 -= axis->p01 * axis->p01 / s;
+    axis->p01 -= axis->p11 * axis->p01 / s;
+    axis->p11 -= axis->p11 * axis->p11 / s;
+}
+
+/**
+ * @brief Update one axis with a measured position
+ *
+ * @param axis axis state
+ * @param y innovation, measured minus predicted position (mm)
+ * @param s innovation variance (mm^2)
+ */
+static void nmea_filter_position(nmea_filter_axis_t *axis, int64_t y, int64_t s)
+{
+    /* P00^2 does not fit, gain of P00 in Q16 */
+    int64_t k = (axis->p00 << 16) / s;
+    axis->pos += (int32_t)(axis->p00 * y / s);
+    axis->vel += (int32_t)(axis->p01 * y / s);
+    axis->p11 -= axis->p01 * axis->p01 / s;
+    axis->p00 -= (k * axis->p00) >> 16;
+    axis->p01 -= (k * axis->p01) >> 16;
+}
+
+bool nmea_filter_update(nmea_filter_t *filter, gps_fix_core_t *fix)
+{
+    if (!fix->valid) {
+        return false;
+    }
+    const nmea_filter_config_t *config = &filter->config;
+    /* Measurement noise, HDOP below 0.5 is not trusted */
+    int64_t sigma = (int64_t)config->uere * 10 * (fix->dop_h > 50 ? fix->dop_h : 50) / 100;
+    int64_t r = sigma * sigma;
+    int64_t rv = (int64_t)config->speed_error * config->speed_error * 100;
+    int32_t speed = fix->speed * 10;
+    int32_t vel[2] = {
+        (int32_t)(((int64_t)speed * nmea_sin_q15(fix->cog)) >> 15),
+        (int32_t)(((int64_t)speed * nmea_cos_q15(fix->cog)) >> 15),
+    };
+    filter->filtered++;
+
+    uint32_t dt_ms = 0;
+    if (filter->running) {
+        dt_ms = (fix->time_ms + NMEA_FILTER_MS_PER_DAY - filter->last_ms) % NMEA_FILTER_MS_PER_DAY;
+    }
+    filter->last_ms = fix->time_ms;
+    if (!filter->running || dt_ms > NMEA_FILTER_MAX_GAP_MS) {
+        filter->resets += filter->running;
+        nmea_filter_restart(filter, fix, vel, r, rv);
+        return true;
+    }
+    int64_t q = (int64_t)config->accel * config->accel * 100;
+    for (int i = 0; i < 2; i++) {
+        nmea_filter_axis_t *axis = &filter->axis[i];
+        nmea_filter_predict(axis, dt_ms, q);
+        if (axis->p00 > NMEA_FILTER_P00_MAX || axis->p11 > NMEA_FILTER_P11_MAX) {
+            filter->resets++;
+            nmea_filter_restart(filter, fix, vel, r, rv);
+            return true;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        nmea_filter_velocity(&filter->axis[i], vel[i], rv);
+    }
+
+    /* Innovation test, squared Mahalanobis distance of both axes (Q8) */
+    int64_t z[2];
+    int64_t y[2];
+    int64_t s[2];
+    int64_t d2 = 0;
+    nmea_filter_local(filter, fix->latitude, fix->longitude, z);
+    for (int i = 0; i < 2; i++) {
+        y[i] = z[i] - filter->axis[i].pos;
+        s[i] = filter->axis[i].p00 + r;
+        if (y[i] > 2 * NMEA_FILTER_RANGE_MM || y[i] < -2 * NMEA_FILTER_RANGE_MM) {
+            d2 = INT64_MAX;
+            break;
+        }
+        d2 += (y[i] * y[i] << 8) / s[i];
+    }
+    if (d2 > ((int64_t)config->gate * config->gate << 8)) {
+        filter->rejected++;
+        filter->outlier_ms += dt_ms;
+        /* Until a position is accepted the filter may have started on an outlier, move on to the next fix */
+        if (!filter->settled || filter->outlier_ms >= config->reset_ms) {
+            filter->resets++;
+            nmea_filter_restart(filter, fix, vel, r, rv);
+            return true;
+        }
+    } else {
+        filter->outlier_ms = 0;
+        filter->settled = true;
+        for (int i = 0; i < 2; i++) {
+            nmea_filter_position(&filter->axis[i], y[i], s[i]);
+        }
+    }
+    nmea_filter_output(filter, fix);
+    if (filter->axis[0].pos > NMEA_FILTER_RANGE_MM || filter->axis[0].pos < -NMEA_FILTER_RANGE_MM ||
+            filter->axis[1].pos > NMEA_FILTER_RANGE_MM || filter->axis[1].pos < -NMEA_FILTER_RANGE_MM) {
+        nmea_filter_origin(filter, fix->latitude, fix->longitude);
+    }
+    return true;
+}
@@ -0,0 +1,100 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "nmea_decoder.h"
+
+#define NMEA_FILTER_MAX_GAP_MS (2000) /*!< Fixes further apart restart the filter */
+
+/**
+ * @brief Configuration of the position filter
+ *
+ */
+typedef struct {
+    uint16_t uere;        /*!< Position error of the receiver at HDOP 1, one sigma (cm), 100 at least */
+    uint16_t speed_error; /*!< Ground speed error, one sigma (cm/s), 10 at least */
+    uint16_t accel;       /*!< Acceleration of the vehicle, one sigma (cm/s^2), 2000 at most */
+    uint8_t gate;         /*!< A fix further from the prediction than this many sigmas of the expected innovation
+                               is an outlier */
+    uint16_t reset_ms;    /*!< Outliers for this long restart the filter at the measured position (ms) */
+} nmea_filter_config_t;
+
+/**
+ * @brief State of one axis of the local frame, fixed-point
+ *
+ */
+typedef struct {
+    int32_t pos; /*!< Position (mm) */
+    int32_t vel; /*!< Velocity (mm/s) */
+    int64_t p00; /*!< Variance of position (mm^2) */
+    int64_t p01; /*!< Covariance of position and velocity (mm^2/s) */
+    int64_t p11; /*!< Variance of velocity (mm^2/s^2) */
+} nmea_filter_axis_t;
+
+/**
+ * @brief Position filter, a constant velocity Kalman filter on east and north
+ *
+ */
+typedef struct {
+    nmea_filter_config_t config; /*!< Configuration */
+    nmea_filter_axis_t axis[2];  /*!< East and north */
+    int32_t origin_lat;          /*!< Latitude of the local frame origin (degrees * 1e7) */
+    int32_t origin_lon;          /*!< Longitude of the local frame origin (degrees * 1e7) */
+    int32_t cos_lat;             /*!< Cosine of the origin latitude (Q15) */
+    uint32_t last_ms;            /*!< UTC time of the previous valid fix (ms) */
+    uint32_t outlier_ms;         /*!< Time since the last accepted position (ms) */
+    bool running;                /*!< The state is initialized */
+    bool settled;                /*!< A position was accepted since the filter started */
+    uint32_t filtered;           /*!< Fixes filtered */
+    uint32_t rejected;           /*!< Positions rejected as outliers */
+    uint32_t resets;             /*!< Restarts after a gap or a run of outliers */
+} nmea_filter_t;
+
+/**
+ * @brief Init position filter
+ *
+ * @param filter position filter
+ * @param config configuration, copied
+ */
+void nmea_filter_init(nmea_filter_t *filter, const nmea_filter_config_t *config);
+
+/**
+ * @brief Filter the position of a fix
+ *
+ * The state is predicted to the time of the fix, then updated with the ground speed and course, then with the
+ * position unless it fails the innovation test: the distance from the prediction, normalized by the spread
+ * expected from the filter uncertainty and from HDOP, must stay within config.gate. The uncertainty of the
+ * prediction grows with the time since the last accepted position, so the test follows the speed reported by
+ * the receiver and loosens during a run of outliers. An outlier is replaced by the prediction.
+ *
+ * Constant time, integer arithmetic only. Invalid fixes are left untouched and do not change the state.
+ *
+ * @param filter position filter
+ * @param fix decoded fix, latitude and longitude are replaced by the filtered position
+ * @return true if the position was filtered, false if the fix is invalid
+ */
+bool nmea_filter_update(nmea_filter_t *filter, gps_fix_core_t *fix);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,902 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "nmea_fix_log.h"
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+static const char *FIX_LOG_TAG = "nmea_fix_log";
+#else
+/* Host build of the tools: a pthread mutex in place of the FreeRTOS one, no flash partition */
+#include <pthread.h>
+#define ESP_LOGE(tag, format, ...) ((void)0)
+#define ESP_LOGI(tag, format, ...) ((void)0)
+#endif
+
+#define NMEA_FIX_LOG_BLOCK_SIZE CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE
+#define NMEA_FIX_LOG_MAGIC (0x314C464EUL) /* "NFL1" */
+#define NMEA_FIX_LOG_RECORD_MAX_SIZE (64)
+#define NMEA_FIX_LOG_MS_PER_DAY (86400000LL)
+
+/**
+ * @brief Fields present in a record, other fields are predicted
+ *
+ * Bit 7 is never set, so an erased byte (0xFF) ends the records of a block.
+ */
+#define NMEA_FIX_LOG_DT     (1 << 0) /*!< Change of the time step (ms) */
+#define NMEA_FIX_LOG_LAT    (1 << 1) /*!< Change of the latitude step (1e-7 degree) */
+#define NMEA_FIX_LOG_LON    (1 << 2) /*!< Change of the longitude step (1e-7 degree) */
+#define NMEA_FIX_LOG_ALT    (1 << 3) /*!< Altitude delta (cm) */
+#define NMEA_FIX_LOG_SPEED  (1 << 4) /*!< Speed delta (cm/s) */
+#define NMEA_FIX_LOG_COG    (1 << 5) /*!< Course delta (0.01 degree) */
+#define NMEA_FIX_LOG_STATUS (1 << 6) /*!< Status byte, satellites in use and HDOP */
+#define NMEA_FIX_LOG_END    (0xFF)
+
+/**
+ * @brief Block header, the first fix of the block is stored in full
+ *
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;       /*!< NMEA_FIX_LOG_MAGIC, written last */
+    uint32_t seq;         /*!< Sequence number of the block */
+    int64_t start_utc_ms; /*!< Time of the first fix (ms since 2000-01-01 UTC) */
+    int32_t latitude;     /*!< Latitude of the first fix (degrees * 1e7) */
+    int32_t longitude;    /*!< Longitude of the first fix (degrees * 1e7) */
+    int32_t altitude;     /*!< Altitude of the first fix (cm) */
+    uint16_t speed;       /*!< Speed of the first fix (cm/s) */
+    uint16_t cog;         /*!< Course of the first fix (0.01 degree) */
+    uint16_t dop_h;       /*!< HDOP of the first fix (0.01) */
+    uint8_t status;       /*!< Fix status, fix mode and validity of the first fix */
+    uint8_t sats_in_use;  /*!< Satellites in use of the first fix */
+} nmea_fix_log_header_t;
+
+/**
+ * @brief Decoder state, the last fix and the steps used to predict the next one
+ *
+ */
+typedef struct {
+    int64_t utc_ms;      /*!< Time of the last fix */
+    int32_t latitude;    /*!< Latitude of the last fix */
+    int32_t longitude;   /*!< Longitude of the last fix */
+    int32_t altitude;    /*!< Altitude of the last fix */
+    int32_t speed;       /*!< Speed of the last fix */
+    int32_t cog;         /*!< Course of the last fix */
+    uint16_t dop_h;      /*!< HDOP of the last fix */
+    uint8_t status;      /*!< Status byte of the last fix */
+    uint8_t sats_in_use; /*!< Satellites in use of the last fix */
+    int64_t dt;          /*!< Last time step */
+    int32_t dlat;        /*!< Last latitude step */
+    int32_t dlon;        /*!< Last longitude step */
+} nmea_fix_log_state_t;
+
+/**
+ * @brief Fix log runtime structure
+ *
+ */
+typedef struct {
+    nmea_fix_log_storage_t storage; /*!< Storage of the log */
+#ifdef ESP_PLATFORM
+    SemaphoreHandle_t lock;         /*!< Serializes storage accesses of the writer and readers */
+#else
+    pthread_mutex_t lock;           /*!< Serializes storage accesses of the writer and readers */
+#endif
+    uint32_t blocks;                /*!< Number of blocks in the storage */
+    uint32_t head;                  /*!< Block being written */
+    uint32_t head_seq;              /*!< Sequence number of the block being written */
+    uint32_t used_blocks;           /*!< Number of blocks holding fixes, ending with head */
+    uint32_t used;                  /*!< Bytes used in the head block, 0 to open a new block on next append */
+    nmea_fix_log_state_t state;     /*!< State after the last fix appended */
+    uint32_t fixes;                 /*!< Number of fixes appended */
+    uint32_t bytes;                 /*!< Number of bytes written */
+    uint32_t dropped;               /*!< Number of fixes not appended */
+} nmea_fix_log_t;
+
+#ifdef ESP_PLATFORM
+static bool nmea_fix_log_lock_create(nmea_fix_log_t *log)
+{
+    log->lock = xSemaphoreCreateMutex();
+    return log->lock != NULL;
+}
+
+static void nmea_fix_log_lock_delete(nmea_fix_log_t *log)
+{
+    vSemaphoreDelete(log->lock);
+}
+
+static void nmea_fix_log_lock(nmea_fix_log_t *log)
+{
+    xSemaphoreTake(log->lock, portMAX_DELAY);
+}
+
+static void nmea_fix_log_unlock(nmea_fix_log_t *log)
+{
+    xSemaphoreGive(log->lock);
+}
+#else
+static bool nmea_fix_log_lock_create(nmea_fix_log_t *log)
+{
+    return pthread_mutex_init(&log->lock, NULL) == 0;
+}
+
+static void nmea_fix_log_lock_delete(nmea_fix_log_t *log)
+{
+    pthread_mutex_destroy(&log->lock);
+}
+
+static void nmea_fix_log_lock(nmea_fix_log_t *log)
+{
+    pthread_mutex_lock(&log->lock);
+}
+
+static void nmea_fix_log_unlock(nmea_fix_log_t *log)
+{
+    pthread_mutex_unlock(&log->lock);
+}
+#endif
+
+/**
+ * @brief Put a signed integer as zigzag LEB128 variable length integer
+ *
+ * @param buf buffer, at least 10 bytes
+ * @param value value to put
+ * @return size_t number of bytes written
+ */
+static size_t nmea_varint_put(uint8_t *buf, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t len = 0;
+    while (zigzag >= 0x80) {
+        buf[len++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    buf[len++] = (uint8_t)zigzag;
+    return len;
+}
+
+/**
+ * @brief Get a signed integer put by nmea_varint_put()
+ *
+ * @param buf buffer
+ * @param size size of the buffer
+ * @param pos position in the buffer, advanced past the integer
+ * @param value value will be saved in this pointer
+ * @return true on success, false if the integer is truncated or too long
+ */
+static bool nmea_varint_get(const uint8_t *buf, size_t size, size_t *pos, int64_t *value)
+{
+    uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64 && *pos < size; shift += 7) {
+        uint8_t byte = buf[(*pos)++];
+        zigzag |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint8_t nmea_fix_log_status(const gps_fix_core_t *fix)
+{
+    return (fix->fix & 0x03) | ((fix->fix_mode & 0x03) << 2) | ((fix->valid ? 1 : 0) << 4);
+}
+
+/**
+ * @brief Apply a course delta, wrapping around north
+ *
+ */
+static int32_t nmea_fix_log_add_cog(int32_t cog, int32_t delta)
+{
+    cog += delta;
+    if (cog < 0) {
+        cog += 36000;
+    } else if (cog > 36000) {
+        cog -= 36000;
+    }
+    return cog;
+}
+
+/**
+ * @brief Get the shortest course delta from a course to another, 360.00 degrees is kept as is
+ *
+ */
+static int32_t nmea_fix_log_delta_cog(int32_t from, int32_t to)
+{
+    int32_t delta = to - from;
+    int32_t wrapped = delta >= 18000 ? delta - 36000 : (delta < -18000 ? delta + 36000 : delta);
+    return nmea_fix_log_add_cog(from, wrapped) == to ? wrapped : delta;
+}
+
+static void nmea_fix_log_state_from_header(const nmea_fix_log_header_t *header, nmea_fix_log_state_t *state)
+{
+    memset(state, 0, sizeof(nmea_fix_log_state_t));
+    state->utc_ms = header->start_utc_ms;
+    state->latitude = header->latitude;
+    state->longitude = header->longitude;
+    state->altitude = header->altitude;
+    state->speed = header->speed;
+    state->cog = header->cog;
+    state->dop_h = header->dop_h;
+    state->status = header->status;
+    state->sats_in_use = header->sats_in_use;
+}
+
+/**
+ * @brief Encode a fix as a record, against the state of the previous fix
+ *
+ * The time, latitude and longitude are predicted with the previous step (constant rate), only the change
+ * of step is stored. Other fields are stored as delta. Fields with nothing to store are omitted.
+ *
+ * @param state state of the previous fix, updated to the encoded fix
+ * @param fix fix to encode
+ * @param utc_ms time of the fix
+ * @param buf buffer, at least NMEA_FIX_LOG_RECORD_MAX_SIZE bytes
+ * @return size_t size of the record
+ */
+static size_t nmea_fix_log_encode(nmea_fix_log_state_t *state, const gps_fix_core_t *fix, int64_t utc_ms, uint8_t *buf)
+{
+    int64_t dt = utc_ms - state->utc_ms;
+    int32_t dlat = fix->latitude - state->latitude;
+    int32_t dlon = fix->longitude - state->longitude;
+    int32_t dalt = fix->altitude - state->altitude;
+    int32_t dspeed = fix->speed - state->speed;
+    int32_t dcog = nmea_fix_log_delta_cog(state->cog, fix->cog);
+    uint8_t status = nmea_fix_log_status(fix);
+    uint8_t mask = 0;
+    size_t len = 1;
+
+    if (dt != state->dt) {
+        mask |= NMEA_FIX_LOG_DT;
+        len += nmea_varint_put(buf + len, dt - state->dt);
+    }
+    if (dlat != state->dlat) {
+        mask |= NMEA_FIX_LOG_LAT;
+        len += nmea_varint_put(buf + len, (int64_t)dlat - state->dlat);
+    }
+    if (dlon != state->dlon) {
+        mask |= NMEA_FIX_LOG_LON;
+        len += nmea_varint_put(buf + len, (int64_t)dlon - state->dlon);
+    }
+    if (dalt) {
+        mask |= NMEA_FIX_LOG_ALT;
+        len += nmea_varint_put(buf + len, dalt);
+    }
+    if (dspeed) {
+        mask |= NMEA_FIX_LOG_SPEED;
+        len += nmea_varint_put(buf + len, dspeed);
+    }
+    if (dcog) {
+        mask |= NMEA_FIX_LOG_COG;
+        len += nmea_varint_put(buf + len, dcog);
+    }
+    if (status != state->status || fix->sats_in_use != state->sats_in_use || fix->dop_h != state->dop_h) {
+        mask |= NMEA_FIX_LOG_STATUS;
+        buf[len++] = status;
+        buf[len++] = fix->sats_in_use;
+        len += nmea_varint_put(buf + len, fix->dop_h);
+    }
+    buf[0] = mask;
+
+    state->utc_ms = utc_ms;
+    state->latitude = fix->latitude;
+    state->longitude = fix->longitude;
+    state->altitude = fix->altitude;
+    state->speed = fix->speed;
+    state->cog = fix->cog;
+    state->dop_h = fix->dop_h;
+    state->status = status;
+    state->sats_in_use = fix->sats_in_use;
+    state->dt = dt;
+    state->dlat = dlat;
+    state->dlon = dlon;
+    return len;
+}
+
+/**
+ * @brief Decode the record at a position of a block, reverse of nmea_fix_log_encode()
+ *
+ * @param buf block
+ * @param size size of the block
+ * @param pos position of the record, advanced past it
+ * @param state state of the previous fix, updated to the decoded fix
+ * @return true on success, false at the end of the records or on a truncated record
+ */
+static bool nmea_fix_log_decode(const uint8_t *buf, size_t size, size_t *pos, nmea_fix_log_state_t *state)
+{
+    if (*pos >= size || buf[*pos] == NMEA_FIX_LOG_END) {
+        return false;
+    }
+    nmea_fix_log_state_t next = *state;
+    size_t p = *pos;
+    uint8_t mask = buf[p++];
+    int64_t value = 0;
+
+    if (mask & NMEA_FIX_LOG_DT) {
+        if (!nmea_varint_get(buf, size, &p, &value)) {
+            return false;
+        }
+        next.dt += value;
+    }
+    if (mask & NMEA_FIX_LOG_LAT) {
+        if (!nmea_varint_get(buf, size, &p, &value)) {
+            return false;
+        }
+        next.dlat += (int32_t)value;
+    }
+    if (mask & NMEA_FIX_LOG_LON) {
+        if (!nmea_varint_get(buf, size, &p, &value)) {
+            return false;
+        }
+        next.dlon += (int32_t)value;
+    }
+    next.utc_ms += next.dt;
+    next.latitude += next.dlat;
+    next.longitude += next.dlon;
+    if (mask & NMEA_FIX_LOG_ALT) {
+        if (!nmea_varint_get(buf, size, &p, &value)) {
+            return false;
+        }
+        next.altitude += (int32_t)value;
+    }
+    if (mask & NMEA_FIX_LOG_SPEED) {
+        if (!nmea_varint_get(buf, size, &p, &value)) {
+            return false;
+        }
+        next.speed += (int32_t)value;
+    }
+    if (mask & NMEA_FIX_LOG_COG) {
+        if (!nmea_varint_get(buf, size, &p, &value)) {
+            return false;
+        }
+        next.cog = nmea_fix_log_add_cog(next.cog, (int32_t)value);
+    }
+    if (mask & NMEA_FIX_LOG_STATUS) {
+        if (p + 2 > size) {
+            return false;
+        }
+        next.status = buf[p++];
+        next.sats_in_use = buf[p++];
+        if (!nmea_varint_get(buf, size, &p, &value)) {
+            return false;
+        }
+        next.dop_h = (uint16_t)value;
+    }
+    *state = next;
+    *pos = p;
+    return true;
+}
+
+/**
+ * @brief Convert a decoder state to a fix, date and time of day included
+ *
+ */
+static void nmea_fix_log_state_to_fix(const nmea_fix_log_state_t *state, gps_fix_core_t *fix)
+{
+    static const uint8_t days_in_month[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int32_t days = (int32_t)(state->utc_ms / NMEA_FIX_LOG_MS_PER_DAY);
+    uint8_t year = 0;
+    uint8_t month = 0;
+
+    fix->time_ms = (uint32_t)(state->utc_ms % NMEA_FIX_LOG_MS_PER_DAY);
+    /* Every 4th year is a leap year from 2000 to 2099 */
+    while (days >= ((year % 4) ? 365 : 366)) {
+        days -= (year % 4) ? 365 : 366;
+        year++;
+    }
+    while (month < 11 && days >= days_in_month[month] + (month == 1 && (year % 4) == 0)) {
+        days -= days_in_month[month] + (month == 1 && (year % 4) == 0);
+        month++;
+    }
+    fix->year = year;
+    fix->month = month + 1;
+    fix->day = days + 1;
+    fix->latitude = state->latitude;
+    fix->longitude = state->longitude;
+    fix->altitude = state->altitude;
+    fix->speed = (uint16_t)state->speed;
+    fix->cog = (uint16_t)state->cog;
+    fix->dop_h = state->dop_h;
+    fix->fix = state->status & 0x03;
+    fix->fix_mode = (state->status >> 2) & 0x03;
+    fix->valid = (state->status >> 4) & 0x01;
+    fix->sats_in_use = state->sats_in_use;
+}
+
+static inline uint32_t nmea_fix_log_block_offset(const nmea_fix_log_t *log, uint32_t block)
+{
+    (void)log;
+    return block * NMEA_FIX_LOG_BLOCK_SIZE;
+}
+
+/**
+ * @brief Get the block holding a sequence number
+ *
+ * @return true if the block still holds fixes
+ */
+static bool nmea_fix_log_seq_block(const nmea_fix_log_t *log, uint32_t seq, uint32_t *block)
+{
+    uint32_t age = log->head_seq - seq;
+    if (age >= log->used_blocks) {
+        return false;
+    }
+    *block = (log->head + log->blocks - age) % log->blocks;
+    return true;
+}
+
+static esp_err_t nmea_fix_log_read_header(nmea_fix_log_t *log, uint32_t block, nmea_fix_log_header_t *header)
+{
+    return log->storage.read(log->storage.ctx, nmea_fix_log_block_offset(log, block), header,
+                             sizeof(nmea_fix_log_header_t));
+}
+
+/**
+ * @brief Start a new block with a fix, erasing the oldest block if the storage is full
+ *
+ */
+static esp_err_t nmea_fix_log_new_block(nmea_fix_log_t *log, const gps_fix_core_t *fix, int64_t utc_ms)
+{
+    uint32_t block = (log->head + 1) % log->blocks;
+    uint32_t offset = nmea_fix_log_block_offset(log, block);
+    nmea_fix_log_header_t header = {
+        .magic = NMEA_FIX_LOG_MAGIC,
+        .seq = log->head_seq + 1,
+        .start_utc_ms = utc_ms,
+        .latitude = fix->latitude,
+        .longitude = fix->longitude,
+        .altitude = fix->altitude,
+        .speed = fix->speed,
+        .cog = fix->cog,
+        .dop_h = fix->dop_h,
+        .status = nmea_fix_log_status(fix),
+        .sats_in_use = fix->sats_in_use,
+    };
+
+    log->used = 0;
+    if (log->used_blocks == log->blocks) {
+        log->used_blocks--;
+    }
+    esp_err_t err = log->storage.erase(log->storage.ctx, offset, NMEA_FIX_LOG_BLOCK_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    /* Write the magic last, a header torn by a reset is not taken as a block */
+    err = log->storage.write(log->storage.ctx, offset + sizeof(header.magic), (const uint8_t *)&header + sizeof(header.magic),
+                             sizeof(header) - sizeof(header.magic));
+    if (err == ESP_OK) {
+        err = log->storage.write(log->storage.ctx, offset, &header.magic, sizeof(header.magic));
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    log->head = block;
+    log->head_seq = header.seq;
+    log->used_blocks++;
+    log->used = sizeof(header);
+    log->bytes += sizeof(header);
+    nmea_fix_log_state_from_header(&header, &log->state);
+    return ESP_OK;
+}
+
+/**
+ * @brief Find the blocks holding fixes and the end of the last one
+ *
+ */
+static esp_err_t nmea_fix_log_scan(nmea_fix_log_t *log)
+{
+    nmea_fix_log_header_t header;
+    bool found = false;
+    esp_err_t err = ESP_OK;
+
+    log->head = log->blocks - 1;
+    log->head_seq = UINT32_MAX;
+    log->used_blocks = 0;
+    log->used = 0;
+    for (uint32_t i = 0; i < log->blocks; i++) {
+        err = nmea_fix_log_read_header(log, i, &header);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (header.magic == NMEA_FIX_LOG_MAGIC && (!found || (int32_t)(header.seq - log->head_seq) > 0)) {
+            found = true;
+            log->head = i;
+            log->head_seq = header.seq;
+        }
+    }
+    if (!found) {
+        return ESP_OK;
+    }
+    /* Blocks are written in sequence, walk back from the last one */
+    log->used_blocks = 1;
+    while (log->used_blocks < log->blocks) {
+        uint32_t block = (log->head + log->blocks - log->used_blocks) % log->blocks;
+        err = nmea_fix_log_read_header(log, block, &header);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (header.magic != NMEA_FIX_LOG_MAGIC || header.seq != log->head_seq - log->used_blocks) {
+            break;
+        }
+        log->used_blocks++;
+    }
+    /* Rebuild the encoder state from the fixes of the last block */
+    uint8_t *buf = malloc(NMEA_FIX_LOG_BLOCK_SIZE);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = log->storage.read(log->storage.ctx, nmea_fix_log_block_offset(log, log->head), buf, NMEA_FIX_LOG_BLOCK_SIZE);
+    if (err == ESP_OK) {
+        size_t pos = sizeof(nmea_fix_log_header_t);
+        nmea_fix_log_state_from_header((const nmea_fix_log_header_t *)buf, &log->state);
+        while (nmea_fix_log_decode(buf, NMEA_FIX_LOG_BLOCK_SIZE, &pos, &log->state)) {
+        }
+        /* Append after the last record, unless it was torn by a reset */
+        if (pos == NMEA_FIX_LOG_BLOCK_SIZE || buf[pos] == NMEA_FIX_LOG_END) {
+            log->used = pos;
+        }
+    }
+    free(buf);
+    return err;
+}
+
+#ifdef ESP_PLATFORM
+static esp_err_t nmea_fix_log_partition_read(void *ctx, uint32_t offset, void *data, size_t size)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static esp_err_t nmea_fix_log_partition_write(void *ctx, uint32_t offset, const void *data, size_t size)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static esp_err_t nmea_fix_log_partition_erase(void *ctx, uint32_t offset, size_t size)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, size);
+}
+
+/**
+ * @brief Storage of a fix log on a flash partition
+ *
+ * @param partition partition to store the log on
+ * @param storage storage will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: partition is NULL or smaller than two blocks, or the block size is not sector aligned
+ */
+esp_err_t nmea_fix_log_storage_partition(const esp_partition_t *partition, nmea_fix_log_storage_t *storage)
+{
+    if (!partition || partition->size < 2 * NMEA_FIX_LOG_BLOCK_SIZE ||
+            (NMEA_FIX_LOG_BLOCK_SIZE % SPI_FLASH_SEC_SIZE) != 0) {
+        ESP_LOGE(FIX_LOG_TAG, "partition too small or block size not a multiple of %d", SPI_FLASH_SEC_SIZE);
+        return ESP_ERR_INVALID_ARG;
+    }
+    storage->read = nmea_fix_log_partition_read;
+    storage->write = nmea_fix_log_partition_write;
+    storage->erase = nmea_fix_log_partition_erase;
+    storage->ctx = (void *)partition;
+    storage->size = partition->size;
+    return ESP_OK;
+}
+#endif
+
+static esp_err_t nmea_fix_log_file_read(void *ctx, uint32_t offset, void *data, size_t size)
+{
+    FILE *file = (FILE *)ctx;
+    memset(data, NMEA_FIX_LOG_END, size);
+    if (fseek(file, offset, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    /* Past the end of the file reads as erased */
+    fread(data, 1, size, file);
+    if (ferror(file)) {
+        clearerr(file);
+        return ESP_FAIL;
+    }
+    clearerr(file);
+    return ESP_OK;
+}
+
+static esp_err_t nmea_fix_log_file_write(void *ctx, uint32_t offset, const void *data, size_t size)
+{
+    FILE *file = (FILE *)ctx;
+    if (fseek(file, offset, SEEK_SET) != 0 || fwrite(data, 1, size, file) != size || fflush(file) != 0) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t nmea_fix_log_file_erase(void *ctx, uint32_t offset, size_t size)
+{
+    uint8_t erased[64];
+    memset(erased, NMEA_FIX_LOG_END, sizeof(erased));
+    for (size_t done = 0; done < size; done += sizeof(erased)) {
+        esp_err_t err = nmea_fix_log_file_write(ctx, offset + done, erased, MIN(sizeof(erased), size - done));
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Storage of a fix log in a file
+ *
+ * @param file file opened for update
+ * @param size size of the storage (bytes)
+ * @param storage storage will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: file is NULL or size is smaller than two blocks
+ */
+esp_err_t nmea_fix_log_storage_file(FILE *file, uint32_t size, nmea_fix_log_storage_t *storage)
+{
+    if (!file || size < 2 * NMEA_FIX_LOG_BLOCK_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    storage->read = nmea_fix_log_file_read;
+    storage->write = nmea_fix_log_file_write;
+    storage->erase = nmea_fix_log_file_erase;
+    storage->ctx = file;
+    storage->size = size;
+    return ESP_OK;
+}
+
+/**
+ * @brief Open a fix log, resume after the last fix already stored
+ *
+ * @param storage storage of the log
+ * @param log handle of the log will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: storage is smaller than two blocks
+ *  - ESP_ERR_NO_MEM: out of memory
+ *  - others: error of the storage
+ */
+esp_err_t nmea_fix_log_open(const nmea_fix_log_storage_t *storage, nmea_fix_log_handle_t *log)
+{
+    if (storage->size / NMEA_FIX_LOG_BLOCK_SIZE < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nmea_fix_log_t *fix_log = calloc(1, sizeof(nmea_fix_log_t));
+    if (!fix_log) {
+        ESP_LOGE(FIX_LOG_TAG, "calloc memory for fix log failed");
+        return ESP_ERR_NO_MEM;
+    }
+    if (!nmea_fix_log_lock_create(fix_log)) {
+        ESP_LOGE(FIX_LOG_TAG, "create fix log lock failed");
+        free(fix_log);
+        return ESP_ERR_NO_MEM;
+    }
+    fix_log->storage = *storage;
+    fix_log->blocks = storage->size / NMEA_FIX_LOG_BLOCK_SIZE;
+    esp_err_t err = nmea_fix_log_scan(fix_log);
+    if (err != ESP_OK) {
+        ESP_LOGE(FIX_LOG_TAG, "scan fix log failed (%d)", err);
+        nmea_fix_log_lock_delete(fix_log);
+        free(fix_log);
+        return err;
+    }
+    ESP_LOGI(FIX_LOG_TAG, "fix log: %u of %u blocks used", (unsigned)fix_log->used_blocks, (unsigned)fix_log->blocks);
+    *log = fix_log;
+    return ESP_OK;
+}
+
+/**
+ * @brief Close a fix log
+ *
+ * @param log handle of the log
+ */
+void nmea_fix_log_close(nmea_fix_log_handle_t log)
+{
+    nmea_fix_log_t *fix_log = (nmea_fix_log_t *)log;
+    nmea_fix_log_lock_delete(fix_log);
+    free(fix_log);
+}
+
+/**
+ * @brief Append a fix to a fix log
+ *
+ * @param log handle of the log
+ * @param fix fix to append
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_STATE: fix is not valid or has no date
+ *  - others: error of the storage
+ */
+esp_err_t nmea_fix_log_append(nmea_fix_log_handle_t log, const gps_fix_core_t *fix)
+{
+    nmea_fix_log_t *fix_log = (nmea_fix_log_t *)log;
+    int64_t utc_ms = nmea_fix_utc_ms(fix);
+    if (!fix->valid || utc_ms < 0) {
+        fix_log->dropped++;
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    nmea_fix_log_lock(fix_log);
+    /* Keep blocks in time order for the binary search */
+    if (!fix_log->used || utc_ms < fix_log->state.utc_ms) {
+        err = nmea_fix_log_new_block(fix_log, fix, utc_ms);
+    } else {
+        uint8_t record[NMEA_FIX_LOG_RECORD_MAX_SIZE];
+        nmea_fix_log_state_t state = fix_log->state;
+        size_t len = nmea_fix_log_encode(&state, fix, utc_ms, record);
+        if (fix_log->used + len > NMEA_FIX_LOG_BLOCK_SIZE) {
+            err = nmea_fix_log_new_block(fix_log, fix, utc_ms);
+        } else {
+            err = fix_log->storage.write(fix_log->storage.ctx,
+                                         nmea_fix_log_block_offset(fix_log, fix_log->head) + fix_log->used, record, len);
+            if (err == ESP_OK) {
+                fix_log->state = state;
+                fix_log->used += len;
+                fix_log->bytes += len;
+            } else {
+                /* Do not append after a partially written record */
+                fix_log->used = 0;
+            }
+        }
+    }
+    if (err == ESP_OK) {
+        fix_log->fixes++;
+    } else {
+        fix_log->dropped++;
+    }
+    nmea_fix_log_unlock(fix_log);
+    return err;
+}
+
+/**
+ * @brief Read the fixes of a time range from a fix log
+ *
+ * @param log handle of the log
+ * @param from_ms start of the range (ms since 2000-01-01 UTC)
+ * @param to_ms end of the range, included
+ * @param cb function called for each fix of the range
+ * @param arg argument passed to cb
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: no fix in the range
+ *  - ESP_ERR_NO_MEM: out of memory
+ *  - others: error of the storage
+ */
+esp_err_t nmea_fix_log_read(nmea_fix_log_handle_t log, int64_t from_ms, int64_t to_ms, nmea_fix_log_cb_t cb, void *arg)
+{
+    nmea_fix_log_t *fix_log = (nmea_fix_log_t *)log;
+    nmea_fix_log_header_t header;
+    uint32_t block = 0;
+    uint32_t seq = 0;
+    uint32_t found = 0;
+    bool more = true;
+    esp_err_t err = ESP_OK;
+
+    uint8_t *buf = malloc(NMEA_FIX_LOG_BLOCK_SIZE);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* Binary search of the last block starting at or before from_ms */
+    nmea_fix_log_lock(fix_log);
+    uint32_t lo = 0;
+    uint32_t hi = fix_log->used_blocks;
+    uint32_t oldest_seq = fix_log->head_seq - fix_log->used_blocks + 1;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!nmea_fix_log_seq_block(fix_log, oldest_seq + mid, &block)) {
+            break;
+        }
+        err = nmea_fix_log_read_header(fix_log, block, &header);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (header.start_utc_ms <= from_ms) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    seq = oldest_seq + lo;
+    nmea_fix_log_unlock(fix_log);
+
+    /* Decode block by block, the lock is not held while calling back */
+    while (err == ESP_OK && more) {
+        nmea_fix_log_lock(fix_log);
+        if (!nmea_fix_log_seq_block(fix_log, seq, &block)) {
+            nmea_fix_log_unlock(fix_log);
+            break;
+        }
+        err = fix_log->storage.read(fix_log->storage.ctx, nmea_fix_log_block_offset(fix_log, block), buf,
+                                    NMEA_FIX_LOG_BLOCK_SIZE);
+        nmea_fix_log_unlock(fix_log);
+        const nmea_fix_log_header_t *block_header = (const nmea_fix_log_header_t *)buf;
+        if (err != ESP_OK || block_header->magic != NMEA_FIX_LOG_MAGIC || block_header->seq != seq) {
+            break;
+        }
+        nmea_fix_log_state_t state;
+        size_t pos = sizeof(nmea_fix_log_header_t);
+        nmea_fix_log_state_from_header(block_header, &state);
+        do {
+            if (state.utc_ms > to_ms) {
+                more = false;
+            } else if (state.utc_ms >= from_ms) {
+                gps_fix_core_t fix;
+                nmea_fix_log_state_to_fix(&state, &fix);
+                found++;
+                more = cb(&fix, state.utc_ms, arg);
+            }
+        } while (more && nmea_fix_log_decode(buf, NMEA_FIX_LOG_BLOCK_SIZE, &pos, &state));
+        seq++;
+    }
+    free(buf);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Erase all fixes of a fix log
+ *
+ * @param log handle of the log
+ * @return esp_err_t ESP_OK on success, error of the storage otherwise
+ */
+esp_err_t nmea_fix_log_erase(nmea_fix_log_handle_t log)
+{
+    nmea_fix_log_t *fix_log = (nmea_fix_log_t *)log;
+    esp_err_t err = ESP_OK;
+    nmea_fix_log_lock(fix_log);
+    for (uint32_t i = 0; i < fix_log->blocks && err == ESP_OK; i++) {
+        err = fix_log->storage.erase(fix_log->storage.ctx, nmea_fix_log_block_offset(fix_log, i), NMEA_FIX_LOG_BLOCK_SIZE);
+    }
+    fix_log->head = fix_log->blocks - 1;
+    fix_log->head_seq = UINT32_MAX;
+    fix_log->used_blocks = 0;
+    fix_log->used = 0;
+    nmea_fix_log_unlock(fix_log);
+    return err;
+}
+
+/**
+ * @brief Get statistics of a fix log
+ *
+ * @param log handle of the log
+ * @param stats statistics will be saved in this pointer
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t nmea_fix_log_get_stats(nmea_fix_log_handle_t log, nmea_fix_log_stats_t *stats)
+{
+    nmea_fix_log_t *fix_log = (nmea_fix_log_t *)log;
+    nmea_fix_log_header_t header;
+    uint32_t block = 0;
+    esp_err_t err = ESP_OK;
+    nmea_fix_log_lock(fix_log);
+    stats->blocks = fix_log->blocks;
+    stats->blocks_used = fix_log->used_blocks;
+    stats->fixes = fix_log->fixes;
+    stats->bytes = fix_log->bytes;
+    stats->dropped = fix_log->dropped;
+    stats->first_utc_ms = -1;
+    stats->last_utc_ms = -1;
+    if (nmea_fix_log_seq_block(fix_log, fix_log->head_seq - fix_log->used_blocks + 1, &block)) {
+        err = nmea_fix_log_read_header(fix_log, block, &header);
+        if (err == ESP_OK) {
+            stats->first_utc_ms = header.start_utc_ms;
+        }
+        stats->last_utc_ms = fix_log->state.utc_ms;
+    }
+    nmea_fix_log_unlock(fix_log);
+    return err;
+}
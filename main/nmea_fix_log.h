@@ -0,0 +1,181 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "esp_err.h"
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+#include "nmea_decoder.h"
+
+/**
+ * @brief Storage of a fix log
+ *
+ * The storage is split into blocks of CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE bytes, used as a ring.
+ * Erased bytes read as 0xFF, as on NOR flash. Offsets and sizes passed to erase are aligned to a block.
+ */
+typedef struct {
+    esp_err_t (*read)(void *ctx, uint32_t offset, void *data, size_t size);        /*!< Read bytes */
+    esp_err_t (*write)(void *ctx, uint32_t offset, const void *data, size_t size); /*!< Write bytes to erased storage */
+    esp_err_t (*erase)(void *ctx, uint32_t offset, size_t size);                   /*!< Erase bytes to 0xFF */
+    void *ctx;                                                                     /*!< Context of the callbacks */
+    uint32_t size;                                                                 /*!< Size of the storage (bytes) */
+} nmea_fix_log_storage_t;
+
+/**
+ * @brief Fix log Handle
+ *
+ */
+typedef void *nmea_fix_log_handle_t;
+
+/**
+ * @brief Function called for each fix read from a fix log
+ *
+ * @param fix fix read from the log
+ * @param utc_ms time of the fix (ms since 2000-01-01 UTC)
+ * @param arg argument passed to nmea_fix_log_read()
+ * @return true to read the next fix, false to stop
+ */
+typedef bool (*nmea_fix_log_cb_t)(const gps_fix_core_t *fix, int64_t utc_ms, void *arg);
+
+/**
+ * @brief Statistics of a fix log
+ *
+ */
+typedef struct {
+    uint32_t blocks;       /*!< Number of blocks in the storage */
+    uint32_t blocks_used;  /*!< Number of blocks holding fixes */
+    uint32_t fixes;        /*!< Number of fixes appended since open */
+    uint32_t bytes;        /*!< Number of bytes written since open, block headers included */
+    uint32_t dropped;      /*!< Number of fixes not appended (invalid fix or storage error) */
+    int64_t first_utc_ms;  /*!< Time of the oldest block, -1 if the log is empty */
+    int64_t last_utc_ms;   /*!< Time of the last fix, -1 if the log is empty */
+} nmea_fix_log_stats_t;
+
+/**
+ * @brief Storage of a fix log on a flash partition
+ *
+ * @note CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE must be a multiple of the flash sector size (4096).
+ *
+ * @param partition partition to store the log on (e.g. a data partition found by esp_partition_find_first())
+ * @param storage storage will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: partition is NULL or smaller than two blocks, or the block size is not sector aligned
+ */
+#ifdef ESP_PLATFORM
+esp_err_t nmea_fix_log_storage_partition(const esp_partition_t *partition, nmea_fix_log_storage_t *storage);
+#endif
+
+/**
+ * @brief Storage of a fix log in a file
+ *
+ * Works with any stdio file: a file of a VFS (SPIFFS, FAT, SD card) on target, or a plain file on the host
+ * to write and read logs in tests and tools. Bytes after the end of the file read as erased.
+ *
+ * @param file file opened for update ("r+b" or "w+b"), kept open until nmea_fix_log_close()
+ * @param size size of the storage (bytes), at least two blocks
+ * @param storage storage will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: file is NULL or size is smaller than two blocks
+ */
+esp_err_t nmea_fix_log_storage_file(FILE *file, uint32_t size, nmea_fix_log_storage_t *storage);
+
+/**
+ * @brief Open a fix log, resume after the last fix already stored
+ *
+ * @param storage storage of the log, copied
+ * @param log handle of the log will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: storage is smaller than two blocks
+ *  - ESP_ERR_NO_MEM: out of memory
+ *  - others: error of the storage
+ */
+esp_err_t nmea_fix_log_open(const nmea_fix_log_storage_t *storage, nmea_fix_log_handle_t *log);
+
+/**
+ * @brief Close a fix log
+ *
+ * @param log handle of the log
+ */
+void nmea_fix_log_close(nmea_fix_log_handle_t log);
+
+/**
+ * @brief Append a fix to a fix log
+ *
+ * Fixes are delta-encoded against the previous fixes and packed as variable length integers, 3 to 7 bytes each
+ * when moving (about 100 bytes for UBX NAV-PVT, 150 bytes for the NMEA statements of an epoch). The oldest
+ * block is erased when the storage is full. Each fix is written to the storage immediately.
+ *
+ * @note Meant to be called from a GPS_FIX event handler or a direct handler, with fixes in time order, or by the
+ *       parser (nmea_parser_set_fix_log()).
+ *
+ * @param log handle of the log
+ * @param fix fix to append, ignored if not valid
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_STATE: fix is not valid or has no date
+ *  - others: error of the storage
+ */
+esp_err_t nmea_fix_log_append(nmea_fix_log_handle_t log, const gps_fix_core_t *fix);
+
+/**
+ * @brief Read the fixes of a time range from a fix log
+ *
+ * The first block of the range is found by a binary search over the block headers, so the cost does not
+ * depend on the size of the log.
+ *
+ * @note May be called from any task, concurrently with nmea_fix_log_append().
+ *
+ * @param log handle of the log
+ * @param from_ms start of the range (ms since 2000-01-01 UTC, see nmea_fix_utc_ms())
+ * @param to_ms end of the range, included
+ * @param cb function called for each fix of the range, in time order
+ * @param arg argument passed to cb
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: no fix in the range
+ *  - ESP_ERR_NO_MEM: out of memory
+ *  - others: error of the storage
+ */
+esp_err_t nmea_fix_log_read(nmea_fix_log_handle_t log, int64_t from_ms, int64_t to_ms, nmea_fix_log_cb_t cb, void *arg);
+
+/**
+ * @brief Erase all fixes of a fix log
+ *
+ * @param log handle of the log
+ * @return esp_err_t ESP_OK on success, error of the storage otherwise
+ */
+esp_err_t nmea_fix_log_erase(nmea_fix_log_handle_t log);
+
+/**
+ * @brief Get statistics of a fix log
+ *
+ * @param log handle of the log
+ * @param stats statistics will be saved in this pointer
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t nmea_fix_log_get_stats(nmea_fix_log_handle_t log, nmea_fix_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,329 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "driver/uart.h"
+#endif
+#include "nmea_forward.h"
+
+#define NMEA_FORWARD_ADDRESS_MAX_LENGTH (15)
+
+/**
+ * @brief Run of adjacent sentences pending for a sink without batching
+ *
+ */
+typedef struct {
+    const uint8_t *data; /*!< First sentence of the run, in the line buffer */
+    size_t len;          /*!< Length of the run */
+} nmea_forward_run_t;
+
+/**
+ * @brief Split a comma separated list of a filter
+ *
+ * @param list comma separated list, NULL for all
+ * @param names names will be saved in this array, NUL terminated if shorter than name_size
+ * @param name_size size of each name
+ * @param exact_len names must have exactly name_size characters
+ * @param num number of names will be saved in this pointer
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG on a bad list
+ */
+static esp_err_t nmea_forward_split(const char *list, char *names, size_t name_size, bool exact_len, uint8_t *num)
+{
+    *num = 0;
+    if (!list) {
+        return ESP_OK;
+    }
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        if (*num == NMEA_FORWARD_FILTER_NUM || !len || len > name_size ||
+                (exact_len ? len != name_size : len == name_size)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        char *name = names + *num * name_size;
+        memset(name, 0, name_size);
+        memcpy(name, list, len);
+        (*num)++;
+        list += len;
+        if (*list == ',') {
+            list++;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Compile the filter of a sink configuration
+ *
+ * @param config sink configuration
+ * @param filter compiled filter will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: A talker ID is not 2 characters, a sentence name is too long, or too many entries
+ */
+esp_err_t nmea_forward_filter_init(const nmea_forward_config_t *config, nmea_forward_filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+    if (nmea_forward_split(config->talkers, &filter->talkers[0][0], sizeof(filter->talkers[0]), true,
+                           &filter->talker_num) != ESP_OK ||
+            nmea_forward_split(config->sentences, &filter->sentences[0][0], sizeof(filter->sentences[0]), false,
+                               &filter->sentence_num) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Check a sentence address against the filter of a sink
+ *
+ * @param filter filter of the sink
+ * @param addr address field, without '$'
+ * @param addr_len length of address field
+ * @return true if the sentence is forwarded to the sink
+ */
+static bool nmea_forward_match(const nmea_forward_filter_t *filter, const char *addr, size_t addr_len)
+{
+    if (filter->talker_num && addr[0] != 'P') {
+        int i = 0;
+        while (i < filter->talker_num && (addr_len < 2 || memcmp(filter->talkers[i], addr, 2))) {
+            i++;
+        }
+        if (i == filter->talker_num) {
+            return false;
+        }
+    }
+    if (!filter->sentence_num) {
+        return true;
+    }
+    for (int i = 0; i < filter->sentence_num; i++) {
+        if (nmea_decoder_address_match(addr, addr_len, filter->sentences[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Write to a sink and count the write
+ *
+ */
+static inline void nmea_forward_write(nmea_forward_t *forward, nmea_forward_sink_t *sink, const uint8_t *data,
+                                      size_t len)
+{
+    sink->write(sink->arg, data, len);
+    forward->writes++;
+}
+
+/**
+ * @brief Pass one sentence to the sinks
+ *
+ * @param forward forwarding stage
+ * @param runs pending runs of the sinks without batching, NULL if the sentence is not in the line buffer
+ * @param data sentence, from '$' to '\n'
+ * @param len length of sentence
+ * @param now_ms reception time of the sentence (ms)
+ */
+static void nmea_forward_sentence(nmea_forward_t *forward, nmea_forward_run_t *runs, const uint8_t *data, size_t len,
+                                  uint32_t now_ms)
+{
+    const char *addr = (const char *)data + 1;
+    size_t addr_len = 0;
+    while (addr_len < len - 1 && addr_len < NMEA_FORWARD_ADDRESS_MAX_LENGTH &&
+            addr[addr_len] != ',' && addr[addr_len] != '*' && addr[addr_len] != '\r') {
+        addr_len++;
+    }
+    if (!addr_len) {
+        return;
+    }
+    for (int i = 0; i < NMEA_FORWARD_SINK_NUM; i++) {
+        nmea_forward_sink_t *sink = &forward->sinks[i];
+        if (!sink->write || !nmea_forward_match(&sink->filter, addr, addr_len)) {
+            continue;
+        }
+        forward->forwarded++;
+        if (sink->batch) {
+            if (sink->fill + len > NMEA_FORWARD_BUFFER_SIZE) {
+                if (sink->fill) {
+                    nmea_forward_write(forward, sink, sink->buffer, sink->fill);
+                    sink->fill = 0;
+                }
+                if (len > NMEA_FORWARD_BUFFER_SIZE) {
+                    nmea_forward_write(forward, sink, data, len);
+                    continue;
+                }
+            }
+            if (!sink->fill) {
+                sink->batch_ms = now_ms;
+            }
+            memcpy(sink->buffer + sink->fill, data, len);
+            sink->fill += len;
+        } else if (!runs) {
+            nmea_forward_write(forward, sink, data, len);
+        } else if (runs[i].len && runs[i].data + runs[i].len == data) {
+            runs[i].len += len;
+        } else {
+            if (runs[i].len) {
+                nmea_forward_write(forward, sink, runs[i].data, runs[i].len);
+            }
+            runs[i].data = data;
+            runs[i].len = len;
+        }
+    }
+}
+
+/**
+ * @brief Forward the sentences of a received line
+ *
+ * @param forward forwarding stage
+ * @param data received bytes
+ * @param len number of bytes in data
+ * @param now_ms reception time of the line (ms)
+ */
+void nmea_forward_feed(nmea_forward_t *forward, const uint8_t *data, size_t len, uint32_t now_ms)
+{
+    nmea_forward_poll(forward, now_ms);
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+    nmea_forward_run_t runs[NMEA_FORWARD_SINK_NUM];
+    memset(runs, 0, sizeof(runs));
+
+    /* Complete the sentence split across the previous line and this one */
+    if (forward->carry_len) {
+        const uint8_t *eol = p;
+        while (eol < end && *eol != '\n' && *eol != '$') {
+            eol++;
+        }
+        size_t n = eol - p + (eol < end && *eol == '\n');
+        if (forward->carry_len + n > sizeof(forward->carry)) {
+            /* Too long for a sentence, drop it */
+            forward->carry_len = 0;
+        } else {
+            memcpy(forward->carry + forward->carry_len, p, n);
+            forward->carry_len += n;
+        }
+        if (eol == end) {
+            return;
+        }
+        if (*eol == '\n' && forward->carry_len) {
+            nmea_forward_sentence(forward, NULL, forward->carry, forward->carry_len, now_ms);
+        }
+        forward->carry_len = 0;
+        p += n;
+    }
+
+    while (p < end && (p = memchr(p, '$', end - p)) != NULL) {
+        const uint8_t *eol = memchr(p + 1, '\n', end - p - 1);
+        const uint8_t *next = memchr(p + 1, '$', (eol ? eol : end) - p - 1);
+        if (next) {
+            /* Truncated sentence, restart on the next one */
+            p = next;
+            continue;
+        }
+        if (!eol) {
+            /* Sentence continues in the next line */
+            if ((size_t)(end - p) <= sizeof(forward->carry)) {
+                memcpy(forward->carry, p, end - p);
+                forward->carry_len = end - p;
+            }
+            break;
+        }
+        nmea_forward_sentence(forward, runs, p, eol + 1 - p, now_ms);
+        p = eol + 1;
+    }
+
+    for (int i = 0; i < NMEA_FORWARD_SINK_NUM; i++) {
+        nmea_forward_sink_t *sink = &forward->sinks[i];
+        if (runs[i].len && sink->write) {
+            nmea_forward_write(forward, sink, runs[i].data, runs[i].len);
+        }
+    }
+}
+
+/**
+ * @brief Write the sentences batched by the sinks
+ *
+ * @param forward forwarding stage
+ */
+void nmea_forward_flush(nmea_forward_t *forward)
+{
+    for (int i = 0; i < NMEA_FORWARD_SINK_NUM; i++) {
+        nmea_forward_sink_t *sink = &forward->sinks[i];
+        if (sink->fill && sink->write) {
+            nmea_forward_write(forward, sink, sink->buffer, sink->fill);
+        }
+        sink->fill = 0;
+    }
+}
+
+/**
+ * @brief Write the batches whose first sentence is NMEA_FORWARD_FLUSH_MS old or older
+ *
+ * @param forward forwarding stage
+ * @param now_ms current time (ms)
+ */
+void nmea_forward_poll(nmea_forward_t *forward, uint32_t now_ms)
+{
+#if NMEA_FORWARD_FLUSH_MS
+    for (int i = 0; i < NMEA_FORWARD_SINK_NUM; i++) {
+        nmea_forward_sink_t *sink = &forward->sinks[i];
+        if (sink->fill && sink->write && now_ms - sink->batch_ms >= NMEA_FORWARD_FLUSH_MS) {
+            nmea_forward_write(forward, sink, sink->buffer, sink->fill);
+            sink->fill = 0;
+            forward->timed_flushes++;
+        }
+    }
+#endif
+}
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Sink output to a UART
+ *
+ * @param arg uart_port_t of the UART
+ * @param data sentences
+ * @param len number of bytes in data
+ */
+void nmea_forward_uart_write(void *arg, const uint8_t *data, size_t len)
+{
+    uart_write_bytes((uart_port_t)(intptr_t)arg, (const char *)data, len);
+}
+
+/**
+ * @brief Sink output to a byte ring buffer, without waiting for free space
+ *
+ * @param arg RingbufHandle_t of the ring buffer
+ * @param data sentences
+ * @param len number of bytes in data
+ */
+void nmea_forward_ringbuf_write(void *arg, const uint8_t *data, size_t len)
+{
+    xRingbufferSend((RingbufHandle_t)arg, data, len, 0);
+}
+#endif
+
+/**
+ * @brief Sink output to the console
+ *
+ * @param arg not used
+ * @param data sentences
+ * @param len number of bytes in data
+ */
+void nmea_forward_console_write(void *arg, const uint8_t *data, size_t len)
+{
+    (void)arg;
+    fwrite(data, 1, len, stdout);
+}
@@ -0,0 +1,167 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "nmea_decoder.h"
+
+#define NMEA_FORWARD_SINK_NUM CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+#define NMEA_FORWARD_BUFFER_SIZE CONFIG_NMEA_PARSER_FORWARD_BUFFER_SIZE
+#define NMEA_FORWARD_FLUSH_MS CONFIG_NMEA_PARSER_FORWARD_FLUSH_MS
+#define NMEA_FORWARD_FILTER_NUM (8)     /*!< Maximum number of talkers and of sentences in a filter */
+#define NMEA_FORWARD_NAME_LENGTH (8)    /*!< Maximum length of a sentence name in a filter, NUL included */
+
+/**
+ * @brief Output of forwarded sentences
+ *
+ * Called from the parser task with the original bytes of one or more sentences, line endings included.
+ *
+ * @param arg sink specific arguments
+ * @param data sentences
+ * @param len number of bytes in data
+ */
+typedef void (*nmea_forward_write_t)(void *arg, const uint8_t *data, size_t len);
+
+/**
+ * @brief Configuration of a forward sink
+ *
+ */
+typedef struct {
+    nmea_forward_write_t write; /*!< Output function, e.g. nmea_forward_uart_write() */
+    void *arg;                  /*!< Argument of write */
+    const char *talkers;        /*!< Comma separated talker IDs to forward (e.g. "GP,GN"), NULL for all.
+                                     Proprietary sentences have no talker ID and pass this filter */
+    const char *sentences;      /*!< Comma separated sentences to forward (e.g. "GGA,RMC,PUBX"), NULL for all.
+                                     Names match as those of user statement parsers */
+    bool batch;                 /*!< Collect sentences in the buffer of the sink and write them at the end of
+                                     each epoch (or when the buffer is full, or NMEA_FORWARD_FLUSH_MS after the
+                                     first of them). Otherwise sentences are written straight from the line
+                                     buffer, one write per run of adjacent sentences */
+} nmea_forward_config_t;
+
+/**
+ * @brief Filter of a sink, compiled from its configuration
+ *
+ */
+typedef struct {
+    uint8_t talker_num;                                             /*!< Number of talkers, 0 for all */
+    uint8_t sentence_num;                                           /*!< Number of sentences, 0 for all */
+    char talkers[NMEA_FORWARD_FILTER_NUM][2];                       /*!< Talker IDs */
+    char sentences[NMEA_FORWARD_FILTER_NUM][NMEA_FORWARD_NAME_LENGTH]; /*!< Sentence names */
+} nmea_forward_filter_t;
+
+/**
+ * @brief Forward sink
+ *
+ */
+typedef struct {
+    nmea_forward_write_t write;           /*!< Output function, NULL if the slot is free */
+    void *arg;                            /*!< Argument of write */
+    bool batch;                           /*!< Batch sentences in buffer */
+    uint16_t fill;                        /*!< Bytes in buffer */
+    uint32_t batch_ms;                    /*!< Reception time of the first sentence in buffer (ms) */
+    nmea_forward_filter_t filter;         /*!< Filter */
+    uint8_t buffer[NMEA_FORWARD_BUFFER_SIZE]; /*!< Batched sentences */
+} nmea_forward_sink_t;
+
+/**
+ * @brief Forwarding stage, passes received sentences to the sinks whose filter they match
+ *
+ */
+typedef struct {
+    nmea_forward_sink_t sinks[NMEA_FORWARD_SINK_NUM]; /*!< Sinks */
+    uint32_t forwarded;                               /*!< Sentences forwarded, counted once per sink */
+    uint32_t writes;                                  /*!< Calls of the sink outputs */
+    uint32_t timed_flushes;                           /*!< Batches written by the flush timeout */
+    uint16_t carry_len;                               /*!< Bytes of a sentence split across two lines */
+    uint8_t carry[NMEA_MAX_STATEMENT_LENGTH];         /*!< Start of a sentence split across two lines */
+} nmea_forward_t;
+
+/**
+ * @brief Compile the filter of a sink configuration
+ *
+ * @param config sink configuration
+ * @param filter compiled filter will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: A talker ID is not 2 characters, a sentence name is too long, or too many entries
+ */
+esp_err_t nmea_forward_filter_init(const nmea_forward_config_t *config, nmea_forward_filter_t *filter);
+
+/**
+ * @brief Forward the sentences of a received line
+ *
+ * Sentences are delimited by '$' and '\n'. A sentence split across two lines is kept until its end is
+ * received, other bytes (e.g. UBX frames) are not forwarded. Checksums are not verified. Batches older than
+ * NMEA_FORWARD_FLUSH_MS are written first, as by nmea_forward_poll().
+ *
+ * @param forward forwarding stage
+ * @param data received bytes
+ * @param len number of bytes in data
+ * @param now_ms reception time of the line (ms), any monotonic clock
+ */
+void nmea_forward_feed(nmea_forward_t *forward, const uint8_t *data, size_t len, uint32_t now_ms);
+
+/**
+ * @brief Write the sentences batched by the sinks, called at the end of each epoch
+ *
+ * @param forward forwarding stage
+ */
+void nmea_forward_flush(nmea_forward_t *forward);
+
+/**
+ * @brief Write the batches whose first sentence is NMEA_FORWARD_FLUSH_MS old or older
+ *
+ * Bounds the delay of batched sentences when no epoch ends: statements of the epoch disabled on the receiver,
+ * a receiver without fix that only sends some of them, or one that went silent. Does nothing if
+ * NMEA_FORWARD_FLUSH_MS is 0.
+ *
+ * @param forward forwarding stage
+ * @param now_ms current time (ms), same clock as nmea_forward_feed()
+ */
+void nmea_forward_poll(nmea_forward_t *forward, uint32_t now_ms);
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Sink output to a UART, arg is the uart_port_t
+ *
+ * The UART driver must be installed, with a Tx ring buffer to not block the parser task.
+ */
+void nmea_forward_uart_write(void *arg, const uint8_t *data, size_t len);
+
+/**
+ * @brief Sink output to a byte ring buffer, arg is the RingbufHandle_t
+ *
+ * Sentences are dropped if the ring buffer is full.
+ */
+void nmea_forward_ringbuf_write(void *arg, const uint8_t *data, size_t len);
+#endif
+
+/**
+ * @brief Sink output to the console (stdout), arg is not used
+ *
+ */
+void nmea_forward_console_write(void *arg, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
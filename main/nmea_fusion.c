@@ -0,0 +1,288 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <math.h>
+#include "nmea_fusion.h"
+
+#define NMEA_FUSION_MS_PER_DAY (86400000)
+#define NMEA_FUSION_DOP_MARGIN (1.25f) /* Receivers of the same fix type swap only if HDOP is 1.25 times lower */
+#define NMEA_FUSION_SATS_MARGIN (3)    /* or, at similar HDOP, with 3 more satellites in use */
+#define NMEA_FUSION_DOP_UNKNOWN (99.9f)
+
+void nmea_fusion_init(nmea_fusion_t *fusion, const nmea_fusion_config_t *config, nmea_fusion_publish_t publish,
+                      void *ctx)
+{
+    memset(fusion, 0, sizeof(*fusion));
+    fusion->config = *config;
+    fusion->publish = publish;
+    fusion->ctx = ctx;
+}
+
+/**
+ * @brief Difference of two UTC times of day, across midnight
+ *
+ * @return int32_t a - b (ms)
+ */
+static int32_t nmea_fusion_diff(uint32_t a, uint32_t b)
+{
+    int32_t d = (int32_t)((a + NMEA_FUSION_MS_PER_DAY - b) % NMEA_FUSION_MS_PER_DAY);
+    return d > NMEA_FUSION_MS_PER_DAY / 2 ? d - NMEA_FUSION_MS_PER_DAY : d;
+}
+
+/**
+ * @brief UTC time of day of an epoch
+ *
+ * @return uint32_t time (ms since midnight)
+ */
+static inline uint32_t nmea_fusion_time_ms(const gps_t *gps)
+{
+    return ((gps->tim.hour * 60 + gps->tim.minute) * 60 + gps->tim.second) * 1000UL + gps->tim.thousand;
+}
+
+/**
+ * @brief Class of a solution, from its fix type and fix mode
+ *
+ * @param gps epoch
+ * @return uint8_t class, 0 if the epoch has no fix, higher is better
+ */
+static uint8_t nmea_fusion_class(const gps_t *gps)
+{
+    /* Rank of GGA fix quality: invalid, GPS, DGPS, PPS, RTK fixed, RTK float, estimated, manual, simulation */
+    static const uint8_t rank[] = {0, 2, 3, 2, 5, 4, 1, 0, 0};
+    uint8_t fix = (unsigned)gps->fix < sizeof(rank) ? rank[gps->fix] : 0;
+    if (!fix) {
+        if (!gps->valid) {
+            return 0;
+        }
+        /* Valid by RMC or GLL, without GGA */
+        fix = rank[GPS_FIX_GPS];
+    }
+    return fix * 2 + (gps->fix_mode == GPS_MODE_3D);
+}
+
+static inline float nmea_fusion_dop(const gps_t *gps)
+{
+    return gps->dop_h > 0 ? gps->dop_h : NMEA_FUSION_DOP_UNKNOWN;
+}
+
+/**
+ * @brief Compare two solutions by fix type, HDOP and satellites in use
+ *
+ * @param a epoch
+ * @param b epoch
+ * @return true if a is better than b by a margin, so that two similar receivers do not take turns
+ */
+static bool nmea_fusion_better(const gps_t *a, const gps_t *b)
+{
+    uint8_t class_a = nmea_fusion_class(a);
+    uint8_t class_b = nmea_fusion_class(b);
+    if (class_a != class_b) {
+        return class_a > class_b;
+    }
+    if (!class_a) {
+        return false;
+    }
+    float dop_a = nmea_fusion_dop(a);
+    float dop_b = nmea_fusion_dop(b);
+    if (dop_a * NMEA_FUSION_DOP_MARGIN < dop_b) {
+        return true;
+    }
+    if (dop_b * NMEA_FUSION_DOP_MARGIN < dop_a) {
+        return false;
+    }
+    return a->sats_in_use >= b->sats_in_use + NMEA_FUSION_SATS_MARGIN;
+}
+
+/**
+ * @brief Publish an epoch
+ *
+ * @param fusion fusion stage
+ * @param gps epoch
+ * @param rx receiver, NMEA_FUSION_RX_NUM for an average
+ * @param epoch_us local time of the first statement of the epoch
+ */
+static void nmea_fusion_output(nmea_fusion_t *fusion, const gps_t *gps, uint8_t rx, int64_t epoch_us)
+{
+    fusion->has_published = true;
+    fusion->published_ms = nmea_fusion_time_ms(gps);
+    if (rx < NMEA_FUSION_RX_NUM) {
+        fusion->rx[rx].published++;
+    } else {
+        fusion->weighted++;
+    }
+    fusion->publish(fusion->ctx, gps, rx, epoch_us);
+}
+
+/**
+ * @brief Publish the epoch of a receiver alone
+ *
+ * @param fusion fusion stage
+ * @param rx receiver
+ */
+static void nmea_fusion_output_rx(nmea_fusion_t *fusion, uint8_t rx)
+{
+    fusion->rx[rx].pending = false;
+    nmea_fusion_output(fusion, &fusion->rx[rx].gps, rx, fusion->rx[rx].epoch_us);
+}
+
+/**
+ * @brief Average two epochs of the same UTC time, weighted by the inverse of HDOP squared
+ *
+ * @param base better epoch, other fields are copied from it
+ * @param other other epoch
+ * @param fused average will be saved in this pointer
+ */
+static void nmea_fusion_average(const gps_t *base, const gps_t *other, gps_t *fused)
+{
+    float dop_a = base->dop_h;
+    float dop_b = other->dop_h;
+    /* Weight of other */
+    float u = dop_a * dop_a / (dop_a * dop_a + dop_b * dop_b);
+    *fused = *base;
+    fused->latitude = base->latitude + (int32_t)lroundf(u * (float)((int64_t)other->latitude - base->latitude));
+    int64_t d_lon = (int64_t)other->longitude - base->longitude;
+    if (d_lon > 1800000000) {
+        d_lon -= 3600000000LL;
+    } else if (d_lon < -1800000000) {
+        d_lon += 3600000000LL;
+    }
+    int64_t lon = base->longitude + (int64_t)llroundf(u * (float)d_lon);
+    if (lon > 1800000000) {
+        lon -= 3600000000LL;
+    } else if (lon < -1800000000) {
+        lon += 3600000000LL;
+    }
+    fused->longitude = (int32_t)lon;
+    fused->altitude = base->altitude + u * (other->altitude - base->altitude);
+    fused->speed = base->speed + u * (other->speed - base->speed);
+    float d_cog = other->cog - base->cog;
+    if (d_cog > 180) {
+        d_cog -= 360;
+    } else if (d_cog < -180) {
+        d_cog += 360;
+    }
+    fused->cog = fmodf(base->cog + u * d_cog + 360, 360);
+    fused->dop_h = dop_a * dop_b / sqrtf(dop_a * dop_a + dop_b * dop_b);
+}
+
+/**
+ * @brief Publish the epochs of both receivers for the same UTC time
+ *
+ * @param fusion fusion stage
+ */
+static void nmea_fusion_output_pair(nmea_fusion_t *fusion)
+{
+    uint8_t sel = fusion->selected;
+    const gps_t *a = &fusion->rx[sel].gps;
+    const gps_t *b = &fusion->rx[!sel].gps;
+    fusion->rx[0].pending = false;
+    fusion->rx[1].pending = false;
+    uint8_t best = nmea_fusion_better(b, a) ? !sel : sel;
+    uint8_t fix_class = nmea_fusion_class(a);
+    if (fusion->config.mode == NMEA_FUSION_WEIGHT && fix_class && fix_class == nmea_fusion_class(b) &&
+            a->dop_h > 0 && b->dop_h > 0) {
+        /* Same UTC time, the earlier arrival is the closer to the time of the fix */
+        int64_t epoch_us = fusion->rx[0].epoch_us < fusion->rx[1].epoch_us ? fusion->rx[0].epoch_us :
+                           fusion->rx[1].epoch_us;
+        nmea_fusion_average(&fusion->rx[best].gps, &fusion->rx[!best].gps, &fusion->fused);
+        nmea_fusion_output(fusion, &fusion->fused, NMEA_FUSION_RX_NUM, epoch_us);
+    } else {
+        nmea_fusion_output(fusion, &fusion->rx[best].gps, best, fusion->rx[best].epoch_us);
+    }
+}
+
+/**
+ * @brief Select the other receiver if its last epoch is better
+ *
+ * @param fusion fusion stage
+ */
+static void nmea_fusion_select(nmea_fusion_t *fusion)
+{
+    uint8_t sel = fusion->selected;
+    const nmea_fusion_rx_t *other = &fusion->rx[!sel];
+    if (other->seen && !other->missed && nmea_fusion_better(&other->gps, &fusion->rx[sel].gps)) {
+        fusion->selected = !sel;
+        fusion->failovers++;
+    }
+}
+
+void nmea_fusion_push(nmea_fusion_t *fusion, uint8_t rx, const gps_t *gps, int64_t epoch_us, uint32_t now_ms)
+{
+    nmea_fusion_rx_t *r = &fusion->rx[rx];
+    nmea_fusion_rx_t *o = &fusion->rx[!rx];
+    uint32_t time_ms = nmea_fusion_time_ms(gps);
+    if (r->pending) {
+        /* Timeout longer than the fix period, do not wait any more */
+        nmea_fusion_output_rx(fusion, rx);
+    }
+    r->gps = *gps;
+    r->time_ms = time_ms;
+    r->rx_ms = now_ms;
+    r->epoch_us = epoch_us;
+    r->seen = true;
+    r->missed = false;
+    r->epochs++;
+    if (fusion->has_published && nmea_fusion_diff(time_ms, fusion->published_ms) <= 0) {
+        /* The other receiver already delivered this time, too late to be used */
+        fusion->late++;
+        return;
+    }
+    if (o->pending) {
+        int32_t d = nmea_fusion_diff(o->time_ms, time_ms);
+        if (!d) {
+            nmea_fusion_output_pair(fusion);
+            nmea_fusion_select(fusion);
+            return;
+        }
+        if (d > 0) {
+            /* This receiver lags behind, its epoch is older than the waiting one */
+            nmea_fusion_output_rx(fusion, rx);
+            return;
+        }
+        /* This receiver skipped the time of the waiting epoch */
+        nmea_fusion_output_rx(fusion, !rx);
+    }
+    if (o->seen && !o->missed && (fusion->config.mode == NMEA_FUSION_WEIGHT || fusion->selected != rx)) {
+        r->pending = true;
+        return;
+    }
+    nmea_fusion_output_rx(fusion, rx);
+    nmea_fusion_select(fusion);
+}
+
+uint32_t nmea_fusion_poll(nmea_fusion_t *fusion, uint32_t now_ms)
+{
+    uint32_t next_ms = UINT32_MAX;
+    for (uint8_t rx = 0; rx < NMEA_FUSION_RX_NUM; rx++) {
+        nmea_fusion_rx_t *r = &fusion->rx[rx];
+        if (!r->pending) {
+            continue;
+        }
+        uint32_t waited_ms = now_ms - r->rx_ms;
+        if (waited_ms < fusion->config.timeout_ms) {
+            next_ms = fusion->config.timeout_ms - waited_ms;
+            continue;
+        }
+        /* The other receiver missed this epoch, fail over */
+        fusion->timeouts++;
+        fusion->rx[!rx].missed = true;
+        if (fusion->selected != rx) {
+            fusion->selected = rx;
+            fusion->failovers++;
+        }
+        nmea_fusion_output_rx(fusion, rx);
+    }
+    return next_ms;
+}
@@ -0,0 +1,132 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "nmea_decoder.h"
+
+#define NMEA_FUSION_RX_NUM (2) /*!< Number of receivers fused */
+
+/**
+ * @brief How the epochs of both receivers are combined
+ *
+ */
+typedef enum {
+    NMEA_FUSION_SELECT, /*!< Publish the epoch of the best receiver, as soon as the selected receiver delivers it */
+    NMEA_FUSION_WEIGHT, /*!< Wait for both receivers and average position, altitude, speed and course weighted by
+                             HDOP when both have the same fix type, otherwise publish the best epoch */
+} nmea_fusion_mode_t;
+
+/**
+ * @brief Configuration of the fusion stage
+ *
+ */
+typedef struct {
+    nmea_fusion_mode_t mode; /*!< How epochs are combined */
+    uint16_t timeout_ms;     /*!< Longest wait for the other receiver's epoch of the same UTC time (ms), must be
+                                  shorter than the fix period. A receiver which misses it is not waited for again
+                                  until it delivers an epoch */
+} nmea_fusion_config_t;
+
+/**
+ * @brief Output of fused epochs
+ *
+ * @param ctx context passed to nmea_fusion_init()
+ * @param gps fused epoch, only valid during the call
+ * @param rx receiver the epoch comes from, NMEA_FUSION_RX_NUM for an average of both
+ * @param epoch_us local time of the first statement of the epoch on its receiver, the earlier of both for an
+ *                 average
+ */
+typedef void (*nmea_fusion_publish_t)(void *ctx, const gps_t *gps, uint8_t rx, int64_t epoch_us);
+
+/**
+ * @brief State of one receiver in the fusion stage
+ *
+ */
+typedef struct {
+    gps_t gps;          /*!< Last epoch received */
+    uint32_t time_ms;   /*!< UTC time of day of the last epoch (ms) */
+    uint32_t rx_ms;     /*!< Local time the last epoch was received (ms) */
+    int64_t epoch_us;   /*!< Local time of the first statement of the last epoch */
+    bool seen;          /*!< An epoch was received */
+    bool pending;       /*!< The last epoch waits for the other receiver */
+    bool missed;        /*!< The last wait for this receiver timed out */
+    uint32_t epochs;    /*!< Epochs received */
+    uint32_t published; /*!< Epochs published from this receiver alone */
+} nmea_fusion_rx_t;
+
+/**
+ * @brief Fusion stage, aligns the epochs of two receivers by UTC time and publishes one stream
+ *
+ * Each UTC time is published once, in increasing order. Epochs arriving after their time was published are
+ * dropped. The stage does not allocate memory and does not depend on FreeRTOS, so that it can run on the host.
+ */
+typedef struct {
+    nmea_fusion_config_t config;          /*!< Configuration */
+    nmea_fusion_publish_t publish;        /*!< Output */
+    void *ctx;                            /*!< Context of output */
+    nmea_fusion_rx_t rx[NMEA_FUSION_RX_NUM]; /*!< Receivers */
+    uint8_t selected;                     /*!< Receiver preferred by the last epochs */
+    bool has_published;                   /*!< An epoch was published */
+    uint32_t published_ms;                /*!< UTC time of day of the last published epoch (ms) */
+    gps_t fused;                          /*!< Average of both receivers (weight mode only) */
+    uint32_t weighted;                    /*!< Epochs published as an average of both receivers */
+    uint32_t failovers;                   /*!< Switches of the selected receiver */
+    uint32_t timeouts;                    /*!< Epochs published after waiting for the other receiver in vain */
+    uint32_t late;                        /*!< Epochs dropped as their UTC time was already published */
+} nmea_fusion_t;
+
+/**
+ * @brief Init fusion stage
+ *
+ * @param fusion fusion stage
+ * @param config configuration, copied
+ * @param publish output of fused epochs
+ * @param ctx context of publish
+ */
+void nmea_fusion_init(nmea_fusion_t *fusion, const nmea_fusion_config_t *config, nmea_fusion_publish_t publish,
+                      void *ctx);
+
+/**
+ * @brief Feed the epoch decoded from one receiver
+ *
+ * The epoch is published at once, or when the other receiver delivers the same UTC time, or at the timeout.
+ *
+ * @param fusion fusion stage
+ * @param rx receiver index, 0 or 1
+ * @param gps decoded epoch, copied
+ * @param epoch_us local time of the first statement of the epoch, passed to the output with the epoch
+ * @param now_ms local time (ms), wrapping
+ */
+void nmea_fusion_push(nmea_fusion_t *fusion, uint8_t rx, const gps_t *gps, int64_t epoch_us, uint32_t now_ms);
+
+/**
+ * @brief Publish the epochs whose wait timed out
+ *
+ * @param fusion fusion stage
+ * @param now_ms local time (ms), wrapping
+ * @return uint32_t time until the next timeout (ms), UINT32_MAX if no epoch waits
+ */
+uint32_t nmea_fusion_poll(nmea_fusion_t *fusion, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,644 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/param.h>
+#include "nmea_geofence.h"
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+
+static const char *GEOFENCE_TAG = "nmea_geofence";
+#else
+#define ESP_LOGE(tag, format, ...) ((void)0)
+#define ESP_LOGI(tag, format, ...) ((void)0)
+#endif
+
+#define NMEA_GEOFENCE_MAX_CELLS (1 << 22)
+#define NMEA_GEOFENCE_FULL (1)    /* Cell entry flag, the cell is fully inside the fence */
+#define NMEA_GEOFENCE_INSIDE (1 << 0) /* Fence flag, last update was inside */
+#define NMEA_GEOFENCE_SEEN (1 << 1)   /* Fence flag, current update is inside */
+
+/**
+ * @brief Cell mark while building the index
+ *
+ */
+typedef enum {
+    NMEA_CELL_OUT,     /*!< Cell outside of the fence */
+    NMEA_CELL_FULL,    /*!< Cell fully inside of the fence */
+    NMEA_CELL_PARTIAL, /*!< Cell crossed by an edge of the fence */
+} nmea_cell_mark_t;
+
+/**
+ * @brief Polygon fence
+ *
+ */
+typedef struct {
+    uint32_t id;        /*!< Identifier of the fence */
+    uint32_t vertex;    /*!< Index of the first vertex */
+    uint32_t count;     /*!< Number of vertices */
+    int32_t lat_min;    /*!< Bounding box, minimum latitude */
+    int32_t lat_max;    /*!< Bounding box, maximum latitude */
+    int32_t lon_min;    /*!< Bounding box, minimum longitude */
+    int32_t lon_max;    /*!< Bounding box, maximum longitude */
+    uint32_t row_min;   /*!< First row of cells of the bounding box */
+    uint32_t row_max;   /*!< Last row of cells of the bounding box */
+    uint32_t col_min;   /*!< First column of cells of the bounding box */
+    uint32_t col_max;   /*!< Last column of cells of the bounding box */
+    uint32_t row_start; /*!< Index of the edge list offset of the first row */
+} nmea_fence_t;
+
+/**
+ * @brief Set of geofences and grid index
+ *
+ */
+typedef struct {
+    nmea_fence_t *fence;            /*!< Fences */
+    uint32_t fence_num;             /*!< Number of fences */
+    uint32_t fence_cap;             /*!< Capacity of fences */
+    nmea_geofence_point_t *vertex;  /*!< Vertices of all fences */
+    uint32_t vertex_num;            /*!< Number of vertices */
+    uint32_t vertex_cap;            /*!< Capacity of vertices */
+    bool built;                     /*!< Index built */
+    int32_t lat0;                   /*!< Latitude of the first row of cells */
+    int32_t lon0;                   /*!< Longitude of the first column of cells */
+    uint32_t cell_size;             /*!< Size of a cell (degrees * 1e7) */
+    uint32_t rows;                  /*!< Number of rows of cells */
+    uint32_t cols;                  /*!< Number of columns of cells */
+    uint32_t *cell_start;           /*!< Index of the first entry of each cell, rows * cols + 1 */
+    uint32_t *cell_entry;           /*!< Entries of all cells, fence index << 1 | NMEA_GEOFENCE_FULL */
+    uint32_t *row_offset;           /*!< Index of the first edge of each row of each fence, rows + 1 per fence */
+    uint16_t *row_edge;             /*!< Edges of all rows of all fences, index in the fence */
+    uint32_t row_edge_num;          /*!< Number of edges of all rows */
+    uint8_t *flags;                 /*!< State of each fence for nmea_geofence_update() */
+    uint32_t *inside;               /*!< Fences inside at last update */
+    uint32_t *next_inside;          /*!< Fences inside at current update */
+    uint32_t inside_num;            /*!< Number of fences inside at last update */
+} nmea_geofence_t;
+
+static inline uint32_t nmea_geofence_row(const nmea_geofence_t *geo, int32_t latitude)
+{
+    return (uint32_t)(((int64_t)latitude - geo->lat0) / geo->cell_size);
+}
+
+static inline uint32_t nmea_geofence_col(const nmea_geofence_t *geo, int32_t longitude)
+{
+    return (uint32_t)(((int64_t)longitude - geo->lon0) / geo->cell_size);
+}
+
+/**
+ * @brief Test a position against a fence, with the edges of the row of cells of the position
+ *
+ * Even-odd rule: count the edges crossed by a ray to the east, in integer arithmetic.
+ *
+ * @param geo set of geofences
+ * @param fence fence
+ * @param row row of cells of the position
+ * @param latitude latitude of the position
+ * @param longitude longitude of the position
+ * @return true if the position is inside of the fence
+ */
+static bool nmea_fence_contains(const nmea_geofence_t *geo, const nmea_fence_t *fence, uint32_t row,
+                                int32_t latitude, int32_t longitude)
+{
+    if (latitude < fence->lat_min || latitude > fence->lat_max ||
+            longitude < fence->lon_min || longitude > fence->lon_max) {
+        return false;
+    }
+    const uint32_t *offset = &geo->row_offset[fence->row_start + row - fence->row_min];
+    const nmea_geofence_point_t *vertex = &geo->vertex[fence->vertex];
+    bool inside = false;
+    for (uint32_t k = offset[0]; k < offset[1]; k++) {
+        uint32_t e = geo->row_edge[k];
+        const nmea_geofence_point_t *a = &vertex[e];
+        const nmea_geofence_point_t *b = &vertex[e + 1 == fence->count ? 0 : e + 1];
+        if ((a->latitude > latitude) != (b->latitude > latitude)) {
+            /* longitude < crossing longitude, without division */
+            int64_t dlat = (int64_t)b->latitude - a->latitude;
+            int64_t lhs = ((int64_t)longitude - a->longitude) * dlat;
+            int64_t rhs = ((int64_t)latitude - a->latitude) * ((int64_t)b->longitude - a->longitude);
+            if (dlat > 0 ? lhs < rhs : lhs > rhs) {
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+/**
+ * @brief Get the columns of cells crossed by an edge within a row of cells
+ *
+ */
+static void nmea_edge_row_cols(const nmea_geofence_t *geo, const nmea_geofence_point_t *a,
+                               const nmea_geofence_point_t *b, uint32_t row, uint32_t *col_min, uint32_t *col_max)
+{
+    int64_t lon_a = a->longitude;
+    int64_t lon_b = b->longitude;
+    if (a->latitude != b->latitude) {
+        /* Clip the edge to the latitudes of the row */
+        int64_t band_min = (int64_t)geo->lat0 + (int64_t)row * geo->cell_size;
+        int64_t band_max = band_min + geo->cell_size - 1;
+        int64_t lat_lo = MAX(MIN(a->latitude, b->latitude), band_min);
+        int64_t lat_hi = MIN(MAX(a->latitude, b->latitude), band_max);
+        int64_t dlat = (int64_t)b->latitude - a->latitude;
+        int64_t dlon = (int64_t)b->longitude - a->longitude;
+        lon_a = a->longitude + (lat_lo - a->latitude) * dlon / dlat;
+        lon_b = a->longitude + (lat_hi - a->latitude) * dlon / dlat;
+    }
+    /* Crossing longitudes are rounded, widen by one unit not to miss a cell crossed close to its border */
+    *col_min = nmea_geofence_col(geo, (int32_t)MAX(MIN(lon_a, lon_b) - 1, (int64_t)geo->lon0));
+    *col_max = nmea_geofence_col(geo, (int32_t)MAX(lon_a, lon_b) + 1);
+}
+
+/**
+ * @brief Create an empty set of geofences
+ *
+ * @param geofence handle of the set will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NO_MEM: out of memory
+ */
+esp_err_t nmea_geofence_create(nmea_geofence_handle_t *geofence)
+{
+    nmea_geofence_t *geo = calloc(1, sizeof(nmea_geofence_t));
+    if (!geo) {
+        ESP_LOGE(GEOFENCE_TAG, "calloc memory for geofence failed");
+        return ESP_ERR_NO_MEM;
+    }
+    *geofence = geo;
+    return ESP_OK;
+}
+
+/**
+ * @brief Delete a set of geofences
+ *
+ * @param geofence handle of the set
+ */
+void nmea_geofence_delete(nmea_geofence_handle_t geofence)
+{
+    nmea_geofence_t *geo = (nmea_geofence_t *)geofence;
+    free(geo->fence);
+    free(geo->vertex);
+    free(geo->cell_start);
+    free(geo->cell_entry);
+    free(geo->row_offset);
+    free(geo->row_edge);
+    free(geo->flags);
+    free(geo->inside);
+    free(geo->next_inside);
+    free(geo);
+}
+
+/**
+ * @brief Add a polygon fence
+ *
+ * @param geofence handle of the set
+ * @param fence_id identifier of the fence
+ * @param vertices vertices of the polygon
+ * @param count number of vertices
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: too few or too many vertices
+ *  - ESP_ERR_INVALID_STATE: the index is already built
+ *  - ESP_ERR_NO_MEM: out of memory
+ */
+esp_err_t nmea_geofence_add(nmea_geofence_handle_t geofence, uint32_t fence_id, const nmea_geofence_point_t *vertices,
+                            size_t count)
+{
+    nmea_geofence_t *geo = (nmea_geofence_t *)geofence;
+    if (count < 3 || count > UINT16_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (geo->built) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (geo->fence_num == geo->fence_cap) {
+        uint32_t cap = geo->fence_cap ? geo->fence_cap * 2 : 16;
+        nmea_fence_t *fence = realloc(geo->fence, cap * sizeof(nmea_fence_t));
+        if (!fence) {
+            return ESP_ERR_NO_MEM;
+        }
+        geo->fence = fence;
+        geo->fence_cap = cap;
+    }
+    if (geo->vertex_num + count > geo->vertex_cap) {
+        uint32_t cap = MAX(geo->vertex_cap * 2, geo->vertex_num + count);
+        nmea_geofence_point_t *vertex = realloc(geo->vertex, cap * sizeof(nmea_geofence_point_t));
+        if (!vertex) {
+            return ESP_ERR_NO_MEM;
+        }
+        geo->vertex = vertex;
+        geo->vertex_cap = cap;
+    }
+    nmea_fence_t *fence = &geo->fence[geo->fence_num++];
+    memset(fence, 0, sizeof(nmea_fence_t));
+    fence->id = fence_id;
+    fence->vertex = geo->vertex_num;
+    fence->count = count;
+    fence->lat_min = fence->lon_min = INT32_MAX;
+    fence->lat_max = fence->lon_max = INT32_MIN;
+    for (size_t i = 0; i < count; i++) {
+        fence->lat_min = MIN(fence->lat_min, vertices[i].latitude);
+        fence->lat_max = MAX(fence->lat_max, vertices[i].latitude);
+        fence->lon_min = MIN(fence->lon_min, vertices[i].longitude);
+        fence->lon_max = MAX(fence->lon_max, vertices[i].longitude);
+    }
+    memcpy(&geo->vertex[geo->vertex_num], vertices, count * sizeof(nmea_geofence_point_t));
+    geo->vertex_num += count;
+    return ESP_OK;
+}
+
+/**
+ * @brief Size the grid over the bounding box of all fences
+ *
+ */
+static esp_err_t nmea_geofence_size_grid(nmea_geofence_t *geo, uint32_t cell_size)
+{
+    int32_t lat_min = INT32_MAX;
+    int32_t lat_max = INT32_MIN;
+    int32_t lon_min = INT32_MAX;
+    int32_t lon_max = INT32_MIN;
+    for (uint32_t i = 0; i < geo->fence_num; i++) {
+        lat_min = MIN(lat_min, geo->fence[i].lat_min);
+        lat_max = MAX(lat_max, geo->fence[i].lat_max);
+        lon_min = MIN(lon_min, geo->fence[i].lon_min);
+        lon_max = MAX(lon_max, geo->fence[i].lon_max);
+    }
+    double height = (double)lat_max - lat_min + 1;
+    double width = (double)lon_max - lon_min + 1;
+    if (!cell_size) {
+        /* About one cell per fence */
+        cell_size = (uint32_t)MAX(ceil(sqrt(height * width / geo->fence_num)), 1);
+    }
+    if (ceil(height / cell_size) * ceil(width / cell_size) > NMEA_GEOFENCE_MAX_CELLS) {
+        ESP_LOGE(GEOFENCE_TAG, "cell size %u too small", (unsigned)cell_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    geo->lat0 = lat_min;
+    geo->lon0 = lon_min;
+    geo->cell_size = cell_size;
+    geo->rows = nmea_geofence_row(geo, lat_max) + 1;
+    geo->cols = nmea_geofence_col(geo, lon_max) + 1;
+    return ESP_OK;
+}
+
+/**
+ * @brief Build the lists of edges of each row of cells of each fence
+ *
+ */
+static esp_err_t nmea_geofence_build_rows(nmea_geofence_t *geo)
+{
+    uint32_t offsets = 0;
+    for (uint32_t i = 0; i < geo->fence_num; i++) {
+        nmea_fence_t *fence = &geo->fence[i];
+        fence->row_min = nmea_geofence_row(geo, fence->lat_min);
+        fence->row_max = nmea_geofence_row(geo, fence->lat_max);
+        fence->col_min = nmea_geofence_col(geo, fence->lon_min);
+        fence->col_max = nmea_geofence_col(geo, fence->lon_max);
+        fence->row_start = offsets;
+        offsets += fence->row_max - fence->row_min + 2;
+    }
+    geo->row_offset = calloc(offsets, sizeof(uint32_t));
+    if (!geo->row_offset) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* Count the edges of each row, then fill the lists */
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < geo->fence_num; i++) {
+            const nmea_fence_t *fence = &geo->fence[i];
+            uint32_t *offset = &geo->row_offset[fence->row_start];
+            uint32_t rows = fence->row_max - fence->row_min + 1;
+            if (pass == 0) {
+                memset(offset, 0, (rows + 1) * sizeof(uint32_t));
+            }
+            for (uint32_t e = 0; e < fence->count; e++) {
+                const nmea_geofence_point_t *a = &geo->vertex[fence->vertex + e];
+                const nmea_geofence_point_t *b = &geo->vertex[fence->vertex + (e + 1 == fence->count ? 0 : e + 1)];
+                if (a->latitude == b->latitude) {
+                    /* Never crossed by a ray to the east */
+                    continue;
+                }
+                uint32_t r0 = nmea_geofence_row(geo, MIN(a->latitude, b->latitude)) - fence->row_min;
+                uint32_t r1 = nmea_geofence_row(geo, MAX(a->latitude, b->latitude)) - fence->row_min;
+                for (uint32_t r = r0; r <= r1; r++) {
+                    if (pass == 0) {
+                        offset[r + 1]++;
+                    } else {
+                        geo->row_edge[offset[r]++] = (uint16_t)e;
+                    }
+                }
+            }
+            if (pass == 0) {
+                /* Prefix sum, offsets of the fence continue those of the previous fence */
+                offset[0] = total;
+                for (uint32_t r = 1; r <= rows; r++) {
+                    offset[r] += offset[r - 1];
+                }
+                total = offset[rows];
+            } else {
+                /* Filling advanced each offset to the start of the next row, shift back */
+                memmove(&offset[1], &offset[0], rows * sizeof(uint32_t));
+                offset[0] = total;
+                total = offset[rows];
+            }
+        }
+        if (pass == 0) {
+            geo->row_edge_num = total;
+            geo->row_edge = malloc(MAX(total, 1) * sizeof(uint16_t));
+            if (!geo->row_edge) {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Mark the cells of the bounding box of a fence
+ *
+ * @param geo set of geofences
+ * @param fence fence
+ * @param mark marks of the cells of the bounding box, row by row
+ */
+static void nmea_geofence_mark_cells(const nmea_geofence_t *geo, const nmea_fence_t *fence, uint8_t *mark)
+{
+    uint32_t cols = fence->col_max - fence->col_min + 1;
+    uint32_t rows = fence->row_max - fence->row_min + 1;
+    memset(mark, NMEA_CELL_OUT, rows * cols);
+    /* Cells crossed by an edge */
+    for (uint32_t e = 0; e < fence->count; e++) {
+        const nmea_geofence_point_t *a = &geo->vertex[fence->vertex + e];
+        const nmea_geofence_point_t *b = &geo->vertex[fence->vertex + (e + 1 == fence->count ? 0 : e + 1)];
+        uint32_t r0 = nmea_geofence_row(geo, MIN(a->latitude, b->latitude));
+        uint32_t r1 = nmea_geofence_row(geo, MAX(a->latitude, b->latitude));
+        for (uint32_t r = r0; r <= r1; r++) {
+            uint32_t c0;
+            uint32_t c1;
+            nmea_edge_row_cols(geo, a, b, r, &c0, &c1);
+            c0 = MAX(c0, fence->col_min);
+            c1 = MIN(c1, fence->col_max);
+            memset(&mark[(r - fence->row_min) * cols + c0 - fence->col_min], NMEA_CELL_PARTIAL, c1 - c0 + 1);
+        }
+    }
+    /* Other cells are either fully inside or fully outside, test their center */
+    for (uint32_t r = 0; r < rows; r++) {
+        int32_t lat = (int32_t)((int64_t)geo->lat0 + (int64_t)(fence->row_min + r) * geo->cell_size + geo->cell_size / 2);
+        for (uint32_t c = 0; c < cols; c++) {
+            if (mark[r * cols + c] == NMEA_CELL_PARTIAL) {
+                continue;
+            }
+            int32_t lon = (int32_t)((int64_t)geo->lon0 + (int64_t)(fence->col_min + c) * geo->cell_size +
+                                    geo->cell_size / 2);
+            /* The center of a border cell may be outside of the bounding box, and so outside of the fence */
+            if (nmea_fence_contains(geo, fence, fence->row_min + r, lat, lon)) {
+                mark[r * cols + c] = NMEA_CELL_FULL;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Build the grid index of the fences, after the last nmea_geofence_add()
+ *
+ * @param geofence handle of the set
+ * @param cell_size size of a cell (degrees * 1e7), 0 for automatic
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_STATE: no fence added, or the index is already built
+ *  - ESP_ERR_INVALID_SIZE: cell_size too small for the area of the fences
+ *  - ESP_ERR_NO_MEM: out of memory
+ */
+esp_err_t nmea_geofence_build(nmea_geofence_handle_t geofence, uint32_t cell_size)
+{
+    nmea_geofence_t *geo = (nmea_geofence_t *)geofence;
+    if (geo->built || !geo->fence_num) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = nmea_geofence_size_grid(geo, cell_size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nmea_geofence_build_rows(geo);
+    if (err != ESP_OK) {
+        goto err_rows;
+    }
+    uint32_t cells = geo->rows * geo->cols;
+    size_t mark_size = 0;
+    for (uint32_t i = 0; i < geo->fence_num; i++) {
+        const nmea_fence_t *fence = &geo->fence[i];
+        mark_size = MAX(mark_size, (size_t)(fence->row_max - fence->row_min + 1) * (fence->col_max - fence->col_min + 1));
+    }
+    uint8_t *mark = malloc(mark_size);
+    geo->cell_start = calloc(cells + 1, sizeof(uint32_t));
+    geo->flags = calloc(geo->fence_num, sizeof(uint8_t));
+    geo->inside = malloc(geo->fence_num * sizeof(uint32_t));
+    geo->next_inside = malloc(geo->fence_num * sizeof(uint32_t));
+    if (!mark || !geo->cell_start || !geo->flags || !geo->inside || !geo->next_inside) {
+        err = ESP_ERR_NO_MEM;
+        goto err_cells;
+    }
+    /* Count the entries of each cell, then fill them, fence by fence */
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < geo->fence_num; i++) {
+            const nmea_fence_t *fence = &geo->fence[i];
+            uint32_t cols = fence->col_max - fence->col_min + 1;
+            nmea_geofence_mark_cells(geo, fence, mark);
+            for (uint32_t r = fence->row_min; r <= fence->row_max; r++) {
+                for (uint32_t c = fence->col_min; c <= fence->col_max; c++) {
+                    uint8_t m = mark[(r - fence->row_min) * cols + c - fence->col_min];
+                    if (m == NMEA_CELL_OUT) {
+                        continue;
+                    }
+                    uint32_t cell = r * geo->cols + c;
+                    if (pass == 0) {
+                        geo->cell_start[cell + 1]++;
+                    } else {
+                        geo->cell_entry[geo->cell_start[cell]++] = (i << 1) | (m == NMEA_CELL_FULL ? NMEA_GEOFENCE_FULL : 0);
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (uint32_t cell = 1; cell <= cells; cell++) {
+                geo->cell_start[cell] += geo->cell_start[cell - 1];
+            }
+            geo->cell_entry = malloc(MAX(geo->cell_start[cells], 1) * sizeof(uint32_t));
+            if (!geo->cell_entry) {
+                err = ESP_ERR_NO_MEM;
+                goto err_cells;
+            }
+        } else {
+            /* Filling advanced each start to the start of the next cell, shift back */
+            memmove(&geo->cell_start[1], &geo->cell_start[0], cells * sizeof(uint32_t));
+            geo->cell_start[0] = 0;
+        }
+    }
+    free(mark);
+    geo->built = true;
+    ESP_LOGI(GEOFENCE_TAG, "%u fences, %ux%u cells of %u, %u bytes", (unsigned)geo->fence_num, (unsigned)geo->rows,
+             (unsigned)geo->cols, (unsigned)geo->cell_size, (unsigned)nmea_geofence_get_size(geo));
+    return ESP_OK;
+    /*Error Handling*/
+err_cells:
+    free(mark);
+    free(geo->cell_start);
+    free(geo->cell_entry);
+    free(geo->flags);
+    free(geo->inside);
+    free(geo->next_inside);
+    geo->cell_start = NULL;
+    geo->cell_entry = NULL;
+    geo->flags = NULL;
+    geo->inside = NULL;
+    geo->next_inside = NULL;
+err_rows:
+    free(geo->row_offset);
+    free(geo->row_edge);
+    geo->row_offset = NULL;
+    geo->row_edge = NULL;
+    return err;
+}
+
+/**
+ * @brief Get the entries of the cell of a position
+ *
+ * @return uint32_t number of entries, 0 outside of the grid
+ */
+static uint32_t nmea_geofence_cell(const nmea_geofence_t *geo, int32_t latitude, int32_t longitude,
+                                   uint32_t *row, const uint32_t **entry)
+{
+    if (latitude < geo->lat0 || longitude < geo->lon0) {
+        return 0;
+    }
+    uint32_t r = nmea_geofence_row(geo, latitude);
+    uint32_t c = nmea_geofence_col(geo, longitude);
+    if (r >= geo->rows || c >= geo->cols) {
+        return 0;
+    }
+    uint32_t cell = r * geo->cols + c;
+    *row = r;
+    *entry = &geo->cell_entry[geo->cell_start[cell]];
+    return geo->cell_start[cell + 1] - geo->cell_start[cell];
+}
+
+/**
+ * @brief Test a position against the fences, report fences entered and exited since the last update
+ *
+ * @param geofence handle of the set
+ * @param latitude latitude (degrees * 1e7)
+ * @param longitude longitude (degrees * 1e7)
+ * @param cb function called for each fence entered or exited, may be NULL
+ * @param arg argument passed to cb
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_STATE: the index is not built
+ */
+esp_err_t nmea_geofence_update(nmea_geofence_handle_t geofence, int32_t latitude, int32_t longitude,
+                               nmea_geofence_cb_t cb, void *arg)
+{
+    nmea_geofence_t *geo = (nmea_geofence_t *)geofence;
+    if (!geo->built) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint32_t row = 0;
+    const uint32_t *entry = NULL;
+    uint32_t entries = nmea_geofence_cell(geo, latitude, longitude, &row, &entry);
+    uint32_t next_num = 0;
+    for (uint32_t k = 0; k < entries; k++) {
+        uint32_t i = entry[k] >> 1;
+        if ((entry[k] & NMEA_GEOFENCE_FULL) || nmea_fence_contains(geo, &geo->fence[i], row, latitude, longitude)) {
+            geo->flags[i] |= NMEA_GEOFENCE_SEEN;
+            geo->next_inside[next_num++] = i;
+        }
+    }
+    /* Exits first, then entries */
+    for (uint32_t k = 0; k < geo->inside_num; k++) {
+        uint32_t i = geo->inside[k];
+        if (!(geo->flags[i] & NMEA_GEOFENCE_SEEN)) {
+            geo->flags[i] &= ~NMEA_GEOFENCE_INSIDE;
+            if (cb) {
+                cb(geo->fence[i].id, false, arg);
+            }
+        }
+    }
+    for (uint32_t k = 0; k < next_num; k++) {
+        uint32_t i = geo->next_inside[k];
+        geo->flags[i] &= ~NMEA_GEOFENCE_SEEN;
+        if (!(geo->flags[i] & NMEA_GEOFENCE_INSIDE)) {
+            geo->flags[i] |= NMEA_GEOFENCE_INSIDE;
+            if (cb) {
+                cb(geo->fence[i].id, true, arg);
+            }
+        }
+    }
+    uint32_t *inside = geo->inside;
+    geo->inside = geo->next_inside;
+    geo->next_inside = inside;
+    geo->inside_num = next_num;
+    return ESP_OK;
+}
+
+/**
+ * @brief Check whether a position is inside a fence
+ *
+ * @param geofence handle of the set
+ * @param fence_id identifier of the fence
+ * @param latitude latitude (degrees * 1e7)
+ * @param longitude longitude (degrees * 1e7)
+ * @param inside result will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: no fence with this identifier
+ *  - ESP_ERR_INVALID_STATE: the index is not built
+ */
+esp_err_t nmea_geofence_contains(nmea_geofence_handle_t geofence, uint32_t fence_id, int32_t latitude,
+                                 int32_t longitude, bool *inside)
+{
+    nmea_geofence_t *geo = (nmea_geofence_t *)geofence;
+    if (!geo->built) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (uint32_t i = 0; i < geo->fence_num; i++) {
+        const nmea_fence_t *fence = &geo->fence[i];
+        if (fence->id == fence_id) {
+            *inside = nmea_fence_contains(geo, fence, nmea_geofence_row(geo, MAX(latitude, geo->lat0)), latitude,
+                                          longitude);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Get the memory used by a set of geofences
+ *
+ * @param geofence handle of the set
+ * @return size_t bytes allocated for fences, vertices and index
+ */
+size_t nmea_geofence_get_size(nmea_geofence_handle_t geofence)
+{
+    const nmea_geofence_t *geo = (const nmea_geofence_t *)geofence;
+    size_t size = sizeof(nmea_geofence_t) + geo->fence_cap * sizeof(nmea_fence_t) +
+                  geo->vertex_cap * sizeof(nmea_geofence_point_t);
+    if (geo->built) {
+        size += (geo->rows * geo->cols + 1) * sizeof(uint32_t) + geo->cell_start[geo->rows * geo->cols] * sizeof(uint32_t);
+        size += (geo->fence[geo->fence_num - 1].row_start + geo->fence[geo->fence_num - 1].row_max -
+                 geo->fence[geo->fence_num - 1].row_min + 2) * sizeof(uint32_t);
+        size += geo->row_edge_num * sizeof(uint16_t);
+        size += geo->fence_num * (sizeof(uint8_t) + 2 * sizeof(uint32_t));
+    }
+    return size;
+}
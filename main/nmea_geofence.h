@@ -0,0 +1,155 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "nmea_decoder.h"
+
+/**
+ * @brief Vertex of a geofence polygon
+ *
+ */
+typedef struct {
+    int32_t latitude;  /*!< Latitude (degrees * 1e7) */
+    int32_t longitude; /*!< Longitude (degrees * 1e7) */
+} nmea_geofence_point_t;
+
+/**
+ * @brief Geofence event, data of GPS_GEOFENCE_ENTER and GPS_GEOFENCE_EXIT events
+ *
+ */
+typedef struct {
+    uint32_t fence_id;  /*!< Identifier of the fence, as passed to nmea_geofence_add() */
+    gps_fix_core_t fix; /*!< Fix that entered or exited the fence */
+} nmea_geofence_event_t;
+
+/**
+ * @brief Geofence Handle
+ *
+ */
+typedef void *nmea_geofence_handle_t;
+
+/**
+ * @brief Function called for each fence entered or exited by nmea_geofence_update()
+ *
+ * @param fence_id identifier of the fence
+ * @param inside true if the fence was entered, false if it was exited
+ * @param arg argument passed to nmea_geofence_update()
+ */
+typedef void (*nmea_geofence_cb_t)(uint32_t fence_id, bool inside, void *arg);
+
+/**
+ * @brief Create an empty set of geofences
+ *
+ * @param geofence handle of the set will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NO_MEM: out of memory
+ */
+esp_err_t nmea_geofence_create(nmea_geofence_handle_t *geofence);
+
+/**
+ * @brief Delete a set of geofences
+ *
+ * @param geofence handle of the set
+ */
+void nmea_geofence_delete(nmea_geofence_handle_t geofence);
+
+/**
+ * @brief Add a polygon fence
+ *
+ * The polygon is closed implicitly (last vertex to first) and may be concave. It must not cross the
+ * antimeridian. The vertices are copied.
+ *
+ * @param geofence handle of the set
+ * @param fence_id identifier of the fence, reported in events
+ * @param vertices vertices of the polygon
+ * @param count number of vertices, 3 to 65535
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: too few or too many vertices
+ *  - ESP_ERR_INVALID_STATE: the index is already built
+ *  - ESP_ERR_NO_MEM: out of memory
+ */
+esp_err_t nmea_geofence_add(nmea_geofence_handle_t geofence, uint32_t fence_id, const nmea_geofence_point_t *vertices,
+                            size_t count);
+
+/**
+ * @brief Build the grid index of the fences, after the last nmea_geofence_add()
+ *
+ * The bounding box of all fences is split into square cells. Each cell lists the fences covering it, marked
+ * as fully inside or crossed by an edge, and each fence lists its edges per row of cells. A fix is tested
+ * against the fences of its cell only: in constant time if the cell is fully inside, against the edges of its
+ * row of cells otherwise.
+ *
+ * @param geofence handle of the set
+ * @param cell_size size of a cell (degrees * 1e7), 0 to size the grid to about one cell per fence
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_STATE: no fence added, or the index is already built
+ *  - ESP_ERR_INVALID_SIZE: cell_size too small for the area of the fences
+ *  - ESP_ERR_NO_MEM: out of memory
+ */
+esp_err_t nmea_geofence_build(nmea_geofence_handle_t geofence, uint32_t cell_size);
+
+/**
+ * @brief Test a position against the fences, report fences entered and exited since the last update
+ *
+ * @param geofence handle of the set
+ * @param latitude latitude (degrees * 1e7)
+ * @param longitude longitude (degrees * 1e7)
+ * @param cb function called for each fence entered or exited, may be NULL
+ * @param arg argument passed to cb
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_STATE: the index is not built
+ */
+esp_err_t nmea_geofence_update(nmea_geofence_handle_t geofence, int32_t latitude, int32_t longitude,
+                               nmea_geofence_cb_t cb, void *arg);
+
+/**
+ * @brief Check whether a position is inside a fence, without changing the state of nmea_geofence_update()
+ *
+ * @param geofence handle of the set
+ * @param fence_id identifier of the fence
+ * @param latitude latitude (degrees * 1e7)
+ * @param longitude longitude (degrees * 1e7)
+ * @param inside result will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: no fence with this identifier
+ *  - ESP_ERR_INVALID_STATE: the index is not built
+ */
+esp_err_t nmea_geofence_contains(nmea_geofence_handle_t geofence, uint32_t fence_id, int32_t latitude,
+                                 int32_t longitude, bool *inside);
+
+/**
+ * @brief Get the memory used by a set of geofences
+ *
+ * @param geofence handle of the set
+ * @return size_t bytes allocated for fences, vertices and index
+ */
+size_t nmea_geofence_get_size(nmea_geofence_handle_t geofence);
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,21 +13,55 @@
 // limitations under the License.
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nmea_parser.h"
+#include "nmea_geofence.h"
+#include "nmea_rate.h"
+#include "nmea_fusion.h"
+#include "nmea_filter.h"
+#include "nmea_predictor.h"
+#include "nmea_track.h"
 
 /**
  * @brief NMEA Parser runtime buffer size
  *
  */
 #define NMEA_PARSER_RUNTIME_BUFFER_SIZE (CONFIG_NMEA_PARSER_RING_BUFFER_SIZE / 2)
-#define NMEA_MAX_STATEMENT_ITEM_LENGTH (16)
-#define NMEA_EVENT_LOOP_QUEUE_SIZE (16)
+#define NMEA_EVENT_LOOP_QUEUE_SIZE CONFIG_NMEA_PARSER_EVENT_LOOP_QUEUE_SIZE
+#define NMEA_PARSER_HANDLER_NUM CONFIG_NMEA_PARSER_HANDLER_NUM
+#define NMEA_PARSER_DIRECT_HANDLER_NUM CONFIG_NMEA_PARSER_DIRECT_HANDLER_NUM
+#define NMEA_EVENT_NUM (GPS_GEOFENCE_EXIT + 1)
+#define NMEA_HANDLER_HIST_BUCKETS (20)
+#define NMEA_PARSER_FIX_HISTORY_SIZE CONFIG_NMEA_PARSER_FIX_HISTORY_SIZE
+#define NMEA_MS_PER_DAY (86400000LL)
+#if CONFIG_NMEA_PARSER_RATE_PROTOCOL_UBX
+#define NMEA_RATE_PROTOCOL NMEA_RATE_PROTOCOL_UBX
+#else
+#define NMEA_RATE_PROTOCOL NMEA_RATE_PROTOCOL_PMTK
+#endif
+#if CONFIG_NMEA_PARSER_PREDICTOR && CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ
+/* Wake up the parser task at twice the upsampling rate */
+#define NMEA_PARSER_TASK_WAIT_TICKS MAX(1, pdMS_TO_TICKS(500 / CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ))
+#else
+#define NMEA_PARSER_TASK_WAIT_TICKS pdMS_TO_TICKS(200)
+#endif
+#define NMEA_PARSER_STATEMENT_PARSER_NUM CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM
+#define NMEA_PARSER_PIPELINE_SLOTS CONFIG_NMEA_PARSER_PIPELINE_SLOTS
+#define NMEA_PARSER_PIPELINE_SLOT_SIZE CONFIG_NMEA_PARSER_PIPELINE_SLOT_SIZE
+#define NMEA_PARSER_TASK_STACK_SIZE CONFIG_NMEA_PARSER_TASK_STACK_SIZE
+#if CONFIG_NMEA_PARSER_PIPELINE
+#define NMEA_PARSER_INGEST_TASK_STACK_SIZE CONFIG_NMEA_PARSER_INGEST_TASK_STACK_SIZE
+#else
+#define NMEA_PARSER_INGEST_TASK_STACK_SIZE (0)
+#endif
 
 /**
  * @brief Define of NMEA Parser Event base
@@ -37,678 +71,1444 @@ ESP_EVENT_DEFINE_BASE(ESP_NMEA_EVENT);
 
 static const char *GPS_TAG = "nmea_parser";
 
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
 /**
- * @brief GPS parser library runtime structure
+ * @brief Execution time accumulator of one event handler
+ *
+ */
+typedef struct {
+    uint32_t count;                           /*!< Number of calls */
+    uint64_t sum_us;                          /*!< Sum of execution times (us) */
+    uint32_t min_us;                          /*!< Minimum execution time (us) */
+    uint32_t max_us;                          /*!< Maximum execution time (us) */
+    uint32_t overrun;                         /*!< Calls exceeding the budget */
+    uint32_t hist[NMEA_HANDLER_HIST_BUCKETS]; /*!< Calls per execution time bucket, bucket n holds [2^(n-1), 2^n) us */
+} nmea_handler_acc_t;
+#endif
+
+/**
+ * @brief Event handler slot
+ *
+ */
+typedef struct {
+    esp_event_handler_t handler; /*!< User defined event handler */
+    void *handler_args;          /*!< Handler specific arguments */
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
+    nmea_handler_acc_t acc;      /*!< Execution time of the handler */
+#endif
+} nmea_event_handler_t;
+
+/**
+ * @brief Direct handler slot
+ *
+ */
+typedef struct {
+    nmea_parser_direct_handler_t handler; /*!< User defined direct handler */
+    void *handler_args;                   /*!< Handler specific arguments */
+} nmea_direct_handler_t;
+
+/**
+ * @brief Latency accumulator of one hop
+ *
+ */
+typedef struct {
+    uint32_t count;  /*!< Number of samples */
+    uint64_t sum_us; /*!< Sum of all samples (us) */
+    uint32_t max_us; /*!< Maximum sample (us) */
+} nmea_hop_acc_t;
+
+#if CONFIG_NMEA_PARSER_PIPELINE
+/**
+ * @brief Line buffer handed from ingestion task to decode task
+ *
+ */
+typedef struct {
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    int64_t rx_us;                                 /*!< Timestamp of line reception */
+#endif
+    uint16_t len;                                  /*!< Number of bytes in data */
+    uint8_t data[NMEA_PARSER_PIPELINE_SLOT_SIZE];  /*!< Line data, NUL terminated */
+} nmea_line_slot_t;
+
+/**
+ * @brief Lock-free single producer (ingestion) single consumer (decode) ring of lines
  *
  */
 typedef struct {
-    uint8_t item_pos;                              /*!< Current position in item */
-    uint8_t item_num;                              /*!< Current item number */
-    uint8_t asterisk;                              /*!< Asterisk detected flag */
-    uint8_t crc;                                   /*!< Calculated CRC value */
-    uint8_t parsed_statement;                      /*!< OR'd of statements that have been parsed */
-    uint8_t sat_num;                               /*!< Satellite number */
-    uint8_t sat_count;                             /*!< Satellite count */
-    uint8_t cur_statement;                         /*!< Current statement ID */
-    uint32_t all_statements;                       /*!< All statements mask */
-    char item_str[NMEA_MAX_STATEMENT_ITEM_LENGTH]; /*!< Current item */
-    gps_t parent;                                  /*!< Parent class */
+    nmea_line_slot_t *slots;                       /*!< NMEA_PARSER_PIPELINE_SLOTS line buffers */
+    uint32_t head;                                 /*!< Next slot to fill, written by ingestion task only */
+    uint32_t tail;                                 /*!< Next slot to decode, written by decode task only */
+} nmea_line_ring_t;
+#endif
+
+#if CONFIG_NMEA_PARSER_FIX_HISTORY
+/**
+ * @brief Fix history entry
+ *
+ */
+typedef struct {
+    int64_t utc_ms;     /*!< Time of fix (ms since 2000-01-01 UTC) */
+    gps_fix_core_t fix; /*!< Fix */
+} nmea_history_entry_t;
+
+/**
+ * @brief Time ordered ring of past fixes, single writer (parser task) many readers
+ *
+ * Readers never block the writer: they retry if the sequence number changed (or was odd) while they read.
+ */
+typedef struct {
+    nmea_history_entry_t entry[NMEA_PARSER_FIX_HISTORY_SIZE]; /*!< Fixes, oldest overwritten first */
+    uint32_t count;                                           /*!< Number of fixes written since reset */
+    uint32_t seq;                                             /*!< Sequence number, odd while the writer updates */
+} nmea_fix_history_t;
+#endif
+
+/**
+ * @brief GPS parser library runtime structure
+ *
+ */
+typedef struct esp_gps {
+    nmea_decoder_t decoder;                        /*!< NMEA decoder */
     uart_port_t uart_port;                         /*!< Uart port number */
+    uint32_t event_queue_size;                     /*!< UART event queue size */
+    uint32_t ring_size;                            /*!< Size of UART Rx ring buffer */
+    uint32_t ring_high_water;                      /*!< Maximum bytes observed in UART Rx ring buffer */
+    uint32_t overflow;                             /*!< UART FIFO overflow / ring buffer full events */
+    uint32_t pattern_lost;                         /*!< Line end positions dropped by UART driver */
     uint8_t *buffer;                               /*!< Runtime buffer */
     esp_event_loop_handle_t event_loop_hdl;        /*!< Event loop handle */
     TaskHandle_t tsk_hdl;                          /*!< NMEA Parser task handle */
+#if CONFIG_NMEA_PARSER_PIPELINE
+    TaskHandle_t ingest_tsk_hdl;                   /*!< NMEA Parser ingestion task handle */
+    nmea_line_ring_t line_ring;                    /*!< Lines from ingestion task to decode task */
+    uint32_t pipeline_stall;                       /*!< Times ingestion task waited for a free line slot */
+#endif
     QueueHandle_t event_queue;                     /*!< UART event queue handle */
+    portMUX_TYPE lock;                             /*!< Lock of handler and statement parser slots */
+    nmea_event_handler_t handler[NMEA_PARSER_HANDLER_NUM]; /*!< Event handlers, called from the event loop */
+    int8_t handler_running;                        /*!< Slot of the event handler being called, -1 if none */
+    uint8_t event_pending[NMEA_EVENT_NUM];         /*!< Events queued in the event loop, per event id */
+    uint8_t event_stale[NMEA_EVENT_NUM];           /*!< Queued events superseded by a newer one, per event id */
+    uint8_t event_evict;                           /*!< Next event delivered by the event loop is evicted */
+    uint32_t event_blocked;                        /*!< Posts which waited for the consumer */
+    uint32_t event_dropped;                        /*!< Events dropped as the event loop queue was full */
+    uint32_t event_evicted;                        /*!< Queued events evicted to make room for a newer one */
+    uint32_t event_coalesced;                      /*!< Queued events superseded by a newer one */
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
+    uint32_t handler_budget_us;                    /*!< Execution time budget of each event handler */
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILE_LOG_PERIOD
+    int64_t profile_log_us;                        /*!< Timestamp of last handler profile log */
+#endif
+#endif
+#if NMEA_PARSER_DIRECT_HANDLER_NUM
+    nmea_direct_handler_t direct[NMEA_PARSER_DIRECT_HANDLER_NUM]; /*!< Direct handlers */
+#endif
+#if CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+    nmea_forward_t forward;                        /*!< Raw sentence forwarding */
+#endif
+#if CONFIG_NMEA_PARSER_FIX_HISTORY
+    nmea_fix_history_t history;                    /*!< History of past fixes */
+#endif
+#if CONFIG_NMEA_PARSER_PREDICTOR
+    nmea_predictor_t predictor;                    /*!< Latency compensation and upsampling */
+    int64_t predictor_epoch_us;                    /*!< Local time of the first statement of the epoch being decoded */
+#if CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ
+    int64_t predictor_next_us;                     /*!< Local time of the next upsampled output */
+#endif
+#endif
+#if CONFIG_NMEA_PARSER_TRACK_SIMPLIFY
+    nmea_track_t track;                            /*!< Track simplification */
+#endif
+#if CONFIG_NMEA_PARSER_GEOFENCE
+    nmea_geofence_handle_t geofence;               /*!< Geofences evaluated on each fix, NULL if none */
+    const gps_fix_core_t *geofence_fix;            /*!< Fix being evaluated */
+#endif
+#if CONFIG_NMEA_PARSER_FIX_LOG
+    nmea_fix_log_handle_t fix_log;                 /*!< Log valid fixes are appended to, NULL if none */
+#endif
+#if CONFIG_NMEA_PARSER_RATE_CONTROL
+    nmea_rate_t rate;                              /*!< Adaptive fix rate */
+#endif
+#if CONFIG_NMEA_PARSER_FUSION
+    nmea_decoder_t fusion_decoder;                 /*!< NMEA decoder of the secondary receiver */
+    uart_port_t fusion_port;                       /*!< UART port of the secondary receiver */
+    QueueHandle_t fusion_queue;                    /*!< UART event queue of the secondary receiver */
+    QueueSetHandle_t queue_set;                    /*!< UART event queues of both receivers */
+    nmea_fusion_t fusion;                          /*!< Fusion of both receivers */
+    int64_t fusion_epoch_us[NMEA_FUSION_RX_NUM];   /*!< Local time of the first statement of the epoch being decoded,
+                                                        of each receiver */
+#endif
+#if CONFIG_NMEA_PARSER_FILTER
+    nmea_filter_t filter;                          /*!< Position filter */
+#if CONFIG_NMEA_PARSER_POST_GPS_UPDATE
+    gps_t filtered;                                /*!< Epoch with the filtered position, for GPS_UPDATE */
+#endif
+#endif
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    int64_t decode_line_us;                        /*!< Reception timestamp of the line being decoded, decode task only */
+    int64_t post_us;                               /*!< Timestamp of last event post, 0 if none pending */
+    nmea_hop_acc_t hop_decode;                     /*!< Line received -> epoch decoded */
+    nmea_hop_acc_t hop_direct;                     /*!< Epoch decoded -> direct handlers returned */
+    nmea_hop_acc_t hop_event;                      /*!< Epoch decoded -> event loop dispatched */
+#endif
 } esp_gps_t;
 
+#if CONFIG_NMEA_PARSER_PIPELINE
+#define NMEA_PARSER_BUFFER_FOOTPRINT (NMEA_PARSER_PIPELINE_SLOTS * sizeof(nmea_line_slot_t))
+#else
+#define NMEA_PARSER_BUFFER_FOOTPRINT (NMEA_PARSER_RUNTIME_BUFFER_SIZE)
+#endif
+
+#if CONFIG_NMEA_PARSER_STATIC_ALLOCATION
 /**
- * @brief parse latitude or longitude
- *              format of latitude in NMEA is ddmm.sss and longitude is dddmm.sss
- * @param esp_gps esp_gps_t type object
- * @return int32_t Latitude or Longitude value (unit: degree without dot)
+ * @brief Statically allocated NMEA Parser instance
+ *
  */
-static int32_t parse_lat_long(esp_gps_t *esp_gps)
-{
-    int32_t ll = 0;
-    int32_t deg = (strtof(esp_gps->item_str, NULL)) / 100;
-    int32_t min = (strtof(esp_gps->item_str, NULL)) - (deg * 100);
-    int32_t under_point = 0;
-    min = min * 10000000;
-
-    char raw[NMEA_MAX_STATEMENT_ITEM_LENGTH] = {0, };
-    strncpy(raw, esp_gps->item_str, NMEA_MAX_STATEMENT_ITEM_LENGTH);
+static struct {
+    esp_gps_t gps;                                               /*!< Parser runtime structure */
+    StaticTask_t tsk_tcb;                                        /*!< NMEA Parser task control block */
+    StackType_t tsk_stack[NMEA_PARSER_TASK_STACK_SIZE];          /*!< NMEA Parser task stack */
+#if CONFIG_NMEA_PARSER_PIPELINE
+    StaticTask_t ingest_tsk_tcb;                                 /*!< Ingestion task control block */
+    StackType_t ingest_tsk_stack[NMEA_PARSER_INGEST_TASK_STACK_SIZE]; /*!< Ingestion task stack */
+    nmea_line_slot_t line_slots[NMEA_PARSER_PIPELINE_SLOTS];     /*!< Line ring slots */
+#else
+    uint8_t buffer[NMEA_PARSER_RUNTIME_BUFFER_SIZE];             /*!< Runtime buffer */
+#endif
+    bool used;                                                   /*!< Instance handed out by nmea_parser_init() */
+} s_nmea_parser;
+#endif
 
-    char under_point_str[NMEA_MAX_STATEMENT_ITEM_LENGTH] = {0, };
 
-    for (int i = 0; raw[i] != '\0'; i++)
-    {
-        if (raw[i] == '.')
-        {
-            strcpy(under_point_str, &(raw[i + 1]));
-            break;
-        }
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+/**
+ * @brief Add one latency sample to hop accumulator
+ *
+ * @param acc hop accumulator
+ * @param start_us start timestamp of the hop
+ * @param end_us end timestamp of the hop
+ */
+static inline void nmea_hop_add(nmea_hop_acc_t *acc, int64_t start_us, int64_t end_us)
+{
+    uint32_t delta = (uint32_t)(end_us - start_us);
+    acc->count++;
+    acc->sum_us += delta;
+    if (delta > acc->max_us) {
+        acc->max_us = delta;
     }
-
-    under_point = atoi(under_point_str);
-    under_point = under_point * 10;
-    min += under_point;
-    ll = (deg * 10000000) + (min / 60);
-
-    return ll;
 }
+#endif
+
+/**
+ * @brief First event posted for each epoch, latency is measured on it
+ *
+ */
+#if CONFIG_NMEA_PARSER_POST_FIX_CORE
+#define NMEA_EPOCH_EVENT GPS_FIX
+#else
+#define NMEA_EPOCH_EVENT GPS_UPDATE
+#endif
 
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
 /**
- * @brief Converter two continuous numeric character into a uint8_t number
+ * @brief Account one execution of an event handler
  *
- * @param digit_char numeric character
- * @return uint8_t result of converting
+ * @param acc accumulator of the handler
+ * @param delta_us execution time (us)
+ * @param budget_us execution time budget (us)
  */
-static inline uint8_t convert_two_digit2number(const char *digit_char)
+static void nmea_handler_acc_add(nmea_handler_acc_t *acc, uint32_t delta_us, uint32_t budget_us)
 {
-    return 10 * (digit_char[0] - '0') + (digit_char[1] - '0');
+    if (!acc->count || delta_us < acc->min_us) {
+        acc->min_us = delta_us;
+    }
+    if (delta_us > acc->max_us) {
+        acc->max_us = delta_us;
+    }
+    if (delta_us > budget_us) {
+        acc->overrun++;
+    }
+    acc->count++;
+    acc->sum_us += delta_us;
+    int bucket = delta_us ? 32 - __builtin_clz(delta_us) : 0;
+    acc->hist[MIN(bucket, NMEA_HANDLER_HIST_BUCKETS - 1)]++;
 }
 
 /**
- * @brief Parse UTC time in GPS statements
+ * @brief Summarize the execution times of an event handler
  *
- * @param esp_gps esp_gps_t type object
+ * @param acc accumulator of the handler
+ * @param profile summary, p99 is the upper bound of the histogram bucket holding the 99th percentile
  */
-static void parse_utc_time(esp_gps_t *esp_gps)
-{
-    esp_gps->parent.tim.hour = convert_two_digit2number(esp_gps->item_str + 0);
-    esp_gps->parent.tim.minute = convert_two_digit2number(esp_gps->item_str + 2);
-    esp_gps->parent.tim.second = convert_two_digit2number(esp_gps->item_str + 4);
-    if (esp_gps->item_str[6] == '.') {
-        uint16_t tmp = 0;
-        uint8_t i = 7;
-        while (esp_gps->item_str[i]) {
-            tmp = 10 * tmp + esp_gps->item_str[i] - '0';
-            i++;
+static void nmea_handler_acc_get(const nmea_handler_acc_t *acc, nmea_parser_handler_profile_t *profile)
+{
+    profile->count = acc->count;
+    profile->min_us = acc->min_us;
+    profile->avg_us = acc->count ? (uint32_t)(acc->sum_us / acc->count) : 0;
+    profile->max_us = acc->max_us;
+    profile->overrun = acc->overrun;
+    profile->p99_us = 0;
+    uint32_t rank = acc->count - acc->count / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < NMEA_HANDLER_HIST_BUCKETS && acc->count; i++) {
+        seen += acc->hist[i];
+        if (seen >= rank) {
+            profile->p99_us = MIN((1UL << i) - 1, acc->max_us);
+            break;
         }
-        esp_gps->parent.tim.thousand = tmp;
     }
 }
 
-//TODO ENABLE NMEA TYPES MANUALLY
-#if CONFIG_NMEA_STATEMENT_GGA
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILE_LOG_PERIOD
 /**
- * @brief Parse GGA statements
+ * @brief Log execution time of all event handlers periodically
  *
  * @param esp_gps esp_gps_t type object
  */
-static void parse_gga(esp_gps_t *esp_gps)
-{
-    /* Process GGA statement */
-    switch (esp_gps->item_num) {
-    case 1: /* Process UTC time */
-        parse_utc_time(esp_gps);
-        break;
-    case 2: /* Latitude */
-        esp_gps->parent.latitude = parse_lat_long(esp_gps);
-        break;
-    case 3: /* Latitude north(1)/south(-1) information */
-        if (esp_gps->item_str[0] == 'S' || esp_gps->item_str[0] == 's') {
-            esp_gps->parent.latitude *= -1;
-        }
-        break;
-    case 4: /* Longitude */
-        esp_gps->parent.longitude = parse_lat_long(esp_gps);
-        break;
-    case 5: /* Longitude east(1)/west(-1) information */
-        if (esp_gps->item_str[0] == 'W' || esp_gps->item_str[0] == 'w') {
-            esp_gps->parent.longitude *= -1;
+static void nmea_handler_profile_log(esp_gps_t *esp_gps)
+{
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - esp_gps->profile_log_us < CONFIG_NMEA_PARSER_HANDLER_PROFILE_LOG_PERIOD * 1000000LL) {
+        return;
+    }
+    esp_gps->profile_log_us = now_us;
+    for (int i = 0; i < NMEA_PARSER_HANDLER_NUM; i++) {
+        if (!esp_gps->handler[i].handler) {
+            continue;
         }
-        break;
-    case 6: /* Fix status */
-        esp_gps->parent.fix = (gps_fix_t)strtol(esp_gps->item_str, NULL, 10);
-        break;
-    case 7: /* Satellites in use */
-        esp_gps->parent.sats_in_use = (uint8_t)strtol(esp_gps->item_str, NULL, 10);
-        break;
-    case 8: /* HDOP */
-        esp_gps->parent.dop_h = strtof(esp_gps->item_str, NULL);
-        break;
-    case 9: /* Altitude */
-        esp_gps->parent.altitude = strtof(esp_gps->item_str, NULL);
-        break;
-    case 11: /* Altitude above ellipsoid */
-        esp_gps->parent.altitude += strtof(esp_gps->item_str, NULL);
-        break;
-    default:
-        break;
+        nmea_parser_handler_profile_t profile;
+        nmea_handler_acc_get(&esp_gps->handler[i].acc, &profile);
+        ESP_LOGI(GPS_TAG, "handler %p: %u calls, min/avg/p99/max %u/%u/%u/%u us, %u over %u us budget",
+                 esp_gps->handler[i].handler, (unsigned)profile.count, (unsigned)profile.min_us,
+                 (unsigned)profile.avg_us, (unsigned)profile.p99_us, (unsigned)profile.max_us,
+                 (unsigned)profile.overrun, (unsigned)esp_gps->handler_budget_us);
     }
 }
 #endif
+#endif
 
-#if CONFIG_NMEA_STATEMENT_GSA
 /**
- * @brief Parse GSA statements
+ * @brief Event loop handler, delivers events to user event handlers
  *
- * @param esp_gps esp_gps_t type object
+ * Events evicted or superseded while queued are discarded here.
+ *
+ * @param arg esp_gps_t type object
+ * @param event_base event base, fixed to ESP_NMEA_EVENT
+ * @param event_id event id
+ * @param event_data event data
  */
-static void parse_gsa(esp_gps_t *esp_gps)
-{
-    /* Process GSA statement */
-    switch (esp_gps->item_num) {
-    case 2: /* Process fix mode */
-        esp_gps->parent.fix_mode = (gps_fix_mode_t)strtol(esp_gps->item_str, NULL, 10);
-        break;
-    case 15: /* Process PDOP */
-        esp_gps->parent.dop_p = strtof(esp_gps->item_str, NULL);
-        break;
-    case 16: /* Process HDOP */
-        esp_gps->parent.dop_h = strtof(esp_gps->item_str, NULL);
-        break;
-    case 17: /* Process VDOP */
-        esp_gps->parent.dop_v = strtof(esp_gps->item_str, NULL);
-        break;
-    default:
-        /* Parse satellite IDs */
-        if (esp_gps->item_num >= 3 && esp_gps->item_num <= 14) {
-            esp_gps->parent.sats_id_in_use[esp_gps->item_num - 3] = (uint8_t)strtol(esp_gps->item_str, NULL, 10);
+static void esp_gps_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)arg;
+    esp_gps->event_pending[event_id]--;
+    if (esp_gps->event_stale[event_id]) {
+        esp_gps->event_stale[event_id]--;
+        return;
+    }
+    if (esp_gps->event_evict) {
+        esp_gps->event_evict = 0;
+        esp_gps->event_evicted++;
+        return;
+    }
+    for (int i = 0; i < NMEA_PARSER_HANDLER_NUM; i++) {
+        if (!esp_gps->handler[i].handler) {
+            continue;
+        }
+        /* Take the slot and mark it running in one go, nmea_parser_remove_handler() waits for the call */
+        portENTER_CRITICAL(&esp_gps->lock);
+        esp_event_handler_t handler = esp_gps->handler[i].handler;
+        void *handler_args = esp_gps->handler[i].handler_args;
+        esp_gps->handler_running = handler ? i : -1;
+        portEXIT_CRITICAL(&esp_gps->lock);
+        if (!handler) {
+            continue;
         }
-        break;
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
+        int64_t start_us = esp_timer_get_time();
+        handler(handler_args, event_base, event_id, event_data);
+        nmea_handler_acc_add(&esp_gps->handler[i].acc, (uint32_t)(esp_timer_get_time() - start_us),
+                             esp_gps->handler_budget_us);
+#else
+        handler(handler_args, event_base, event_id, event_data);
+#endif
+        portENTER_CRITICAL(&esp_gps->lock);
+        esp_gps->handler_running = -1;
+        portEXIT_CRITICAL(&esp_gps->lock);
     }
 }
-#endif
 
-#if CONFIG_NMEA_STATEMENT_GSV
 /**
- * @brief Parse GSV statements
+ * @brief Post event to the event loop, applying the backpressure policy when its queue is full
+ *
+ * The event loop is run by the NMEA Parser task itself, so waiting on a full queue never frees a slot:
+ * room is made by delivering (block) or discarding (drop oldest, coalesce) the oldest queued event.
  *
  * @param esp_gps esp_gps_t type object
+ * @param event_id event id
+ * @param event_data event data
+ * @param event_data_size size of event data
  */
-static void parse_gsv(esp_gps_t *esp_gps)
-{
-    /* Process GSV statement */
-    switch (esp_gps->item_num) {
-    case 1: /* total GSV numbers */
-        esp_gps->sat_count = (uint8_t)strtol(esp_gps->item_str, NULL, 10);
-        break;
-    case 2: /* Current GSV statement number */
-        esp_gps->sat_num = (uint8_t)strtol(esp_gps->item_str, NULL, 10);
-        break;
-    case 3: /* Process satellites in view */
-        esp_gps->parent.sats_in_view = (uint8_t)strtol(esp_gps->item_str, NULL, 10);
-        break;
-    default:
-        if (esp_gps->item_num >= 4 && esp_gps->item_num <= 19) {
-            uint8_t item_num = esp_gps->item_num - 4; /* Normalize item number from 4-19 to 0-15 */
-            uint8_t index;
-            uint32_t value;
-            index = 4 * (esp_gps->sat_num - 1) + item_num / 4; /* Get array index */
-            if (index < GPS_MAX_SATELLITES_IN_VIEW) {
-                value = strtol(esp_gps->item_str, NULL, 10);
-                switch (item_num % 4) {
-                case 0:
-                    esp_gps->parent.sats_desc_in_view[index].num = (uint8_t)value;
-                    break;
-                case 1:
-                    esp_gps->parent.sats_desc_in_view[index].elevation = (uint8_t)value;
-                    break;
-                case 2:
-                    esp_gps->parent.sats_desc_in_view[index].azimuth = (uint16_t)value;
-                    break;
-                case 3:
-                    esp_gps->parent.sats_desc_in_view[index].snr = (uint8_t)value;
-                    break;
-                default:
-                    break;
-                }
-            }
+static void gps_post(esp_gps_t *esp_gps, nmea_event_id_t event_id, void *event_data, size_t event_data_size)
+{
+#if CONFIG_NMEA_PARSER_BACKPRESSURE_COALESCE
+    /* Only the latest state event of each id is delivered. Discrete events (unknown statements, track points,
+     * geofence crossings) are all delivered: several of the same id may be posted for one fix */
+    bool state = event_id == GPS_FIX || event_id == GPS_UPDATE || event_id == GPS_FIX_PREDICTED;
+    if (state && esp_gps->event_pending[event_id] > esp_gps->event_stale[event_id]) {
+        esp_gps->event_stale[event_id]++;
+        esp_gps->event_coalesced++;
+    }
+#endif
+    if (esp_event_post_to(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, event_id,
+                          event_data, event_data_size, 0) != ESP_OK) {
+#if CONFIG_NMEA_PARSER_BACKPRESSURE_DROP_NEWEST
+        esp_gps->event_dropped++;
+        return;
+#else
+#if CONFIG_NMEA_PARSER_BACKPRESSURE_BLOCK
+        /* Wait for the consumer to handle the oldest event */
+        esp_gps->event_blocked++;
+#else
+        esp_gps->event_evict = 1;
+#endif
+        esp_event_loop_run(esp_gps->event_loop_hdl, 0);
+        esp_gps->event_evict = 0;
+        if (esp_event_post_to(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, event_id,
+                              event_data, event_data_size, 0) != ESP_OK) {
+            esp_gps->event_dropped++;
+            return;
         }
-        break;
+#endif
     }
+    esp_gps->event_pending[event_id]++;
 }
-#endif
 
-#if CONFIG_NMEA_STATEMENT_RMC
 /**
- * @brief Parse RMC statements
+ * @brief Deliver event to direct handlers and to the event loop
  *
  * @param esp_gps esp_gps_t type object
+ * @param event_id event id
+ * @param event_data event data
+ * @param event_data_size size of event data
  */
-static void parse_rmc(esp_gps_t *esp_gps)
-{
-    /* Process GPRMC statement */
-    switch (esp_gps->item_num) {
-    case 1:/* Process UTC time */
-        parse_utc_time(esp_gps);
-        break;
-    case 2: /* Process valid status */
-        esp_gps->parent.valid = (esp_gps->item_str[0] == 'A');
-        break;
-    case 3:/* Latitude */
-        esp_gps->parent.latitude = parse_lat_long(esp_gps);
-        break;
-    case 4: /* Latitude north(1)/south(-1) information */
-        if (esp_gps->item_str[0] == 'S' || esp_gps->item_str[0] == 's') {
-            esp_gps->parent.latitude *= -1;
-        }
-        break;
-    case 5: /* Longitude */
-        esp_gps->parent.longitude = parse_lat_long(esp_gps);
-        break;
-    case 6: /* Longitude east(1)/west(-1) information */
-        if (esp_gps->item_str[0] == 'W' || esp_gps->item_str[0] == 'w') {
-            esp_gps->parent.longitude *= -1;
+static void gps_dispatch(esp_gps_t *esp_gps, nmea_event_id_t event_id, void *event_data, size_t event_data_size)
+{
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    int64_t epoch_us = esp_timer_get_time();
+    if (event_id == NMEA_EPOCH_EVENT) {
+        nmea_hop_add(&esp_gps->hop_decode, esp_gps->decode_line_us, epoch_us);
+    }
+#endif
+#if NMEA_PARSER_DIRECT_HANDLER_NUM
+    /* Direct handlers see the payload in place, no copy and no queueing */
+    for (int i = 0; i < NMEA_PARSER_DIRECT_HANDLER_NUM; i++) {
+        nmea_parser_direct_handler_t handler = esp_gps->direct[i].handler;
+        if (handler) {
+            handler(esp_gps->direct[i].handler_args, event_id, event_data, event_data_size);
         }
-        break;
-    case 7: /* Process ground speed in unit m/s */
-        esp_gps->parent.speed = strtof(esp_gps->item_str, NULL) * 1.852;
-        break;
-    case 8: /* Process true course over ground */
-        esp_gps->parent.cog = strtof(esp_gps->item_str, NULL);
-        break;
-    case 9: /* Process date */
-        esp_gps->parent.date.day = convert_two_digit2number(esp_gps->item_str + 0);
-        esp_gps->parent.date.month = convert_two_digit2number(esp_gps->item_str + 2);
-        esp_gps->parent.date.year = convert_two_digit2number(esp_gps->item_str + 4);
-        break;
-    case 10: /* Process magnetic variation */
-        esp_gps->parent.variation = strtof(esp_gps->item_str, NULL);
-        break;
-    default:
-        break;
     }
-}
 #endif
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    if (event_id == NMEA_EPOCH_EVENT) {
+        nmea_hop_add(&esp_gps->hop_direct, epoch_us, esp_timer_get_time());
+    }
+#endif
+    gps_post(esp_gps, event_id, event_data, event_data_size);
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    if (event_id == NMEA_EPOCH_EVENT) {
+        esp_gps->post_us = epoch_us;
+    }
+#endif
+}
 
-#if CONFIG_NMEA_STATEMENT_GLL
+#if CONFIG_NMEA_PARSER_PREDICTOR
 /**
- * @brief Parse GLL statements
+ * @brief Publish the last fix extrapolated to now
  *
  * @param esp_gps esp_gps_t type object
+ * @param now_us local time (esp_timer)
+ * @return true if published, false if there is no recent valid fix
  */
-static void parse_gll(esp_gps_t *esp_gps)
+static bool esp_gps_predictor_publish(esp_gps_t *esp_gps, int64_t now_us)
 {
-    /* Process GPGLL statement */
-    switch (esp_gps->item_num) {
-    case 1:/* Latitude */
-        esp_gps->parent.latitude = parse_lat_long(esp_gps);
-        break;
-    case 2: /* Latitude north(1)/south(-1) information */
-        if (esp_gps->item_str[0] == 'S' || esp_gps->item_str[0] == 's') {
-            esp_gps->parent.latitude *= -1;
-        }
-        break;
-    case 3: /* Longitude */
-        esp_gps->parent.longitude = parse_lat_long(esp_gps);
-        break;
-    case 4: /* Longitude east(1)/west(-1) information */
-        if (esp_gps->item_str[0] == 'W' || esp_gps->item_str[0] == 'w') {
-            esp_gps->parent.longitude *= -1;
-        }
-        break;
-    case 5:/* Process UTC time */
-        parse_utc_time(esp_gps);
-        break;
-    case 6: /* Process valid status */
-        esp_gps->parent.valid = (esp_gps->item_str[0] == 'A');
-        break;
-    default:
-        break;
+    gps_fix_core_t predicted;
+    if (!nmea_predictor_predict(&esp_gps->predictor, now_us, &predicted)) {
+        return false;
     }
+    gps_dispatch(esp_gps, GPS_FIX_PREDICTED, &predicted, sizeof(predicted));
+    return true;
 }
-#endif
 
-#if CONFIG_NMEA_STATEMENT_VTG
 /**
- * @brief Parse VTG statements
+ * @brief Feed a new fix to the predictor and publish it extrapolated to now
+ *
+ * The fix is considered valid at the first statement of its epoch minus the receiver latency.
  *
  * @param esp_gps esp_gps_t type object
+ * @param fix new fix
  */
-static void parse_vtg(esp_gps_t *esp_gps)
+static void esp_gps_predictor_update(esp_gps_t *esp_gps, const gps_fix_core_t *fix)
 {
-    /* Process GPVGT statement */
-    switch (esp_gps->item_num) {
-    case 1: /* Process true course over ground */
-        esp_gps->parent.cog = strtof(esp_gps->item_str, NULL);
-        break;
-    case 3:/* Process magnetic variation */
-        esp_gps->parent.variation = strtof(esp_gps->item_str, NULL);
-        break;
-    case 5:/* Process ground speed in unit m/s */
-        esp_gps->parent.speed = strtof(esp_gps->item_str, NULL) * 1.852;//knots to m/s
-        break;
-    case 7:/* Process ground speed in unit m/s */
-        esp_gps->parent.speed = strtof(esp_gps->item_str, NULL) / 3.6;//km/h to m/s
-        break;
-    default:
-        break;
+    int64_t fix_us = esp_gps->predictor_epoch_us - CONFIG_NMEA_PARSER_PREDICTOR_LATENCY_MS * 1000;
+    if (!nmea_predictor_update(&esp_gps->predictor, fix, fix_us)) {
+        return;
     }
-}
+    int64_t now_us = esp_timer_get_time();
+    esp_gps_predictor_publish(esp_gps, now_us);
+#if CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ
+    esp_gps->predictor_next_us = now_us + 1000000 / CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ;
 #endif
+}
 
+#if CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ
 /**
- * @brief Parse received item
+ * @brief Publish upsampled fixes between two receiver fixes
+ *
+ * Called from the parser task loop, whose wait is bounded by NMEA_PARSER_TASK_WAIT_TICKS. Stops
+ * NMEA_PREDICTOR_HORIZON_US after the last fix, when the receiver went silent.
  *
  * @param esp_gps esp_gps_t type object
- * @return esp_err_t ESP_OK on success, ESP_FAIL on error
  */
-static esp_err_t parse_item(esp_gps_t *esp_gps)
+static void esp_gps_predictor_tick(esp_gps_t *esp_gps)
 {
-    esp_err_t err = ESP_OK;
-    /* start of a statement */
-    if (esp_gps->item_num == 0 && esp_gps->item_str[0] == '$') {
-        if (0) {
-        }
-#if CONFIG_NMEA_STATEMENT_GGA
-        else if (strstr(esp_gps->item_str, "GGA")) {
-            esp_gps->cur_statement = STATEMENT_GGA;
-        }
-#endif
-#if CONFIG_NMEA_STATEMENT_GSA
-        else if (strstr(esp_gps->item_str, "GSA")) {
-            esp_gps->cur_statement = STATEMENT_GSA;
-        }
-#endif
-#if CONFIG_NMEA_STATEMENT_RMC
-        else if (strstr(esp_gps->item_str, "RMC")) {
-            esp_gps->cur_statement = STATEMENT_RMC;
-        }
-#endif
-#if CONFIG_NMEA_STATEMENT_GSV
-        else if (strstr(esp_gps->item_str, "GSV")) {
-            esp_gps->cur_statement = STATEMENT_GSV;
-        }
-#endif
-#if CONFIG_NMEA_STATEMENT_GLL
-        else if (strstr(esp_gps->item_str, "GLL")) {
-            esp_gps->cur_statement = STATEMENT_GLL;
-        }
-#endif
-#if CONFIG_NMEA_STATEMENT_VTG
-        else if (strstr(esp_gps->item_str, "VTG")) {
-            esp_gps->cur_statement = STATEMENT_VTG;
-        }
-#endif
-        else {
-            esp_gps->cur_statement = STATEMENT_UNKNOWN;
-        }
-        goto out;
+    int64_t now_us = esp_timer_get_time();
+    if (now_us < esp_gps->predictor_next_us || !esp_gps_predictor_publish(esp_gps, now_us)) {
+        return;
     }
-    /* Parse each item, depend on the type of the statement */
-    if (esp_gps->cur_statement == STATEMENT_UNKNOWN) {
-        goto out;
-    }
-#if CONFIG_NMEA_STATEMENT_GGA
-    else if (esp_gps->cur_statement == STATEMENT_GGA) {
-        parse_gga(esp_gps);
+    esp_gps->predictor_next_us += 1000000 / CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ;
+    if (esp_gps->predictor_next_us < now_us) {
+        esp_gps->predictor_next_us = now_us + 1000000 / CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ;
     }
+}
 #endif
-#if CONFIG_NMEA_STATEMENT_GSA
-    else if (esp_gps->cur_statement == STATEMENT_GSA) {
-        parse_gsa(esp_gps);
-    }
 #endif
-#if CONFIG_NMEA_STATEMENT_GSV
-    else if (esp_gps->cur_statement == STATEMENT_GSV) {
-        parse_gsv(esp_gps);
-    }
+
+#if CONFIG_NMEA_PARSER_TRACK_SIMPLIFY
+/**
+ * @brief Post a point of the simplified track
+ *
+ * @param ctx esp_gps_t type object
+ * @param point track point
+ */
+static void esp_gps_track_publish(void *ctx, const gps_fix_core_t *point)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)ctx;
+    gps_fix_core_t data = *point;
+    gps_dispatch(esp_gps, GPS_TRACK_POINT, &data, sizeof(data));
+}
 #endif
-#if CONFIG_NMEA_STATEMENT_RMC
-    else if (esp_gps->cur_statement == STATEMENT_RMC) {
-        parse_rmc(esp_gps);
-    }
+
+#if CONFIG_NMEA_PARSER_GEOFENCE
+/**
+ * @brief Post a geofence entered or exited, called back by nmea_geofence_update()
+ *
+ * @param fence_id identifier of the fence
+ * @param inside true if the fence was entered
+ * @param arg esp_gps_t type object
+ */
+static void nmea_geofence_post(uint32_t fence_id, bool inside, void *arg)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)arg;
+    nmea_geofence_event_t event = {
+        .fence_id = fence_id,
+        .fix = *esp_gps->geofence_fix,
+    };
+    gps_dispatch(esp_gps, inside ? GPS_GEOFENCE_ENTER : GPS_GEOFENCE_EXIT, &event, sizeof(event));
+}
 #endif
-#if CONFIG_NMEA_STATEMENT_GLL
-    else if (esp_gps->cur_statement == STATEMENT_GLL) {
-        parse_gll(esp_gps);
+
+#if CONFIG_NMEA_PARSER_RATE_CONTROL
+/**
+ * @brief Feed a fix to the fix rate controller, and command the new fix period to the receiver
+ *
+ * @param esp_gps esp_gps_t type object
+ * @param fix new fix
+ */
+static void esp_gps_rate_update(esp_gps_t *esp_gps, const gps_fix_core_t *fix)
+{
+    uint16_t period_ms = nmea_rate_update(&esp_gps->rate, fix);
+    if (!period_ms) {
+        return;
     }
+    uint8_t cmd[NMEA_RATE_COMMAND_MAX_SIZE];
+    size_t len = nmea_rate_command(NMEA_RATE_PROTOCOL, period_ms, cmd, sizeof(cmd));
+    /* The UART driver has no Tx ring buffer, a command this short only waits for the Tx FIFO */
+    uart_write_bytes(esp_gps->uart_port, (const char *)cmd, len);
+#if CONFIG_NMEA_PARSER_FUSION
+    /* Keep the epochs of both receivers on the same UTC times */
+    uart_write_bytes(esp_gps->fusion_port, (const char *)cmd, len);
 #endif
-#if CONFIG_NMEA_STATEMENT_VTG
-    else if (esp_gps->cur_statement == STATEMENT_VTG) {
-        parse_vtg(esp_gps);
-    }
+    ESP_LOGD(GPS_TAG, "fix period %u ms", (unsigned)period_ms);
+}
 #endif
-    else {
-        err =  ESP_FAIL;
+
+#if CONFIG_NMEA_PARSER_FIX_HISTORY
+/**
+ * @brief Append a fix to the history
+ *
+ * Only valid fixes are recorded. If time goes backwards (receiver reset), the history is cleared.
+ *
+ * @param history fix history
+ * @param fix compact fix
+ */
+static void nmea_fix_history_push(nmea_fix_history_t *history, const gps_fix_core_t *fix)
+{
+    int64_t utc_ms = nmea_parser_fix_utc_ms(fix);
+    if (!fix->valid || utc_ms < 0) {
+        return;
     }
-out:
-    return err;
+    uint32_t count = history->count;
+    uint32_t seq = history->seq;
+    __atomic_store_n(&history->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (count && utc_ms <= history->entry[(count - 1) % NMEA_PARSER_FIX_HISTORY_SIZE].utc_ms) {
+        count = 0;
+    }
+    nmea_history_entry_t *entry = &history->entry[count % NMEA_PARSER_FIX_HISTORY_SIZE];
+    entry->utc_ms = utc_ms;
+    entry->fix = *fix;
+    history->count = count + 1;
+    __atomic_store_n(&history->seq, seq + 2, __ATOMIC_RELEASE);
 }
 
 /**
- * @brief Parse NMEA statements from GPS receiver
+ * @brief Start a read of the history
  *
- * @param esp_gps esp_gps_t type object
- * @param len number of bytes to decode
- * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+ * @param history fix history
+ * @return uint32_t sequence number to pass to nmea_fix_history_read_retry()
  */
-static esp_err_t gps_decode(esp_gps_t *esp_gps, size_t len)
-{
-    const uint8_t *d = esp_gps->buffer;
-    while (*d) {
-        /* Start of a statement */
-        if (*d == '$') {
-            /* Reset runtime information */
-            esp_gps->asterisk = 0;
-            esp_gps->item_num = 0;
-            esp_gps->item_pos = 0;
-            esp_gps->cur_statement = 0;
-            esp_gps->crc = 0;
-            esp_gps->sat_count = 0;
-            esp_gps->sat_num = 0;
-            /* Add character to item */
-            esp_gps->item_str[esp_gps->item_pos++] = *d;
-            esp_gps->item_str[esp_gps->item_pos] = '\0';
-        }
-        /* Detect item separator character */
-        else if (*d == ',') {
-            /* Parse current item */
-            parse_item(esp_gps);
-            /* Add character to CRC computation */
-            esp_gps->crc ^= (uint8_t)(*d);
-            /* Start with next item */
-            esp_gps->item_pos = 0;
-            esp_gps->item_str[0] = '\0';
-            esp_gps->item_num++;
-        }
-        /* End of CRC computation */
-        else if (*d == '*') {
-            /* Parse current item */
-            parse_item(esp_gps);
-            /* Asterisk detected */
-            esp_gps->asterisk = 1;
-            /* Start with next item */
-            esp_gps->item_pos = 0;
-            esp_gps->item_str[0] = '\0';
-            esp_gps->item_num++;
-        }
-        /* End of statement */
-        else if (*d == '\r') {
-            /* Convert received CRC from string (hex) to number */
-            uint8_t crc = (uint8_t)strtol(esp_gps->item_str, NULL, 16);
-            /* CRC passed */
-            if (esp_gps->crc == crc) {
-                switch (esp_gps->cur_statement) {
-#if CONFIG_NMEA_STATEMENT_GGA
-                case STATEMENT_GGA:
-                    esp_gps->parsed_statement |= 1 << STATEMENT_GGA;
-                    break;
-#endif
-#if CONFIG_NMEA_STATEMENT_GSA
-                case STATEMENT_GSA:
-                    esp_gps->parsed_statement |= 1 << STATEMENT_GSA;
-                    break;
-#endif
-#if CONFIG_NMEA_STATEMENT_RMC
-                case STATEMENT_RMC:
-                    esp_gps->parsed_statement |= 1 << STATEMENT_RMC;
-                    break;
-#endif
-#if CONFIG_NMEA_STATEMENT_GSV
-                case STATEMENT_GSV:
-                    if (esp_gps->sat_num == esp_gps->sat_count) {
-                        esp_gps->parsed_statement |= 1 << STATEMENT_GSV;
-                    }
-                    break;
-#endif
-#if CONFIG_NMEA_STATEMENT_GLL
-                case STATEMENT_GLL:
-                    esp_gps->parsed_statement |= 1 << STATEMENT_GLL;
-                    break;
-#endif
-#if CONFIG_NMEA_STATEMENT_VTG
-                case STATEMENT_VTG:
-                    esp_gps->parsed_statement |= 1 << STATEMENT_VTG;
-                    break;
-#endif
-                default:
-                    break;
-                }
-                /* Check if all statements have been parsed */
-                if (((esp_gps->parsed_statement) & esp_gps->all_statements) == esp_gps->all_statements) {
-                    esp_gps->parsed_statement = 0;
-                    /* Send signal to notify that GPS information has been updated */
-
-                    #if (__GNSS_COORDINATE_MODE == 2)
-                    esp_event_post_to(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, GPS_UPDATE,
-                                      esp_gps->buffer, len, 100 / portTICK_PERIOD_MS);
-                    #else
-                    esp_event_post_to(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, GPS_UPDATE,
-                                      &(esp_gps->parent), sizeof(gps_t), 100 / portTICK_PERIOD_MS);
-                    #endif
-                }
-            } else {
-                ESP_LOGD(GPS_TAG, "CRC Error for statement:%s", esp_gps->buffer);
-            }
-            if (esp_gps->cur_statement == STATEMENT_UNKNOWN) {
-                /* Send signal to notify that one unknown statement has been met */
-                esp_event_post_to(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, GPS_UNKNOWN,
-                                  esp_gps->buffer, len, 100 / portTICK_PERIOD_MS);
-            }
-        }
-        /* Other non-space character */
-        else {
-            if (!(esp_gps->asterisk)) {
-                /* Add to CRC */
-                esp_gps->crc ^= (uint8_t)(*d);
-            }
-            /* Add character to item */
-            esp_gps->item_str[esp_gps->item_pos++] = *d;
-            esp_gps->item_str[esp_gps->item_pos] = '\0';
-        }
-        /* Process next character */
-        d++;
+static uint32_t nmea_fix_history_read_begin(const nmea_fix_history_t *history)
+{
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&history->seq, __ATOMIC_ACQUIRE)) & 1) {
+        /* Writer preempted in the middle of an update, let it finish */
+        vTaskDelay(1);
     }
-    return ESP_OK;
+    return seq;
 }
 
 /**
- * @brief Handle when a pattern has been detected by uart
+ * @brief Check whether a read of the history raced with the writer
  *
- * @param esp_gps esp_gps_t type object
+ * @param history fix history
+ * @param seq sequence number returned by nmea_fix_history_read_begin()
+ * @return true if the read has to be done again
  */
-static void esp_handle_uart_pattern(esp_gps_t *esp_gps)
+static bool nmea_fix_history_read_retry(const nmea_fix_history_t *history, uint32_t seq)
 {
-    int pos = uart_pattern_pop_pos(esp_gps->uart_port);
-    if (pos != -1) {
-        /* read one line(include '\n') */
-        int read_len = uart_read_bytes(esp_gps->uart_port, esp_gps->buffer, pos + 1, 100 / portTICK_PERIOD_MS);
-
-        /* make sure the line is a standard string */
-        esp_gps->buffer[read_len] = '\0';
-        /* Send new line to handle */
-        if (gps_decode(esp_gps, read_len + 1) != ESP_OK) {
-            ESP_LOGW(GPS_TAG, "GPS decode line failed");
-        }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&history->seq, __ATOMIC_RELAXED) != seq;
+}
 
-    #if (__GNSS_COORDINATE_MODE == 2)
-        printf("%s", esp_gps->buffer);
-    #endif
-    } else {
-        ESP_LOGW(GPS_TAG, "Pattern Queue Size too small");
-        uart_flush_input(esp_gps->uart_port);
-    }
+/**
+ * @brief Get entry of the history by age order
+ *
+ * @param history fix history
+ * @param count number of fixes written, read once by the reader
+ * @param k index, 0 is the oldest fix still in the history
+ * @return const nmea_history_entry_t* entry
+ */
+static inline const nmea_history_entry_t *nmea_fix_history_at(const nmea_fix_history_t *history, uint32_t count,
+                                                              uint32_t k)
+{
+    uint32_t num = MIN(count, NMEA_PARSER_FIX_HISTORY_SIZE);
+    return &history->entry[(count - num + k) % NMEA_PARSER_FIX_HISTORY_SIZE];
 }
 
 /**
- * @brief NMEA Parser Task Entry
+ * @brief Binary search of the last fix at or before a time
  *
- * @param arg argument
+ * @param history fix history
+ * @param count number of fixes written, read once by the reader
+ * @param utc_ms time (ms since 2000-01-01 UTC)
+ * @return int32_t index of the fix (0 is the oldest), -1 if all fixes are after utc_ms
  */
-static void nmea_parser_task_entry(void *arg)
+static int32_t nmea_fix_history_find(const nmea_fix_history_t *history, uint32_t count, int64_t utc_ms)
 {
-    esp_gps_t *esp_gps = (esp_gps_t *)arg;
-    uart_event_t event;
-    while (1) {
-        if (xQueueReceive(esp_gps->event_queue, &event, pdMS_TO_TICKS(200))) {
-            switch (event.type) {
-                case UART_DATA:
-                    break;
-                case UART_FIFO_OVF:
-                    ESP_LOGW(GPS_TAG, "HW FIFO Overflow");
-                    uart_flush(esp_gps->uart_port);
-                    xQueueReset(esp_gps->event_queue);
-                    break;
-                case UART_BUFFER_FULL:
-                    ESP_LOGW(GPS_TAG, "Ring Buffer Full");
-                    uart_flush(esp_gps->uart_port);
-                    xQueueReset(esp_gps->event_queue);
-                    break;
-                case UART_BREAK:
-                    ESP_LOGW(GPS_TAG, "Rx Break");
-                    break;
-                case UART_PARITY_ERR:
-                    ESP_LOGE(GPS_TAG, "Parity Error");
-                    break;
-                case UART_FRAME_ERR:
-                    ESP_LOGE(GPS_TAG, "Frame Error");
-                    break;
-                case UART_PATTERN_DET:
-                    esp_handle_uart_pattern(esp_gps);
-                    break;
-                default:
-                    ESP_LOGW(GPS_TAG, "unknown uart event type: %d", event.type);
-                    break;
-            }
+    int32_t lo = 0;
+    int32_t hi = (int32_t)MIN(count, NMEA_PARSER_FIX_HISTORY_SIZE) - 1;
+    int32_t found = -1;
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) / 2;
+        if (nmea_fix_history_at(history, count, mid)->utc_ms <= utc_ms) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
         }
-        /* Drive the event loop */
-        esp_event_loop_run(esp_gps->event_loop_hdl, pdMS_TO_TICKS(1));
     }
-    vTaskDelete(NULL);
+    return found;
 }
 
 /**
- * @brief Init NMEA Parser
+ * @brief Linear interpolation of an angle, on the shortest arc
  *
- * @param config Configuration of NMEA Parser
- * @return nmea_parser_handle_t handle of nmea_parser
+ * @param a angle at start
+ * @param b angle at end
+ * @param full full turn in the unit of a and b
+ * @param num elapsed time since start
+ * @param den time between start and end
+ * @return int64_t interpolated angle, not wrapped
  */
-nmea_parser_handle_t nmea_parser_init(const nmea_parser_config_t *config)
+static inline int64_t nmea_lerp_angle(int64_t a, int64_t b, int64_t full, int64_t num, int64_t den)
 {
-    esp_gps_t *esp_gps = calloc(1, sizeof(esp_gps_t));
-    if (!esp_gps) {
-        ESP_LOGE(GPS_TAG, "calloc memory for esp_fps failed");
-        goto err_gps;
+    int64_t delta = b - a;
+    if (delta > full / 2) {
+        delta -= full;
+    } else if (delta < -full / 2) {
+        delta += full;
     }
-    esp_gps->buffer = calloc(1, NMEA_PARSER_RUNTIME_BUFFER_SIZE);
+    return a + delta * num / den;
+}
+
+/**
+ * @brief Interpolate two fixes
+ *
+ * @param a fix before utc_ms
+ * @param b fix after utc_ms
+ * @param utc_ms time (ms since 2000-01-01 UTC)
+ * @param fix interpolated fix, other fields than position, speed, course and time are taken from a
+ */
+static void nmea_fix_interpolate(const nmea_history_entry_t *a, const nmea_history_entry_t *b, int64_t utc_ms,
+                                 gps_fix_core_t *fix)
+{
+    int64_t num = utc_ms - a->utc_ms;
+    int64_t den = b->utc_ms - a->utc_ms;
+    *fix = a->fix;
+    if (!den) {
+        return;
+    }
+    fix->latitude = (int32_t)(a->fix.latitude + ((int64_t)b->fix.latitude - a->fix.latitude) * num / den);
+    int64_t longitude = nmea_lerp_angle(a->fix.longitude, b->fix.longitude, 3600000000LL, num, den);
+    if (longitude > 1800000000LL) {
+        longitude -= 3600000000LL;
+    } else if (longitude < -1800000000LL) {
+        longitude += 3600000000LL;
+    }
+    fix->longitude = (int32_t)longitude;
+    fix->altitude = (int32_t)(a->fix.altitude + ((int64_t)b->fix.altitude - a->fix.altitude) * num / den);
+    fix->speed = (uint16_t)(a->fix.speed + ((int32_t)b->fix.speed - a->fix.speed) * num / den);
+    fix->cog = (uint16_t)((nmea_lerp_angle(a->fix.cog, b->fix.cog, 36000, num, den) + 36000) % 36000);
+    fix->time_ms = (uint32_t)(utc_ms % NMEA_MS_PER_DAY);
+}
+#endif
+
+
+#if CONFIG_NMEA_PARSER_PREDICTOR && !CONFIG_NMEA_PARSER_FUSION
+/**
+ * @brief Record the local time of the first statement of an epoch, called by the decoder
+ *
+ * @param ctx esp_gps_t type object
+ */
+static void esp_gps_epoch_start(void *ctx)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)ctx;
+    esp_gps->predictor_epoch_us = esp_timer_get_time();
+}
+#endif
+
+#if CONFIG_NMEA_PARSER_POST_UNKNOWN
+/**
+ * @brief Post a statement nobody parses, called by the decoder
+ *
+ * @param ctx esp_gps_t type object
+ * @param statement statement, NUL terminated
+ * @param len size of statement, NUL included
+ */
+static void esp_gps_unknown(void *ctx, const char *statement, size_t len)
+{
+    /* Send signal to notify that one unknown statement has been met */
+    gps_dispatch((esp_gps_t *)ctx, GPS_UNKNOWN, (void *)statement, len);
+}
+#endif
+
+/**
+ * @brief Run the stages of a decoded epoch and deliver its events, called by the decoder
+ *
+ * @param ctx esp_gps_t type object
+ * @param gps decoded epoch
+ * @param buf line buffer the epoch ended in
+ * @param len number of bytes in line buffer
+ */
+static void esp_gps_epoch(void *ctx, const gps_t *gps, const uint8_t *buf, size_t len)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)ctx;
+#if CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+    /* Sentences of the epoch were forwarded before decoding, write the batches */
+    nmea_forward_flush(&esp_gps->forward);
+#endif
+#if CONFIG_NMEA_PARSER_POST_FIX_CORE || CONFIG_NMEA_PARSER_FIX_HISTORY || CONFIG_NMEA_PARSER_PREDICTOR || \
+    CONFIG_NMEA_PARSER_TRACK_SIMPLIFY || CONFIG_NMEA_PARSER_GEOFENCE || CONFIG_NMEA_PARSER_RATE_CONTROL || \
+    CONFIG_NMEA_PARSER_FILTER || CONFIG_NMEA_PARSER_FIX_LOG
+    gps_fix_core_t core;
+    nmea_decoder_fix_core(gps, &core);
+#endif
+#if CONFIG_NMEA_PARSER_FILTER
+    /* All later stages and handlers see the filtered position */
+    if (nmea_filter_update(&esp_gps->filter, &core)) {
+#if CONFIG_NMEA_PARSER_POST_GPS_UPDATE
+        esp_gps->filtered = *gps;
+        esp_gps->filtered.latitude = core.latitude;
+        esp_gps->filtered.longitude = core.longitude;
+        gps = &esp_gps->filtered;
+#endif
+    }
+#endif
+#if CONFIG_NMEA_PARSER_FIX_HISTORY
+    nmea_fix_history_push(&esp_gps->history, &core);
+#endif
+    /* Send signal to notify that GPS information has been updated */
+#if CONFIG_NMEA_PARSER_POST_FIX_CORE
+    gps_dispatch(esp_gps, GPS_FIX, &core, sizeof(core));
+#endif
+#if CONFIG_NMEA_PARSER_PREDICTOR
+    esp_gps_predictor_update(esp_gps, &core);
+#endif
+#if CONFIG_NMEA_PARSER_TRACK_SIMPLIFY
+    nmea_track_update(&esp_gps->track, &core);
+#endif
+#if CONFIG_NMEA_PARSER_GEOFENCE
+    nmea_geofence_handle_t geofence = esp_gps->geofence;
+    if (geofence && core.valid) {
+        esp_gps->geofence_fix = &core;
+        nmea_geofence_update(geofence, core.latitude, core.longitude, nmea_geofence_post, esp_gps);
+    }
+#endif
+#if CONFIG_NMEA_PARSER_FIX_LOG
+    nmea_fix_log_handle_t fix_log = esp_gps->fix_log;
+    if (fix_log && core.valid) {
+        nmea_fix_log_append(fix_log, &core);
+    }
+#endif
+#if CONFIG_NMEA_PARSER_RATE_CONTROL
+    esp_gps_rate_update(esp_gps, &core);
+#endif
+#if CONFIG_NMEA_PARSER_POST_GPS_UPDATE
+    gps_dispatch(esp_gps, GPS_UPDATE, (void *)gps, sizeof(gps_t));
+#endif
+}
+
+#if CONFIG_NMEA_PARSER_FUSION
+/**
+ * @brief Run the stages of a fused epoch, called by the fusion stage
+ *
+ * @param ctx esp_gps_t type object
+ * @param gps fused epoch
+ * @param rx receiver of the epoch, NMEA_FUSION_RX_NUM for an average of both
+ */
+static void esp_gps_fusion_publish(void *ctx, const gps_t *gps, uint8_t rx, int64_t epoch_us)
+{
+#if CONFIG_NMEA_PARSER_PREDICTOR
+    /* The fix is valid at the arrival of the epoch on the receiver it comes from */
+    ((esp_gps_t *)ctx)->predictor_epoch_us = epoch_us;
+#endif
+    esp_gps_epoch(ctx, gps, NULL, 0);
+}
+
+/**
+ * @brief Record the local time of the first statement of an epoch of the primary receiver, called by the decoder
+ *
+ * @param ctx esp_gps_t type object
+ */
+static void esp_gps_fusion_primary_start(void *ctx)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)ctx;
+    esp_gps->fusion_epoch_us[0] = esp_timer_get_time();
+}
+
+/**
+ * @brief Record the local time of the first statement of an epoch of the secondary receiver, called by the decoder
+ *
+ * @param ctx esp_gps_t type object
+ */
+static void esp_gps_fusion_secondary_start(void *ctx)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)ctx;
+    esp_gps->fusion_epoch_us[1] = esp_timer_get_time();
+}
+
+/**
+ * @brief Pass an epoch of the primary receiver to the fusion stage, called by the decoder
+ *
+ * @param ctx esp_gps_t type object
+ * @param gps decoded epoch
+ * @param buf line buffer the epoch ended in
+ * @param len number of bytes in line buffer
+ */
+static void esp_gps_fusion_primary(void *ctx, const gps_t *gps, const uint8_t *buf, size_t len)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)ctx;
+    nmea_fusion_push(&esp_gps->fusion, 0, gps, esp_gps->fusion_epoch_us[0], (uint32_t)(esp_timer_get_time() / 1000));
+}
+
+/**
+ * @brief Pass an epoch of the secondary receiver to the fusion stage, called by the decoder
+ *
+ * @param ctx esp_gps_t type object
+ * @param gps decoded epoch
+ * @param buf line buffer the epoch ended in
+ * @param len number of bytes in line buffer
+ */
+static void esp_gps_fusion_secondary(void *ctx, const gps_t *gps, const uint8_t *buf, size_t len)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)ctx;
+    nmea_fusion_push(&esp_gps->fusion, 1, gps, esp_gps->fusion_epoch_us[1], (uint32_t)(esp_timer_get_time() / 1000));
+}
+#endif
+
+/**
+ * @brief Forward and decode one line
+ *
+ * @param esp_gps esp_gps_t type object
+ * @param buf line buffer, NUL terminated
+ * @param len number of bytes in line buffer
+ */
+static void esp_gps_process_line(esp_gps_t *esp_gps, uint8_t *buf, int len)
+{
+#if CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+    nmea_forward_feed(&esp_gps->forward, buf, len, (uint32_t)(esp_timer_get_time() / 1000));
+#endif
+    nmea_decoder_feed(&esp_gps->decoder, buf, len);
+}
+
+#if CONFIG_NMEA_PARSER_PIPELINE
+/**
+ * @brief Get the free slot of line ring, wait for decode task if the ring is full
+ *
+ * Only called from ingestion task (single producer).
+ *
+ * @param esp_gps esp_gps_t type object
+ * @return nmea_line_slot_t* slot to read the next line into
+ */
+static nmea_line_slot_t *nmea_line_ring_acquire(esp_gps_t *esp_gps)
+{
+    nmea_line_ring_t *ring = &esp_gps->line_ring;
+    uint32_t next = (ring->head + 1) % NMEA_PARSER_PIPELINE_SLOTS;
+    if (next == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+        /* Decode task is behind, leave the data in UART ring buffer meanwhile */
+        esp_gps->pipeline_stall++;
+        while (next == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+            vTaskDelay(1);
+        }
+    }
+    return &ring->slots[ring->head];
+}
+
+/**
+ * @brief Publish the acquired slot of line ring to decode task
+ *
+ * @param esp_gps esp_gps_t type object
+ */
+static void nmea_line_ring_publish(esp_gps_t *esp_gps)
+{
+    nmea_line_ring_t *ring = &esp_gps->line_ring;
+    __atomic_store_n(&ring->head, (ring->head + 1) % NMEA_PARSER_PIPELINE_SLOTS, __ATOMIC_RELEASE);
+    xTaskNotifyGive(esp_gps->tsk_hdl);
+}
+
+/**
+ * @brief Decode all lines pending in line ring
+ *
+ * Only called from decode task (single consumer).
+ *
+ * @param esp_gps esp_gps_t type object
+ */
+static void nmea_line_ring_drain(esp_gps_t *esp_gps)
+{
+    nmea_line_ring_t *ring = &esp_gps->line_ring;
+    uint32_t tail = ring->tail;
+    while (tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+        nmea_line_slot_t *slot = &ring->slots[tail];
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+        esp_gps->decode_line_us = slot->rx_us;
+#endif
+        esp_gps_process_line(esp_gps, slot->data, slot->len);
+        tail = (tail + 1) % NMEA_PARSER_PIPELINE_SLOTS;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+#endif
+
+/**
+ * @brief Install UART driver and line end detection
+ *
+ * @param esp_gps esp_gps_t type object
+ * @param rx_size size of UART Rx ring buffer
+ * @param tx_size size of UART Tx ring buffer
+ * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+ */
+static esp_err_t esp_gps_uart_install(esp_gps_t *esp_gps, uint32_t rx_size, uint32_t tx_size)
+{
+    if (uart_driver_install(esp_gps->uart_port, rx_size, tx_size,
+                            esp_gps->event_queue_size, &esp_gps->event_queue, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    esp_gps->ring_size = rx_size;
+    /* Set pattern interrupt, used to detect the end of a line */
+    uart_enable_pattern_det_baud_intr(esp_gps->uart_port, '\n', 1, 9, 0, 0);
+    /* Set pattern queue size */
+    uart_pattern_queue_reset(esp_gps->uart_port, esp_gps->event_queue_size);
+    return ESP_OK;
+}
+
+/**
+ * @brief Record the high water mark of the UART Rx ring buffer
+ *
+ * The ring buffer is sized once at init: reinstalling the driver at runtime would lose the bytes received
+ * meanwhile. The first burst filling more than 3/4 of it is logged, size it from nmea_parser_get_stats().
+ *
+ * @param esp_gps esp_gps_t type object
+ */
+static void esp_gps_ring_watch(esp_gps_t *esp_gps)
+{
+    size_t buffered = 0;
+    uart_get_buffered_data_len(esp_gps->uart_port, &buffered);
+    if (buffered <= esp_gps->ring_high_water) {
+        return;
+    }
+    if (buffered * 4 > esp_gps->ring_size * 3 && esp_gps->ring_high_water * 4 <= esp_gps->ring_size * 3) {
+        ESP_LOGW(GPS_TAG, "uart ring buffer %u of %u bytes, raise NMEA Parser Ring Buffer Size",
+                 (unsigned)buffered, (unsigned)esp_gps->ring_size);
+    }
+    esp_gps->ring_high_water = buffered;
+}
+
+/**
+ * @brief Handle when a pattern has been detected by uart
+ *
+ * @param esp_gps esp_gps_t type object
+ */
+static void esp_handle_uart_pattern(esp_gps_t *esp_gps)
+{
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    /* Local to the ingestion path, the decode task only sees it through the line slots */
+    int64_t rx_us = esp_timer_get_time();
+#endif
+    int pos = uart_pattern_pop_pos(esp_gps->uart_port);
+    if (pos != -1) {
+        /* read up to the line end (include '\n'), lines whose position was dropped come along */
+        int remain = pos + 1;
+        while (remain > 0) {
+#if CONFIG_NMEA_PARSER_PIPELINE
+            nmea_line_slot_t *slot = nmea_line_ring_acquire(esp_gps);
+            uint8_t *buffer = slot->data;
+            int buffer_size = NMEA_PARSER_PIPELINE_SLOT_SIZE;
+#else
+            uint8_t *buffer = esp_gps->buffer;
+            int buffer_size = NMEA_PARSER_RUNTIME_BUFFER_SIZE;
+#endif
+            int read_len = uart_read_bytes(esp_gps->uart_port, buffer,
+                                           MIN(remain, buffer_size - 1), 100 / portTICK_PERIOD_MS);
+            if (read_len <= 0) {
+                break;
+            }
+            remain -= read_len;
+
+            /* make sure the line is a standard string */
+            buffer[read_len] = '\0';
+#if CONFIG_NMEA_PARSER_PIPELINE
+            /* Hand the line over to decode task */
+            slot->len = read_len;
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+            slot->rx_us = rx_us;
+#endif
+            nmea_line_ring_publish(esp_gps);
+#else
+            /* Send new line to handle */
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+            esp_gps->decode_line_us = rx_us;
+#endif
+            esp_gps_process_line(esp_gps, buffer, read_len);
+#endif
+        }
+        esp_gps_ring_watch(esp_gps);
+    } else {
+#if CONFIG_NMEA_PARSER_OVERFLOW_RESYNC
+        /* Line end was not recorded, its bytes will be read along with the next line */
+        esp_gps->pattern_lost++;
+#else
+        ESP_LOGW(GPS_TAG, "Pattern Queue Size too small");
+        uart_flush_input(esp_gps->uart_port);
+#endif
+    }
+}
+
+/**
+ * @brief Handle UART FIFO overflow or ring buffer full
+ *
+ * @param esp_gps esp_gps_t type object
+ */
+static void esp_gps_overflow(esp_gps_t *esp_gps)
+{
+    esp_gps->overflow++;
+#if CONFIG_NMEA_PARSER_OVERFLOW_RESYNC
+    /* Keep buffered statements and pending line positions, the damaged statement fails
+     * its checksum or is truncated by the next '$' and is dropped by the decoder */
+#else
+    uart_flush(esp_gps->uart_port);
+    xQueueReset(esp_gps->event_queue);
+#endif
+}
+
+/**
+ * @brief Handle one UART event
+ *
+ * @param esp_gps esp_gps_t type object
+ * @param event UART event
+ */
+static void esp_handle_uart_event(esp_gps_t *esp_gps, const uart_event_t *event)
+{
+    switch (event->type) {
+        case UART_DATA:
+            break;
+        case UART_FIFO_OVF:
+            ESP_LOGW(GPS_TAG, "HW FIFO Overflow");
+            esp_gps_overflow(esp_gps);
+            break;
+        case UART_BUFFER_FULL:
+            ESP_LOGW(GPS_TAG, "Ring Buffer Full");
+            esp_gps_overflow(esp_gps);
+            break;
+        case UART_BREAK:
+            ESP_LOGW(GPS_TAG, "Rx Break");
+            break;
+        case UART_PARITY_ERR:
+            ESP_LOGE(GPS_TAG, "Parity Error");
+            break;
+        case UART_FRAME_ERR:
+            ESP_LOGE(GPS_TAG, "Frame Error");
+            break;
+        case UART_PATTERN_DET:
+            esp_handle_uart_pattern(esp_gps);
+            break;
+        default:
+            ESP_LOGW(GPS_TAG, "unknown uart event type: %d", event->type);
+            break;
+    }
+}
+
+#if CONFIG_NMEA_PARSER_FUSION
+/**
+ * @brief Install the UART of the secondary receiver, and the queue set of both UART event queues
+ *
+ * @param esp_gps esp_gps_t type object
+ * @param uart_config UART configuration of the primary receiver, only the baud rate differs
+ * @return esp_err_t ESP_OK on success, ESP_FAIL on error (the queue set, if created, is left to the caller)
+ */
+static esp_err_t esp_gps_fusion_install(esp_gps_t *esp_gps, const uart_config_t *uart_config)
+{
+    uart_port_t port = CONFIG_NMEA_PARSER_FUSION_UART_PORT;
+    uart_config_t config = *uart_config;
+    config.baud_rate = CONFIG_NMEA_PARSER_FUSION_BAUD_RATE;
+    esp_gps->fusion_port = port;
+    if (uart_driver_install(port, CONFIG_NMEA_PARSER_RING_BUFFER_SIZE, 0,
+                            esp_gps->event_queue_size, &esp_gps->fusion_queue, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (uart_param_config(port, &config) != ESP_OK ||
+            uart_set_pin(port, CONFIG_NMEA_PARSER_FUSION_TX_PIN, CONFIG_NMEA_PARSER_FUSION_RX_PIN,
+                         UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+        goto err;
+    }
+    uart_enable_pattern_det_baud_intr(port, '\n', 1, 9, 0, 0);
+    esp_gps->queue_set = xQueueCreateSet(2 * esp_gps->event_queue_size);
+    if (!esp_gps->queue_set) {
+        goto err;
+    }
+    /* Queues must be empty when added to a set, drop what was received so far */
+    uart_flush_input(esp_gps->uart_port);
+    uart_flush_input(port);
+    uart_pattern_queue_reset(esp_gps->uart_port, esp_gps->event_queue_size);
+    uart_pattern_queue_reset(port, esp_gps->event_queue_size);
+    portENTER_CRITICAL(&esp_gps->lock);
+    xQueueReset(esp_gps->event_queue);
+    xQueueReset(esp_gps->fusion_queue);
+    bool added = xQueueAddToSet(esp_gps->event_queue, esp_gps->queue_set) == pdPASS &&
+                 xQueueAddToSet(esp_gps->fusion_queue, esp_gps->queue_set) == pdPASS;
+    portEXIT_CRITICAL(&esp_gps->lock);
+    if (added) {
+        return ESP_OK;
+    }
+err:
+    uart_driver_delete(port);
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Handle one UART event of the secondary receiver
+ *
+ * Lines are read into the runtime buffer and decoded like those of the primary receiver, but not forwarded.
+ *
+ * @param esp_gps esp_gps_t type object
+ * @param event UART event
+ */
+static void esp_gps_fusion_uart_event(esp_gps_t *esp_gps, const uart_event_t *event)
+{
+    uart_port_t port = esp_gps->fusion_port;
+    int pos;
+    switch (event->type) {
+        case UART_PATTERN_DET:
+            pos = uart_pattern_pop_pos(port);
+            if (pos == -1) {
+#if CONFIG_NMEA_PARSER_OVERFLOW_RESYNC
+                esp_gps->pattern_lost++;
+#else
+                uart_flush_input(port);
+#endif
+                break;
+            }
+            for (int remain = pos + 1; remain > 0;) {
+                int read_len = uart_read_bytes(port, esp_gps->buffer, MIN(remain, NMEA_PARSER_RUNTIME_BUFFER_SIZE - 1),
+                                               100 / portTICK_PERIOD_MS);
+                if (read_len <= 0) {
+                    break;
+                }
+                remain -= read_len;
+                esp_gps->buffer[read_len] = '\0';
+                nmea_decoder_feed(&esp_gps->fusion_decoder, esp_gps->buffer, read_len);
+            }
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            ESP_LOGW(GPS_TAG, "Secondary Receiver Overflow");
+            esp_gps->overflow++;
+#if !CONFIG_NMEA_PARSER_OVERFLOW_RESYNC
+            uart_flush(port);
+            xQueueReset(esp_gps->fusion_queue);
+#endif
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Wait for a UART event of either receiver and handle it
+ *
+ * Epochs waiting for the other receiver are published once their timeout is over, the wait ends in time
+ * for the next one.
+ *
+ * @param esp_gps esp_gps_t type object
+ * @param event UART event will be saved in this pointer
+ */
+static void esp_gps_fusion_receive(esp_gps_t *esp_gps, uart_event_t *event)
+{
+    TickType_t wait = NMEA_PARSER_TASK_WAIT_TICKS;
+    uint32_t next_ms = nmea_fusion_poll(&esp_gps->fusion, (uint32_t)(esp_timer_get_time() / 1000));
+    if (next_ms != UINT32_MAX) {
+        wait = MIN(wait, MAX(1, pdMS_TO_TICKS(next_ms + portTICK_PERIOD_MS - 1)));
+    }
+    QueueSetMemberHandle_t queue = xQueueSelectFromSet(esp_gps->queue_set, wait);
+    /* An overflow may have reset the queue since it was selected */
+    if (queue == esp_gps->event_queue && xQueueReceive(esp_gps->event_queue, event, 0)) {
+        esp_handle_uart_event(esp_gps, event);
+    } else if (queue == esp_gps->fusion_queue && xQueueReceive(esp_gps->fusion_queue, event, 0)) {
+        esp_gps_fusion_uart_event(esp_gps, event);
+    }
+}
+#endif
+
+/**
+ * @brief Drive the event loop of NMEA Parser
+ *
+ * @param esp_gps esp_gps_t type object
+ */
+static void esp_gps_run_event_loop(esp_gps_t *esp_gps)
+{
+    esp_event_loop_run(esp_gps->event_loop_hdl, pdMS_TO_TICKS(1));
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    if (esp_gps->post_us) {
+        nmea_hop_add(&esp_gps->hop_event, esp_gps->post_us, esp_timer_get_time());
+        esp_gps->post_us = 0;
+    }
+#endif
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING && CONFIG_NMEA_PARSER_HANDLER_PROFILE_LOG_PERIOD
+    nmea_handler_profile_log(esp_gps);
+#endif
+#if CONFIG_NMEA_PARSER_PREDICTOR && CONFIG_NMEA_PARSER_UPSAMPLE_RATE_HZ
+    esp_gps_predictor_tick(esp_gps);
+#endif
+#if CONFIG_NMEA_PARSER_FORWARD_SINK_NUM && CONFIG_NMEA_PARSER_FORWARD_FLUSH_MS
+    /* Batches of epochs that do not end */
+    nmea_forward_poll(&esp_gps->forward, (uint32_t)(esp_timer_get_time() / 1000));
+#endif
+}
+
+#if CONFIG_NMEA_PARSER_PIPELINE
+/**
+ * @brief NMEA Parser Ingestion Task Entry, reads UART lines into line ring
+ *
+ * @param arg argument
+ */
+static void nmea_parser_ingest_task_entry(void *arg)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)arg;
+    uart_event_t event;
+    while (1) {
+        if (xQueueReceive(esp_gps->event_queue, &event, pdMS_TO_TICKS(200))) {
+            esp_handle_uart_event(esp_gps, &event);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief NMEA Parser Task Entry, decodes lines from line ring and drives the event loop
+ *
+ * @param arg argument
+ */
+static void nmea_parser_task_entry(void *arg)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)arg;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, NMEA_PARSER_TASK_WAIT_TICKS);
+        nmea_line_ring_drain(esp_gps);
+        /* Drive the event loop */
+        esp_gps_run_event_loop(esp_gps);
+    }
+    vTaskDelete(NULL);
+}
+#else
+/**
+ * @brief NMEA Parser Task Entry
+ *
+ * @param arg argument
+ */
+static void nmea_parser_task_entry(void *arg)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)arg;
+    uart_event_t event;
+    while (1) {
+#if CONFIG_NMEA_PARSER_FUSION
+        esp_gps_fusion_receive(esp_gps, &event);
+#else
+        if (xQueueReceive(esp_gps->event_queue, &event, NMEA_PARSER_TASK_WAIT_TICKS)) {
+            esp_handle_uart_event(esp_gps, &event);
+        }
+#endif
+        /* Drive the event loop */
+        esp_gps_run_event_loop(esp_gps);
+    }
+    vTaskDelete(NULL);
+}
+#endif
+
+/**
+ * @brief Init NMEA Parser
+ *
+ * @param config Configuration of NMEA Parser
+ * @return nmea_parser_handle_t handle of nmea_parser
+ */
+nmea_parser_handle_t nmea_parser_init(const nmea_parser_config_t *config)
+{
+#if CONFIG_NMEA_PARSER_STATIC_ALLOCATION
+    if (s_nmea_parser.used) {
+        ESP_LOGE(GPS_TAG, "static NMEA Parser instance already in use");
+        return NULL;
+    }
+    memset(&s_nmea_parser, 0, sizeof(s_nmea_parser));
+    s_nmea_parser.used = true;
+    esp_gps_t *esp_gps = &s_nmea_parser.gps;
+#if CONFIG_NMEA_PARSER_PIPELINE
+    esp_gps->line_ring.slots = s_nmea_parser.line_slots;
+#else
+    esp_gps->buffer = s_nmea_parser.buffer;
+#endif
+#else
+    esp_gps_t *esp_gps = calloc(1, sizeof(esp_gps_t));
+    if (!esp_gps) {
+        ESP_LOGE(GPS_TAG, "calloc memory for esp_fps failed");
+        goto err_gps;
+    }
+#if CONFIG_NMEA_PARSER_PIPELINE
+    esp_gps->line_ring.slots = calloc(NMEA_PARSER_PIPELINE_SLOTS, sizeof(nmea_line_slot_t));
+    if (!esp_gps->line_ring.slots) {
+        ESP_LOGE(GPS_TAG, "calloc memory for line ring failed");
+        goto err_buffer;
+    }
+#else
+    esp_gps->buffer = calloc(1, NMEA_PARSER_RUNTIME_BUFFER_SIZE);
     if (!esp_gps->buffer) {
         ESP_LOGE(GPS_TAG, "calloc memory for runtime buffer failed");
         goto err_buffer;
     }
-#if CONFIG_NMEA_STATEMENT_GSA
-    esp_gps->all_statements |= (1 << STATEMENT_GSA);
 #endif
-#if CONFIG_NMEA_STATEMENT_GSV
-    esp_gps->all_statements |= (1 << STATEMENT_GSV);
 #endif
-#if CONFIG_NMEA_STATEMENT_GGA
-    esp_gps->all_statements |= (1 << STATEMENT_GGA);
+    /* Set attributes */
+    esp_gps->uart_port = config->uart.uart_port;
+    esp_gps->event_queue_size = config->uart.event_queue_size;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    esp_gps->lock = lock;
+    esp_gps->handler_running = -1;
+    nmea_decoder_cb_t decoder_cb = {
+#if CONFIG_NMEA_PARSER_FUSION
+        .epoch = esp_gps_fusion_primary,
+        .epoch_start = esp_gps_fusion_primary_start,
+#else
+        .epoch = esp_gps_epoch,
+#if CONFIG_NMEA_PARSER_PREDICTOR
+        .epoch_start = esp_gps_epoch_start,
 #endif
-#if CONFIG_NMEA_STATEMENT_RMC
-    esp_gps->all_statements |= (1 << STATEMENT_RMC);
 #endif
-#if CONFIG_NMEA_STATEMENT_GLL
-    esp_gps->all_statements |= (1 << STATEMENT_GLL);
+#if CONFIG_NMEA_PARSER_POST_UNKNOWN
+        .unknown = esp_gps_unknown,
 #endif
-#if CONFIG_NMEA_STATEMENT_VTG
-    esp_gps->all_statements |= (1 << STATEMENT_VTG);
+        .ctx = esp_gps,
+    };
+    nmea_decoder_init(&esp_gps->decoder, 0, &decoder_cb);
+#if CONFIG_NMEA_PARSER_FUSION
+    /* Both decoders feed the fusion stage, which runs the stages of each UTC time once */
+    decoder_cb.epoch = esp_gps_fusion_secondary;
+    decoder_cb.epoch_start = esp_gps_fusion_secondary_start;
+    nmea_decoder_init(&esp_gps->fusion_decoder, 0, &decoder_cb);
+    nmea_fusion_config_t fusion_config = {
+#if CONFIG_NMEA_PARSER_FUSION_WEIGHT
+        .mode = NMEA_FUSION_WEIGHT,
+#else
+        .mode = NMEA_FUSION_SELECT,
+#endif
+        .timeout_ms = CONFIG_NMEA_PARSER_FUSION_TIMEOUT_MS,
+    };
+    nmea_fusion_init(&esp_gps->fusion, &fusion_config, esp_gps_fusion_publish, esp_gps);
+#endif
+#if CONFIG_NMEA_PARSER_PREDICTOR
+    nmea_predictor_init(&esp_gps->predictor);
+#endif
+#if CONFIG_NMEA_PARSER_TRACK_SIMPLIFY
+    nmea_track_config_t track_config = {
+        .tolerance_cm = CONFIG_NMEA_PARSER_TRACK_TOLERANCE_CM,
+        .window = CONFIG_NMEA_PARSER_TRACK_WINDOW,
+        .max_interval_s = CONFIG_NMEA_PARSER_TRACK_MAX_INTERVAL_S,
+    };
+    nmea_track_init(&esp_gps->track, &track_config, esp_gps_track_publish, esp_gps);
+#endif
+#if CONFIG_NMEA_PARSER_RATE_CONTROL
+    nmea_rate_config_t rate_config = {
+        .period_ms = {
+            [NMEA_RATE_IDLE] = CONFIG_NMEA_PARSER_RATE_IDLE_PERIOD_MS,
+            [NMEA_RATE_CRUISE] = CONFIG_NMEA_PARSER_RATE_CRUISE_PERIOD_MS,
+            [NMEA_RATE_MANOEUVRE] = CONFIG_NMEA_PARSER_RATE_MANOEUVRE_PERIOD_MS,
+        },
+        .idle_speed = CONFIG_NMEA_PARSER_RATE_IDLE_SPEED_CMS,
+        .turn_rate = CONFIG_NMEA_PARSER_RATE_TURN_RATE * 100,
+        .accel = CONFIG_NMEA_PARSER_RATE_ACCEL_CMS2,
+        .hold_ms = CONFIG_NMEA_PARSER_RATE_HOLD_MS,
+    };
+    nmea_rate_init(&esp_gps->rate, &rate_config);
+#endif
+#if CONFIG_NMEA_PARSER_FILTER
+    nmea_filter_config_t filter_config = {
+        .uere = CONFIG_NMEA_PARSER_FILTER_UERE_CM,
+        .speed_error = CONFIG_NMEA_PARSER_FILTER_SPEED_ERROR_CMS,
+        .accel = CONFIG_NMEA_PARSER_FILTER_ACCEL_CMS2,
+        .gate = CONFIG_NMEA_PARSER_FILTER_GATE,
+        .reset_ms = CONFIG_NMEA_PARSER_FILTER_RESET_MS,
+    };
+    nmea_filter_init(&esp_gps->filter, &filter_config);
+#endif
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
+    esp_gps->handler_budget_us = CONFIG_NMEA_PARSER_HANDLER_BUDGET_US;
 #endif
-    /* Set attributes */
-    esp_gps->uart_port = config->uart.uart_port;
-    esp_gps->all_statements &= 0xFE;
     /* Install UART friver */
     uart_config_t uart_config = {
         .baud_rate = config->uart.baud_rate,
@@ -718,8 +1518,7 @@ nmea_parser_handle_t nmea_parser_init(const nmea_parser_config_t *config)
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
         .source_clk = UART_SCLK_APB,
     };
-    if (uart_driver_install(esp_gps->uart_port, CONFIG_NMEA_PARSER_RING_BUFFER_SIZE, CONFIG_NMEA_PARSER_RING_BUFFER_SIZE,
-                            config->uart.event_queue_size, &esp_gps->event_queue, 0) != ESP_OK) {
+    if (esp_gps_uart_install(esp_gps, CONFIG_NMEA_PARSER_RING_BUFFER_SIZE, 0) != ESP_OK) {
         ESP_LOGE(GPS_TAG, "install uart driver failed");
         goto err_uart_install;
     }
@@ -732,11 +1531,13 @@ nmea_parser_handle_t nmea_parser_init(const nmea_parser_config_t *config)
         ESP_LOGE(GPS_TAG, "config uart gpio failed");
         goto err_uart_config;
     }
-    /* Set pattern interrupt, used to detect the end of a line */
-    uart_enable_pattern_det_baud_intr(esp_gps->uart_port, '\n', 1, 9, 0, 0);
-    /* Set pattern queue size */
-    uart_pattern_queue_reset(esp_gps->uart_port, config->uart.event_queue_size);
     uart_flush(esp_gps->uart_port);
+#if CONFIG_NMEA_PARSER_FUSION
+    if (esp_gps_fusion_install(esp_gps, &uart_config) != ESP_OK) {
+        ESP_LOGE(GPS_TAG, "install secondary receiver failed");
+        goto err_uart_install;
+    }
+#endif
     /* Create Event loop */
     esp_event_loop_args_t loop_args = {
         .queue_size = NMEA_EVENT_LOOP_QUEUE_SIZE,
@@ -746,11 +1547,87 @@ nmea_parser_handle_t nmea_parser_init(const nmea_parser_config_t *config)
         ESP_LOGE(GPS_TAG, "create event loop faild");
         goto err_eloop;
     }
+    if (esp_event_handler_register_with(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, ESP_EVENT_ANY_ID,
+                                        esp_gps_event_handler, esp_gps) != ESP_OK) {
+        ESP_LOGE(GPS_TAG, "register event handler failed");
+        goto err_handler;
+    }
+#if CONFIG_NMEA_PARSER_STATIC_ALLOCATION
+#if CONFIG_NMEA_PARSER_PIPELINE
+    /* Create NMEA Parser decode task, then ingestion task which notifies it */
+    esp_gps->tsk_hdl = xTaskCreateStaticPinnedToCore(
+                           nmea_parser_task_entry,
+                           "nmea_parser",
+                           NMEA_PARSER_TASK_STACK_SIZE,
+                           esp_gps,
+                           CONFIG_NMEA_PARSER_TASK_PRIORITY,
+                           s_nmea_parser.tsk_stack,
+                           &s_nmea_parser.tsk_tcb,
+                           CONFIG_NMEA_PARSER_DECODE_CORE);
+    if (!esp_gps->tsk_hdl) {
+        ESP_LOGE(GPS_TAG, "create NMEA Parser task failed");
+        goto err_task_create;
+    }
+    esp_gps->ingest_tsk_hdl = xTaskCreateStaticPinnedToCore(
+                                  nmea_parser_ingest_task_entry,
+                                  "nmea_ingest",
+                                  NMEA_PARSER_INGEST_TASK_STACK_SIZE,
+                                  esp_gps,
+                                  CONFIG_NMEA_PARSER_INGEST_TASK_PRIORITY,
+                                  s_nmea_parser.ingest_tsk_stack,
+                                  &s_nmea_parser.ingest_tsk_tcb,
+                                  CONFIG_NMEA_PARSER_INGEST_CORE);
+    if (!esp_gps->ingest_tsk_hdl) {
+        ESP_LOGE(GPS_TAG, "create NMEA Parser ingestion task failed");
+        goto err_ingest_task_create;
+    }
+#else
+    /* Create NMEA Parser task */
+    esp_gps->tsk_hdl = xTaskCreateStatic(
+                           nmea_parser_task_entry,
+                           "nmea_parser",
+                           NMEA_PARSER_TASK_STACK_SIZE,
+                           esp_gps,
+                           CONFIG_NMEA_PARSER_TASK_PRIORITY,
+                           s_nmea_parser.tsk_stack,
+                           &s_nmea_parser.tsk_tcb);
+    if (!esp_gps->tsk_hdl) {
+        ESP_LOGE(GPS_TAG, "create NMEA Parser task failed");
+        goto err_task_create;
+    }
+#endif
+#elif CONFIG_NMEA_PARSER_PIPELINE
+    /* Create NMEA Parser decode task, then ingestion task which notifies it */
+    BaseType_t err = xTaskCreatePinnedToCore(
+                         nmea_parser_task_entry,
+                         "nmea_parser",
+                         NMEA_PARSER_TASK_STACK_SIZE,
+                         esp_gps,
+                         CONFIG_NMEA_PARSER_TASK_PRIORITY,
+                         &esp_gps->tsk_hdl,
+                         CONFIG_NMEA_PARSER_DECODE_CORE);
+    if (err != pdTRUE) {
+        ESP_LOGE(GPS_TAG, "create NMEA Parser task failed");
+        goto err_task_create;
+    }
+    err = xTaskCreatePinnedToCore(
+              nmea_parser_ingest_task_entry,
+              "nmea_ingest",
+              NMEA_PARSER_INGEST_TASK_STACK_SIZE,
+              esp_gps,
+              CONFIG_NMEA_PARSER_INGEST_TASK_PRIORITY,
+              &esp_gps->ingest_tsk_hdl,
+              CONFIG_NMEA_PARSER_INGEST_CORE);
+    if (err != pdTRUE) {
+        ESP_LOGE(GPS_TAG, "create NMEA Parser ingestion task failed");
+        goto err_ingest_task_create;
+    }
+#else
     /* Create NMEA Parser task */
     BaseType_t err = xTaskCreate(
                          nmea_parser_task_entry,
                          "nmea_parser",
-                         4096,
+                         NMEA_PARSER_TASK_STACK_SIZE,
                          esp_gps,
                          CONFIG_NMEA_PARSER_TASK_PRIORITY,
                          &esp_gps->tsk_hdl);
@@ -758,20 +1635,47 @@ nmea_parser_handle_t nmea_parser_init(const nmea_parser_config_t *config)
         ESP_LOGE(GPS_TAG, "create NMEA Parser task failed");
         goto err_task_create;
     }
-    ESP_LOGI(GPS_TAG, "NMEA Parser init OK");
+#endif
+    ESP_LOGI(GPS_TAG, "NMEA Parser init OK, RAM: object %u, buffer %u, stack %u, uart rx ring %u bytes",
+             (unsigned)sizeof(esp_gps_t), (unsigned)NMEA_PARSER_BUFFER_FOOTPRINT,
+             (unsigned)(NMEA_PARSER_TASK_STACK_SIZE + NMEA_PARSER_INGEST_TASK_STACK_SIZE),
+             (unsigned)esp_gps->ring_size);
     return esp_gps;
     /*Error Handling*/
+#if CONFIG_NMEA_PARSER_PIPELINE
+err_ingest_task_create:
+    vTaskDelete(esp_gps->tsk_hdl);
+#endif
 err_task_create:
+err_handler:
     esp_event_loop_delete(esp_gps->event_loop_hdl);
 err_eloop:
+#if CONFIG_NMEA_PARSER_FUSION
+    uart_driver_delete(esp_gps->fusion_port);
+#endif
 err_uart_install:
     uart_driver_delete(esp_gps->uart_port);
+#if CONFIG_NMEA_PARSER_FUSION
+    /* Delete the set once no UART driver posts to its queues */
+    if (esp_gps->queue_set) {
+        vQueueDelete(esp_gps->queue_set);
+    }
+#endif
 err_uart_config:
+#if CONFIG_NMEA_PARSER_STATIC_ALLOCATION
+    s_nmea_parser.used = false;
+    return NULL;
+#else
 err_buffer:
+#if CONFIG_NMEA_PARSER_PIPELINE
+    free(esp_gps->line_ring.slots);
+#else
     free(esp_gps->buffer);
+#endif
 err_gps:
     free(esp_gps);
     return NULL;
+#endif
 }
 
 /**
@@ -783,45 +1687,671 @@ err_gps:
 esp_err_t nmea_parser_deinit(nmea_parser_handle_t nmea_hdl)
 {
     esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+#if CONFIG_NMEA_PARSER_PIPELINE
+    vTaskDelete(esp_gps->ingest_tsk_hdl);
+#endif
     vTaskDelete(esp_gps->tsk_hdl);
     esp_event_loop_delete(esp_gps->event_loop_hdl);
     esp_err_t err = uart_driver_delete(esp_gps->uart_port);
+#if CONFIG_NMEA_PARSER_FUSION
+    uart_driver_delete(esp_gps->fusion_port);
+    vQueueDelete(esp_gps->queue_set);
+#endif
+#if CONFIG_NMEA_PARSER_STATIC_ALLOCATION
+    s_nmea_parser.used = false;
+#else
+#if CONFIG_NMEA_PARSER_PIPELINE
+    free(esp_gps->line_ring.slots);
+#else
     free(esp_gps->buffer);
+#endif
     free(esp_gps);
+#endif
     return err;
 }
 
 /**
  * @brief Add user defined handler for NMEA parser
  *
+ * At most CONFIG_NMEA_PARSER_HANDLER_NUM (default 4) handlers can be added.
+ *
  * @param nmea_hdl handle of NMEA parser
  * @param event_handler user defined event handler
  * @param handler_args handler specific arguments
  * @return esp_err_t
  *  - ESP_OK: Success
- *  - ESP_ERR_NO_MEM: Cannot allocate memory for the handler
- *  - ESP_ERR_INVALIG_ARG: Invalid combination of event base and event id
- *  - Others: Fail
+ *  - ESP_ERR_NO_MEM: All CONFIG_NMEA_PARSER_HANDLER_NUM handler slots are in use
+ *  - ESP_ERR_INVALID_ARG: Invalid handler
  */
 esp_err_t nmea_parser_add_handler(nmea_parser_handle_t nmea_hdl, esp_event_handler_t event_handler, void *handler_args)
 {
+    if (!event_handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
     esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
-    return esp_event_handler_register_with(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, ESP_EVENT_ANY_ID,
-                                           event_handler, handler_args);
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_PARSER_HANDLER_NUM; i++) {
+        if (!esp_gps->handler[i].handler) {
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
+            memset(&esp_gps->handler[i].acc, 0, sizeof(esp_gps->handler[i].acc));
+#endif
+            /* Publish arguments before the handler, the parser task may read the slot at any time */
+            esp_gps->handler[i].handler_args = handler_args;
+            esp_gps->handler[i].handler = event_handler;
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+    return err;
 }
 
 /**
  * @brief Remove user defined handler for NMEA parser
  *
+ * Waits for a call of the handler in progress, after which its arguments can be freed. Called from the
+ * handler itself, it returns at once and the current call runs to its end.
+ *
  * @param nmea_hdl handle of NMEA parser
  * @param event_handler user defined event handler
  * @return esp_err_t
  *  - ESP_OK: Success
- *  - ESP_ERR_INVALIG_ARG: Invalid combination of event base and event id
- *  - Others: Fail
+ *  - ESP_ERR_NOT_FOUND: Handler was not registered
  */
 esp_err_t nmea_parser_remove_handler(nmea_parser_handle_t nmea_hdl, esp_event_handler_t event_handler)
 {
     esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
-    return esp_event_handler_unregister_with(esp_gps->event_loop_hdl, ESP_NMEA_EVENT, ESP_EVENT_ANY_ID, event_handler);
+    int slot = -1;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_PARSER_HANDLER_NUM; i++) {
+        if (esp_gps->handler[i].handler == event_handler) {
+            esp_gps->handler[i].handler = NULL;
+            esp_gps->handler[i].handler_args = NULL;
+            slot = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+    if (slot < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (xTaskGetCurrentTaskHandle() != esp_gps->tsk_hdl) {
+        /* The slot is cleared, a call taken before is the last one */
+        while (__atomic_load_n(&esp_gps->handler_running, __ATOMIC_ACQUIRE) == slot) {
+            vTaskDelay(1);
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Add direct handler for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param direct_handler user defined direct handler
+ * @param handler_args handler specific arguments
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid handler
+ *  - ESP_ERR_NO_MEM: All direct handler slots are in use
+ */
+esp_err_t nmea_parser_add_direct_handler(nmea_parser_handle_t nmea_hdl, nmea_parser_direct_handler_t direct_handler,
+                                         void *handler_args)
+{
+    if (!direct_handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#if NMEA_PARSER_DIRECT_HANDLER_NUM
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_PARSER_DIRECT_HANDLER_NUM; i++) {
+        if (!esp_gps->direct[i].handler) {
+            /* Publish arguments before the handler, the parser task may read the slot at any time */
+            esp_gps->direct[i].handler_args = handler_args;
+            esp_gps->direct[i].handler = direct_handler;
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+    return err;
+#else
+    return ESP_ERR_NO_MEM;
+#endif
+}
+
+/**
+ * @brief Remove direct handler for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param direct_handler user defined direct handler
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: Handler was not registered
+ */
+esp_err_t nmea_parser_remove_direct_handler(nmea_parser_handle_t nmea_hdl, nmea_parser_direct_handler_t direct_handler)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+#if NMEA_PARSER_DIRECT_HANDLER_NUM
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_PARSER_DIRECT_HANDLER_NUM; i++) {
+        if (esp_gps->direct[i].handler == direct_handler) {
+            esp_gps->direct[i].handler = NULL;
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+#endif
+    return err;
+}
+
+/**
+ * @brief Add user defined statement parser for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param parser user defined statement parser, copied into NMEA parser
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid parser
+ *  - ESP_ERR_NO_MEM: All statement parser slots are in use
+ */
+esp_err_t nmea_parser_add_statement_parser(nmea_parser_handle_t nmea_hdl, const nmea_parser_statement_parser_t *parser)
+{
+    if (!parser || !parser->name || !parser->name[0] || !parser->parse_item) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#if NMEA_PARSER_STATEMENT_PARSER_NUM
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_PARSER_STATEMENT_PARSER_NUM; i++) {
+        if (!esp_gps->decoder.user_parser[i].name) {
+            /* Publish the name last, the parser task may read the slot at any time */
+            esp_gps->decoder.user_parser[i].parse_item = parser->parse_item;
+            esp_gps->decoder.user_parser[i].statement_end = parser->statement_end;
+            esp_gps->decoder.user_parser[i].parser_args = parser->parser_args;
+            esp_gps->decoder.user_parser[i].name = parser->name;
+#if CONFIG_NMEA_PARSER_FUSION
+            esp_gps->fusion_decoder.user_parser[i] = esp_gps->decoder.user_parser[i];
+#endif
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+    return err;
+#else
+    return ESP_ERR_NO_MEM;
+#endif
+}
+
+/**
+ * @brief Remove user defined statement parser for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param name statement name the parser was added with
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: No parser was added for this name
+ */
+esp_err_t nmea_parser_remove_statement_parser(nmea_parser_handle_t nmea_hdl, const char *name)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+#if NMEA_PARSER_STATEMENT_PARSER_NUM
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_PARSER_STATEMENT_PARSER_NUM; i++) {
+        if (esp_gps->decoder.user_parser[i].name && !strcmp(esp_gps->decoder.user_parser[i].name, name)) {
+            esp_gps->decoder.user_parser[i].name = NULL;
+#if CONFIG_NMEA_PARSER_FUSION
+            esp_gps->fusion_decoder.user_parser[i].name = NULL;
+#endif
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+#endif
+    return err;
+}
+
+/**
+ * @brief Add forward sink for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param config sink configuration, copied into NMEA parser
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid output or filter
+ *  - ESP_ERR_NO_MEM: All forward sink slots are in use
+ */
+esp_err_t nmea_parser_add_forward_sink(nmea_parser_handle_t nmea_hdl, const nmea_forward_config_t *config)
+{
+    if (!config || !config->write) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#if CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    nmea_forward_filter_t filter;
+    if (nmea_forward_filter_init(config, &filter) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_FORWARD_SINK_NUM; i++) {
+        nmea_forward_sink_t *sink = &esp_gps->forward.sinks[i];
+        if (!sink->write) {
+            /* Publish the sink before its output, the parser task may read the slot at any time */
+            sink->filter = filter;
+            sink->arg = config->arg;
+            sink->batch = config->batch;
+            sink->fill = 0;
+            sink->write = config->write;
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+    return err;
+#else
+    return ESP_ERR_NO_MEM;
+#endif
+}
+
+/**
+ * @brief Remove forward sink for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param write output the sink was added with
+ * @param arg argument of output the sink was added with
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: Sink was not added
+ */
+esp_err_t nmea_parser_remove_forward_sink(nmea_parser_handle_t nmea_hdl, nmea_forward_write_t write, void *arg)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+#if CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    portENTER_CRITICAL(&esp_gps->lock);
+    for (int i = 0; i < NMEA_FORWARD_SINK_NUM; i++) {
+        nmea_forward_sink_t *sink = &esp_gps->forward.sinks[i];
+        if (sink->write == write && sink->arg == arg) {
+            sink->write = NULL;
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_gps->lock);
+#endif
+    return err;
+}
+
+/**
+ * @brief Set authoritative statement of a field group
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param group field group
+ * @param statement statement always decoding this field group
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid field group or statement
+ *  - ESP_ERR_NOT_SUPPORTED: Redundant field skipping is disabled
+ */
+esp_err_t nmea_parser_set_field_authority(nmea_parser_handle_t nmea_hdl, nmea_field_group_t group,
+                                          nmea_statement_t statement)
+{
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    if (group >= NMEA_FIELD_GROUP_MAX || statement > STATEMENT_ZDA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    esp_gps->decoder.authority[group] = statement;
+#if CONFIG_NMEA_PARSER_FUSION
+    esp_gps->fusion_decoder.authority[group] = statement;
+#endif
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Get time of a compact fix
+ *
+ * @param fix compact fix
+ * @return int64_t time of fix (ms since 2000-01-01 UTC), -1 if the date is invalid
+ */
+int64_t nmea_parser_fix_utc_ms(const gps_fix_core_t *fix)
+{
+    return nmea_fix_utc_ms(fix);
+}
+
+/**
+ * @brief Evaluate a set of geofences on each valid fix of NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param geofence handle of a built set, NULL to detach
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: Geofences are disabled
+ */
+esp_err_t nmea_parser_set_geofence(nmea_parser_handle_t nmea_hdl, nmea_geofence_handle_t geofence)
+{
+#if CONFIG_NMEA_PARSER_GEOFENCE
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    esp_gps->geofence = geofence;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Append each valid fix of NMEA parser to a fix log
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param log handle of an open fix log, NULL to detach
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: Fix log is disabled
+ */
+esp_err_t nmea_parser_set_fix_log(nmea_parser_handle_t nmea_hdl, nmea_fix_log_handle_t log)
+{
+#if CONFIG_NMEA_PARSER_FIX_LOG
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    esp_gps->fix_log = log;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Get the last fix at or before a time from the fix history
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param utc_ms time (ms since 2000-01-01 UTC)
+ * @param fix fix will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: utc_ms is before the oldest fix of the history
+ *  - ESP_ERR_NOT_SUPPORTED: Fix history is disabled
+ */
+esp_err_t nmea_parser_history_get(nmea_parser_handle_t nmea_hdl, int64_t utc_ms, gps_fix_core_t *fix)
+{
+#if CONFIG_NMEA_PARSER_FIX_HISTORY
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    const nmea_fix_history_t *history = &esp_gps->history;
+    esp_err_t err;
+    uint32_t seq;
+    do {
+        seq = nmea_fix_history_read_begin(history);
+        uint32_t count = history->count;
+        int32_t k = nmea_fix_history_find(history, count, utc_ms);
+        err = ESP_ERR_NOT_FOUND;
+        if (k >= 0) {
+            *fix = nmea_fix_history_at(history, count, k)->fix;
+            err = ESP_OK;
+        }
+    } while (nmea_fix_history_read_retry(history, seq));
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Interpolate position, speed and course at a time from the fix history
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param utc_ms time (ms since 2000-01-01 UTC)
+ * @param fix interpolated fix will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: utc_ms is outside of the time range of the history
+ *  - ESP_ERR_NOT_SUPPORTED: Fix history is disabled
+ */
+esp_err_t nmea_parser_history_interpolate(nmea_parser_handle_t nmea_hdl, int64_t utc_ms, gps_fix_core_t *fix)
+{
+#if CONFIG_NMEA_PARSER_FIX_HISTORY
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    const nmea_fix_history_t *history = &esp_gps->history;
+    esp_err_t err;
+    uint32_t seq;
+    do {
+        seq = nmea_fix_history_read_begin(history);
+        uint32_t count = history->count;
+        uint32_t num = MIN(count, NMEA_PARSER_FIX_HISTORY_SIZE);
+        int32_t k = nmea_fix_history_find(history, count, utc_ms);
+        err = ESP_ERR_NOT_FOUND;
+        if (k >= 0) {
+            const nmea_history_entry_t *a = nmea_fix_history_at(history, count, k);
+            if (a->utc_ms == utc_ms) {
+                *fix = a->fix;
+                err = ESP_OK;
+            } else if (k + 1 < num) {
+                nmea_fix_interpolate(a, nmea_fix_history_at(history, count, k + 1), utc_ms, fix);
+                err = ESP_OK;
+            }
+        }
+    } while (nmea_fix_history_read_retry(history, seq));
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Copy the fixes of a time range from the fix history
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param from_ms start of range, included (ms since 2000-01-01 UTC)
+ * @param to_ms end of range, included (ms since 2000-01-01 UTC)
+ * @param fixes fixes will be saved in this array, oldest first
+ * @param max_fixes size of fixes array
+ * @return size_t number of fixes saved
+ */
+size_t nmea_parser_history_range(nmea_parser_handle_t nmea_hdl, int64_t from_ms, int64_t to_ms,
+                                 gps_fix_core_t *fixes, size_t max_fixes)
+{
+#if CONFIG_NMEA_PARSER_FIX_HISTORY
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    const nmea_fix_history_t *history = &esp_gps->history;
+    size_t n;
+    uint32_t seq;
+    do {
+        seq = nmea_fix_history_read_begin(history);
+        uint32_t count = history->count;
+        uint32_t num = MIN(count, NMEA_PARSER_FIX_HISTORY_SIZE);
+        /* First fix at or after from_ms */
+        uint32_t k = nmea_fix_history_find(history, count, from_ms - 1) + 1;
+        n = 0;
+        for (; k < num && n < max_fixes; k++) {
+            const nmea_history_entry_t *entry = nmea_fix_history_at(history, count, k);
+            if (entry->utc_ms > to_ms) {
+                break;
+            }
+            fixes[n++] = entry->fix;
+        }
+    } while (nmea_fix_history_read_retry(history, seq));
+    return n;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Get latency statistics of NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param latency latency statistics will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: Latency statistics are disabled
+ */
+esp_err_t nmea_parser_get_latency(nmea_parser_handle_t nmea_hdl, nmea_parser_latency_t *latency)
+{
+#if CONFIG_NMEA_PARSER_LATENCY_STATS
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    const nmea_hop_acc_t *acc[] = {&esp_gps->hop_decode, &esp_gps->hop_direct, &esp_gps->hop_event};
+    nmea_parser_hop_stats_t *out[] = {&latency->decode, &latency->direct, &latency->event};
+    for (int i = 0; i < 3; i++) {
+        out[i]->count = acc[i]->count;
+        out[i]->avg_us = acc[i]->count ? (uint32_t)(acc[i]->sum_us / acc[i]->count) : 0;
+        out[i]->max_us = acc[i]->max_us;
+    }
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Set execution time budget of event handlers
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param budget_us budget (us), handler calls taking longer are counted as overruns
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: Handler profiling is disabled
+ */
+esp_err_t nmea_parser_set_handler_budget(nmea_parser_handle_t nmea_hdl, uint32_t budget_us)
+{
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    esp_gps->handler_budget_us = budget_us;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Get execution time profile of an event handler
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param event_handler event handler added with nmea_parser_add_handler()
+ * @param profile profile will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: Handler was not registered
+ *  - ESP_ERR_NOT_SUPPORTED: Handler profiling is disabled
+ */
+esp_err_t nmea_parser_get_handler_profile(nmea_parser_handle_t nmea_hdl, esp_event_handler_t event_handler,
+                                          nmea_parser_handler_profile_t *profile)
+{
+#if CONFIG_NMEA_PARSER_HANDLER_PROFILING
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    for (int i = 0; i < NMEA_PARSER_HANDLER_NUM; i++) {
+        if (esp_gps->handler[i].handler == event_handler) {
+            nmea_handler_acc_get(&esp_gps->handler[i].acc, profile);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief Get statistics of NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param stats statistics will be saved in this pointer
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t nmea_parser_get_stats(nmea_parser_handle_t nmea_hdl, nmea_parser_stats_t *stats)
+{
+    esp_gps_t *esp_gps = (esp_gps_t *)nmea_hdl;
+    stats->overflow = esp_gps->overflow;
+    stats->pattern_lost = esp_gps->pattern_lost;
+    stats->lost_bytes = esp_gps->decoder.lost_bytes;
+    stats->crc_error = esp_gps->decoder.crc_error;
+    stats->unknown = esp_gps->decoder.unknown;
+#if CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+    stats->forwarded = esp_gps->forward.forwarded;
+    stats->forward_writes = esp_gps->forward.writes;
+    stats->forward_timed_flushes = esp_gps->forward.timed_flushes;
+#else
+    stats->forwarded = 0;
+    stats->forward_writes = 0;
+    stats->forward_timed_flushes = 0;
+#endif
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    stats->field_decoded = esp_gps->decoder.field_decoded;
+    stats->field_skipped = esp_gps->decoder.field_skipped;
+#else
+    stats->field_decoded = 0;
+    stats->field_skipped = 0;
+#endif
+    stats->ring_size = esp_gps->ring_size;
+    stats->ring_high_water = esp_gps->ring_high_water;
+    stats->event_blocked = esp_gps->event_blocked;
+    stats->event_dropped = esp_gps->event_dropped;
+    stats->event_evicted = esp_gps->event_evicted;
+    stats->event_coalesced = esp_gps->event_coalesced;
+#if CONFIG_NMEA_PARSER_PREDICTOR
+    const nmea_predictor_t *predictor = &esp_gps->predictor;
+    stats->predict_err_avg_cm = predictor->err_count ? (uint32_t)(predictor->err_sum_cm / predictor->err_count) : 0;
+    stats->predict_err_max_cm = predictor->err_max_cm;
+#else
+    stats->predict_err_avg_cm = 0;
+    stats->predict_err_max_cm = 0;
+#endif
+#if CONFIG_NMEA_PARSER_TRACK_SIMPLIFY
+    stats->track_fixes_in = esp_gps->track.fixes_in;
+    stats->track_points_out = esp_gps->track.points_out;
+    stats->track_err_max_cm = esp_gps->track.err_max_cm;
+#else
+    stats->track_fixes_in = 0;
+    stats->track_points_out = 0;
+    stats->track_err_max_cm = 0;
+#endif
+#if CONFIG_NMEA_PARSER_RATE_CONTROL
+    const nmea_rate_t *rate = &esp_gps->rate;
+    stats->rate_period_ms = rate->state < NMEA_RATE_STATE_MAX ? rate->config.period_ms[rate->state] : 0;
+    stats->rate_changes = rate->changes;
+#else
+    stats->rate_period_ms = 0;
+    stats->rate_changes = 0;
+#endif
+#if CONFIG_NMEA_PARSER_FUSION
+    const nmea_fusion_t *fusion = &esp_gps->fusion;
+    stats->lost_bytes += esp_gps->fusion_decoder.lost_bytes;
+    stats->crc_error += esp_gps->fusion_decoder.crc_error;
+    stats->unknown += esp_gps->fusion_decoder.unknown;
+    stats->fusion_selected = fusion->selected;
+    stats->fusion_weighted = fusion->weighted;
+    stats->fusion_failovers = fusion->failovers;
+    stats->fusion_timeouts = fusion->timeouts;
+    stats->fusion_late = fusion->late;
+#else
+    stats->fusion_selected = 0;
+    stats->fusion_weighted = 0;
+    stats->fusion_failovers = 0;
+    stats->fusion_timeouts = 0;
+    stats->fusion_late = 0;
+#endif
+#if CONFIG_NMEA_PARSER_FILTER
+    stats->filter_rejected = esp_gps->filter.rejected;
+    stats->filter_resets = esp_gps->filter.resets;
+#else
+    stats->filter_rejected = 0;
+    stats->filter_resets = 0;
+#endif
+    stats->task_stack_free = uxTaskGetStackHighWaterMark(esp_gps->tsk_hdl);
+#if CONFIG_NMEA_PARSER_PIPELINE
+    stats->pipeline_stall = esp_gps->pipeline_stall;
+    stats->ingest_task_stack_free = uxTaskGetStackHighWaterMark(esp_gps->ingest_tsk_hdl);
+#else
+    stats->pipeline_stall = 0;
+    stats->ingest_task_stack_free = 0;
+#endif
+    return ESP_OK;
 }
@@ -22,11 +22,10 @@ extern "C" {
 #include "esp_event.h"
 #include "esp_err.h"
 #include "driver/uart.h"
-
-#define __GNSS_COORDINATE_MODE (2) // 0: NAV_PVT OUTPUT  1: COORDINATE OUTPUT  2: GNSS DIRECT MODE
-
-#define GPS_MAX_SATELLITES_IN_USE (12)
-#define GPS_MAX_SATELLITES_IN_VIEW (16)
+#include "nmea_decoder.h"
+#include "nmea_forward.h"
+#include "nmea_geofence.h"
+#include "nmea_fix_log.h"
 
 /**
  * @brief Declare of NMEA Parser Event base
@@ -34,97 +33,6 @@ extern "C" {
  */
 ESP_EVENT_DECLARE_BASE(ESP_NMEA_EVENT);
 
-/**
- * @brief GPS fix type
- *
- */
-typedef enum {
-    GPS_FIX_INVALID, /*!< Not fixed */
-    GPS_FIX_GPS,     /*!< GPS */
-    GPS_FIX_DGPS,    /*!< Differential GPS */
-} gps_fix_t;
-
-/**
- * @brief GPS fix mode
- *
- */
-typedef enum {
-    GPS_MODE_INVALID = 1, /*!< Not fixed */
-    GPS_MODE_2D,          /*!< 2D GPS */
-    GPS_MODE_3D           /*!< 3D GPS */
-} gps_fix_mode_t;
-
-/**
- * @brief GPS satellite information
- *
- */
-typedef struct {
-    uint8_t num;       /*!< Satellite number */
-    uint8_t elevation; /*!< Satellite elevation */
-    uint16_t azimuth;  /*!< Satellite azimuth */
-    uint8_t snr;       /*!< Satellite signal noise ratio */
-} gps_satellite_t;
-
-/**
- * @brief GPS time
- *
- */
-typedef struct {
-    uint8_t hour;      /*!< Hour */
-    uint8_t minute;    /*!< Minute */
-    uint8_t second;    /*!< Second */
-    uint16_t thousand; /*!< Thousand */
-} gps_time_t;
-
-/**
- * @brief GPS date
- *
- */
-typedef struct {
-    uint8_t day;   /*!< Day (start from 1) */
-    uint8_t month; /*!< Month (start from 1) */
-    uint16_t year; /*!< Year (start from 2000) */
-} gps_date_t;
-
-/**
- * @brief NMEA Statement
- *
- */
-typedef enum {
-    STATEMENT_UNKNOWN = 0, /*!< Unknown statement */
-    STATEMENT_GGA,         /*!< GGA */
-    STATEMENT_GSA,         /*!< GSA */
-    STATEMENT_RMC,         /*!< RMC */
-    STATEMENT_GSV,         /*!< GSV */
-    STATEMENT_GLL,         /*!< GLL */
-    STATEMENT_VTG          /*!< VTG */
-} nmea_statement_t;
-
-/**
- * @brief GPS object
- *
- */
-typedef struct {
-    int32_t latitude;                                                /*!< Latitude (degrees) */
-    int32_t longitude;                                               /*!< Longitude (degrees) */
-    float altitude;                                                /*!< Altitude (meters) */
-    gps_fix_t fix;                                                 /*!< Fix status */
-    uint8_t sats_in_use;                                           /*!< Number of satellites in use */
-    gps_time_t tim;                                                /*!< time in UTC */
-    gps_fix_mode_t fix_mode;                                       /*!< Fix mode */
-    uint8_t sats_id_in_use[GPS_MAX_SATELLITES_IN_USE];             /*!< ID list of satellite in use */
-    float dop_h;                                                   /*!< Horizontal dilution of precision */
-    float dop_p;                                                   /*!< Position dilution of precision  */
-    float dop_v;                                                   /*!< Vertical dilution of precision  */
-    uint8_t sats_in_view;                                          /*!< Number of satellites in view */
-    gps_satellite_t sats_desc_in_view[GPS_MAX_SATELLITES_IN_VIEW]; /*!< Information of satellites in view */
-    gps_date_t date;                                               /*!< Fix date */
-    bool valid;                                                    /*!< GPS validity */
-    float speed;                                                   /*!< Ground speed, unit: m/s */
-    float cog;                                                     /*!< Course over ground */
-    float variation;                                               /*!< Magnetic variation */
-} gps_t;
-
 /**
  * @brief Configuration of NMEA Parser
  *
@@ -147,55 +55,6 @@ typedef struct {
  */
 typedef void *nmea_parser_handle_t;
 
-//TODO NAV-PVT type
-typedef enum {
-    NAV_PVT_MODE_INVALID,       /*!< Not fixed */
-    NAV_PVT_MODE_DEAD,          /*!< Dead-reckoning */
-    NAV_PVT_MODE_2D,            /*!< 2D GPS */
-    NAV_PVT_MODE_3D,            /*!< 3D GPS */
-    NAV_PVT_MODE_COMBINED,      /*!< GNSS + dead-reckoning */
-    NAV_PVT_MODE_TIMEONLY       /*!< Time only fixed */
-} nav_pvt_fix_mode_t;
-
-typedef struct {
-    uint16_t header;		        // Packet header
-    uint8_t class;			        // Class
-    uint8_t id;			        	// Id
-    uint16_t length;                // payload length
-    uint32_t iTOW;                  // Time of week (sec)
-    gps_date_t date;                // Date from GPS (UTC+0)
-    gps_time_t time;                // Time from GPS (UTC+0)
-    uint8_t valid;                  // Validity flags
-    uint32_t tAcc;                  // Time accuracy estimate (UTC+0) !not used!
-    uint32_t nano;                  // Fraction of second (UTC+0) !not used!
-    uint8_t fixType;                // 0: nofix  1: Dead-reckoning  2: 2D-fix  3: 3D-fix  4: GNSS + Dead-reckoning  5: time only fix
-    uint8_t flags;                  // Fix status flags
-    uint8_t flags2;                 // Additional flags
-    uint8_t numSV;                  // Number of satellites used in Nav Solution
-    int32_t lon;                    // Longitude
-    int32_t lat;                    // Latitude
-    int32_t height;                 // Height above ellipsoid
-    int32_t hMSL;                   // Height above mean sea level
-    uint32_t hAcc;                  // Horizontal accuracy estimate
-    uint32_t vAcc;                  // Vertical accuracy estimate
-    int32_t velN;                   // NED north velocity
-    int32_t velE;                   // NED east velocity
-    int32_t velD;                   // NED down velocity
-    int32_t gSpeed;                 // Ground Speed (2-D)
-    int32_t headMot;                // Heading of motion (2-D)
-    uint32_t sAcc;                  // Speed accuracy estimate
-    uint32_t headAcc;               // Heading accuracy estimate
-    uint16_t pDOP;                  // Position DOP
-    uint16_t flags3;                // Additional flags
-    uint8_t reserved1[4];           // Reserved
-    int32_t headVeh;                // Heading of vehicle (2-D)
-    int16_t magDec;                 // Magnetic declination
-    uint16_t magAcc;                // Magnetic declination accuracy
-    uint16_t checksum;             // Checksum A CK_A = CK_A + Buffer[I]
-} nav_pvt_t;
-
-
-
 /**
  * @brief Default configuration for NMEA Parser
  *
@@ -218,10 +77,107 @@ typedef struct {
  *
  */
 typedef enum {
-    GPS_UPDATE, /*!< GPS information has been updated */
-    GPS_UNKNOWN /*!< Unknown statements detected */
+    GPS_UPDATE,  /*!< GPS information has been updated (only if CONFIG_NMEA_PARSER_POST_GPS_UPDATE is enabled) */
+    GPS_UNKNOWN, /*!< Unknown statements detected (only if CONFIG_NMEA_PARSER_POST_UNKNOWN is enabled) */
+    GPS_FIX,     /*!< New fix, event data is gps_fix_core_t (only if CONFIG_NMEA_PARSER_POST_FIX_CORE is enabled) */
+    GPS_FIX_PREDICTED, /*!< Last fix extrapolated to the time of the event, event data is gps_fix_core_t
+                            (only if CONFIG_NMEA_PARSER_PREDICTOR is enabled) */
+    GPS_TRACK_POINT,   /*!< Point of the simplified track, event data is gps_fix_core_t
+                            (only if CONFIG_NMEA_PARSER_TRACK_SIMPLIFY is enabled) */
+    GPS_GEOFENCE_ENTER, /*!< A geofence was entered, event data is nmea_geofence_event_t
+                             (only if CONFIG_NMEA_PARSER_GEOFENCE is enabled) */
+    GPS_GEOFENCE_EXIT,  /*!< A geofence was exited, event data is nmea_geofence_event_t
+                             (only if CONFIG_NMEA_PARSER_GEOFENCE is enabled) */
 } nmea_event_id_t;
 
+/**
+ * @brief Direct handler, invoked synchronously from the NMEA Parser task
+ *
+ * @note The event data is not copied: it points into the parser runtime and is only valid
+ *       until the handler returns. Keep direct handlers short, they delay decoding of the next statement.
+ *
+ * @param handler_args handler specific arguments
+ * @param event_id event id
+ * @param event_data event specific data (same payload as the ESP_NMEA_EVENT event)
+ * @param event_data_size size of event data in bytes
+ */
+typedef void (*nmea_parser_direct_handler_t)(void *handler_args, nmea_event_id_t event_id,
+                                             const void *event_data, size_t event_data_size);
+
+
+/**
+ * @brief Latency statistics of one hop in the NMEA Parser pipeline
+ *
+ */
+typedef struct {
+    uint32_t count;  /*!< Number of samples */
+    uint32_t avg_us; /*!< Average latency (us) */
+    uint32_t max_us; /*!< Maximum latency (us) */
+} nmea_parser_hop_stats_t;
+
+/**
+ * @brief Latency statistics of NMEA Parser
+ *
+ */
+typedef struct {
+    nmea_parser_hop_stats_t decode; /*!< UART line received -> epoch decoded */
+    nmea_parser_hop_stats_t direct; /*!< Epoch decoded -> all direct handlers returned */
+    nmea_parser_hop_stats_t event;  /*!< Epoch decoded -> event loop dispatched to esp_event handlers */
+} nmea_parser_latency_t;
+
+/**
+ * @brief Execution time profile of an event handler
+ *
+ */
+typedef struct {
+    uint32_t count;   /*!< Number of calls */
+    uint32_t min_us;  /*!< Minimum execution time (us) */
+    uint32_t avg_us;  /*!< Average execution time (us) */
+    uint32_t p99_us;  /*!< 99th percentile of execution time, upper bound of a power of two bucket (us) */
+    uint32_t max_us;  /*!< Maximum execution time (us) */
+    uint32_t overrun; /*!< Number of calls exceeding the budget */
+} nmea_parser_handler_profile_t;
+
+/**
+ * @brief Statistics of NMEA Parser
+ *
+ */
+typedef struct {
+    uint32_t overflow;        /*!< Number of UART FIFO overflow / ring buffer full events */
+    uint32_t pattern_lost;    /*!< Number of line end positions dropped by the UART driver */
+    uint32_t lost_bytes;      /*!< Bytes dropped while resynchronizing (damaged statements and garbage) */
+    uint32_t crc_error;       /*!< Number of statements rejected by checksum */
+    uint32_t unknown;         /*!< Number of statements without built-in or user parser */
+    uint32_t forwarded;       /*!< Sentences passed to forward sinks, counted once per sink */
+    uint32_t forward_writes;  /*!< Writes to forward sink outputs */
+    uint32_t forward_timed_flushes; /*!< Batches written by NMEA Parser Forward Flush Timeout, no epoch ended */
+    uint32_t field_decoded;   /*!< Number of items converted (redundant field skipping only) */
+    uint32_t field_skipped;   /*!< Number of items skipped as already filled in the epoch (redundant field skipping only) */
+    uint32_t ring_size;       /*!< Size of UART Rx ring buffer */
+    uint32_t ring_high_water; /*!< Maximum number of bytes observed in UART Rx ring buffer after reading a line */
+    uint32_t pipeline_stall;  /*!< Times ingestion task waited for decode task (pipelined mode only) */
+    uint32_t event_blocked;   /*!< Posts which waited for the consumer (block policy) */
+    uint32_t event_dropped;   /*!< Events dropped as the event loop queue was full */
+    uint32_t event_evicted;   /*!< Queued events evicted to make room for a newer one (drop oldest, coalesce policies) */
+    uint32_t event_coalesced; /*!< Queued events superseded by a newer event of the same id (coalesce policy) */
+    uint32_t predict_err_avg_cm; /*!< Average distance between a prediction and the next fix (cm, predictor only) */
+    uint32_t predict_err_max_cm; /*!< Maximum distance between a prediction and the next fix (cm, predictor only) */
+    uint32_t track_fixes_in;     /*!< Valid fixes fed to the track simplification */
+    uint32_t track_points_out;   /*!< Track points published (GPS_TRACK_POINT) */
+    uint32_t track_err_max_cm;   /*!< Maximum distance between a dropped fix and the simplified track (cm) */
+    uint32_t rate_period_ms;     /*!< Fix period last commanded to the receiver (ms, adaptive fix rate only) */
+    uint32_t rate_changes;       /*!< Fix period changes commanded to the receiver (adaptive fix rate only) */
+    uint32_t fusion_selected;    /*!< Receiver currently selected, 0 primary, 1 secondary (fusion only) */
+    uint32_t fusion_weighted;    /*!< Epochs published as an average of both receivers (fusion only) */
+    uint32_t fusion_failovers;   /*!< Switches of the selected receiver (fusion only) */
+    uint32_t fusion_timeouts;    /*!< Epochs published after waiting for the other receiver in vain (fusion only) */
+    uint32_t fusion_late;        /*!< Epochs dropped as the other receiver already delivered their time (fusion only) */
+    uint32_t filter_rejected;    /*!< Positions rejected as outliers and replaced by the prediction (filter only) */
+    uint32_t filter_resets;      /*!< Filter restarts after a gap or a run of outliers (filter only) */
+    uint32_t task_stack_free; /*!< Minimum free stack of NMEA Parser task since start (bytes) */
+    uint32_t ingest_task_stack_free; /*!< Minimum free stack of ingestion task since start (bytes, pipelined mode only) */
+} nmea_parser_stats_t;
+
 /**
  * @brief Init NMEA Parser
  *
@@ -241,29 +197,256 @@ esp_err_t nmea_parser_deinit(nmea_parser_handle_t nmea_hdl);
 /**
  * @brief Add user defined handler for NMEA parser
  *
+ * At most CONFIG_NMEA_PARSER_HANDLER_NUM (default 4) handlers can be added.
+ *
  * @param nmea_hdl handle of NMEA parser
  * @param event_handler user defined event handler
  * @param handler_args handler specific arguments
  * @return esp_err_t
  *  - ESP_OK: Success
- *  - ESP_ERR_NO_MEM: Cannot allocate memory for the handler
- *  - ESP_ERR_INVALIG_ARG: Invalid combination of event base and event id
- *  - Others: Fail
+ *  - ESP_ERR_NO_MEM: All CONFIG_NMEA_PARSER_HANDLER_NUM handler slots are in use
+ *  - ESP_ERR_INVALID_ARG: Invalid handler
  */
 esp_err_t nmea_parser_add_handler(nmea_parser_handle_t nmea_hdl, esp_event_handler_t event_handler, void *handler_args);
 
 /**
  * @brief Remove user defined handler for NMEA parser
  *
+ * Waits for a call of the handler in progress, after which its arguments can be freed. Called from the
+ * handler itself, it returns at once and the current call runs to its end.
+ *
  * @param nmea_hdl handle of NMEA parser
  * @param event_handler user defined event handler
  * @return esp_err_t
  *  - ESP_OK: Success
- *  - ESP_ERR_INVALIG_ARG: Invalid combination of event base and event id
- *  - Others: Fail
+ *  - ESP_ERR_NOT_FOUND: Handler was not registered
  */
 esp_err_t nmea_parser_remove_handler(nmea_parser_handle_t nmea_hdl, esp_event_handler_t event_handler);
 
+/**
+ * @brief Add direct handler for NMEA parser
+ *
+ * Direct handlers are called inline from the decoder, before the event is posted to the event loop,
+ * without copying or queueing the payload. Handlers added by nmea_parser_add_handler are still served.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param direct_handler user defined direct handler
+ * @param handler_args handler specific arguments
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid handler
+ *  - ESP_ERR_NO_MEM: All CONFIG_NMEA_PARSER_DIRECT_HANDLER_NUM slots are in use
+ */
+esp_err_t nmea_parser_add_direct_handler(nmea_parser_handle_t nmea_hdl, nmea_parser_direct_handler_t direct_handler,
+                                         void *handler_args);
+
+/**
+ * @brief Remove direct handler for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param direct_handler user defined direct handler
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: Handler was not registered
+ */
+esp_err_t nmea_parser_remove_direct_handler(nmea_parser_handle_t nmea_hdl, nmea_parser_direct_handler_t direct_handler);
+
+/**
+ * @brief Add user defined statement parser for NMEA parser
+ *
+ * Use it to parse proprietary or unsupported statements (e.g. PMTK, PUBX, GPTXT) item by item,
+ * instead of re-parsing a copy of the statement in a GPS_UNKNOWN handler.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param parser user defined statement parser, copied into NMEA parser
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid parser
+ *  - ESP_ERR_NO_MEM: All CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM slots are in use
+ */
+esp_err_t nmea_parser_add_statement_parser(nmea_parser_handle_t nmea_hdl, const nmea_parser_statement_parser_t *parser);
+
+/**
+ * @brief Remove user defined statement parser for NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param name statement name the parser was added with
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: No parser was added for this name
+ */
+esp_err_t nmea_parser_remove_statement_parser(nmea_parser_handle_t nmea_hdl, const char *name);
+
+/**
+ * @brief Add forward sink for NMEA parser
+ *
+ * Received sentences matching the filter of the sink are passed to its output as they were received (no
+ * formatting, no event), before they are decoded.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param config sink configuration, copied into NMEA parser
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid output or filter
+ *  - ESP_ERR_NO_MEM: All CONFIG_NMEA_PARSER_FORWARD_SINK_NUM slots are in use
+ */
+esp_err_t nmea_parser_add_forward_sink(nmea_parser_handle_t nmea_hdl, const nmea_forward_config_t *config);
+
+/**
+ * @brief Remove forward sink for NMEA parser
+ *
+ * Sentences batched and not written yet are dropped.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param write output the sink was added with
+ * @param arg argument of output the sink was added with
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: Sink was not added
+ */
+esp_err_t nmea_parser_remove_forward_sink(nmea_parser_handle_t nmea_hdl, nmea_forward_write_t write, void *arg);
+
+/**
+ * @brief Set authoritative statement of a field group
+ *
+ * Within an epoch (same UTC time), a field group is converted by the first statement carrying it and by its
+ * authoritative statement only, other statements skip it.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param group field group
+ * @param statement statement always decoding this field group
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: Invalid field group or statement
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS is disabled
+ */
+esp_err_t nmea_parser_set_field_authority(nmea_parser_handle_t nmea_hdl, nmea_field_group_t group,
+                                          nmea_statement_t statement);
+
+/**
+ * @brief Set execution time budget of event handlers
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param budget_us budget (us), handler calls taking longer are counted as overruns
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_HANDLER_PROFILING is disabled
+ */
+esp_err_t nmea_parser_set_handler_budget(nmea_parser_handle_t nmea_hdl, uint32_t budget_us);
+
+/**
+ * @brief Get execution time profile of an event handler
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param event_handler event handler added with nmea_parser_add_handler()
+ * @param profile profile will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: Handler was not registered
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_HANDLER_PROFILING is disabled
+ */
+esp_err_t nmea_parser_get_handler_profile(nmea_parser_handle_t nmea_hdl, esp_event_handler_t event_handler,
+                                          nmea_parser_handler_profile_t *profile);
+
+/**
+ * @brief Evaluate a set of geofences on each valid fix of NMEA parser
+ *
+ * Fences entered and exited are posted as GPS_GEOFENCE_ENTER and GPS_GEOFENCE_EXIT events
+ * (nmea_geofence_event_t). The set must be built and must not be deleted while attached.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param geofence handle of a built set, NULL to detach
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_GEOFENCE is disabled
+ */
+esp_err_t nmea_parser_set_geofence(nmea_parser_handle_t nmea_hdl, nmea_geofence_handle_t geofence);
+
+/**
+ * @brief Append each valid fix of NMEA parser to a fix log
+ *
+ * The log must not be closed while attached. Other tasks may read it with nmea_fix_log_read().
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param log handle of an open fix log, NULL to detach
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_FIX_LOG is disabled
+ */
+esp_err_t nmea_parser_set_fix_log(nmea_parser_handle_t nmea_hdl, nmea_fix_log_handle_t log);
+
+/**
+ * @brief Get time of a compact fix
+ *
+ * @param fix compact fix
+ * @return int64_t time of fix (ms since 2000-01-01 UTC), -1 if the date is invalid
+ */
+int64_t nmea_parser_fix_utc_ms(const gps_fix_core_t *fix);
+
+/**
+ * @brief Get the last fix at or before a time from the fix history
+ *
+ * @note The fix history functions may be called from any task, concurrently with the parser task.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param utc_ms time (ms since 2000-01-01 UTC, see nmea_parser_fix_utc_ms())
+ * @param fix fix will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: utc_ms is before the oldest fix of the history
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_FIX_HISTORY is disabled
+ */
+esp_err_t nmea_parser_history_get(nmea_parser_handle_t nmea_hdl, int64_t utc_ms, gps_fix_core_t *fix);
+
+/**
+ * @brief Interpolate position, speed and course at a time from the fix history
+ *
+ * Position, altitude and speed are interpolated linearly between the two surrounding fixes, course on the
+ * shortest arc. Other fields are those of the fix before utc_ms.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param utc_ms time (ms since 2000-01-01 UTC, see nmea_parser_fix_utc_ms())
+ * @param fix interpolated fix will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: utc_ms is outside of the time range of the history
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_FIX_HISTORY is disabled
+ */
+esp_err_t nmea_parser_history_interpolate(nmea_parser_handle_t nmea_hdl, int64_t utc_ms, gps_fix_core_t *fix);
+
+/**
+ * @brief Copy the fixes of a time range from the fix history
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param from_ms start of range, included (ms since 2000-01-01 UTC)
+ * @param to_ms end of range, included (ms since 2000-01-01 UTC)
+ * @param fixes fixes will be saved in this array, oldest first
+ * @param max_fixes size of fixes array
+ * @return size_t number of fixes saved, 0 if CONFIG_NMEA_PARSER_FIX_HISTORY is disabled
+ */
+size_t nmea_parser_history_range(nmea_parser_handle_t nmea_hdl, int64_t from_ms, int64_t to_ms,
+                                 gps_fix_core_t *fixes, size_t max_fixes);
+
+/**
+ * @brief Get latency statistics of NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param latency latency statistics will be saved in this pointer
+ * @return esp_err_t
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_SUPPORTED: CONFIG_NMEA_PARSER_LATENCY_STATS is disabled
+ */
+esp_err_t nmea_parser_get_latency(nmea_parser_handle_t nmea_hdl, nmea_parser_latency_t *latency);
+
+/**
+ * @brief Get statistics of NMEA parser
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param stats statistics will be saved in this pointer
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t nmea_parser_get_stats(nmea_parser_handle_t nmea_hdl, nmea_parser_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
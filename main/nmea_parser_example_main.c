@@ -8,107 +8,190 @@
 */
 
 #include <stdio.h>
-#include <stdlib.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#if CONFIG_NMEA_OUTPUT_COMMANDS
+#include "esp_vfs_dev.h"
+#endif
 #include "nmea_parser.h"
-#include "time.h"
-#include "math.h"
+#include "nmea_ubx.h"
 
 static const char *TAG = "gps_demo";
 
 #define TIME_ZONE (+9)   //Seoul Time
 #define YEAR_BASE (2000) //date in GPS starts from 2000
-#define SECS_PER_DAY (60L*60*24)
-#define SECS_PER_WEEK (SECS_PER_DAY*7)
-#define LEAF_SECOND (18)
-#define MAX_SECS_OF_WEEK (604799) // 0 ~ 604799, 604800 = 0
-
-#define _UbxHeader_1    0xB5
-#define _UbxHeader_2    0x62
 
 uint8_t BAUDRATE_CONFIG[] = "\r\n$PMTK251,115200*1F\r\n";
 uint8_t FIX_PERIOD_CONFIG[] = "\r\n$PMTK220,100*2F\r\n";
 
 /**
- * @brief Change to Little endian type
+ * @brief Outputs of the example, any combination of them can be enabled at runtime
+ *
+ */
+typedef enum {
+    GPS_OUTPUT_UBX,         /*!< UBX NAV-PVT, NAV-DOP, NAV-SAT and NAV-TIMEUTC of each epoch, as hex on the console */
+    GPS_OUTPUT_COORDINATES, /*!< Time, position, altitude and speed of each epoch, logged */
+    GPS_OUTPUT_RAW,         /*!< Received sentences passed through to the console */
+    GPS_OUTPUT_MAX,
+} gps_output_t;
+
+static const char *const gps_output_names[GPS_OUTPUT_MAX] = {"ubx", "coord", "raw"};
+static bool gps_output_enabled[GPS_OUTPUT_MAX];
+
+/**
+ * @brief UBX output, encodes the frames of each epoch and prints them in one write
  *
- * @param raw_data the data which will be little endian type
- * @param changed_data the little endian type data will be saved in this pointer
- * @param array_size the size of raw_data(==changed_data), (n Byte)
- * @param array_address_buffer this agur will be increased by array_size and returned
+ * @param handler_args handler specific arguments
+ * @param event_id event id
+ * @param event_data decoded epoch for GPS_UPDATE
+ * @param event_data_size size of event data in bytes
  */
-void make_little_endian(int32_t *raw_data, uint8_t *changed_data, uint8_t array_size, uint32_t *array_address_buffer)
+static void gps_ubx_output(void *handler_args, nmea_event_id_t event_id, const void *event_data,
+                           size_t event_data_size)
 {
-    for(int count = (array_size - 1); count >= 0; count--)
-	{
-		*(changed_data + count) = ((*raw_data) >> (8 * count)) & 0xFF;
-	}
-    *array_address_buffer += array_size;
+    /* Only called from the parser task, static to keep the buffers off its stack */
+    static uint8_t frames[NMEA_UBX_EPOCH_MAX_SIZE];
+    static char hex[NMEA_UBX_EPOCH_MAX_SIZE * 3 + 2];
+    if (event_id != GPS_UPDATE) {
+        return;
+    }
+    size_t len = nmea_ubx_encode_epoch((const gps_t *)event_data, frames, sizeof(frames));
+    for (size_t i = 0; i < len; i++) {
+        hex[i * 3] = "0123456789abcdef"[frames[i] >> 4];
+        hex[i * 3 + 1] = "0123456789abcdef"[frames[i] & 0x0F];
+        hex[i * 3 + 2] = ' ';
+    }
+    hex[len * 3] = '\r';
+    hex[len * 3 + 1] = '\n';
+    fwrite(hex, 1, len * 3 + 2, stdout);
 }
 
 /**
- * @brief Make checksum for UBX protocol
+ * @brief Coordinates output, logs time, position, altitude and speed of each epoch
  *
- * @param pucBuf the data which will be little endian type
-  */
-uint16_t usUbxCalcCheckSum(uint8_t *pucBuf)
+ * @param handler_args handler specific arguments
+ * @param event_id event id
+ * @param event_data decoded epoch for GPS_UPDATE
+ * @param event_data_size size of event data in bytes
+ */
+static void gps_coordinate_output(void *handler_args, nmea_event_id_t event_id, const void *event_data,
+                                  size_t event_data_size)
 {
-    uint8_t ucChk1 = 0;
-    uint8_t ucChk2 = 0;
-    uint16_t usCnt = 0;
-    uint16_t usLength = 0;
+    if (event_id != GPS_UPDATE) {
+        return;
+    }
+    const gps_t *gps = (const gps_t *)event_data;
+    ESP_LOGI(TAG, "%d/%d/%d %d:%d:%d => "
+             "\t\tlatitude   = %.05f°N"
+             "\t\tlongitude = %.05f°E"
+             "\t\taltitude   = %.02fm"
+             "\t\tspeed      = %fm/s\r\n",
+             gps->date.year + YEAR_BASE, gps->date.month, gps->date.day,
+             gps->tim.hour + TIME_ZONE, gps->tim.minute, gps->tim.second,
+             gps->latitude * 1e-7, gps->longitude * 1e-7, gps->altitude, gps->speed);
+}
 
-    if((pucBuf[0] != _UbxHeader_1) || (pucBuf[1] != _UbxHeader_2))
-    {
-        printf("Chksum: Header mismatch\n\r");
-        return 0;
+/**
+ * @brief Enable or disable an output
+ *
+ * UBX and coordinates are direct handlers of the GPS_UPDATE epoch, raw is a forward sink, so all
+ * enabled outputs share the epoch decoded once by the parser task. A disabled output is not registered
+ * and costs nothing. A failure is logged and leaves the output in its previous state.
+ *
+ * @param nmea_hdl handle of NMEA parser
+ * @param output output to switch
+ * @param enable true to enable, false to disable
+ * @return esp_err_t ESP_OK on success (also if the output already was in this state), else the error of
+ *         the parser (e.g. ESP_ERR_NO_MEM if no direct handler or forward sink slot is free)
+ */
+static esp_err_t gps_output_enable(nmea_parser_handle_t nmea_hdl, gps_output_t output, bool enable)
+{
+    esp_err_t err = ESP_OK;
+    if (gps_output_enabled[output] == enable) {
+        return ESP_OK;
     }
-    usLength = pucBuf[5];
-    usLength <<= 8;
-    usLength |= pucBuf[4];
-    usLength += 4;
-    if(usLength==0 || usLength > 1000)
-        return 0;
-    for(usCnt = 0; usCnt < usLength; usCnt++)
-    {
-        ucChk1 = ucChk1 + pucBuf[usCnt + 2];
-        ucChk2 = ucChk1 + ucChk2;
+    switch (output) {
+    case GPS_OUTPUT_UBX:
+        err = enable ? nmea_parser_add_direct_handler(nmea_hdl, gps_ubx_output, NULL) :
+              nmea_parser_remove_direct_handler(nmea_hdl, gps_ubx_output);
+        break;
+    case GPS_OUTPUT_COORDINATES:
+        err = enable ? nmea_parser_add_direct_handler(nmea_hdl, gps_coordinate_output, NULL) :
+              nmea_parser_remove_direct_handler(nmea_hdl, gps_coordinate_output);
+        break;
+    case GPS_OUTPUT_RAW:
+        if (enable) {
+            /* filtered sentences, written once per epoch */
+            nmea_forward_config_t console_sink = {
+                .write = nmea_forward_console_write,
+                .sentences = CONFIG_NMEA_OUTPUT_RAW_SENTENCES[0] ? CONFIG_NMEA_OUTPUT_RAW_SENTENCES : NULL,
+                .batch = true,
+            };
+            err = nmea_parser_add_forward_sink(nmea_hdl, &console_sink);
+        } else {
+            err = nmea_parser_remove_forward_sink(nmea_hdl, nmea_forward_console_write, NULL);
+        }
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
     }
-    usLength = ucChk1;
-    usLength <<= 8;
-    usLength |= ucChk2;
-    return usLength;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s output %s failed: %s", enable ? "enable" : "disable", gps_output_names[output],
+                 esp_err_to_name(err));
+        return err;
+    }
+    gps_output_enabled[output] = enable;
+    return ESP_OK;
 }
 
-// for get "Week-number"
-time_t time_frem_YMD(int year, int month, int day) {
-    struct tm tm = {0};
-
-    tm.tm_year = year - 1900;
-    tm.tm_mon = month - 1;
-    tm.tm_mday = day;
-
-    return mktime(&tm);
-}
-// for get "Week-number"
-int get_gps_week_number(int year, int month, int day) {
-	double diff = difftime(time_frem_YMD(year, month, day), time_frem_YMD(1980, 1, 6));
-	return (int) (diff / SECS_PER_WEEK);
+#if CONFIG_NMEA_OUTPUT_COMMANDS
+/**
+ * @brief Console command task, switches outputs with lines like "ubx on" or "raw off"
+ *
+ * @param arg handle of NMEA parser
+ */
+static void gps_output_command_task(void *arg)
+{
+    nmea_parser_handle_t nmea_hdl = (nmea_parser_handle_t)arg;
+    char line[32];
+    char name[16];
+    char state[8];
+    while (fgets(line, sizeof(line), stdin)) {
+        if (sscanf(line, "%15s %7s", name, state) != 2) {
+            continue;
+        }
+        int i = 0;
+        while (i < GPS_OUTPUT_MAX && strcmp(name, gps_output_names[i])) {
+            i++;
+        }
+        if (i == GPS_OUTPUT_MAX || (strcmp(state, "on") && strcmp(state, "off"))) {
+            ESP_LOGW(TAG, "usage: ubx|coord|raw on|off");
+            continue;
+        }
+        if (gps_output_enable(nmea_hdl, i, !strcmp(state, "on")) == ESP_OK) {
+            ESP_LOGI(TAG, "output %s %s", name, state);
+        }
+    }
+    vTaskDelete(NULL);
 }
+#endif
 
-int get_gps_iTOW(int year, int month, int day, int hour, int min, int sec, int thousand) {
-	double diff = difftime(time_frem_YMD(year, month, day), time_frem_YMD(1980, 1, 6));
-	uint32_t buffer =  (int) (fmod(diff, SECS_PER_WEEK) + (hour * 3600) + (min * 60) + sec + LEAF_SECOND);
-	if(buffer > MAX_SECS_OF_WEEK)
-	{
-		buffer -= (MAX_SECS_OF_WEEK + 1);
-	}
-	return (uint32_t) (buffer * 1000) + thousand;
+/**
+ * @brief TXT statement parser, e.g. $GPTXT,01,01,01,ANTENNA OK*35
+ *
+ * @param parser_args parser specific arguments
+ * @param item_num item number in the statement
+ * @param item item string
+ */
+static void gps_txt_parse_item(void *parser_args, uint8_t item_num, const char *item)
+{
+    if (item_num == 4) { /* Text message */
+        ESP_LOGI(TAG, "Receiver text: %s", item);
+    }
 }
 
-
 /**
  * @brief GPS Event Handler
  *
@@ -119,175 +202,13 @@ int get_gps_iTOW(int year, int month, int day, int hour, int min, int sec, int t
  */
 static void gps_event_handler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
-    gps_t *gps = NULL;
-    nav_pvt_t *nav_pvt_struct = malloc(sizeof(nav_pvt_t));
-
-    uint8_t nav_pvt_array[sizeof(nav_pvt_t)] = {0, };
-    uint32_t data_length_buffer = 0;
+    gps_fix_core_t *fix = NULL;
 
     switch (event_id) {
-    case GPS_UPDATE:
-        gps = (gps_t *)event_data;
-
-#if (__GNSS_COORDINATE_MODE == 1)
-        /* print information parsed from GPS statements */
-        ESP_LOGI(TAG, "%d/%d/%d %d:%d:%d => "
-                 "\t\tlatitude   = %.05f°N"
-                 "\t\tlongitude = %.05f°E"
-                 "\t\taltitude   = %.02fm"
-                 "\t\tspeed      = %fm/s\r\n",
-                 gps->date.year + YEAR_BASE, gps->date.month, gps->date.day,
-                 gps->tim.hour + TIME_ZONE, gps->tim.minute, gps->tim.second,
-                 gps->latitude, gps->longitude, gps->altitude, gps->speed);
-
-#elif (__GNSS_COORDINATE_MODE == 0)
-        //TODO Need to check the variables with 0 are not used in 3SECONDZ service
-
-        nav_pvt_struct->header = 0xB562;
-        nav_pvt_struct->class = 0x01;
-        nav_pvt_struct->id = 0x07;
-
-        // packet header initialize
-        nav_pvt_array[0] = (nav_pvt_struct->header >> 8) & 0xFF;
-        nav_pvt_array[1] = nav_pvt_struct->header & 0xFF;
-        nav_pvt_array[2] = nav_pvt_struct->class;
-        nav_pvt_array[3] = nav_pvt_struct->id;
-        nav_pvt_array[4] = 0x5C; // nav_pvt payload length
-        nav_pvt_array[5] = 0x00;
-        data_length_buffer = sizeof(nav_pvt_struct->header) + sizeof(nav_pvt_struct->class) + sizeof(nav_pvt_struct->id) + 2;
-
-        nav_pvt_struct->iTOW = get_gps_iTOW(gps->date.year + YEAR_BASE, gps->date.month, gps->date.day, gps->tim.hour, gps->tim.minute, gps->tim.second, gps->tim.thousand);
-        nav_pvt_struct->date.year = gps->date.year + YEAR_BASE;
-        nav_pvt_struct->date.month = gps->date.month;
-        nav_pvt_struct->date.day = gps->date.day;
-        nav_pvt_struct->time.hour = gps->tim.hour;
-        nav_pvt_struct->time.minute = gps->tim.minute;
-        nav_pvt_struct->time.second = gps->tim.second;
-        nav_pvt_struct->time.thousand = gps->tim.thousand;
-
-        nav_pvt_struct->valid = 0;
-
-        nav_pvt_struct->tAcc = 0;
-        nav_pvt_struct->nano = 0;
-
-        switch(gps->fix_mode) {
-            case GPS_MODE_2D:
-                nav_pvt_struct->fixType = NAV_PVT_MODE_2D;
-                break;
-            case GPS_MODE_3D:
-                nav_pvt_struct->fixType = NAV_PVT_MODE_3D;
-                break;
-            case GPS_MODE_INVALID:
-                nav_pvt_struct->fixType = NAV_PVT_MODE_INVALID;
-                break;
-            default:
-                nav_pvt_struct->fixType = 0;
-                break;
-        }
-
-        nav_pvt_struct->flags = 0;
-        nav_pvt_struct->flags2 = 0;
-
-        nav_pvt_struct->numSV = gps->sats_in_use;
-
-        nav_pvt_struct->lon = gps->longitude;
-        nav_pvt_struct->lat = gps->latitude;
-        nav_pvt_struct->height = (int32_t) ((double_t) gps->altitude * (double_t) 1000); // nav_pvt - mm, gps - m //FIXME When move value to nav_pvt type, the value can be changed, need to fix
-
-        nav_pvt_struct->hMSL = 0; //FIXME use Geoidal field
-        nav_pvt_struct->hAcc = 0;
-        nav_pvt_struct->vAcc = 0;
-        nav_pvt_struct->velN = 0;
-        nav_pvt_struct->velE = 0;
-        nav_pvt_struct->velD = 0;
-
-        nav_pvt_struct->gSpeed = (int32_t) ((double_t) gps->speed * (double_t) 1000); //FIXME When move value to nav_pvt type, the value can be changed, need to fix
-
-        nav_pvt_struct->headMot = 0; //FIXME use Course over ground in degrees
-
-        nav_pvt_struct->sAcc = 0;
-        nav_pvt_struct->headAcc = 0;
-        nav_pvt_struct->pDOP = 0;
-        nav_pvt_struct->flags3 = 0;
-
-        for(uint8_t reserved_num = 0; reserved_num < 4; reserved_num++)
-        {
-            nav_pvt_struct->reserved1[reserved_num] = 0;
-        }
-
-        nav_pvt_struct->headVeh = 0;
-        nav_pvt_struct->magDec = 0;
-        nav_pvt_struct->magAcc = 0;
-
-
-
-        make_little_endian((int32_t) &(nav_pvt_struct->iTOW), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->iTOW), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->date.year), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->date.year), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->date.month), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->date.month), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->date.day), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->date.day), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->time.hour), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->time.hour), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->time.minute), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->time.minute), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->time.second), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->time.second), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->valid), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->valid), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->tAcc), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->tAcc), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->nano), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->nano), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->fixType), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->fixType), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->flags), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->flags), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->flags2), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->flags2), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->numSV), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->numSV), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->lon), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->lon), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->lat), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->lat), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->height), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->height), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->hMSL), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->hMSL), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->hAcc), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->hAcc), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->vAcc), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->vAcc), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->velN), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->velN), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->velE), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->velE), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->velD), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->velD), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->gSpeed), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->gSpeed), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->headMot), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->headMot), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->sAcc), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->sAcc), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->headAcc), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->headAcc), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->pDOP), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->pDOP), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->flags3), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->flags3), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->reserved1[0]), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->reserved1[0]), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->reserved1[1]), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->reserved1[1]), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->reserved1[2]), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->reserved1[2]), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->reserved1[3]), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->reserved1[3]), &data_length_buffer);
-
-        make_little_endian((int32_t) &(nav_pvt_struct->headVeh), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->headVeh), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->magDec), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->magDec), &data_length_buffer);
-        make_little_endian((int32_t) &(nav_pvt_struct->magAcc), &(nav_pvt_array[data_length_buffer]), sizeof(nav_pvt_struct->magAcc), &data_length_buffer);
-
-        uint16_t checksum_buffer = 0;
-        checksum_buffer = usUbxCalcCheckSum(nav_pvt_array);
-
-        nav_pvt_array[data_length_buffer] = (checksum_buffer >> 8) & 0xFF;
-        data_length_buffer += 1;
-        nav_pvt_array[data_length_buffer] = checksum_buffer & 0xFF;
-        data_length_buffer += 1;
-
-
-        for(int i = 0; i < data_length_buffer; i++) // TODO PACKET MAKING TESTED
-        {
-            printf("%02x ", nav_pvt_array[i]);
-        }
-        printf("\r\n");
-        // printf(" // data_length_buffer - %d // nav_pvt_t - %d\r\n", data_length_buffer, sizeof(nav_pvt_t));
-
-#endif
-
+    case GPS_FIX:
+        fix = (gps_fix_core_t *)event_data;
+        ESP_LOGD(TAG, "fix: latitude = %d, longitude = %d (1e-7 degree), speed = %ucm/s",
+                 (int)fix->latitude, (int)fix->longitude, (unsigned)fix->speed);
         break;
     case GPS_UNKNOWN:
         /* print unknown statements */
@@ -295,8 +216,6 @@ static void gps_event_handler(void *event_handler_arg, esp_event_base_t event_ba
         break;
     default:
         break;
-
-    free(nav_pvt_struct);
     }
 }
 
@@ -308,6 +227,35 @@ void app_main(void)
     nmea_parser_handle_t nmea_hdl = nmea_parser_init(&config);
     /* register event handler for NMEA parser library */
     nmea_parser_add_handler(nmea_hdl, gps_event_handler, NULL);
+    /* register parser for vendor specific TXT statements */
+    nmea_parser_statement_parser_t txt_parser = {
+        .name = "TXT",
+        .parse_item = gps_txt_parse_item,
+    };
+    nmea_parser_add_statement_parser(nmea_hdl, &txt_parser);
+    /* enable the outputs selected in menuconfig */
+#if CONFIG_NMEA_OUTPUT_UBX
+    gps_output_enable(nmea_hdl, GPS_OUTPUT_UBX, true);
+#endif
+#if CONFIG_NMEA_OUTPUT_COORDINATES
+    gps_output_enable(nmea_hdl, GPS_OUTPUT_COORDINATES, true);
+#endif
+#if CONFIG_NMEA_OUTPUT_RAW
+    gps_output_enable(nmea_hdl, GPS_OUTPUT_RAW, true);
+#endif
+#if CONFIG_NMEA_OUTPUT_COMMANDS
+    /* read output commands from the console */
+    esp_err_t err = uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "install console UART driver failed: %s, no output commands", esp_err_to_name(err));
+    } else {
+        setvbuf(stdin, NULL, _IONBF, 0);
+        esp_vfs_dev_uart_use_driver(CONFIG_ESP_CONSOLE_UART_NUM);
+        if (xTaskCreate(gps_output_command_task, "gps_output_cmd", 3072, nmea_hdl, 1, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "create output command task failed");
+        }
+    }
+#endif
 
     // vTaskDelay(1000 / portTICK_PERIOD_MS);
     // uart_write_bytes(2, BAUDRATE_CONFIG, sizeof(BAUDRATE_CONFIG));
@@ -0,0 +1,142 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <math.h>
+#include "nmea_predictor.h"
+
+#define NMEA_PREDICTOR_MS_PER_DAY (86400000LL)
+#define NMEA_PREDICTOR_CM_PER_DEGREE (11131949LL) /* Length of one degree of latitude */
+#define NMEA_PREDICTOR_MIN_TURN_SPEED (100)       /* Course below this speed (cm/s) is too noisy for a turn rate */
+#define NMEA_PREDICTOR_MAX_TURN_RATE (9000)       /* Turn rate limit (0.01 degree/s) */
+#define NMEA_PREDICTOR_MIN_COS_LAT (328)          /* Floor of the cosine of latitude near the poles (Q15) */
+
+/**
+ * @brief Wrap a course difference to [-180, 180) degrees
+ *
+ * @param delta course difference (0.01 degree)
+ * @return int32_t wrapped difference (0.01 degree)
+ */
+static inline int32_t nmea_wrap_cdeg(int32_t delta)
+{
+    delta %= 36000;
+    if (delta >= 18000) {
+        delta -= 36000;
+    } else if (delta < -18000) {
+        delta += 36000;
+    }
+    return delta;
+}
+
+/**
+ * @brief Extrapolate a fix with constant ground speed and turn rate
+ *
+ * The displacement is taken along the course at mid-interval, which is exact for a straight line and
+ * close to the arc for the turn rates of a vehicle.
+ *
+ * @param fix fix to extrapolate
+ * @param turn_rate turn rate (0.01 degree/s)
+ * @param dt_ms time to extrapolate (ms)
+ * @param out extrapolated fix
+ */
+static void nmea_predict(const gps_fix_core_t *fix, int32_t turn_rate, int32_t dt_ms, gps_fix_core_t *out)
+{
+    *out = *fix;
+    int64_t dist_cm = (int64_t)fix->speed * dt_ms / 1000;
+    int32_t heading = fix->cog + (int32_t)((int64_t)turn_rate * dt_ms / 2000);
+    int64_t north_cm = dist_cm * nmea_cos_q15(heading) >> 15;
+    int64_t east_cm = dist_cm * nmea_sin_q15(heading) >> 15;
+    /* Meridians get closer with latitude, keep a floor near the poles */
+    int32_t cos_lat = nmea_cos_q15(fix->latitude / 100000);
+    if (cos_lat < NMEA_PREDICTOR_MIN_COS_LAT) {
+        cos_lat = NMEA_PREDICTOR_MIN_COS_LAT;
+    }
+    out->latitude += (int32_t)(north_cm * 10000000 / NMEA_PREDICTOR_CM_PER_DEGREE);
+    int64_t longitude = out->longitude + east_cm * 10000000 * 32768 / (NMEA_PREDICTOR_CM_PER_DEGREE * cos_lat);
+    if (longitude > 1800000000LL) {
+        longitude -= 3600000000LL;
+    } else if (longitude < -1800000000LL) {
+        longitude += 3600000000LL;
+    }
+    out->longitude = (int32_t)longitude;
+    int32_t cog = (fix->cog + (int32_t)((int64_t)turn_rate * dt_ms / 1000)) % 36000;
+    out->cog = (uint16_t)(cog < 0 ? cog + 36000 : cog);
+    out->time_ms = (uint32_t)((fix->time_ms + dt_ms) % NMEA_PREDICTOR_MS_PER_DAY);
+}
+
+/**
+ * @brief Distance between two fixes, for error statistics
+ *
+ * @param a fix
+ * @param b fix
+ * @return uint32_t distance (cm)
+ */
+static uint32_t nmea_fix_distance_cm(const gps_fix_core_t *a, const gps_fix_core_t *b)
+{
+    float north = (float)(b->latitude - a->latitude) * NMEA_PREDICTOR_CM_PER_DEGREE / 1e7f;
+    float east = (float)(b->longitude - a->longitude) * NMEA_PREDICTOR_CM_PER_DEGREE / 1e7f *
+                 nmea_cos_q15(a->latitude / 100000) / 32768.0f;
+    return (uint32_t)sqrtf(north * north + east * east);
+}
+
+void nmea_predictor_init(nmea_predictor_t *predictor)
+{
+    memset(predictor, 0, sizeof(*predictor));
+}
+
+bool nmea_predictor_update(nmea_predictor_t *predictor, const gps_fix_core_t *fix, int64_t fix_us)
+{
+    if (!fix->valid) {
+        predictor->has_fix = false;
+        return false;
+    }
+    int32_t dt_ms = (int32_t)(((int64_t)fix->time_ms - predictor->fix.time_ms + NMEA_PREDICTOR_MS_PER_DAY) %
+                              NMEA_PREDICTOR_MS_PER_DAY);
+    if (predictor->has_fix && dt_ms > 0 && dt_ms < NMEA_PREDICTOR_HORIZON_US / 1000) {
+        /* Error of the previous prediction at the time of this fix */
+        gps_fix_core_t predicted;
+        nmea_predict(&predictor->fix, predictor->turn_rate, dt_ms, &predicted);
+        uint32_t err_cm = nmea_fix_distance_cm(&predicted, fix);
+        predictor->err_sum_cm += err_cm;
+        if (err_cm > predictor->err_max_cm) {
+            predictor->err_max_cm = err_cm;
+        }
+        predictor->err_count++;
+        int32_t turn_rate = 0;
+        if (fix->speed >= NMEA_PREDICTOR_MIN_TURN_SPEED) {
+            turn_rate = nmea_wrap_cdeg(fix->cog - predictor->fix.cog) * 1000 / dt_ms;
+        }
+        if (turn_rate > NMEA_PREDICTOR_MAX_TURN_RATE) {
+            turn_rate = NMEA_PREDICTOR_MAX_TURN_RATE;
+        } else if (turn_rate < -NMEA_PREDICTOR_MAX_TURN_RATE) {
+            turn_rate = -NMEA_PREDICTOR_MAX_TURN_RATE;
+        }
+        predictor->turn_rate = turn_rate;
+    } else {
+        predictor->turn_rate = 0;
+    }
+    predictor->fix = *fix;
+    predictor->fix_us = fix_us;
+    predictor->has_fix = true;
+    return true;
+}
+
+bool nmea_predictor_predict(const nmea_predictor_t *predictor, int64_t now_us, gps_fix_core_t *out)
+{
+    if (!predictor->has_fix || now_us - predictor->fix_us > NMEA_PREDICTOR_HORIZON_US) {
+        return false;
+    }
+    nmea_predict(&predictor->fix, predictor->turn_rate, (int32_t)((now_us - predictor->fix_us) / 1000), out);
+    return true;
+}
@@ -0,0 +1,75 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "nmea_decoder.h"
+
+#define NMEA_PREDICTOR_HORIZON_US (2000000) /*!< No prediction further than this after the last fix */
+
+/**
+ * @brief Constant velocity and turn rate predictor
+ *
+ */
+typedef struct {
+    gps_fix_core_t fix;   /*!< Last fix */
+    int64_t fix_us;       /*!< Local time matching the UTC time of the last fix (us) */
+    int32_t turn_rate;    /*!< Turn rate (0.01 degree/s) */
+    uint64_t err_sum_cm;  /*!< Sum of prediction errors at the time of the next fix (cm) */
+    uint32_t err_max_cm;  /*!< Maximum prediction error (cm) */
+    uint32_t err_count;   /*!< Number of prediction errors measured */
+    bool has_fix;         /*!< A fix was received */
+} nmea_predictor_t;
+
+/**
+ * @brief Init fix predictor
+ *
+ * @param predictor fix predictor
+ */
+void nmea_predictor_init(nmea_predictor_t *predictor);
+
+/**
+ * @brief Feed a new fix to the predictor
+ *
+ * The previous fix extrapolated to the time of the new one gives the prediction error, and the course
+ * change between both the turn rate (ignored at walking pace). An invalid fix stops the predictions.
+ *
+ * @param predictor fix predictor
+ * @param fix new fix
+ * @param fix_us local time matching the UTC time of the fix (us), e.g. the reception of the first statement
+ *               of its epoch minus the receiver latency
+ * @return true if the fix is valid, predictions can be made from it
+ */
+bool nmea_predictor_update(nmea_predictor_t *predictor, const gps_fix_core_t *fix, int64_t fix_us);
+
+/**
+ * @brief Extrapolate the last fix to a local time
+ *
+ * @param predictor fix predictor
+ * @param now_us local time to extrapolate to (us), in the time base of nmea_predictor_update()
+ * @param out extrapolated fix will be saved in this pointer
+ * @return true on success, false if there is no valid fix or it is older than NMEA_PREDICTOR_HORIZON_US
+ */
+bool nmea_predictor_predict(const nmea_predictor_t *predictor, int64_t now_us, gps_fix_core_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,144 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nmea_rate.h"
+#include "nmea_ubx.h"
+
+#define NMEA_RATE_MAX_GAP_MS (5000) /* Fixes further apart do not give a turn rate or an acceleration */
+#define NMEA_RATE_MS_PER_DAY (86400000)
+
+void nmea_rate_init(nmea_rate_t *rate, const nmea_rate_config_t *config)
+{
+    memset(rate, 0, sizeof(*rate));
+    rate->config = *config;
+    rate->state = NMEA_RATE_STATE_MAX;
+    rate->candidate = NMEA_RATE_STATE_MAX;
+}
+
+/**
+ * @brief Cruise or manoeuvre, from the turn rate and acceleration since the reference fix
+ *
+ * @param rate fix rate controller
+ * @param fix valid fix
+ * @return nmea_rate_state_t motion state
+ */
+static nmea_rate_state_t nmea_rate_motion(const nmea_rate_t *rate, const gps_fix_core_t *fix)
+{
+    const nmea_rate_config_t *config = &rate->config;
+    const gps_fix_core_t *ref = &rate->ref;
+    uint32_t accel = (uint32_t)abs((int)fix->speed - (int)ref->speed) * 1000 / rate->ref_age_ms;
+    if (accel > config->accel) {
+        return NMEA_RATE_MANOEUVRE;
+    }
+    /* Course is noise at low speed */
+    if (ref->speed > config->idle_speed && fix->speed > config->idle_speed) {
+        uint32_t turn = abs((int)fix->cog - (int)ref->cog);
+        if (turn > 18000) {
+            turn = 36000 - turn;
+        }
+        if (turn * 1000 / rate->ref_age_ms > config->turn_rate) {
+            return NMEA_RATE_MANOEUVRE;
+        }
+    }
+    return NMEA_RATE_CRUISE;
+}
+
+uint16_t nmea_rate_update(nmea_rate_t *rate, const gps_fix_core_t *fix)
+{
+    if (!fix->valid) {
+        rate->has_ref = false;
+        return 0;
+    }
+    uint32_t dt_ms = 0;
+    if (rate->has_ref) {
+        dt_ms = (fix->time_ms + NMEA_RATE_MS_PER_DAY - rate->last_ms) % NMEA_RATE_MS_PER_DAY;
+        rate->ref_age_ms += dt_ms;
+        if (dt_ms > NMEA_RATE_MAX_GAP_MS) {
+            dt_ms = 0;
+            rate->has_ref = false;
+        }
+    }
+    rate->last_ms = fix->time_ms;
+    if (!rate->has_ref) {
+        rate->ref = *fix;
+        rate->ref_age_ms = 0;
+        rate->has_ref = true;
+        rate->motion = NMEA_RATE_CRUISE;
+    } else if (rate->ref_age_ms >= NMEA_RATE_BASELINE_MS) {
+        rate->motion = nmea_rate_motion(rate, fix);
+        rate->ref = *fix;
+        rate->ref_age_ms = 0;
+    }
+    /* Hysteresis on speed, so that noise around the threshold does not toggle idle */
+    uint32_t idle_speed = rate->config.idle_speed;
+    nmea_rate_state_t state = rate->motion;
+    if (fix->speed <= (rate->state == NMEA_RATE_IDLE ? 2 * idle_speed : idle_speed)) {
+        state = NMEA_RATE_IDLE;
+    }
+    if (rate->state < NMEA_RATE_STATE_MAX) {
+        rate->time_ms[rate->state] += dt_ms;
+    }
+
+    const uint16_t *period_ms = rate->config.period_ms;
+    if (rate->state == NMEA_RATE_STATE_MAX || period_ms[state] < period_ms[rate->state]) {
+        /* First fix or faster motion, do not miss the start of a manoeuvre */
+        rate->candidate = NMEA_RATE_STATE_MAX;
+    } else if (state == rate->state) {
+        rate->candidate = NMEA_RATE_STATE_MAX;
+        return 0;
+    } else {
+        /* Slower motion, wait until it lasts */
+        if (state != rate->candidate) {
+            rate->candidate = state;
+            rate->candidate_ms = 0;
+            return 0;
+        }
+        rate->candidate_ms += dt_ms;
+        if (rate->candidate_ms < rate->config.hold_ms) {
+            return 0;
+        }
+        rate->candidate = NMEA_RATE_STATE_MAX;
+    }
+    bool first = rate->state == NMEA_RATE_STATE_MAX;
+    uint16_t old_period = first ? 0 : period_ms[rate->state];
+    rate->state = state;
+    if (period_ms[state] == old_period) {
+        return 0;
+    }
+    if (!first) {
+        rate->changes++;
+    }
+    return period_ms[state];
+}
+
+size_t nmea_rate_command(nmea_rate_protocol_t protocol, uint16_t period_ms, uint8_t *buf, size_t size)
+{
+    if (protocol == NMEA_RATE_PROTOCOL_UBX) {
+        return nmea_ubx_encode_cfg_rate(period_ms, buf, size);
+    }
+    char body[16];
+    int len = snprintf(body, sizeof(body), "PMTK220,%u", (unsigned)period_ms);
+    uint8_t crc = 0;
+    for (int i = 0; i < len; i++) {
+        crc ^= (uint8_t)body[i];
+    }
+    int n = snprintf((char *)buf, size, "$%s*%02X\r\n", body, crc);
+    if (n < 0 || (size_t)n >= size) {
+        return 0;
+    }
+    return n;
+}
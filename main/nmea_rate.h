@@ -0,0 +1,117 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "nmea_decoder.h"
+
+#define NMEA_RATE_COMMAND_MAX_SIZE (24) /*!< Longest command of nmea_rate_command() */
+#define NMEA_RATE_BASELINE_MS (500)      /*!< Minimum time over which turn rate and acceleration are measured */
+
+/**
+ * @brief Motion state of the fix rate controller
+ *
+ */
+typedef enum {
+    NMEA_RATE_IDLE,       /*!< Parked or walking pace */
+    NMEA_RATE_CRUISE,     /*!< Moving straight at steady speed */
+    NMEA_RATE_MANOEUVRE,  /*!< Turning, accelerating or braking */
+    NMEA_RATE_STATE_MAX,  /*!< Number of motion states */
+} nmea_rate_state_t;
+
+/**
+ * @brief Receiver command set used to change the fix period
+ *
+ */
+typedef enum {
+    NMEA_RATE_PROTOCOL_PMTK, /*!< $PMTK220 (MediaTek and compatible receivers) */
+    NMEA_RATE_PROTOCOL_UBX,  /*!< UBX-CFG-RATE (u-blox receivers) */
+} nmea_rate_protocol_t;
+
+/**
+ * @brief Configuration of the fix rate controller
+ *
+ */
+typedef struct {
+    uint16_t period_ms[NMEA_RATE_STATE_MAX]; /*!< Fix period of each motion state (ms) */
+    uint16_t idle_speed;                     /*!< Below this ground speed the vehicle is idle, it leaves idle above
+                                                  twice this speed (cm/s) */
+    uint16_t turn_rate;                      /*!< Above this turn rate the vehicle manoeuvres (0.01 degree/s) */
+    uint16_t accel;                          /*!< Above this acceleration or deceleration the vehicle manoeuvres
+                                                  (cm/s^2) */
+    uint16_t hold_ms;                        /*!< Time a slower motion state must last before the fix period is
+                                                  lengthened (ms). Shorter periods are applied at once */
+} nmea_rate_config_t;
+
+/**
+ * @brief Fix rate controller
+ *
+ */
+typedef struct {
+    nmea_rate_config_t config;                          /*!< Configuration */
+    gps_fix_core_t ref;                                 /*!< Reference fix of turn rate and acceleration */
+    uint32_t ref_age_ms;                                /*!< Time since the reference fix (ms) */
+    uint32_t last_ms;                                   /*!< UTC time of the previous valid fix (ms) */
+    bool has_ref;                                       /*!< A reference fix is known */
+    nmea_rate_state_t motion;                           /*!< Cruise or manoeuvre, from the last baseline */
+    nmea_rate_state_t state;                            /*!< Applied motion state, NMEA_RATE_STATE_MAX before the
+                                                             first command */
+    nmea_rate_state_t candidate;                        /*!< Slower motion state waiting for the hold time */
+    uint32_t candidate_ms;                              /*!< Time the candidate has lasted (ms) */
+    uint32_t changes;                                   /*!< Fix period changes commanded */
+    uint32_t time_ms[NMEA_RATE_STATE_MAX];              /*!< Time spent in each applied motion state (ms) */
+} nmea_rate_t;
+
+/**
+ * @brief Init fix rate controller
+ *
+ * @param rate fix rate controller
+ * @param config configuration, copied
+ */
+void nmea_rate_init(nmea_rate_t *rate, const nmea_rate_config_t *config);
+
+/**
+ * @brief Feed a fix to the controller
+ *
+ * The motion state is derived from the ground speed, and from the turn rate and acceleration measured over
+ * at least NMEA_RATE_BASELINE_MS (over a single fix period the noise of speed and course of a 20 Hz receiver
+ * looks like a manoeuvre). Invalid fixes keep the current state.
+ *
+ * @param rate fix rate controller
+ * @param fix decoded fix
+ * @return uint16_t new fix period to command to the receiver (ms), 0 to keep the current one
+ */
+uint16_t nmea_rate_update(nmea_rate_t *rate, const gps_fix_core_t *fix);
+
+/**
+ * @brief Encode the receiver command setting the fix period
+ *
+ * @param protocol receiver command set
+ * @param period_ms fix period (ms)
+ * @param buf command will be saved in this buffer
+ * @param size size of buf
+ * @return size_t length of the command, 0 if buf is too small
+ */
+size_t nmea_rate_command(nmea_rate_protocol_t protocol, uint16_t period_ms, uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,158 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <math.h>
+#include "nmea_track.h"
+
+#define NMEA_TRACK_CM_PER_DEGREE (11131949LL) /* Length of one degree of latitude */
+#define NMEA_TRACK_MIN_COS_LAT (328)          /* Floor of the cosine of latitude near the poles (Q15) */
+
+/**
+ * @brief Squared distance from a point to the segment from the origin to an end point
+ *
+ * @param east point, east of the origin (cm)
+ * @param north point, north of the origin (cm)
+ * @param end_east end of the segment, east of the origin (cm)
+ * @param end_north end of the segment, north of the origin (cm)
+ * @return float squared distance (cm^2)
+ */
+static float nmea_track_dist2(int32_t east, int32_t north, int32_t end_east, int32_t end_north)
+{
+    int64_t len2 = (int64_t)end_east * end_east + (int64_t)end_north * end_north;
+    int64_t dot = (int64_t)east * end_east + (int64_t)north * end_north;
+    if (dot <= 0 || len2 == 0) {
+        return (float)east * east + (float)north * north;
+    }
+    if (dot >= len2) {
+        float de = (float)(east - end_east);
+        float dn = (float)(north - end_north);
+        return de * de + dn * dn;
+    }
+    float cross = (float)((int64_t)east * end_north - (int64_t)north * end_east);
+    return cross * cross / (float)len2;
+}
+
+/**
+ * @brief Convert a fix to local coordinates around the anchor
+ *
+ * @param track track simplification
+ * @param fix fix to convert
+ * @param east east of the anchor (cm)
+ * @param north north of the anchor (cm)
+ */
+static void nmea_track_local(const nmea_track_t *track, const gps_fix_core_t *fix, int32_t *east, int32_t *north)
+{
+    int64_t dlon = (int64_t)fix->longitude - track->anchor.longitude;
+    if (dlon > 1800000000LL) {
+        dlon -= 3600000000LL;
+    } else if (dlon < -1800000000LL) {
+        dlon += 3600000000LL;
+    }
+    *north = (int32_t)(((int64_t)fix->latitude - track->anchor.latitude) * NMEA_TRACK_CM_PER_DEGREE / 10000000);
+    *east = (int32_t)((dlon * NMEA_TRACK_CM_PER_DEGREE / 10000000 * track->cos_lat) >> 15);
+}
+
+/**
+ * @brief Publish a track point, and start a new window from it
+ *
+ * @param track track simplification
+ * @param fix track point
+ */
+static void nmea_track_publish(nmea_track_t *track, const gps_fix_core_t *fix)
+{
+    gps_fix_core_t point = *fix;
+    track->anchor = point;
+    track->anchor_utc_ms = nmea_fix_utc_ms(fix);
+    /* Meridians get closer with latitude, keep a floor near the poles */
+    track->cos_lat = nmea_cos_q15(fix->latitude / 100000);
+    if (track->cos_lat < NMEA_TRACK_MIN_COS_LAT) {
+        track->cos_lat = NMEA_TRACK_MIN_COS_LAT;
+    }
+    track->count = 0;
+    track->window_err_cm = 0;
+    track->has_anchor = true;
+    track->points_out++;
+    track->publish(track->ctx, &point);
+}
+
+void nmea_track_init(nmea_track_t *track, const nmea_track_config_t *config, nmea_track_publish_t publish,
+                     void *ctx)
+{
+    memset(track, 0, sizeof(nmea_track_t));
+    track->config = *config;
+    if (track->config.window < 2) {
+        track->config.window = 2;
+    } else if (track->config.window > NMEA_TRACK_WINDOW_SIZE) {
+        track->config.window = NMEA_TRACK_WINDOW_SIZE;
+    }
+    track->publish = publish;
+    track->ctx = ctx;
+}
+
+void nmea_track_update(nmea_track_t *track, const gps_fix_core_t *fix)
+{
+    int64_t utc_ms = nmea_fix_utc_ms(fix);
+    if (!fix->valid || utc_ms < 0 || (track->has_anchor && utc_ms <= track->anchor_utc_ms)) {
+        /* End of the track (fix lost or time reset), keep its last point */
+        if (track->has_anchor && track->count) {
+            nmea_track_publish(track, &track->last);
+        }
+        track->has_anchor = false;
+        if (!fix->valid || utc_ms < 0) {
+            return;
+        }
+    }
+    track->fixes_in++;
+    if (!track->has_anchor) {
+        nmea_track_publish(track, fix);
+        return;
+    }
+    int32_t east;
+    int32_t north;
+    float err2 = 0;
+    const float tolerance2 = (float)track->config.tolerance_cm * track->config.tolerance_cm;
+    bool split = track->count == track->config.window;
+    if (track->config.max_interval_s) {
+        split |= utc_ms - track->anchor_utc_ms > track->config.max_interval_s * 1000LL;
+    }
+    nmea_track_local(track, fix, &east, &north);
+    for (uint32_t i = 0; i < track->count && !split; i++) {
+        float dist2 = nmea_track_dist2(track->east[i], track->north[i], east, north);
+        if (dist2 > tolerance2) {
+            split = true;
+        } else if (dist2 > err2) {
+            err2 = dist2;
+        }
+    }
+    if (split) {
+        if (!track->count) {
+            nmea_track_publish(track, fix);
+            return;
+        }
+        /* The previous fix ends the segment, the window restarts from it */
+        gps_fix_core_t end = track->last;
+        if (track->window_err_cm > track->err_max_cm) {
+            track->err_max_cm = track->window_err_cm;
+        }
+        nmea_track_publish(track, &end);
+        nmea_track_local(track, fix, &east, &north);
+        err2 = 0;
+    }
+    track->east[track->count] = east;
+    track->north[track->count] = north;
+    track->count++;
+    track->window_err_cm = (uint32_t)sqrtf(err2);
+    track->last = *fix;
+}
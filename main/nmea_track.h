@@ -0,0 +1,101 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "nmea_decoder.h"
+
+#ifdef CONFIG_NMEA_PARSER_TRACK_WINDOW
+#define NMEA_TRACK_WINDOW_SIZE CONFIG_NMEA_PARSER_TRACK_WINDOW
+#else
+#define NMEA_TRACK_WINDOW_SIZE (255) /*!< Largest window of the configuration, without track simplification */
+#endif
+
+/**
+ * @brief Configuration of the track simplification
+ *
+ */
+typedef struct {
+    uint32_t tolerance_cm;   /*!< Maximum distance between a dropped fix and the simplified track (cm) */
+    uint16_t window;         /*!< Maximum number of fixes between two track points, 2 to NMEA_TRACK_WINDOW_SIZE */
+    uint16_t max_interval_s; /*!< Publish a track point at least this often (s), 0 to publish only when needed */
+} nmea_track_config_t;
+
+/**
+ * @brief Output of track points
+ *
+ * @param ctx context passed to nmea_track_init()
+ * @param point track point, only valid during the call
+ */
+typedef void (*nmea_track_publish_t)(void *ctx, const gps_fix_core_t *point);
+
+/**
+ * @brief Streaming track simplification, bounded opening window
+ *
+ * Points are kept in local coordinates (cm east and north of the anchor). The stage does not allocate memory
+ * and does not depend on FreeRTOS, so that it can run on the host.
+ */
+typedef struct {
+    nmea_track_config_t config;             /*!< Configuration */
+    nmea_track_publish_t publish;           /*!< Output */
+    void *ctx;                              /*!< Context of output */
+    gps_fix_core_t anchor;                  /*!< Last point published */
+    gps_fix_core_t last;                    /*!< Last fix, end of the candidate segment */
+    int64_t anchor_utc_ms;                  /*!< Time of the anchor */
+    int32_t cos_lat;                        /*!< Cosine of the anchor latitude (Q15) */
+    int32_t east[NMEA_TRACK_WINDOW_SIZE];   /*!< Fixes since the anchor, east of the anchor (cm) */
+    int32_t north[NMEA_TRACK_WINDOW_SIZE];  /*!< Fixes since the anchor, north of the anchor (cm) */
+    uint32_t count;                         /*!< Fixes in the window, last included */
+    uint32_t window_err_cm;                 /*!< Error of the fixes in the window to the candidate segment (cm) */
+    uint32_t err_max_cm;                    /*!< Maximum error of a dropped fix to its published segment (cm) */
+    uint32_t fixes_in;                      /*!< Valid fixes fed */
+    uint32_t points_out;                    /*!< Points published */
+    bool has_anchor;                        /*!< An anchor was published */
+} nmea_track_t;
+
+/**
+ * @brief Init track simplification
+ *
+ * @param track track simplification
+ * @param config configuration, copied (the window is clamped to 2 to NMEA_TRACK_WINDOW_SIZE)
+ * @param publish output of track points
+ * @param ctx context of publish
+ */
+void nmea_track_init(nmea_track_t *track, const nmea_track_config_t *config, nmea_track_publish_t publish,
+                     void *ctx);
+
+/**
+ * @brief Feed a new fix to the track simplification
+ *
+ * The segment from the last published point to the new fix is checked against every fix in between. When one
+ * of them is further than the tolerance, the previous fix is published and starts the next segment. The window
+ * of fixes is bounded, so memory and time per fix are constant; a full window publishes a point as well.
+ * A point is published one fix late. An invalid fix, or a time going backwards, ends the track with its last
+ * fix.
+ *
+ * @param track track simplification
+ * @param fix new fix
+ */
+void nmea_track_update(nmea_track_t *track, const gps_fix_core_t *fix);
+
+#ifdef __cplusplus
+}
+#endif
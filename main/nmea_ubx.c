@@ -0,0 +1,349 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <math.h>
+#include "nmea_ubx.h"
+
+#define NMEA_UBX_CLASS_NAV (0x01)
+#define NMEA_UBX_ID_NAV_PVT (0x07)
+#define NMEA_UBX_ID_NAV_DOP (0x04)
+#define NMEA_UBX_ID_NAV_TIMEUTC (0x21)
+#define NMEA_UBX_ID_NAV_SAT (0x35)
+#define NMEA_UBX_NAV_SAT_VERSION (1)
+#define NMEA_UBX_CLASS_CFG (0x06)
+#define NMEA_UBX_ID_CFG_RATE (0x08)
+#define NMEA_UBX_TIME_REF_GPS (1)
+#define NMEA_UBX_GPS_EPOCH_DAYS (7300)         /* 1980-01-06 to 2000-01-01 */
+#define NMEA_UBX_LEAP_SECONDS (18)
+#define NMEA_UBX_MS_PER_WEEK (604800000LL)
+
+/* NAV-PVT fixType */
+#define NMEA_UBX_FIX_NONE (0)
+#define NMEA_UBX_FIX_2D (2)
+#define NMEA_UBX_FIX_3D (3)
+
+/* NAV-PVT valid and flags bits */
+#define NMEA_UBX_VALID_DATE (1 << 0)
+#define NMEA_UBX_VALID_TIME (1 << 1)
+#define NMEA_UBX_VALID_FULLY_RESOLVED (1 << 2)
+#define NMEA_UBX_FLAGS_FIX_OK (1 << 0)
+#define NMEA_UBX_FLAGS_DIFF_SOLN (1 << 1)
+
+/* NAV-TIMEUTC valid bits */
+#define NMEA_UBX_TIMEUTC_VALID_TOW (1 << 0)
+#define NMEA_UBX_TIMEUTC_VALID_WKN (1 << 1)
+#define NMEA_UBX_TIMEUTC_VALID_UTC (1 << 2)
+
+/* NAV-SAT GNSS IDs and flags */
+#define NMEA_UBX_GNSS_GPS (0)
+#define NMEA_UBX_GNSS_SBAS (1)
+#define NMEA_UBX_GNSS_QZSS (5)
+#define NMEA_UBX_GNSS_GLONASS (6)
+#define NMEA_UBX_SAT_QUALITY_SEARCHING (1)
+#define NMEA_UBX_SAT_QUALITY_CODE_LOCKED (4)
+#define NMEA_UBX_SAT_SV_USED (1 << 3)
+
+static inline void ubx_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void ubx_put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/**
+ * @brief Write sync chars, class, id and payload length of a frame
+ *
+ */
+static void ubx_frame_header(uint8_t *buf, uint8_t cls, uint8_t id, uint16_t len)
+{
+    buf[0] = NMEA_UBX_SYNC_1;
+    buf[1] = NMEA_UBX_SYNC_2;
+    buf[2] = cls;
+    buf[3] = id;
+    ubx_put_u16(buf + 4, len);
+}
+
+/**
+ * @brief Append the 8-bit Fletcher checksum of class, id, length and payload, once the payload is in place
+ *
+ */
+static void ubx_frame_checksum(uint8_t *buf, uint16_t len)
+{
+    uint8_t ck_a = 0;
+    uint8_t ck_b = 0;
+    for (uint16_t i = 2; i < len + 6; i++) {
+        ck_a += buf[i];
+        ck_b += ck_a;
+    }
+    buf[len + 6] = ck_a;
+    buf[len + 7] = ck_b;
+}
+
+/**
+ * @brief GPS time of week of a decoded epoch
+ *
+ * @return uint32_t time of week (ms), GPS time is ahead of UTC by the leap seconds
+ */
+static uint32_t ubx_itow(const gps_t *gps)
+{
+    static const uint16_t days_before_month[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    int64_t days = NMEA_UBX_GPS_EPOCH_DAYS;
+    if (gps->date.month >= 1 && gps->date.month <= 12) {
+        uint16_t year = gps->date.year % 100;
+        days += year * 365 + (year + 3) / 4 + days_before_month[gps->date.month - 1] + gps->date.day - 1;
+        if (gps->date.month > 2 && (year % 4) == 0) {
+            days++;
+        }
+    }
+    int64_t ms = days * 86400000LL +
+                 ((gps->tim.hour * 60 + gps->tim.minute) * 60 + gps->tim.second + NMEA_UBX_LEAP_SECONDS) * 1000LL +
+                 gps->tim.thousand;
+    return (uint32_t)(ms % NMEA_UBX_MS_PER_WEEK);
+}
+
+/**
+ * @brief NAV-PVT validity flags of date and time
+ *
+ */
+static uint8_t ubx_valid(const gps_t *gps)
+{
+    uint8_t valid = 0;
+    if (gps->date.month) {
+        valid |= NMEA_UBX_VALID_DATE;
+    }
+    if (gps->valid) {
+        valid |= NMEA_UBX_VALID_TIME;
+    }
+    if (valid == (NMEA_UBX_VALID_DATE | NMEA_UBX_VALID_TIME)) {
+        valid |= NMEA_UBX_VALID_FULLY_RESOLVED;
+    }
+    return valid;
+}
+
+size_t nmea_ubx_encode_nav_pvt(const gps_t *gps, uint8_t *buf, size_t size)
+{
+    if (size < NMEA_UBX_NAV_PVT_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + 6;
+    memset(p, 0, NMEA_UBX_NAV_PVT_PAYLOAD);
+    ubx_frame_header(buf, NMEA_UBX_CLASS_NAV, NMEA_UBX_ID_NAV_PVT, NMEA_UBX_NAV_PVT_PAYLOAD);
+
+    ubx_put_u32(p + 0, ubx_itow(gps));
+    ubx_put_u16(p + 4, gps->date.year + 2000);
+    p[6] = gps->date.month;
+    p[7] = gps->date.day;
+    p[8] = gps->tim.hour;
+    p[9] = gps->tim.minute;
+    p[10] = gps->tim.second;
+    p[11] = ubx_valid(gps);
+    /* tAcc unknown, nano is the fraction of second */
+    ubx_put_u32(p + 16, (uint32_t)gps->tim.thousand * 1000000);
+    switch (gps->fix_mode) {
+    case GPS_MODE_2D:
+        p[20] = NMEA_UBX_FIX_2D;
+        break;
+    case GPS_MODE_3D:
+        p[20] = NMEA_UBX_FIX_3D;
+        break;
+    default:
+        p[20] = NMEA_UBX_FIX_NONE;
+        break;
+    }
+    if (gps->valid && gps->fix != GPS_FIX_INVALID) {
+        p[21] |= NMEA_UBX_FLAGS_FIX_OK;
+    }
+    if (gps->fix == GPS_FIX_DGPS) {
+        p[21] |= NMEA_UBX_FLAGS_DIFF_SOLN;
+    }
+    p[23] = gps->sats_in_use;
+    ubx_put_u32(p + 24, (uint32_t)gps->longitude);
+    ubx_put_u32(p + 28, (uint32_t)gps->latitude);
+    ubx_put_u32(p + 32, (uint32_t)(int32_t)lroundf(gps->altitude * 1000));
+    ubx_put_u32(p + 36, (uint32_t)(int32_t)lroundf((gps->altitude - gps->geoid_sep) * 1000));
+    /* NED velocity from ground speed and course, vertical velocity unknown */
+    float cog_rad = gps->cog * (float)(M_PI / 180);
+    float g_speed = gps->speed * 1000;
+    ubx_put_u32(p + 48, (uint32_t)(int32_t)lroundf(g_speed * cosf(cog_rad)));
+    ubx_put_u32(p + 52, (uint32_t)(int32_t)lroundf(g_speed * sinf(cog_rad)));
+    ubx_put_u32(p + 60, (uint32_t)(int32_t)lroundf(g_speed));
+    ubx_put_u32(p + 64, (uint32_t)(int32_t)lroundf(gps->cog * 100000));
+    ubx_put_u16(p + 76, (uint16_t)lroundf(gps->dop_p * 100));
+
+    ubx_frame_checksum(buf, NMEA_UBX_NAV_PVT_PAYLOAD);
+    return NMEA_UBX_NAV_PVT_SIZE;
+}
+
+size_t nmea_ubx_encode_nav_dop(const gps_t *gps, uint8_t *buf, size_t size)
+{
+    if (size < NMEA_UBX_NAV_DOP_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + 6;
+    memset(p, 0, NMEA_UBX_NAV_DOP_PAYLOAD);
+    ubx_frame_header(buf, NMEA_UBX_CLASS_NAV, NMEA_UBX_ID_NAV_DOP, NMEA_UBX_NAV_DOP_PAYLOAD);
+
+    ubx_put_u32(p + 0, ubx_itow(gps));
+    /* gDOP and tDOP unknown */
+    ubx_put_u16(p + 6, (uint16_t)lroundf(gps->dop_p * 100));
+    ubx_put_u16(p + 10, (uint16_t)lroundf(gps->dop_v * 100));
+    ubx_put_u16(p + 12, (uint16_t)lroundf(gps->dop_h * 100));
+    /* nDOP and eDOP unknown */
+
+    ubx_frame_checksum(buf, NMEA_UBX_NAV_DOP_PAYLOAD);
+    return NMEA_UBX_NAV_DOP_SIZE;
+}
+
+/**
+ * @brief GNSS and satellite IDs of an NMEA satellite number
+ *
+ * @return bool false if the number is out of the known ranges
+ */
+static bool ubx_sat_id(uint8_t num, uint8_t *gnss_id, uint8_t *sv_id)
+{
+    if (num >= 1 && num <= 32) {
+        *gnss_id = NMEA_UBX_GNSS_GPS;
+        *sv_id = num;
+    } else if (num >= 33 && num <= 64) {
+        *gnss_id = NMEA_UBX_GNSS_SBAS;
+        *sv_id = num + 87;
+    } else if (num >= 65 && num <= 96) {
+        *gnss_id = NMEA_UBX_GNSS_GLONASS;
+        *sv_id = num - 64;
+    } else if (num >= 120 && num <= 158) {
+        *gnss_id = NMEA_UBX_GNSS_SBAS;
+        *sv_id = num;
+    } else if (num >= 193 && num <= 202) {
+        *gnss_id = NMEA_UBX_GNSS_QZSS;
+        *sv_id = num - 192;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t nmea_ubx_encode_nav_sat(const gps_t *gps, uint8_t *buf, size_t size)
+{
+    uint8_t sats = gps->sats_in_view < GPS_MAX_SATELLITES_IN_VIEW ? gps->sats_in_view : GPS_MAX_SATELLITES_IN_VIEW;
+    uint8_t *p = buf + 6;
+    uint8_t num_svs = 0;
+    if (size < (size_t)(NMEA_UBX_NAV_SAT_PAYLOAD(sats) + NMEA_UBX_FRAME_OVERHEAD)) {
+        return 0;
+    }
+    for (int i = 0; i < sats; i++) {
+        const gps_satellite_t *sat = &gps->sats_desc_in_view[i];
+        uint8_t *sv = p + NMEA_UBX_NAV_SAT_PAYLOAD(num_svs);
+        uint8_t gnss_id;
+        uint8_t sv_id;
+        if (!ubx_sat_id(sat->num, &gnss_id, &sv_id)) {
+            continue;
+        }
+        uint32_t flags = sat->snr ? NMEA_UBX_SAT_QUALITY_CODE_LOCKED : NMEA_UBX_SAT_QUALITY_SEARCHING;
+        for (int j = 0; j < GPS_MAX_SATELLITES_IN_USE; j++) {
+            if (gps->sats_id_in_use[j] == sat->num) {
+                flags |= NMEA_UBX_SAT_SV_USED;
+                break;
+            }
+        }
+        sv[0] = gnss_id;
+        sv[1] = sv_id;
+        sv[2] = sat->snr;
+        sv[3] = sat->elevation;
+        ubx_put_u16(sv + 4, sat->azimuth);
+        /* pseudorange residual unknown */
+        ubx_put_u16(sv + 6, 0);
+        ubx_put_u32(sv + 8, flags);
+        num_svs++;
+    }
+    uint16_t len = NMEA_UBX_NAV_SAT_PAYLOAD(num_svs);
+    ubx_frame_header(buf, NMEA_UBX_CLASS_NAV, NMEA_UBX_ID_NAV_SAT, len);
+    ubx_put_u32(p + 0, ubx_itow(gps));
+    p[4] = NMEA_UBX_NAV_SAT_VERSION;
+    p[5] = num_svs;
+    ubx_put_u16(p + 6, 0);
+
+    ubx_frame_checksum(buf, len);
+    return len + NMEA_UBX_FRAME_OVERHEAD;
+}
+
+size_t nmea_ubx_encode_nav_timeutc(const gps_t *gps, uint8_t *buf, size_t size)
+{
+    if (size < NMEA_UBX_NAV_TIMEUTC_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + 6;
+    memset(p, 0, NMEA_UBX_NAV_TIMEUTC_PAYLOAD);
+    ubx_frame_header(buf, NMEA_UBX_CLASS_NAV, NMEA_UBX_ID_NAV_TIMEUTC, NMEA_UBX_NAV_TIMEUTC_PAYLOAD);
+
+    ubx_put_u32(p + 0, ubx_itow(gps));
+    /* tAcc unknown */
+    ubx_put_u32(p + 8, (uint32_t)gps->tim.thousand * 1000000);
+    ubx_put_u16(p + 12, gps->date.year + 2000);
+    p[14] = gps->date.month;
+    p[15] = gps->date.day;
+    p[16] = gps->tim.hour;
+    p[17] = gps->tim.minute;
+    p[18] = gps->tim.second;
+    /* Time of week and week number need the date, UTC uses the built-in leap seconds */
+    if (gps->date.month && gps->valid) {
+        p[19] = NMEA_UBX_TIMEUTC_VALID_TOW | NMEA_UBX_TIMEUTC_VALID_WKN | NMEA_UBX_TIMEUTC_VALID_UTC;
+    }
+
+    ubx_frame_checksum(buf, NMEA_UBX_NAV_TIMEUTC_PAYLOAD);
+    return NMEA_UBX_NAV_TIMEUTC_SIZE;
+}
+
+size_t nmea_ubx_encode_epoch(const gps_t *gps, uint8_t *buf, size_t size)
+{
+    size_t len = nmea_ubx_encode_nav_pvt(gps, buf, size);
+    size_t n;
+    if (!len) {
+        return 0;
+    }
+    if (!(n = nmea_ubx_encode_nav_dop(gps, buf + len, size - len))) {
+        return 0;
+    }
+    len += n;
+    if (!(n = nmea_ubx_encode_nav_sat(gps, buf + len, size - len))) {
+        return 0;
+    }
+    len += n;
+    if (!(n = nmea_ubx_encode_nav_timeutc(gps, buf + len, size - len))) {
+        return 0;
+    }
+    return len + n;
+}
+
+size_t nmea_ubx_encode_cfg_rate(uint16_t meas_rate_ms, uint8_t *buf, size_t size)
+{
+    if (size < NMEA_UBX_CFG_RATE_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + 6;
+    ubx_frame_header(buf, NMEA_UBX_CLASS_CFG, NMEA_UBX_ID_CFG_RATE, NMEA_UBX_CFG_RATE_PAYLOAD);
+    ubx_put_u16(p + 0, meas_rate_ms);
+    ubx_put_u16(p + 2, 1);
+    ubx_put_u16(p + 4, NMEA_UBX_TIME_REF_GPS);
+
+    ubx_frame_checksum(buf, NMEA_UBX_CFG_RATE_PAYLOAD);
+    return NMEA_UBX_CFG_RATE_SIZE;
+}
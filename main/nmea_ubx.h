@@ -0,0 +1,118 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "nmea_decoder.h"
+
+#define NMEA_UBX_SYNC_1 (0xB5)           /*!< UBX frame first sync char */
+#define NMEA_UBX_SYNC_2 (0x62)           /*!< UBX frame second sync char */
+#define NMEA_UBX_FRAME_OVERHEAD (8)      /*!< Sync chars, class, id, length and checksum */
+#define NMEA_UBX_NAV_PVT_PAYLOAD (92)    /*!< NAV-PVT payload length */
+#define NMEA_UBX_NAV_PVT_SIZE (NMEA_UBX_NAV_PVT_PAYLOAD + NMEA_UBX_FRAME_OVERHEAD) /*!< NAV-PVT frame length */
+#define NMEA_UBX_NAV_DOP_PAYLOAD (18)    /*!< NAV-DOP payload length */
+#define NMEA_UBX_NAV_DOP_SIZE (NMEA_UBX_NAV_DOP_PAYLOAD + NMEA_UBX_FRAME_OVERHEAD) /*!< NAV-DOP frame length */
+#define NMEA_UBX_NAV_TIMEUTC_PAYLOAD (20) /*!< NAV-TIMEUTC payload length */
+#define NMEA_UBX_NAV_TIMEUTC_SIZE (NMEA_UBX_NAV_TIMEUTC_PAYLOAD + NMEA_UBX_FRAME_OVERHEAD) /*!< NAV-TIMEUTC frame length */
+#define NMEA_UBX_NAV_SAT_PAYLOAD(num_svs) (8 + 12 * (num_svs)) /*!< NAV-SAT payload length */
+#define NMEA_UBX_NAV_SAT_MAX_SIZE (NMEA_UBX_NAV_SAT_PAYLOAD(GPS_MAX_SATELLITES_IN_VIEW) + NMEA_UBX_FRAME_OVERHEAD) /*!< Longest NAV-SAT frame */
+#define NMEA_UBX_CFG_RATE_PAYLOAD (6)    /*!< CFG-RATE payload length */
+#define NMEA_UBX_CFG_RATE_SIZE (NMEA_UBX_CFG_RATE_PAYLOAD + NMEA_UBX_FRAME_OVERHEAD) /*!< CFG-RATE frame length */
+#define NMEA_UBX_EPOCH_MAX_SIZE (NMEA_UBX_NAV_PVT_SIZE + NMEA_UBX_NAV_DOP_SIZE + NMEA_UBX_NAV_SAT_MAX_SIZE + \
+                                 NMEA_UBX_NAV_TIMEUTC_SIZE) /*!< Longest epoch of nmea_ubx_encode_epoch() */
+
+/**
+ * @brief Encode a decoded epoch as UBX NAV-PVT frame
+ *
+ * Fields not kept in gps_t (accuracy estimates, vertical velocity, vehicle heading, magnetic declination)
+ * are 0. Height above mean sea level is derived from the geoid separation of GGA or GNS.
+ * The encoder only reads gps and writes buf, it can be called from any thread.
+ *
+ * @param gps decoded epoch
+ * @param buf frame will be saved in this buffer
+ * @param size size of buf
+ * @return size_t length of the frame (NMEA_UBX_NAV_PVT_SIZE), 0 if buf is too small
+ */
+size_t nmea_ubx_encode_nav_pvt(const gps_t *gps, uint8_t *buf, size_t size);
+
+/**
+ * @brief Encode a decoded epoch as UBX NAV-DOP frame
+ *
+ * Position, vertical and horizontal DOP come from GSA (HDOP also from GGA). Geometric, time, northing and
+ * easting DOP are not kept in gps_t and are 0.
+ *
+ * @param gps decoded epoch
+ * @param buf frame will be saved in this buffer
+ * @param size size of buf
+ * @return size_t length of the frame (NMEA_UBX_NAV_DOP_SIZE), 0 if buf is too small
+ */
+size_t nmea_ubx_encode_nav_dop(const gps_t *gps, uint8_t *buf, size_t size);
+
+/**
+ * @brief Encode the satellites in view of a decoded epoch as UBX NAV-SAT frame
+ *
+ * GNSS and satellite IDs are derived from the NMEA satellite numbers (GPS 1-32, SBAS 33-64 and 120-158,
+ * GLONASS 65-96, QZSS 193-202), satellites numbered out of these ranges are not reported. A satellite is
+ * flagged as used if it is listed by GSA.
+ *
+ * @param gps decoded epoch
+ * @param buf frame will be saved in this buffer
+ * @param size size of buf
+ * @return size_t length of the frame (at most NMEA_UBX_NAV_SAT_MAX_SIZE), 0 if buf is too small
+ */
+size_t nmea_ubx_encode_nav_sat(const gps_t *gps, uint8_t *buf, size_t size);
+
+/**
+ * @brief Encode a decoded epoch as UBX NAV-TIMEUTC frame
+ *
+ * @param gps decoded epoch
+ * @param buf frame will be saved in this buffer
+ * @param size size of buf
+ * @return size_t length of the frame (NMEA_UBX_NAV_TIMEUTC_SIZE), 0 if buf is too small
+ */
+size_t nmea_ubx_encode_nav_timeutc(const gps_t *gps, uint8_t *buf, size_t size);
+
+/**
+ * @brief Encode a decoded epoch as NAV-PVT, NAV-DOP, NAV-SAT and NAV-TIMEUTC frames, back to back
+ *
+ * All frames share the time of week of the epoch and can be sent with one write.
+ *
+ * @param gps decoded epoch
+ * @param buf frames will be saved in this buffer, NMEA_UBX_EPOCH_MAX_SIZE bytes are always enough
+ * @param size size of buf
+ * @return size_t length of the frames, 0 if buf is too small
+ */
+size_t nmea_ubx_encode_epoch(const gps_t *gps, uint8_t *buf, size_t size);
+
+/**
+ * @brief Encode a UBX CFG-RATE frame, setting the measurement period of a receiver
+ *
+ * One navigation solution per measurement, aligned to GPS time.
+ *
+ * @param meas_rate_ms measurement period (ms)
+ * @param buf frame will be saved in this buffer
+ * @param size size of buf
+ * @return size_t length of the frame (NMEA_UBX_CFG_RATE_SIZE), 0 if buf is too small
+ */
+size_t nmea_ubx_encode_cfg_rate(uint16_t meas_rate_ms, uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,879 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Columnar fix archive, host tool
+ *
+ * Build:  make -C tools build/fix_archive, or cc -O3 -march=native -o fix_archive tools/fix_archive.c -lm
+ *
+ * fix_archive build ARCHIVE VEHICLE_ID FILE.nmea...
+ *     Append the fixes of NMEA files (GGA and RMC of each epoch) of one vehicle to an archive.
+ * fix_archive query ARCHIVE [--from TIME] [--to TIME] [--bbox LAT0,LON0,LAT1,LON1] [--zone LAT0,LON0,LAT1,LON1]
+ *                           [--vehicle ID]
+ *     Count the fixes matching the filters, and compute distance, maximum speed and time in zone per vehicle.
+ *     TIME is YYYY-MM-DDTHH:MM:SS (UTC), coordinates are in degrees.
+ * fix_archive check [--vehicles N] [--hours H] [--seed S]
+ *     Regression check (exit 1 on failure): write the GGA and RMC statements of N vehicles driving H hours at 1 Hz
+ *     (20 and 12 by default), archive them as the build command does, then read every block back and decode all
+ *     of its columns. Every fix must come back as archived, a full query must count every fix, and the archive
+ *     must take at most FXA_CHECK_BYTES_PER_FIX bytes per fix, FXA_CHECK_RATIO times less than the statements.
+ *
+ * An archive is a sequence of blocks of up to FXA_BLOCK_ROWS fixes of one vehicle, in time order. Each block
+ * starts with min/max statistics of time, position and speed, followed by one compressed column per field
+ * (delta-encoded zigzag varints, second order for time). Queries read the block headers only, skip the
+ * blocks whose statistics do not match the filters, and decode only the columns they need. Filters are
+ * evaluated column by column with branch-free loops the compiler turns into SIMD code.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#define FXA_MAGIC (0x31415846UL) /* "FXA1" */
+#define FXA_BLOCK_ROWS (4096)
+#define FXA_MS_PER_DAY (86400000LL)
+#define FXA_M_PER_DEGREE (111319.49)
+#define FXA_MAX_GAP_MS (60000)    /* Fixes further apart are not joined for distance and time in zone */
+#define FXA_MAX_VEHICLES (4096)
+#define FXA_CHECK_BYTES_PER_FIX (10.0)
+#define FXA_CHECK_RATIO (14.0)
+
+/**
+ * @brief Columns of an archive block
+ *
+ */
+typedef enum {
+    FXA_COL_TIME,     /*!< UTC time (ms since 2000-01-01) */
+    FXA_COL_LAT,      /*!< Latitude (degrees * 1e7) */
+    FXA_COL_LON,      /*!< Longitude (degrees * 1e7) */
+    FXA_COL_ALT,      /*!< Altitude (cm) */
+    FXA_COL_SPEED,    /*!< Ground speed (cm/s) */
+    FXA_COL_FIX,      /*!< Fix status (GGA quality) */
+    FXA_COL_DOP,      /*!< HDOP (0.01) */
+    FXA_COL_NUM,
+} fxa_col_t;
+
+/**
+ * @brief Block header, followed by the columns
+ *
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                  /*!< FXA_MAGIC */
+    uint32_t vehicle;                /*!< Vehicle identifier */
+    uint32_t rows;                   /*!< Number of fixes */
+    int64_t time_min;                /*!< Time of the first fix */
+    int64_t time_max;                /*!< Time of the last fix */
+    int32_t lat_min;                 /*!< Minimum latitude */
+    int32_t lat_max;                 /*!< Maximum latitude */
+    int32_t lon_min;                 /*!< Minimum longitude */
+    int32_t lon_max;                 /*!< Maximum longitude */
+    uint32_t speed_max;              /*!< Maximum speed */
+    uint32_t col_size[FXA_COL_NUM];  /*!< Size of each column (bytes) */
+} fxa_block_header_t;
+
+/**
+ * @brief Decoded columns of a block
+ *
+ */
+typedef struct {
+    int64_t time[FXA_BLOCK_ROWS];
+    int32_t lat[FXA_BLOCK_ROWS];
+    int32_t lon[FXA_BLOCK_ROWS];
+    int32_t alt[FXA_BLOCK_ROWS];
+    int32_t speed[FXA_BLOCK_ROWS];
+    int32_t fix[FXA_BLOCK_ROWS];
+    int32_t dop[FXA_BLOCK_ROWS];
+    uint32_t rows;
+} fxa_rows_t;
+
+/**
+ * @brief Query filters
+ *
+ */
+typedef struct {
+    int64_t from;     /*!< Minimum time */
+    int64_t to;       /*!< Maximum time */
+    int32_t lat_min;  /*!< Bounding box, minimum latitude */
+    int32_t lat_max;  /*!< Bounding box, maximum latitude */
+    int32_t lon_min;  /*!< Bounding box, minimum longitude */
+    int32_t lon_max;  /*!< Bounding box, maximum longitude */
+    int32_t zone[4];  /*!< Zone for time in zone (lat_min, lon_min, lat_max, lon_max) */
+    bool has_zone;    /*!< Zone given */
+    int64_t vehicle;  /*!< Vehicle, -1 for all */
+} fxa_query_t;
+
+/**
+ * @brief Aggregates of a vehicle
+ *
+ */
+typedef struct {
+    uint32_t vehicle;     /*!< Vehicle identifier */
+    uint64_t fixes;       /*!< Fixes matching the filters */
+    double distance_m;    /*!< Distance between consecutive matching fixes */
+    int32_t speed_max;    /*!< Maximum speed (cm/s) */
+    int64_t zone_ms;      /*!< Time between consecutive matching fixes both in the zone */
+    int64_t last_time;    /*!< Time of the last matching fix, -1 if none */
+    int32_t last_lat;     /*!< Latitude of the last matching fix */
+    int32_t last_lon;     /*!< Longitude of the last matching fix */
+    bool last_in_zone;    /*!< Last matching fix was in the zone */
+} fxa_agg_t;
+
+/**
+ * @brief Put a signed integer as zigzag LEB128 variable length integer
+ *
+ */
+static size_t fxa_varint_put(uint8_t *buf, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t len = 0;
+    while (zigzag >= 0x80) {
+        buf[len++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    buf[len++] = (uint8_t)zigzag;
+    return len;
+}
+
+/**
+ * @brief Get a signed integer put by fxa_varint_put()
+ *
+ */
+static const uint8_t *fxa_varint_get(const uint8_t *p, const uint8_t *end, int64_t *value)
+{
+    uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        zigzag |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Encode a column, delta of the given order
+ *
+ * @return size_t size of the encoded column
+ */
+static size_t fxa_encode_column(const int64_t *value, uint32_t rows, int order, uint8_t *buf)
+{
+    size_t len = 0;
+    int64_t prev = 0;
+    int64_t prev_delta = 0;
+    for (uint32_t i = 0; i < rows; i++) {
+        int64_t delta = value[i] - prev;
+        len += fxa_varint_put(buf + len, order == 2 ? delta - prev_delta : delta);
+        prev = value[i];
+        prev_delta = delta;
+    }
+    return len;
+}
+
+/**
+ * @brief Decode a column encoded by fxa_encode_column()
+ *
+ * @return true on success, false on a truncated column
+ */
+static bool fxa_decode_column(const uint8_t *buf, size_t size, uint32_t rows, int order, int64_t *out64, int32_t *out32)
+{
+    const uint8_t *p = buf;
+    const uint8_t *end = buf + size;
+    int64_t prev = 0;
+    int64_t delta = 0;
+    for (uint32_t i = 0; i < rows; i++) {
+        int64_t value;
+        p = fxa_varint_get(p, end, &value);
+        if (!p) {
+            return false;
+        }
+        delta = order == 2 ? delta + value : value;
+        prev += delta;
+        if (out64) {
+            out64[i] = prev;
+        } else {
+            out32[i] = (int32_t)prev;
+        }
+    }
+    return true;
+}
+
+static const int fxa_col_order[FXA_COL_NUM] = {2, 1, 1, 1, 1, 1, 1};
+
+/**
+ * @brief Days since 2000-01-01 of a date, every 4th year is a leap year from 2000 to 2099
+ *
+ */
+static int64_t fxa_days(int year, int month, int day)
+{
+    static const int days_before_month[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    int y = year - 2000;
+    int64_t days = y * 365 + (y + 3) / 4 + days_before_month[month - 1] + day - 1;
+    if (month > 2 && (y % 4) == 0) {
+        days++;
+    }
+    return days;
+}
+
+/**
+ * @brief Parse a time argument, YYYY-MM-DDTHH:MM:SS
+ *
+ */
+static bool fxa_parse_time(const char *arg, int64_t *utc_ms)
+{
+    int year, month, day, hour, minute, second;
+    if (sscanf(arg, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6 ||
+            year < 2000 || year > 2099 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+    *utc_ms = fxa_days(year, month, day) * FXA_MS_PER_DAY + ((hour * 60 + minute) * 60 + second) * 1000LL;
+    return true;
+}
+
+/**
+ * @brief Parse a box argument, LAT0,LON0,LAT1,LON1 in degrees
+ *
+ * @param box lat_min, lon_min, lat_max, lon_max (degrees * 1e7)
+ */
+static bool fxa_parse_box(const char *arg, int32_t box[4])
+{
+    double v[4];
+    if (sscanf(arg, "%lf,%lf,%lf,%lf", &v[0], &v[1], &v[2], &v[3]) != 4) {
+        return false;
+    }
+    box[0] = (int32_t)lround(fmin(v[0], v[2]) * 1e7);
+    box[1] = (int32_t)lround(fmin(v[1], v[3]) * 1e7);
+    box[2] = (int32_t)lround(fmax(v[0], v[2]) * 1e7);
+    box[3] = (int32_t)lround(fmax(v[1], v[3]) * 1e7);
+    return true;
+}
+
+/**
+ * @brief Write a block of fixes
+ *
+ */
+static bool fxa_write_block(FILE *out, uint32_t vehicle, const fxa_rows_t *rows, uint8_t *buf)
+{
+    fxa_block_header_t header = {
+        .magic = FXA_MAGIC,
+        .vehicle = vehicle,
+        .rows = rows->rows,
+        .time_min = rows->time[0],
+        .time_max = rows->time[rows->rows - 1],
+        .lat_min = INT32_MAX,
+        .lat_max = INT32_MIN,
+        .lon_min = INT32_MAX,
+        .lon_max = INT32_MIN,
+    };
+    static int64_t column[FXA_BLOCK_ROWS];
+    size_t len = 0;
+    for (uint32_t i = 0; i < rows->rows; i++) {
+        header.lat_min = rows->lat[i] < header.lat_min ? rows->lat[i] : header.lat_min;
+        header.lat_max = rows->lat[i] > header.lat_max ? rows->lat[i] : header.lat_max;
+        header.lon_min = rows->lon[i] < header.lon_min ? rows->lon[i] : header.lon_min;
+        header.lon_max = rows->lon[i] > header.lon_max ? rows->lon[i] : header.lon_max;
+        header.speed_max = (uint32_t)rows->speed[i] > header.speed_max ? (uint32_t)rows->speed[i] : header.speed_max;
+    }
+    const int32_t *cols32[FXA_COL_NUM] = {NULL, rows->lat, rows->lon, rows->alt, rows->speed, rows->fix, rows->dop};
+    for (int c = 0; c < FXA_COL_NUM; c++) {
+        for (uint32_t i = 0; i < rows->rows; i++) {
+            column[i] = c == FXA_COL_TIME ? rows->time[i] : cols32[c][i];
+        }
+        header.col_size[c] = (uint32_t)fxa_encode_column(column, rows->rows, fxa_col_order[c], buf + len);
+        len += header.col_size[c];
+    }
+    return fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(buf, 1, len, out) == len;
+}
+
+/**
+ * @brief Check the checksum of a statement and split it into fields
+ *
+ * @return int number of fields, 0 if the statement is invalid
+ */
+static int fxa_nmea_split(char *line, char *field[], int max)
+{
+    char *star = strchr(line, '*');
+    if (line[0] != '$' || !star) {
+        return 0;
+    }
+    uint8_t crc = 0;
+    for (char *p = line + 1; p < star; p++) {
+        crc ^= (uint8_t)*p;
+    }
+    if (strtoul(star + 1, NULL, 16) != crc) {
+        return 0;
+    }
+    *star = '\0';
+    int n = 0;
+    char *p = line + 1;
+    while (n < max) {
+        field[n++] = p;
+        p = strchr(p, ',');
+        if (!p) {
+            break;
+        }
+        *p++ = '\0';
+    }
+    return n;
+}
+
+/**
+ * @brief Parse a NMEA coordinate, (d)ddmm.mmmm and hemisphere
+ *
+ */
+static int32_t fxa_nmea_coord(const char *value, const char *hemisphere)
+{
+    double raw = atof(value);
+    int degrees = (int)(raw / 100);
+    double deg = degrees + (raw - degrees * 100) / 60.0;
+    if (hemisphere[0] == 'S' || hemisphere[0] == 'W') {
+        deg = -deg;
+    }
+    return (int32_t)lround(deg * 1e7);
+}
+
+static int64_t fxa_nmea_time_ms(const char *value)
+{
+    double t = atof(value);
+    int hhmmss = (int)t;
+    return ((hhmmss / 10000) * 3600 + (hhmmss / 100 % 100) * 60 + hhmmss % 100) * 1000LL +
+           (int64_t)lround((t - hhmmss) * 1000);
+}
+
+/**
+ * @brief Append the fixes of a NMEA file to the rows of a vehicle, flushing full blocks
+ *
+ * An epoch is a GGA and a RMC with the same time, the date comes from the last RMC.
+ *
+ * @return long number of fixes, -1 on write error
+ */
+static long fxa_build_file(FILE *in, FILE *out, uint32_t vehicle, fxa_rows_t *rows, uint8_t *buf)
+{
+    char line[256];
+    char *field[24];
+    int64_t day_ms = -1;
+    int64_t gga_time = -2;
+    int64_t rmc_time = -3;
+    int32_t lat = 0, lon = 0, alt = 0, fix = 0, dop = 0, speed = 0;
+    long fixes = 0;
+    while (fgets(line, sizeof(line), in)) {
+        int n = fxa_nmea_split(line, field, 24);
+        if (n < 10) {
+            continue;
+        }
+        const char *type = field[0] + (strlen(field[0]) >= 5 ? strlen(field[0]) - 3 : 0);
+        if (!strcmp(type, "GGA") && n >= 10) {
+            gga_time = fxa_nmea_time_ms(field[1]);
+            lat = fxa_nmea_coord(field[2], field[3]);
+            lon = fxa_nmea_coord(field[4], field[5]);
+            fix = atoi(field[6]);
+            dop = (int32_t)lround(atof(field[8]) * 100);
+            alt = (int32_t)lround(atof(field[9]) * 100);
+        } else if (!strcmp(type, "RMC") && n >= 10 && strlen(field[9]) == 6) {
+            rmc_time = fxa_nmea_time_ms(field[1]);
+            speed = (int32_t)lround(atof(field[7]) * 1852.0 / 36.0);
+            int date = atoi(field[9]);
+            day_ms = fxa_days(2000 + date % 100, date / 100 % 100, date / 10000) * FXA_MS_PER_DAY;
+        } else {
+            continue;
+        }
+        if (gga_time != rmc_time || day_ms < 0 || fix == 0) {
+            continue;
+        }
+        int64_t utc_ms = day_ms + gga_time;
+        gga_time = -2;
+        if (rows->rows && utc_ms <= rows->time[rows->rows - 1]) {
+            /* Keep blocks in time order */
+            continue;
+        }
+        uint32_t i = rows->rows++;
+        rows->time[i] = utc_ms;
+        rows->lat[i] = lat;
+        rows->lon[i] = lon;
+        rows->alt[i] = alt;
+        rows->speed[i] = speed;
+        rows->fix[i] = fix;
+        rows->dop[i] = dop;
+        fixes++;
+        if (rows->rows == FXA_BLOCK_ROWS) {
+            if (!fxa_write_block(out, vehicle, rows, buf)) {
+                return -1;
+            }
+            rows->rows = 0;
+        }
+    }
+    return fixes;
+}
+
+/**
+ * @brief Evaluate the filters on the decoded columns of a block
+ *
+ * Branch-free loops over fixed-width columns, vectorized by the compiler. Not inlined, so that the restrict
+ * qualifiers telling the vectorizer that match does not alias the columns are kept.
+ *
+ * @return uint32_t number of matching fixes
+ */
+static __attribute__((noinline)) uint32_t fxa_filter(const fxa_rows_t *restrict rows, const fxa_query_t *query, uint8_t *restrict match)
+{
+    uint32_t n = rows->rows;
+    const int64_t from = query->from;
+    const int64_t to = query->to;
+    for (uint32_t i = 0; i < n; i++) {
+        match[i] = (rows->time[i] >= from) & (rows->time[i] <= to);
+    }
+    const int32_t lat_min = query->lat_min, lat_max = query->lat_max;
+    const int32_t lon_min = query->lon_min, lon_max = query->lon_max;
+    for (uint32_t i = 0; i < n; i++) {
+        match[i] &= (rows->lat[i] >= lat_min) & (rows->lat[i] <= lat_max) &
+                    (rows->lon[i] >= lon_min) & (rows->lon[i] <= lon_max);
+    }
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        count += match[i];
+    }
+    return count;
+}
+
+/**
+ * @brief Accumulate the aggregates of the matching fixes of a block
+ *
+ * @param cos_lat cosine of the mean latitude of the block, scale of longitude to distance
+ */
+static void fxa_aggregate(const fxa_rows_t *rows, const uint8_t *match, const fxa_query_t *query, double cos_lat,
+                          fxa_agg_t *agg)
+{
+    for (uint32_t i = 0; i < rows->rows; i++) {
+        if (!match[i]) {
+            continue;
+        }
+        bool in_zone = query->has_zone && rows->lat[i] >= query->zone[0] && rows->lon[i] >= query->zone[1] &&
+                       rows->lat[i] <= query->zone[2] && rows->lon[i] <= query->zone[3];
+        if (agg->last_time >= 0 && rows->time[i] - agg->last_time <= FXA_MAX_GAP_MS) {
+            double north = (rows->lat[i] - agg->last_lat) * 1e-7 * FXA_M_PER_DEGREE;
+            double east = (rows->lon[i] - agg->last_lon) * 1e-7 * FXA_M_PER_DEGREE * cos_lat;
+            agg->distance_m += sqrt(north * north + east * east);
+            if (in_zone && agg->last_in_zone) {
+                agg->zone_ms += rows->time[i] - agg->last_time;
+            }
+        }
+        agg->speed_max = rows->speed[i] > agg->speed_max ? rows->speed[i] : agg->speed_max;
+        agg->last_time = rows->time[i];
+        agg->last_lat = rows->lat[i];
+        agg->last_lon = rows->lon[i];
+        agg->last_in_zone = in_zone;
+        agg->fixes++;
+    }
+}
+
+/**
+ * @brief Get the aggregates of a vehicle, created on first use
+ *
+ */
+static fxa_agg_t *fxa_agg_get(fxa_agg_t *agg, uint32_t *agg_num, uint32_t vehicle)
+{
+    for (uint32_t i = 0; i < *agg_num; i++) {
+        if (agg[i].vehicle == vehicle) {
+            return &agg[i];
+        }
+    }
+    if (*agg_num == FXA_MAX_VEHICLES) {
+        return NULL;
+    }
+    fxa_agg_t *a = &agg[(*agg_num)++];
+    memset(a, 0, sizeof(fxa_agg_t));
+    a->vehicle = vehicle;
+    a->last_time = -1;
+    return a;
+}
+
+static int fxa_cmd_build(int argc, char **argv)
+{
+    if (argc < 5) {
+        return 2;
+    }
+    FILE *out = fopen(argv[2], "ab");
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+    uint32_t vehicle = (uint32_t)strtoul(argv[3], NULL, 0);
+    fxa_rows_t *rows = calloc(1, sizeof(fxa_rows_t));
+    uint8_t *buf = malloc(FXA_BLOCK_ROWS * FXA_COL_NUM * 10);
+    long total = 0;
+    int ret = 0;
+    for (int i = 4; i < argc && !ret; i++) {
+        FILE *in = fopen(argv[i], "r");
+        if (!in) {
+            perror(argv[i]);
+            ret = 1;
+            break;
+        }
+        long fixes = fxa_build_file(in, out, vehicle, rows, buf);
+        fclose(in);
+        if (fixes < 0) {
+            ret = 1;
+        }
+        total += fixes;
+    }
+    if (!ret && rows->rows && !fxa_write_block(out, vehicle, rows, buf)) {
+        ret = 1;
+    }
+    long size = ftell(out);
+    if (fclose(out) != 0 || ret) {
+        fprintf(stderr, "write %s failed\n", argv[2]);
+        ret = 1;
+    } else {
+        printf("vehicle %u: %ld fixes appended, archive %ld bytes\n", (unsigned)vehicle, total, size);
+    }
+    free(rows);
+    free(buf);
+    return ret;
+}
+
+static int fxa_cmd_query(int argc, char **argv)
+{
+    fxa_query_t query = {
+        .from = INT64_MIN, .to = INT64_MAX,
+        .lat_min = INT32_MIN, .lat_max = INT32_MAX, .lon_min = INT32_MIN, .lon_max = INT32_MAX,
+        .vehicle = -1,
+    };
+    if (argc < 3) {
+        return 2;
+    }
+    for (int i = 3; i < argc; i++) {
+        int32_t box[4];
+        if (i + 1 == argc) {
+            return 2;
+        }
+        if (!strcmp(argv[i], "--from") && fxa_parse_time(argv[i + 1], &query.from)) {
+        } else if (!strcmp(argv[i], "--to") && fxa_parse_time(argv[i + 1], &query.to)) {
+        } else if (!strcmp(argv[i], "--bbox") && fxa_parse_box(argv[i + 1], box)) {
+            query.lat_min = box[0];
+            query.lon_min = box[1];
+            query.lat_max = box[2];
+            query.lon_max = box[3];
+        } else if (!strcmp(argv[i], "--zone") && fxa_parse_box(argv[i + 1], query.zone)) {
+            query.has_zone = true;
+        } else if (!strcmp(argv[i], "--vehicle")) {
+            query.vehicle = strtoul(argv[i + 1], NULL, 0);
+        } else {
+            return 2;
+        }
+        i++;
+    }
+    FILE *in = fopen(argv[2], "rb");
+    if (!in) {
+        perror(argv[2]);
+        return 1;
+    }
+    fxa_rows_t *rows = calloc(1, sizeof(fxa_rows_t));
+    uint8_t *buf = malloc(FXA_BLOCK_ROWS * FXA_COL_NUM * 10);
+    uint8_t *match = malloc(FXA_BLOCK_ROWS);
+    fxa_agg_t *agg = calloc(FXA_MAX_VEHICLES, sizeof(fxa_agg_t));
+    uint32_t agg_num = 0;
+    uint64_t blocks = 0, blocks_read = 0, fixes = 0;
+    int ret = 0;
+    fxa_block_header_t header;
+    while (fread(&header, sizeof(header), 1, in) == 1) {
+        size_t size = 0;
+        for (int c = 0; c < FXA_COL_NUM; c++) {
+            size += header.col_size[c];
+        }
+        if (header.magic != FXA_MAGIC || header.rows == 0 || header.rows > FXA_BLOCK_ROWS ||
+                size > FXA_BLOCK_ROWS * FXA_COL_NUM * 10) {
+            fprintf(stderr, "corrupted block at %ld\n", ftell(in) - (long)sizeof(header));
+            ret = 1;
+            break;
+        }
+        blocks++;
+        fixes += header.rows;
+        /* Skip the block from its statistics */
+        if ((query.vehicle >= 0 && header.vehicle != query.vehicle) ||
+                header.time_max < query.from || header.time_min > query.to ||
+                header.lat_max < query.lat_min || header.lat_min > query.lat_max ||
+                header.lon_max < query.lon_min || header.lon_min > query.lon_max) {
+            fseek(in, (long)size, SEEK_CUR);
+            continue;
+        }
+        if (fread(buf, 1, size, in) != size) {
+            ret = 1;
+            break;
+        }
+        blocks_read++;
+        /* Only time, position and speed are needed by the query */
+        const uint8_t *col = buf;
+        rows->rows = header.rows;
+        bool ok = fxa_decode_column(col, header.col_size[FXA_COL_TIME], header.rows, 2, rows->time, NULL);
+        col += header.col_size[FXA_COL_TIME];
+        ok = ok && fxa_decode_column(col, header.col_size[FXA_COL_LAT], header.rows, 1, NULL, rows->lat);
+        col += header.col_size[FXA_COL_LAT];
+        ok = ok && fxa_decode_column(col, header.col_size[FXA_COL_LON], header.rows, 1, NULL, rows->lon);
+        col += header.col_size[FXA_COL_LON] + header.col_size[FXA_COL_ALT];
+        ok = ok && fxa_decode_column(col, header.col_size[FXA_COL_SPEED], header.rows, 1, NULL, rows->speed);
+        if (!ok) {
+            fprintf(stderr, "corrupted column in block %llu\n", (unsigned long long)blocks);
+            ret = 1;
+            break;
+        }
+        if (fxa_filter(rows, &query, match)) {
+            fxa_agg_t *a = fxa_agg_get(agg, &agg_num, header.vehicle);
+            if (a) {
+                double cos_lat = cos(((double)header.lat_min + header.lat_max) * 0.5e-7 * M_PI / 180);
+                fxa_aggregate(rows, match, &query, cos_lat, a);
+            }
+        }
+    }
+    fxa_agg_t total = {0};
+    for (uint32_t i = 0; i < agg_num; i++) {
+        printf("vehicle %u: %llu fixes, %.3f km, max %.1f km/h, %.0f s in zone\n", (unsigned)agg[i].vehicle,
+               (unsigned long long)agg[i].fixes, agg[i].distance_m / 1000, agg[i].speed_max * 0.036,
+               agg[i].zone_ms / 1000.0);
+        total.fixes += agg[i].fixes;
+        total.distance_m += agg[i].distance_m;
+        total.speed_max = agg[i].speed_max > total.speed_max ? agg[i].speed_max : total.speed_max;
+        total.zone_ms += agg[i].zone_ms;
+    }
+    printf("total: %llu of %llu fixes, %.3f km, max %.1f km/h, %.0f s in zone, %llu of %llu blocks read\n",
+           (unsigned long long)total.fixes, (unsigned long long)fixes, total.distance_m / 1000, total.speed_max * 0.036,
+           total.zone_ms / 1000.0, (unsigned long long)blocks_read, (unsigned long long)blocks);
+    fclose(in);
+    free(rows);
+    free(buf);
+    free(match);
+    free(agg);
+    return ret;
+}
+
+/**
+ * @brief Uniform random number in [0, 1), xorshift64*
+ *
+ */
+static double fxa_uniform(uint64_t *rng)
+{
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return (double)((*rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+/**
+ * @brief Append a statement with its checksum and line ending
+ *
+ * @return int length of the statement
+ */
+static int fxa_statement(FILE *out, const char *body)
+{
+    uint8_t crc = 0;
+    for (const char *c = body; *c; c++) {
+        crc ^= (uint8_t)*c;
+    }
+    return fprintf(out, "$%s*%02X\r\n", body, crc);
+}
+
+/**
+ * @brief Write the statements of a vehicle and the fixes the archive must return
+ *
+ * The vehicle alternates stops and drives with a random walk of speed and heading, from 2026-10-18T00:00:00.
+ *
+ * @param expected blocks of fixes, parsed from the statements as the build command does
+ * @return long bytes of statements
+ */
+static long fxa_check_drive(FILE *out, uint32_t vehicle, uint32_t fixes, uint64_t *rng, fxa_rows_t *expected)
+{
+    double lat = 31.1 + 0.01 * (vehicle % 20), lon = 121.3 + 0.01 * (vehicle / 20 % 20);
+    double speed = 0, heading = 360 * fxa_uniform(rng), alt = 10 + 20 * fxa_uniform(rng);
+    uint32_t stop = 0;
+    long bytes = 0;
+    for (uint32_t i = 0; i < fixes; i++) {
+        if (stop) {
+            stop--;
+            speed = 0;
+        } else if (fxa_uniform(rng) < 1 / 600.0) {
+            stop = 30 + (uint32_t)(120 * fxa_uniform(rng));
+        } else {
+            speed = fmin(25, fmax(0, speed + 0.6 * (fxa_uniform(rng) - 0.5)));
+            heading = fmod(heading + 6 * (fxa_uniform(rng) - 0.5) + 360, 360);
+        }
+        lat += speed * cos(heading * M_PI / 180) / FXA_M_PER_DEGREE;
+        lon += speed * sin(heading * M_PI / 180) / (FXA_M_PER_DEGREE * cos(lat * M_PI / 180));
+        alt += 0.05 * (fxa_uniform(rng) - 0.5);
+        uint32_t s = i % 86400;
+        char utc[16], lat_text[16], lon_text[16], knots[16], dop[8], alt_text[16], body[160];
+        snprintf(utc, sizeof(utc), "%02u%02u%02u.00", s / 3600, s / 60 % 60, s % 60);
+        snprintf(lat_text, sizeof(lat_text), "%02d%08.5f", (int)lat, (lat - (int)lat) * 60);
+        snprintf(lon_text, sizeof(lon_text), "%03d%08.5f", (int)lon, (lon - (int)lon) * 60);
+        snprintf(knots, sizeof(knots), "%.2f", speed / 0.514444);
+        snprintf(dop, sizeof(dop), "%.1f", 0.8 + 0.1 * (int)(4 * fxa_uniform(rng)));
+        snprintf(alt_text, sizeof(alt_text), "%.1f", alt);
+        snprintf(body, sizeof(body), "GPGGA,%s,%s,N,%s,E,1,09,%s,%s,M,8.0,M,,", utc, lat_text, lon_text, dop,
+                 alt_text);
+        bytes += fxa_statement(out, body);
+        snprintf(body, sizeof(body), "GPRMC,%s,A,%s,N,%s,E,%s,%.1f,%02u1026,,,A", utc, lat_text, lon_text, knots,
+                 heading, 18 + i / 86400);
+        bytes += fxa_statement(out, body);
+        fxa_rows_t *block = &expected[i / FXA_BLOCK_ROWS];
+        uint32_t k = i % FXA_BLOCK_ROWS;
+        block->time[k] = fxa_days(2026, 10, 18) * FXA_MS_PER_DAY + i * 1000LL;
+        block->lat[k] = fxa_nmea_coord(lat_text, "N");
+        block->lon[k] = fxa_nmea_coord(lon_text, "E");
+        block->alt[k] = (int32_t)lround(atof(alt_text) * 100);
+        block->speed[k] = (int32_t)lround(atof(knots) * 1852.0 / 36.0);
+        block->fix[k] = 1;
+        block->dop[k] = (int32_t)lround(atof(dop) * 100);
+    }
+    return bytes;
+}
+
+static int fxa_cmd_check(int argc, char **argv)
+{
+    uint32_t vehicles = 20, hours = 12;
+    uint64_t rng = 7;
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            return 2;
+        }
+        if (!strcmp(argv[i], "--vehicles")) {
+            vehicles = strtoul(argv[i + 1], NULL, 0);
+        } else if (!strcmp(argv[i], "--hours")) {
+            hours = strtoul(argv[i + 1], NULL, 0);
+        } else if (!strcmp(argv[i], "--seed")) {
+            rng = strtoull(argv[i + 1], NULL, 0);
+        } else {
+            return 2;
+        }
+    }
+    uint32_t fixes = hours * 3600;
+    if (!vehicles || vehicles > FXA_MAX_VEHICLES || !fixes || hours > 13 * 24 || !rng) {
+        return 2;
+    }
+    fxa_rows_t *rows = calloc(1, sizeof(fxa_rows_t));
+    fxa_rows_t *decoded = calloc(1, sizeof(fxa_rows_t));
+    fxa_rows_t *expected = malloc(sizeof(fxa_rows_t) * ((fixes + FXA_BLOCK_ROWS - 1) / FXA_BLOCK_ROWS));
+    uint8_t *buf = malloc(FXA_BLOCK_ROWS * FXA_COL_NUM * 10);
+    FILE *archive = tmpfile();
+    if (!rows || !decoded || !expected || !buf || !archive) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    int failures = 0;
+    long nmea_bytes = 0;
+    uint64_t mismatch = 0, blocks = 0;
+    for (uint32_t v = 0; v < vehicles; v++) {
+        FILE *nmea = tmpfile();
+        if (!nmea) {
+            perror("tmpfile");
+            failures++;
+            break;
+        }
+        long start = ftell(archive);
+        nmea_bytes += fxa_check_drive(nmea, v, fixes, &rng, expected);
+        rewind(nmea);
+        rows->rows = 0;
+        long built = fxa_build_file(nmea, archive, v, rows, buf);
+        fclose(nmea);
+        if (built != (long)fixes || (rows->rows && !fxa_write_block(archive, v, rows, buf))) {
+            printf("FAIL: vehicle %u, %ld of %u fixes archived\n", (unsigned)v, built, (unsigned)fixes);
+            failures++;
+            break;
+        }
+        /* Read the blocks of the vehicle back, every column */
+        long end = ftell(archive);
+        fseek(archive, start, SEEK_SET);
+        fxa_block_header_t header;
+        uint32_t row = 0;
+        while (ftell(archive) < end && fread(&header, sizeof(header), 1, archive) == 1) {
+            size_t size = 0;
+            for (int c = 0; c < FXA_COL_NUM; c++) {
+                size += header.col_size[c];
+            }
+            if (header.magic != FXA_MAGIC || header.vehicle != v || header.rows > FXA_BLOCK_ROWS ||
+                    fread(buf, 1, size, archive) != size) {
+                mismatch++;
+                break;
+            }
+            int32_t *cols32[FXA_COL_NUM] = {NULL, decoded->lat, decoded->lon, decoded->alt, decoded->speed,
+                                            decoded->fix, decoded->dop
+                                           };
+            const uint8_t *col = buf;
+            for (int c = 0; c < FXA_COL_NUM; c++) {
+                if (!fxa_decode_column(col, header.col_size[c], header.rows, fxa_col_order[c],
+                                       c == FXA_COL_TIME ? decoded->time : NULL, cols32[c])) {
+                    mismatch++;
+                }
+                col += header.col_size[c];
+            }
+            for (uint32_t i = 0; i < header.rows && row < fixes; i++, row++) {
+                const fxa_rows_t *e = &expected[row / FXA_BLOCK_ROWS];
+                uint32_t k = row % FXA_BLOCK_ROWS;
+                mismatch += decoded->time[i] != e->time[k] || decoded->lat[i] != e->lat[k] ||
+                            decoded->lon[i] != e->lon[k] || decoded->alt[i] != e->alt[k] ||
+                            decoded->speed[i] != e->speed[k] || decoded->fix[i] != e->fix[k] ||
+                            decoded->dop[i] != e->dop[k];
+            }
+            blocks++;
+        }
+        if (row != fixes) {
+            mismatch += fixes - row;
+        }
+        fseek(archive, end, SEEK_SET);
+    }
+    long archive_bytes = ftell(archive);
+    uint64_t total = (uint64_t)vehicles * fixes;
+    double per_fix = (double)archive_bytes / total;
+    double ratio = (double)nmea_bytes / archive_bytes;
+    printf("%u vehicles, %u hours at 1 Hz: %llu fixes in %llu blocks\n", (unsigned)vehicles, (unsigned)hours,
+           (unsigned long long)total, (unsigned long long)blocks);
+    printf("  statements %.1f MB (%.1f bytes per fix), archive %.2f MB (%.2f bytes per fix), %.1f times smaller\n",
+           nmea_bytes / 1e6, (double)nmea_bytes / total, archive_bytes / 1e6, per_fix, ratio);
+    printf("  %llu fixes decoded differently\n", (unsigned long long)mismatch);
+    if (mismatch) {
+        printf("FAIL: every fix must be decoded as archived\n");
+        failures++;
+    }
+    if (per_fix > FXA_CHECK_BYTES_PER_FIX || ratio < FXA_CHECK_RATIO) {
+        printf("FAIL: limits are %.1f bytes per fix, %.0f times smaller than the statements\n",
+               FXA_CHECK_BYTES_PER_FIX, FXA_CHECK_RATIO);
+        failures++;
+    }
+    free(rows);
+    free(decoded);
+    free(expected);
+    free(buf);
+    fclose(archive);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = 2;
+    if (argc >= 2 && !strcmp(argv[1], "build")) {
+        ret = fxa_cmd_build(argc, argv);
+    } else if (argc >= 2 && !strcmp(argv[1], "query")) {
+        ret = fxa_cmd_query(argc, argv);
+    } else if (argc >= 2 && !strcmp(argv[1], "check")) {
+        ret = fxa_cmd_check(argc, argv);
+    }
+    if (ret == 2) {
+        fprintf(stderr, "usage: %s build ARCHIVE VEHICLE_ID FILE.nmea...\n"
+                "       %s query ARCHIVE [--from YYYY-MM-DDTHH:MM:SS] [--to YYYY-MM-DDTHH:MM:SS]\n"
+                "                [--bbox LAT0,LON0,LAT1,LON1] [--zone LAT0,LON0,LAT1,LON1] [--vehicle ID]\n"
+                "       %s check [--vehicles N] [--hours H] [--seed S]\n",
+                argv[0], argv[0], argv[0]);
+    }
+    return ret;
+}
@@ -0,0 +1,522 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Statement decoder fuzz harness, host tool and regression check
+ *
+ * Build:  cc -O1 -g -fsanitize=address,undefined,float-cast-overflow -fno-sanitize-recover=all \
+ *            -DCONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM=2 -Itools/host -Imain -o fuzz_decoder tools/fuzz_decoder.c \
+ *            tools/host/nmea_sim.c main/nmea_decoder.c main/nmea_ubx.c -lm
+ * libFuzzer: the same with clang, -fsanitize=fuzzer,address,undefined and -DFUZZ_DECODER_LIBFUZZER, which leaves
+ *            out main() below; AFL: the same with afl-clang-fast, run as fuzz_decoder -n 0 @@
+ *
+ * fuzz_decoder [-n ITERATIONS] [-s SEED] PATH...
+ *     Decode each corpus file of PATH (files, or directories of files) as one input, then ITERATIONS inputs of 1 to
+ *     8 statements taken from the corpus and mutated: bit flips, NMEA characters, deletions, runs of digits and
+ *     commas, truncation, numbers such as nan, inf, 1e39 or 4294967296, and pieces of other statements. Their
+ *     checksum is recomputed in 15 of 16 statements so that most mutations reach field decoding, the line end is
+ *     left out of 1 in 32, and UBX sync chars followed by random bytes are added after 1 in 64.
+ *
+ * Each input is decoded by a fresh decoder in one call with all statements completing an epoch, then by another one
+ * split at positions taken from the input with GGA and RMC completing an epoch. A TXT and a PMTK user parser take
+ * their items, and each epoch goes through nmea_decoder_fix_core() and nmea_ubx_encode_epoch().
+ *
+ * Reported: inputs and their bytes, then over both decoders the epochs, user items, statements rejected by checksum
+ * and unknown, and bytes lost.
+ *
+ * Regression checks (exit 1 on failure): the sanitizers stop on any memory error or undefined behaviour, and an
+ * invariant aborts (so that libFuzzer and AFL report it as a crash): a user item longer than the line buffer, a UBX
+ * epoch out of its size, a position beyond 180 degrees, a statement staged beyond the line buffer. With ITERATIONS,
+ * the run also fails if the corpus decodes no epoch or the mutated inputs reach no user item.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "nmea_decoder.h"
+#include "nmea_ubx.h"
+#include "nmea_sim.h"
+
+#if CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM < 2
+#error "fuzz_decoder needs two user statement parsers, build it with -DCONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM=2"
+#endif
+
+#define FZ_STATEMENTS_MAX (8)    /* Statements of a mutated input */
+#define FZ_BODY_MAX (300)        /* Length of a mutated statement body */
+#define FZ_INPUT_MAX (4096)      /* Length of a mutated input */
+#define FZ_SEEDS_MAX (4096)      /* Statement bodies taken from the corpus */
+
+#define FZ_CHECK(cond)                                                                   \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            fprintf(stderr, "%s:%d: invariant failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort();                                                                     \
+        }                                                                                \
+    } while (0)
+
+/**
+ * @brief Counters of the decoded inputs
+ *
+ */
+typedef struct {
+    uint32_t inputs;     /*!< Inputs decoded */
+    uint64_t bytes;      /*!< Bytes of the inputs */
+    uint32_t epochs;     /*!< Epochs decoded */
+    uint32_t items;      /*!< Items passed to the user parsers */
+    uint32_t crc_error;  /*!< Statements rejected by checksum */
+    uint32_t unknown;    /*!< Statements without parser */
+    uint64_t lost_bytes; /*!< Bytes dropped while resynchronizing */
+} fz_stats_t;
+
+static fz_stats_t fz_stats;
+
+/**
+ * @brief Random number below n
+ *
+ * @param rng state of the generator
+ * @param n bound, above 0
+ * @return uint32_t random number
+ */
+static uint32_t fz_rand(uint64_t *rng, uint32_t n)
+{
+    return (uint32_t)(nmea_sim_uniform(rng) * n);
+}
+
+/**
+ * @brief Epoch callback, through the fix core and the UBX encoder as the parser task does
+ *
+ * @param ctx unused
+ * @param gps decoded epoch
+ * @param data data being decoded
+ * @param len length of data
+ */
+static void fz_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    static uint8_t frames[NMEA_UBX_EPOCH_MAX_SIZE];
+    gps_fix_core_t core;
+    (void)ctx;
+    (void)data;
+    (void)len;
+    nmea_decoder_fix_core(gps, &core);
+    FZ_CHECK(core.latitude >= -1800000000 && core.latitude <= 1800000000);
+    FZ_CHECK(core.longitude >= -1800000000 && core.longitude <= 1800000000);
+    size_t n = nmea_ubx_encode_epoch(gps, frames, sizeof(frames));
+    FZ_CHECK(n > 0 && n <= sizeof(frames));
+    fz_stats.epochs++;
+}
+
+/**
+ * @brief Item of a user statement
+ *
+ * @param parser_args unused
+ * @param item_num item number
+ * @param item item string
+ */
+static void fz_item(void *parser_args, uint8_t item_num, const char *item)
+{
+    (void)parser_args;
+    (void)item_num;
+    FZ_CHECK(strlen(item) < NMEA_MAX_STATEMENT_LENGTH);
+    fz_stats.items++;
+}
+
+/**
+ * @brief End of a user statement
+ *
+ * @param parser_args unused
+ */
+static void fz_statement_end(void *parser_args)
+{
+    (void)parser_args;
+}
+
+/**
+ * @brief Init a decoder with the user parsers
+ *
+ * @param decoder decoder
+ * @param statements statements completing an epoch
+ */
+static void fz_decoder_init(nmea_decoder_t *decoder, uint32_t statements)
+{
+    static const nmea_decoder_cb_t cb = {.epoch = fz_epoch};
+    nmea_decoder_init(decoder, statements, &cb);
+    decoder->user_parser[0] = (nmea_parser_statement_parser_t) {
+        .name = "TXT", .parse_item = fz_item, .statement_end = fz_statement_end,
+    };
+    decoder->user_parser[1] = (nmea_parser_statement_parser_t) {
+        .name = "PMTK", .parse_item = fz_item,
+    };
+}
+
+/**
+ * @brief Add the counters of a decoder
+ *
+ * @param decoder decoder after its input
+ */
+static void fz_decoder_done(const nmea_decoder_t *decoder)
+{
+    FZ_CHECK(decoder->stmt_len < NMEA_MAX_STATEMENT_LENGTH);
+    fz_stats.crc_error += decoder->crc_error;
+    fz_stats.unknown += decoder->unknown;
+    fz_stats.lost_bytes += decoder->lost_bytes;
+}
+
+/**
+ * @brief Decode one input, entry point of libFuzzer
+ *
+ * @param data input
+ * @param size length of input
+ * @return int 0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static nmea_decoder_t decoder;
+    fz_decoder_init(&decoder, 0);
+    nmea_decoder_feed(&decoder, data, size);
+    fz_decoder_done(&decoder);
+
+    /* Split positions from a hash of the input, so that a crash is reproduced by the input alone */
+    uint64_t rng = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        rng = (rng ^ data[i]) * 1099511628211ULL;
+    }
+    fz_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC));
+    for (size_t off = 0, len; off < size; off += len) {
+        len = 1 + fz_rand(&rng, size - off < 64 ? size - off : 64);
+        nmea_decoder_feed(&decoder, data + off, len);
+    }
+    fz_decoder_done(&decoder);
+    fz_stats.inputs++;
+    fz_stats.bytes += size;
+    return 0;
+}
+
+#ifndef FUZZ_DECODER_LIBFUZZER
+
+static const char fz_alphabet[] = "0123456789,,,,..*-+NSEWAV$\r\n\0eEnaif ";
+
+static const char *const fz_numbers[] = {
+    "nan", "inf", "-inf", "NaN", "1e39", "-1e39", "1e-45", "99999999999", "-2147483648", "4294967296",
+    "0", "00", "-", ".", "255", "256", "65536", "-1",
+};
+
+static char *fz_seeds[FZ_SEEDS_MAX];
+static size_t fz_seed_num;
+
+/**
+ * @brief Insert bytes into a statement body
+ *
+ * @param body body
+ * @param len length of body
+ * @param pos position of the bytes
+ * @param bytes bytes to insert, NULL to leave them to the caller
+ * @param n number of bytes
+ * @return size_t new length of body, len if the bytes do not fit
+ */
+static size_t fz_insert(char *body, size_t len, size_t pos, const char *bytes, size_t n)
+{
+    if (len + n > FZ_BODY_MAX) {
+        return len;
+    }
+    memmove(body + pos + n, body + pos, len - pos);
+    if (bytes) {
+        memcpy(body + pos, bytes, n);
+    }
+    return len + n;
+}
+
+/**
+ * @brief Apply 1 to 6 random mutations to a statement body
+ *
+ * @param rng state of the generator
+ * @param body body, FZ_BODY_MAX bytes
+ * @param len length of body
+ * @return size_t new length of body
+ */
+static size_t fz_mutate(uint64_t *rng, char *body, size_t len)
+{
+    for (int k = 1 + fz_rand(rng, 6); k > 0; k--) {
+        size_t pos = fz_rand(rng, len + 1);
+        size_t n;
+        const char *s;
+        switch (fz_rand(rng, 10)) {
+        case 0: /* Bit flip */
+            if (pos < len) {
+                body[pos] ^= 1 << fz_rand(rng, 8);
+            }
+            break;
+        case 1: /* NMEA character */
+            if (pos < len) {
+                body[pos] = fz_alphabet[fz_rand(rng, sizeof(fz_alphabet) - 1)];
+            }
+            break;
+        case 2:
+            len = fz_insert(body, len, pos, &fz_alphabet[fz_rand(rng, sizeof(fz_alphabet) - 1)], 1);
+            break;
+        case 3: /* Deletion */
+            n = 1 + fz_rand(rng, 8);
+            if (pos + n <= len) {
+                memmove(body + pos, body + pos + n, len - pos - n);
+                len -= n;
+            }
+            break;
+        case 4: /* Run of digits and commas, over-long items and statements */
+            n = fz_rand(rng, 40);
+            if (fz_insert(body, len, pos, NULL, n) != len) {
+                for (size_t i = 0; i < n; i++) {
+                    body[pos + i] = fz_rand(rng, 3) ? '9' : ',';
+                }
+                len += n;
+            }
+            break;
+        case 5: /* Truncation */
+            len = pos;
+            break;
+        case 6: /* Any byte */
+            if (pos < len) {
+                body[pos] = (char)fz_rand(rng, 256);
+            }
+            break;
+        case 7: /* Digits */
+            n = fz_rand(rng, 20);
+            if (fz_insert(body, len, pos, NULL, n) != len) {
+                for (size_t i = 0; i < n; i++) {
+                    body[pos + i] = '0' + fz_rand(rng, 10);
+                }
+                len += n;
+            }
+            break;
+        case 8: /* Number out of the range of an item */
+            s = fz_numbers[fz_rand(rng, sizeof(fz_numbers) / sizeof(fz_numbers[0]))];
+            len = fz_insert(body, len, pos, s, strlen(s));
+            break;
+        default: /* Half of another statement */
+            s = fz_seeds[fz_rand(rng, fz_seed_num)];
+            n = strlen(s) / 2;
+            len = fz_insert(body, len, pos, s + fz_rand(rng, n + 1), n);
+            break;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief Build and decode a mutated input
+ *
+ * @param rng state of the generator
+ */
+static void fz_mutated_input(uint64_t *rng)
+{
+    static uint8_t input[FZ_INPUT_MAX];
+    size_t len = 0;
+    for (int k = 1 + fz_rand(rng, FZ_STATEMENTS_MAX); k > 0; k--) {
+        char body[FZ_BODY_MAX];
+        const char *seed = fz_seeds[fz_rand(rng, fz_seed_num)];
+        size_t n = strlen(seed);
+        memcpy(body, seed, n);
+        if (fz_rand(rng, 8)) {
+            n = fz_mutate(rng, body, n);
+        }
+        if (len + n + 40 > sizeof(input)) {
+            break;
+        }
+        uint8_t crc = 0;
+        for (size_t i = 0; i < n; i++) {
+            crc ^= body[i];
+        }
+        if (!fz_rand(rng, 16)) {
+            crc ^= 1 + fz_rand(rng, 255);
+        }
+        input[len++] = '$';
+        memcpy(input + len, body, n);
+        len += n;
+        if (fz_rand(rng, 32)) {
+            len += sprintf((char *)input + len, "*%02X\r\n", crc);
+        }
+        if (!fz_rand(rng, 64)) {
+            input[len++] = 0xB5;
+            input[len++] = 0x62;
+            for (int i = 0; i < 30; i++) {
+                input[len++] = fz_rand(rng, 256);
+            }
+        }
+    }
+    LLVMFuzzerTestOneInput(input, len);
+}
+
+/**
+ * @brief Add the statement bodies of a corpus file to the seeds of the mutations
+ *
+ * @param data file
+ * @param len length of file
+ */
+static void fz_add_seeds(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len && fz_seed_num < FZ_SEEDS_MAX; i++) {
+        if (data[i] != '$') {
+            continue;
+        }
+        size_t n = 0;
+        while (i + 1 + n < len && n < FZ_BODY_MAX && !memchr("$*\r\n", data[i + 1 + n], 4)) {
+            n++;
+        }
+        char *seed = malloc(n + 1);
+        if (!seed) {
+            return;
+        }
+        memcpy(seed, data + i + 1, n);
+        seed[n] = '\0';
+        fz_seeds[fz_seed_num++] = seed;
+    }
+}
+
+/**
+ * @brief Decode a corpus file, and add its statements to the seeds
+ *
+ * @param path file
+ * @return int 0 on success, -1 if it cannot be read
+ */
+static int fz_run_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if (size < 0 || !data || fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    LLVMFuzzerTestOneInput(data, size);
+    fz_add_seeds(data, size);
+    free(data);
+    return 0;
+}
+
+/**
+ * @brief Compare two file names
+ *
+ * @param a name
+ * @param b name
+ * @return int order of the names
+ */
+static int fz_name_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief Decode a corpus file, or the files of a corpus directory in name order
+ *
+ * @param path file or directory
+ * @return int 0 on success, -1 if a file cannot be read
+ */
+static int fz_run_path(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return fz_run_file(path);
+    }
+    char *names[1024];
+    size_t count = 0;
+    struct dirent *entry;
+    while (count < sizeof(names) / sizeof(names[0]) && (entry = readdir(dir))) {
+        if (entry->d_name[0] != '.') {
+            names[count++] = strdup(entry->d_name);
+        }
+    }
+    closedir(dir);
+    qsort(names, count, sizeof(names[0]), fz_name_cmp);
+    int ret = 0;
+    for (size_t i = 0; i < count; i++) {
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/%s", path, names[i]);
+        if (fz_run_file(file)) {
+            fprintf(stderr, "cannot read %s\n", file);
+            ret = -1;
+        }
+        free(names[i]);
+    }
+    return ret;
+}
+
+/**
+ * @brief Print the counters
+ *
+ * @param name name of the run
+ * @param stats counters of the run
+ */
+static void fz_report(const char *name, const fz_stats_t *stats)
+{
+    printf("%-8s %9u inputs %11llu bytes %9u epochs %9u user items %9u crc errors %8u unknown %11llu lost bytes\n",
+           name, (unsigned)stats->inputs, (unsigned long long)stats->bytes, (unsigned)stats->epochs,
+           (unsigned)stats->items, (unsigned)stats->crc_error, (unsigned)stats->unknown,
+           (unsigned long long)stats->lost_bytes);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = 200000;
+    uint64_t seed = 1;
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-n")) {
+            iterations = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    if (i == argc || argv[i][0] == '-') {
+        fprintf(stderr, "usage: %s [-n ITERATIONS] [-s SEED] PATH...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (; i < argc; i++) {
+        if (fz_run_path(argv[i])) {
+            failed = 1;
+        }
+    }
+    fz_stats_t corpus = fz_stats;
+    fz_report("corpus", &corpus);
+    if (iterations && !corpus.epochs) {
+        printf("FAIL: no epoch decoded from the corpus\n");
+        failed = 1;
+    }
+    if (iterations && fz_seed_num) {
+        memset(&fz_stats, 0, sizeof(fz_stats));
+        for (unsigned long it = 0; it < iterations; it++) {
+            fz_mutated_input(&seed);
+        }
+        fz_report("mutated", &fz_stats);
+        if (!fz_stats.items) {
+            printf("FAIL: no user item decoded from the mutated inputs\n");
+            failed = 1;
+        }
+    }
+    for (size_t k = 0; k < fz_seed_num; k++) {
+        free(fz_seeds[k]);
+    }
+    return failed;
+}
+
+#endif
@@ -0,0 +1,143 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "nmea_sim.h"
+
+#define NMEA_SIM_KNOT (0.514444) /* m/s */
+
+int nmea_sim_drive(nmea_sim_drive_t *drive, const nmea_sim_segment_t *segments, size_t count, uint32_t laps,
+                   double heading, double lat0, double lon0)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += (size_t)llround(segments[i].duration * 1000 / NMEA_SIM_DT_MS);
+    }
+    total *= laps;
+    drive->state = malloc((total + 1) * sizeof(nmea_sim_truth_t));
+    if (!drive->state) {
+        return -1;
+    }
+    drive->lat0 = lat0;
+    drive->lon0 = lon0;
+    const double dt = NMEA_SIM_DT_MS / 1000.0;
+    nmea_sim_truth_t x = {.heading = heading};
+    size_t k = 0;
+    for (uint32_t lap = 0; lap < laps; lap++) {
+        for (size_t i = 0; i < count; i++) {
+            size_t steps = (size_t)llround(segments[i].duration * 1000 / NMEA_SIM_DT_MS);
+            for (size_t s = 0; s < steps; s++) {
+                x.segment = (uint32_t)i;
+                drive->state[k++] = x;
+                /* Heading and speed at mid-step, exact for constant turn rate and acceleration */
+                double speed = fmax(0, x.speed + segments[i].accel * dt / 2);
+                double h = (x.heading + segments[i].turn * dt / 2) * M_PI / 180;
+                x.east += speed * sin(h) * dt;
+                x.north += speed * cos(h) * dt;
+                x.speed = fmax(0, x.speed + segments[i].accel * dt);
+                x.heading = fmod(x.heading + segments[i].turn * dt + 360, 360);
+            }
+        }
+    }
+    drive->state[k++] = x;
+    drive->count = k;
+    return 0;
+}
+
+void nmea_sim_drive_free(nmea_sim_drive_t *drive)
+{
+    free(drive->state);
+    drive->state = NULL;
+    drive->count = 0;
+}
+
+const nmea_sim_truth_t *nmea_sim_at(const nmea_sim_drive_t *drive, int64_t ms)
+{
+    int64_t k = ms / NMEA_SIM_DT_MS;
+    if (k < 0) {
+        k = 0;
+    } else if (k >= (int64_t)drive->count) {
+        k = drive->count - 1;
+    }
+    return &drive->state[k];
+}
+
+size_t nmea_sim_statement(char *out, const char *body)
+{
+    uint8_t crc = 0;
+    for (const char *c = body; *c; c++) {
+        crc ^= (uint8_t)*c;
+    }
+    return sprintf(out, "$%s*%02X\r\n", body, crc);
+}
+
+/**
+ * @brief Write an angle as ddmm.mmmmmm (latitude) or dddmm.mmmmmm (longitude) and its hemisphere
+ *
+ */
+static void nmea_sim_angle(double deg, int lat, char *out)
+{
+    char hemi = lat ? (deg < 0 ? 'S' : 'N') : (deg < 0 ? 'W' : 'E');
+    long long um = llround(fabs(deg) * 60e6);
+    sprintf(out, lat ? "%02lld%02lld.%06lld,%c" : "%03lld%02lld.%06lld,%c", um / 60000000, um / 1000000 % 60,
+            um % 1000000, hemi);
+}
+
+size_t nmea_sim_epoch(const nmea_sim_drive_t *drive, const nmea_sim_fix_t *fix, char *out)
+{
+    char body[160];
+    char lat[24];
+    char lon[24];
+    double latitude = drive->lat0 + fix->north / NMEA_SIM_M_PER_DEGREE;
+    double longitude = drive->lon0 + fix->east / (NMEA_SIM_M_PER_DEGREE * cos(drive->lat0 * M_PI / 180));
+    nmea_sim_angle(latitude, 1, lat);
+    nmea_sim_angle(longitude, 0, lon);
+    uint32_t ms = fix->time_ms % 86400000;
+    char utc[16];
+    sprintf(utc, "%02u%02u%02u.%03u", ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000);
+    size_t len = 0;
+    sprintf(body, "GPGGA,%s,%s,%s,%d,%02u,%.1f,30.0,M,18.0,M,,", utc, lat, lon, fix->valid ? 1 : 0, fix->sats,
+            fix->hdop);
+    len += nmea_sim_statement(out + len, body);
+    sprintf(body, "GPRMC,%s,%c,%s,%s,%.3f,%.2f,181026,,,%c", utc, fix->valid ? 'A' : 'V', lat, lon,
+            fix->speed / NMEA_SIM_KNOT, fmod(fix->course + 360, 360), fix->valid ? 'A' : 'N');
+    len += nmea_sim_statement(out + len, body);
+    return len;
+}
+
+void nmea_sim_local(const nmea_sim_drive_t *drive, int32_t latitude, int32_t longitude, double *east, double *north)
+{
+    *north = (latitude / 1e7 - drive->lat0) * NMEA_SIM_M_PER_DEGREE;
+    *east = (longitude / 1e7 - drive->lon0) * NMEA_SIM_M_PER_DEGREE * cos(drive->lat0 * M_PI / 180);
+}
+
+double nmea_sim_uniform(uint64_t *rng)
+{
+    /* xorshift64*, a zero state is moved off the fixed point */
+    uint64_t x = *rng ? *rng : 0x9E3779B97F4A7C15ULL;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng = x;
+    return ((x * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double nmea_sim_gauss(uint64_t *rng, double sigma)
+{
+    double u = 1.0 - nmea_sim_uniform(rng);
+    double v = nmea_sim_uniform(rng);
+    return sigma * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
@@ -0,0 +1,156 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Simulated drives and receivers for the host tools
+ *
+ * A drive is a list of segments of constant acceleration and turn rate, integrated every millisecond in a
+ * local frame (meters east and north of an origin). Receiver fixes are written as GGA and RMC statements.
+ * Random numbers come from a seeded generator of this file, so that a run gives the same result on any host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "nmea_decoder.h"
+
+#define NMEA_SIM_M_PER_DEGREE (111319.49) /* Length of one degree of latitude */
+#define NMEA_SIM_DT_MS (1)                /* Integration step of a drive */
+
+/**
+ * @brief Segment of a drive
+ *
+ */
+typedef struct {
+    double duration; /*!< Duration (s) */
+    double accel;    /*!< Acceleration (m/s^2), the speed does not go below 0 */
+    double turn;     /*!< Turn rate (degree/s), positive to the right */
+} nmea_sim_segment_t;
+
+/**
+ * @brief True state of the vehicle
+ *
+ */
+typedef struct {
+    double east;      /*!< Position east of the origin (m) */
+    double north;     /*!< Position north of the origin (m) */
+    double speed;     /*!< Ground speed (m/s) */
+    double heading;   /*!< Course over ground (degree) */
+    uint32_t segment; /*!< Index of the segment */
+} nmea_sim_truth_t;
+
+/**
+ * @brief Drive, the true state of every millisecond
+ *
+ */
+typedef struct {
+    nmea_sim_truth_t *state; /*!< State at each millisecond from the start */
+    size_t count;            /*!< Number of states */
+    double lat0;             /*!< Latitude of the origin (degree) */
+    double lon0;             /*!< Longitude of the origin (degree) */
+} nmea_sim_drive_t;
+
+/**
+ * @brief Receiver fix to write as statements
+ *
+ */
+typedef struct {
+    uint32_t time_ms; /*!< UTC time of day (ms) */
+    double east;      /*!< Position east of the origin (m) */
+    double north;     /*!< Position north of the origin (m) */
+    double speed;     /*!< Ground speed (m/s) */
+    double course;    /*!< Course over ground (degree) */
+    double hdop;      /*!< Horizontal dilution of precision */
+    uint8_t sats;     /*!< Satellites in use */
+    uint8_t valid;    /*!< 0 for a receiver without fix */
+} nmea_sim_fix_t;
+
+/**
+ * @brief Integrate a drive
+ *
+ * @param drive drive, free with nmea_sim_drive_free()
+ * @param segments segments of one lap
+ * @param count number of segments
+ * @param laps number of times the segments are driven
+ * @param heading initial heading (degree)
+ * @param lat0 latitude of the origin (degree)
+ * @param lon0 longitude of the origin (degree)
+ * @return 0 on success, -1 out of memory
+ */
+int nmea_sim_drive(nmea_sim_drive_t *drive, const nmea_sim_segment_t *segments, size_t count, uint32_t laps,
+                   double heading, double lat0, double lon0);
+
+/**
+ * @brief Free a drive
+ *
+ * @param drive drive
+ */
+void nmea_sim_drive_free(nmea_sim_drive_t *drive);
+
+/**
+ * @brief True state at a time, clamped to the drive
+ *
+ * @param drive drive
+ * @param ms time since the start (ms)
+ * @return const nmea_sim_truth_t* state
+ */
+const nmea_sim_truth_t *nmea_sim_at(const nmea_sim_drive_t *drive, int64_t ms);
+
+/**
+ * @brief Write a fix as GGA and RMC statements (date 2026-10-18)
+ *
+ * @param drive drive giving the origin
+ * @param fix fix
+ * @param out statements will be saved in this buffer, 256 bytes at least
+ * @return size_t length of the statements
+ */
+size_t nmea_sim_epoch(const nmea_sim_drive_t *drive, const nmea_sim_fix_t *fix, char *out);
+
+/**
+ * @brief Append a statement with its checksum and line ending
+ *
+ * @param out statement will be saved in this buffer
+ * @param body statement between '$' and '*'
+ * @return size_t length of the statement
+ */
+size_t nmea_sim_statement(char *out, const char *body);
+
+/**
+ * @brief Position of a decoded fix in the local frame of a drive
+ *
+ * @param drive drive giving the origin
+ * @param latitude latitude (degrees * 1e7)
+ * @param longitude longitude (degrees * 1e7)
+ * @param east east of the origin (m)
+ * @param north north of the origin (m)
+ */
+void nmea_sim_local(const nmea_sim_drive_t *drive, int32_t latitude, int32_t longitude, double *east, double *north);
+
+/**
+ * @brief Uniform random number in [0, 1)
+ *
+ * @param rng state of the generator, any seed
+ * @return double random number
+ */
+double nmea_sim_uniform(uint64_t *rng);
+
+/**
+ * @brief Normal random number
+ *
+ * @param rng state of the generator
+ * @param sigma standard deviation
+ * @return double random number
+ */
+double nmea_sim_gauss(uint64_t *rng, double sigma);
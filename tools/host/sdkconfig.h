@@ -0,0 +1,33 @@
+/*
+ * Configuration of the component sources built for the host by the tools in this directory,
+ * in place of the sdkconfig.h generated by menuconfig. The parser options may be set with -D by a tool built
+ * with another configuration.
+ */
+#pragma once
+
+#define CONFIG_NMEA_STATEMENT_GGA 1
+#define CONFIG_NMEA_STATEMENT_GSA 1
+#define CONFIG_NMEA_STATEMENT_GSV 1
+#define CONFIG_NMEA_STATEMENT_RMC 1
+#define CONFIG_NMEA_STATEMENT_GLL 1
+#define CONFIG_NMEA_STATEMENT_VTG 1
+#define CONFIG_NMEA_STATEMENT_GNS 1
+#define CONFIG_NMEA_STATEMENT_ZDA 1
+#ifndef CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM
+#define CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM 0
+#endif
+#ifndef CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+#define CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS 1
+#endif
+#ifndef CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE
+#define CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE 4096
+#endif
+#ifndef CONFIG_NMEA_PARSER_FORWARD_SINK_NUM
+#define CONFIG_NMEA_PARSER_FORWARD_SINK_NUM 4
+#endif
+#ifndef CONFIG_NMEA_PARSER_FORWARD_BUFFER_SIZE
+#define CONFIG_NMEA_PARSER_FORWARD_BUFFER_SIZE 512
+#endif
+#ifndef CONFIG_NMEA_PARSER_FORWARD_FLUSH_MS
+#define CONFIG_NMEA_PARSER_FORWARD_FLUSH_MS 250
+#endif
@@ -0,0 +1,314 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Statement decoder throughput, host tool and performance guard
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_decoder_perf tools/nmea_decoder_perf.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c -lm
+ *
+ * nmea_decoder_perf [-e EPOCHS] [-r RUNS] [-t MAX_NS] [-s SEED]
+ *     Generate the log of a 10 Hz receiver on a drive of EPOCHS epochs, each of GGA, GSA, 3 GSV, RMC and VTG
+ *     statements with noisy position, speed and signal levels, and decode it RUNS times from memory in one call,
+ *     as the parser task decodes a UART read. Then pass the decoded epochs RUNS times through a queue of
+ *     DP_QUEUE_SIZE slots, as an event is posted to the event loop and received by its handler: the gps_t of
+ *     GPS_UPDATE as is, and the gps_fix_core_t of GPS_FIX converted by nmea_decoder_fix_core() then copied.
+ *
+ * Reported: sentences and bytes of the log, the time per sentence of the best and median run, the time per epoch
+ * and the throughput of the best run. For each payload, its size and the time per fix and fixes per second through
+ * the queue, best run.
+ *
+ * Regression checks (exit 1 on failure): every epoch decoded without checksum error, and the best run within
+ * MAX_NS per sentence (900 ns by default, a quarter above the host the limit was set on). The time depends on the
+ * host: set the limit from a run of the previous version on the same host.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "nmea_decoder.h"
+#include "nmea_sim.h"
+
+#define DP_PERIOD_MS (100)
+#define DP_STATEMENTS (7)     /* Statements of an epoch */
+#define DP_EPOCH_MAX (640)    /* Bytes of an epoch */
+#define DP_KNOT (0.514444)    /* m/s */
+#define DP_QUEUE_SIZE (16)    /* Default of CONFIG_NMEA_PARSER_EVENT_LOOP_QUEUE_SIZE */
+
+static const nmea_sim_segment_t dp_lap[] = {
+    {20, 0, 0}, {8, 2, 0}, {30, 0, 0}, {6, 0, 15}, {40, 0, 3}, {5, -2, 0}, {30, 0, -4}, {6, 0, -15}, {10, -1.2, 0},
+    {15, 0, 0},
+};
+
+static double dp_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int dp_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void dp_count_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)gps;
+    (void)data;
+    (void)len;
+    (*(size_t *)ctx)++;
+}
+
+/**
+ * @brief Decoded epochs, kept for the queue throughput
+ *
+ */
+typedef struct {
+    gps_t *gps;
+    size_t count;
+} dp_epochs_t;
+
+static void dp_keep_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    dp_epochs_t *epochs = ctx;
+    epochs->gps[epochs->count++] = *gps;
+}
+
+/* Handlers are called through a pointer the compiler cannot follow, as the event loop calls them: the copies
+ * made for them are not optimised away */
+static void dp_gps_handler(const gps_t *gps, uint32_t *sink)
+{
+    *sink += (uint32_t)gps->tim.thousand + gps->sats_in_use;
+}
+
+static void dp_core_handler(const gps_fix_core_t *core, uint32_t *sink)
+{
+    *sink += core->time_ms + core->sats_in_use;
+}
+
+static void (*volatile dp_gps_handler_ptr)(const gps_t *, uint32_t *) = dp_gps_handler;
+static void (*volatile dp_core_handler_ptr)(const gps_fix_core_t *, uint32_t *) = dp_core_handler;
+
+/**
+ * @brief Pass every epoch through a queue of DP_QUEUE_SIZE slots as the gps_t of GPS_UPDATE
+ *
+ * @return double ns per fix
+ */
+static double dp_queue_gps(const gps_t *gps, size_t count, uint32_t *sink)
+{
+    static gps_t queue[DP_QUEUE_SIZE];
+    double start = dp_now_ns();
+    for (size_t k = 0; k < count; k++) {
+        gps_t *slot = &queue[k % DP_QUEUE_SIZE];
+        memcpy(slot, &gps[k], sizeof(gps_t));
+        gps_t received;
+        memcpy(&received, slot, sizeof(gps_t));
+        dp_gps_handler_ptr(&received, sink);
+    }
+    return (dp_now_ns() - start) / count;
+}
+
+/**
+ * @brief Pass every fix through a queue of DP_QUEUE_SIZE slots as the gps_fix_core_t of GPS_FIX
+ *
+ * @param gps epochs to convert with nmea_decoder_fix_core() before the copy, NULL to copy core as is
+ * @return double ns per fix
+ */
+static double dp_queue_core(const gps_t *gps, const gps_fix_core_t *core, size_t count, uint32_t *sink)
+{
+    static gps_fix_core_t queue[DP_QUEUE_SIZE];
+    double start = dp_now_ns();
+    for (size_t k = 0; k < count; k++) {
+        gps_fix_core_t *slot = &queue[k % DP_QUEUE_SIZE];
+        if (gps) {
+            nmea_decoder_fix_core(&gps[k], slot);
+        } else {
+            memcpy(slot, &core[k], sizeof(gps_fix_core_t));
+        }
+        gps_fix_core_t received;
+        memcpy(&received, slot, sizeof(gps_fix_core_t));
+        dp_core_handler_ptr(&received, sink);
+    }
+    return (dp_now_ns() - start) / count;
+}
+
+/**
+ * @brief Generate the log of the drive
+ *
+ * @param drive drive
+ * @param epochs number of epochs
+ * @param seed seed of the noise
+ * @param len length of the log
+ * @return char* log, NULL out of memory
+ */
+static char *dp_log(const nmea_sim_drive_t *drive, size_t epochs, uint64_t seed, size_t *len)
+{
+    static const uint8_t prn[12] = {3, 4, 6, 9, 12, 14, 16, 18, 19, 22, 24, 27};
+    char *log = malloc(epochs * DP_EPOCH_MAX);
+    uint64_t rng = seed;
+    *len = 0;
+    if (!log) {
+        return NULL;
+    }
+    for (size_t k = 0; k < epochs; k++) {
+        uint32_t ms = k * DP_PERIOD_MS;
+        const nmea_sim_truth_t *truth = nmea_sim_at(drive, ms);
+        double hdop = 0.8 + 0.3 * nmea_sim_uniform(&rng);
+        nmea_sim_fix_t fix = {
+            .time_ms = ms,
+            .east = truth->east + nmea_sim_gauss(&rng, 1.5),
+            .north = truth->north + nmea_sim_gauss(&rng, 1.5),
+            .speed = fmax(0, truth->speed + nmea_sim_gauss(&rng, 0.1)),
+            .course = truth->heading,
+            .hdop = hdop,
+            .sats = 9,
+            .valid = 1,
+        };
+        char epoch[DP_EPOCH_MAX];
+        char body[NMEA_MAX_STATEMENT_LENGTH];
+        size_t n = nmea_sim_epoch(drive, &fix, epoch);
+        /* GGA first, then the statements of the receiver in its own order, RMC last but VTG */
+        char *rmc = strstr(epoch, "$GPRMC");
+        size_t gga = rmc - epoch;
+        memcpy(log + *len, epoch, gga);
+        *len += gga;
+        snprintf(body, sizeof(body), "GPGSA,A,3,03,04,06,09,12,14,16,18,19,,,,%.1f,%.1f,%.1f", hdop + 0.6, hdop,
+                 1.2 + 0.2 * nmea_sim_uniform(&rng));
+        *len += nmea_sim_statement(log + *len, body);
+        for (int m = 0; m < 3; m++) {
+            int w = snprintf(body, sizeof(body), "GPGSV,3,%d,12", m + 1);
+            for (int s = 4 * m; s < 4 * m + 4; s++) {
+                w += snprintf(body + w, sizeof(body) - w, ",%02u,%02u,%03u,%02u", prn[s], 5 + 7 * s, 30 * s,
+                              25 + (unsigned)(20 * nmea_sim_uniform(&rng)));
+            }
+            *len += nmea_sim_statement(log + *len, body);
+        }
+        memcpy(log + *len, rmc, n - gga);
+        *len += n - gga;
+        snprintf(body, sizeof(body), "GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,A", fmod(fix.course + 360, 360),
+                 fix.speed / DP_KNOT, fix.speed * 3.6);
+        *len += nmea_sim_statement(log + *len, body);
+    }
+    return log;
+}
+
+int main(int argc, char **argv)
+{
+    size_t epochs = 5000;
+    int runs = 50;
+    double max_ns = 900;
+    uint64_t seed = 7;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-e")) {
+            epochs = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-r")) {
+            runs = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-t")) {
+            max_ns = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    if (argc % 2 == 0 || !epochs || runs <= 0) {
+        fprintf(stderr, "usage: %s [-e EPOCHS] [-r RUNS] [-t MAX_NS] [-s SEED]\n", argv[0]);
+        return 1;
+    }
+
+    nmea_sim_drive_t drive;
+    size_t lap_ms = 0;
+    for (size_t i = 0; i < sizeof(dp_lap) / sizeof(dp_lap[0]); i++) {
+        lap_ms += dp_lap[i].duration * 1000;
+    }
+    if (nmea_sim_drive(&drive, dp_lap, sizeof(dp_lap) / sizeof(dp_lap[0]),
+                       (epochs * DP_PERIOD_MS + lap_ms - 1) / lap_ms, 45, 37.5665, 126.978)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    size_t len;
+    char *log = dp_log(&drive, epochs, seed, &len);
+    double *ns = malloc(runs * sizeof(double));
+    nmea_sim_drive_free(&drive);
+    if (!log || !ns) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    size_t sentences = epochs * DP_STATEMENTS;
+
+    int failures = 0;
+    static nmea_decoder_t decoder;
+    for (int run = 0; run < runs; run++) {
+        size_t count = 0;
+        nmea_decoder_cb_t cb = {.epoch = dp_count_epoch, .ctx = &count};
+        nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_GSA) | (1 << STATEMENT_GSV) |
+                          (1 << STATEMENT_RMC) | (1 << STATEMENT_VTG), &cb);
+        double start = dp_now_ns();
+        nmea_decoder_feed(&decoder, (const uint8_t *)log, len);
+        ns[run] = (dp_now_ns() - start) / sentences;
+        if (count != epochs || decoder.crc_error) {
+            printf("FAIL: %zu of %zu epochs decoded, %u checksum errors\n", count, epochs,
+                   (unsigned)decoder.crc_error);
+            failures++;
+            break;
+        }
+    }
+    qsort(ns, runs, sizeof(double), dp_cmp);
+    printf("%zu sentences, %zu bytes, best of %d runs\n", sentences, len, runs);
+    printf("  %.1f ns/sentence (median %.1f), %.2f us/epoch, %.1f MB/s\n", ns[0], ns[runs / 2],
+           ns[0] * DP_STATEMENTS / 1000, len / (ns[0] * sentences) * 1000);
+    if (ns[0] > max_ns) {
+        printf("FAIL: %.1f ns/sentence above %.0f ns\n", ns[0], max_ns);
+        failures++;
+    }
+
+    /* Event payloads through the queue */
+    dp_epochs_t kept = {.gps = malloc(epochs * sizeof(gps_t))};
+    gps_fix_core_t *core = malloc(epochs * sizeof(gps_fix_core_t));
+    if (!kept.gps || !core) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    nmea_decoder_cb_t cb = {.epoch = dp_keep_epoch, .ctx = &kept};
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_GSA) | (1 << STATEMENT_GSV) |
+                      (1 << STATEMENT_RMC) | (1 << STATEMENT_VTG), &cb);
+    nmea_decoder_feed(&decoder, (const uint8_t *)log, len);
+    for (size_t k = 0; k < kept.count; k++) {
+        nmea_decoder_fix_core(&kept.gps[k], &core[k]);
+    }
+    double gps_ns = 1e9, core_ns = 1e9, convert_ns = 1e9;
+    uint32_t sink = 0;
+    for (int run = 0; run < runs; run++) {
+        gps_ns = fmin(gps_ns, dp_queue_gps(kept.gps, kept.count, &sink));
+        core_ns = fmin(core_ns, dp_queue_core(NULL, core, kept.count, &sink));
+        convert_ns = fmin(convert_ns, dp_queue_core(kept.gps, NULL, kept.count, &sink));
+    }
+    printf("queue of %d events, %zu fixes, best of %d runs (%08x)\n", DP_QUEUE_SIZE, kept.count, runs,
+           (unsigned)sink);
+    printf("  gps_t           %3zu bytes  %6.1f ns/fix  %7.2f M fixes/s\n", sizeof(gps_t), gps_ns, 1e3 / gps_ns);
+    printf("  gps_fix_core_t  %3zu bytes  %6.1f ns/fix  %7.2f M fixes/s, %.1f ns/fix with nmea_decoder_fix_core()\n",
+           sizeof(gps_fix_core_t), core_ns, 1e3 / core_ns, convert_ns);
+    free(core);
+    free(kept.gps);
+    free(ns);
+    free(log);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,379 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Statement decoder stream faults replay, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_decoder_replay tools/nmea_decoder_replay.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c -lm
+ *
+ * nmea_decoder_replay [-e EPOCHS] [-s SEED]
+ *     Generate the log of a 10 Hz receiver on a drive of EPOCHS epochs, each of GGA, RMC, GSA and VTG statements
+ *     with noisy speed and course, and decode it with GGA, RMC, GSA and VTG completing an epoch, statement by
+ *     statement as they arrive. The stream goes through phases of EPOCHS / 4 epochs:
+ *
+ *     all       every statement
+ *     no GGA    GGA dropped mid-stream, RMC still carries the UTC time
+ *     no time   GGA and RMC dropped, GSA and VTG carry no UTC time
+ *     back      every statement again
+ *
+ *     Then decode the same log in reads of up to DR_READ_MAX bytes, as the parser task reads the UART, with faults:
+ *     every DR_FAULT_PERIOD epochs a GGA truncated and followed by the next statement, and an overflow burst
+ *     dropping the bytes from the middle of a GGA to the middle of the VTG of its epoch, as a full ring buffer
+ *     drops what arrives. The decoder is expected to drop the truncated statement, and the statement made of the
+ *     head of the GGA and the tail of the VTG at its checksum.
+ *
+ * Reported per phase: epochs decoded, VTG statements whose speed or course was not taken while no other statement
+ * of its epoch had filled them (stale), and items skipped by NMEA Parser Skip Redundant Fields. For the faults:
+ * truncations and bursts, bytes dropped by the bursts, bytes lost and checksum errors of the decoder against the
+ * expected ones, and epochs decoded.
+ *
+ * Regression checks (exit 1 on failure): no stale VTG in any phase, every epoch of the first and last phase
+ * decoded; with NMEA Parser Skip Redundant Fields, their epochs carry the speed and course of RMC and items are
+ * skipped in the first phase (the skipping still works). For the faults, the lost bytes and checksum errors
+ * exactly as expected, and every epoch decoded but those hit by a fault and the next one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nmea_decoder.h"
+#include "nmea_sim.h"
+
+#define DR_PERIOD_MS (100)
+#define DR_PHASES (4)
+#define DR_KNOT (0.514444)    /* m/s */
+#define DR_SPEED_ERR (0.01)   /* m/s, rounding of the statements */
+#define DR_COURSE_ERR (0.01)  /* degree */
+#define DR_READ_MAX (120)     /* Bytes of a UART read */
+#define DR_FAULT_PERIOD (40)  /* Epochs between two truncations, and two bursts */
+#define DR_EPOCH_MAX (384)    /* Bytes of an epoch */
+
+static const char *const dr_phase_name[DR_PHASES] = {"all", "no GGA", "no time", "back"};
+
+static const nmea_sim_segment_t dr_lap[] = {
+    {10, 1.5, 0}, {20, 0, 6}, {10, -1, 0}, {20, 0, -4}, {10, 0.5, 0},
+};
+
+/**
+ * @brief Result of a phase
+ *
+ */
+typedef struct {
+    uint32_t epochs;      /*!< Epochs decoded */
+    uint32_t epochs_sent; /*!< Epochs that could complete */
+    uint32_t mismatch;    /*!< Epochs decoded without the speed and course of RMC */
+    uint32_t vtg;         /*!< VTG statements alone in their epoch for speed and course */
+    uint32_t stale;       /*!< Of those, VTG whose speed or course was not taken */
+    uint32_t skipped;     /*!< Items skipped */
+} dr_phase_t;
+
+/**
+ * @brief Replay state
+ *
+ */
+typedef struct {
+    nmea_decoder_t decoder;
+    dr_phase_t phase[DR_PHASES];
+    int cur;              /*!< Current phase */
+    double rmc_speed;     /*!< Speed of the RMC of the epoch (m/s) */
+    double rmc_course;    /*!< Course of the RMC of the epoch (degree) */
+} dr_replay_t;
+
+/**
+ * @brief Statements of an epoch
+ *
+ */
+typedef struct {
+    char text[DR_EPOCH_MAX]; /*!< GGA, RMC, GSA and VTG */
+    size_t start[5];         /*!< Offset of each statement, then length of the text */
+    double vtg_speed;        /*!< Speed of the VTG (m/s) */
+    double vtg_course;       /*!< Course of the VTG (degree) */
+} dr_statements_t;
+
+enum {
+    DR_GGA,
+    DR_RMC,
+    DR_GSA,
+    DR_VTG,
+    DR_END,
+};
+
+/**
+ * @brief Write the statements of an epoch
+ *
+ * @param drive drive
+ * @param k epoch
+ * @param rng state of the noise
+ * @param st statements
+ */
+static void dr_statements(const nmea_sim_drive_t *drive, uint32_t k, uint64_t *rng, dr_statements_t *st)
+{
+    const nmea_sim_truth_t *truth = nmea_sim_at(drive, k * DR_PERIOD_MS);
+    nmea_sim_fix_t fix = {
+        .time_ms = k * DR_PERIOD_MS,
+        .east = truth->east + nmea_sim_gauss(rng, 1),
+        .north = truth->north + nmea_sim_gauss(rng, 1),
+        .speed = fmax(0, truth->speed + nmea_sim_gauss(rng, 0.2)),
+        .course = fmod(truth->heading + nmea_sim_gauss(rng, 2) + 360, 360),
+        .hdop = 0.9,
+        .sats = 10,
+        .valid = 1,
+    };
+    char body[NMEA_MAX_STATEMENT_LENGTH];
+    size_t n = nmea_sim_epoch(drive, &fix, st->text);
+    st->start[DR_GGA] = 0;
+    st->start[DR_RMC] = strstr(st->text, "$GPRMC") - st->text;
+    st->start[DR_GSA] = n;
+    snprintf(body, sizeof(body), "GPGSA,A,3,03,04,06,09,12,14,16,18,19,22,,,1.6,0.9,1.3");
+    n += nmea_sim_statement(st->text + n, body);
+    st->start[DR_VTG] = n;
+    /* VTG of its own, its speed and course differ from the ones of RMC */
+    st->vtg_speed = fix.speed + 0.5 + 0.25 * (k % 4);
+    st->vtg_course = fmod(fix.course + 10 + k % 7, 360);
+    snprintf(body, sizeof(body), "GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,A", st->vtg_course, st->vtg_speed / DR_KNOT,
+             st->vtg_speed * 3.6);
+    n += nmea_sim_statement(st->text + n, body);
+    st->start[DR_END] = n;
+}
+
+static void dr_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    dr_replay_t *replay = ctx;
+    dr_phase_t *phase = &replay->phase[replay->cur];
+    phase->epochs++;
+    if (fabs(gps->speed - replay->rmc_speed) > DR_SPEED_ERR || fabs(gps->cog - replay->rmc_course) > DR_COURSE_ERR) {
+        phase->mismatch++;
+    }
+}
+
+static void dr_feed(dr_replay_t *replay, const char *statement, size_t len)
+{
+    nmea_decoder_feed(&replay->decoder, (const uint8_t *)statement, len);
+}
+
+static void dr_count_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)gps;
+    (void)data;
+    (void)len;
+    (*(uint32_t *)ctx)++;
+}
+
+static uint8_t dr_crc(const char *text, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint8_t)text[i];
+    }
+    return crc;
+}
+
+/**
+ * @brief Decode the log with truncated statements and overflow bursts, check the lost bytes
+ *
+ * @param drive drive
+ * @param epochs number of epochs
+ * @param seed seed of the noise and of the faults
+ * @return int number of failures
+ */
+static int dr_resync(const nmea_sim_drive_t *drive, uint32_t epochs, uint64_t seed)
+{
+    char *log = malloc((size_t)epochs * DR_EPOCH_MAX);
+    if (!log) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    uint64_t rng = seed;
+    size_t len = 0;
+    size_t burst_bytes = 0;
+    uint32_t truncated = 0, bursts = 0, damaged = 0;
+    uint32_t expected_lost = 0, expected_crc = 0;
+    static dr_statements_t st;
+    for (uint32_t k = 0; k < epochs; k++) {
+        dr_statements(drive, k, &rng, &st);
+        const char *t = st.text;
+        const size_t *at = st.start;
+        if (k % DR_FAULT_PERIOD == DR_FAULT_PERIOD / 4) {
+            /* GGA cut before its checksum, the next '$' truncates it */
+            size_t cut = 2 + (size_t)(nmea_sim_uniform(&rng) * (at[DR_RMC] - 8));
+            memcpy(log + len, t, cut);
+            len += cut;
+            memcpy(log + len, t + at[DR_RMC], at[DR_END] - at[DR_RMC]);
+            len += at[DR_END] - at[DR_RMC];
+            expected_lost += cut;
+            truncated++;
+            damaged++;
+        } else if (k % DR_FAULT_PERIOD == DR_FAULT_PERIOD * 3 / 4) {
+            /* Burst from within the GGA, before its '*', to within the VTG: head and tail make one statement
+             * ending with the checksum of the VTG, moved on if that checksum would happen to match */
+            size_t vtg_end = at[DR_END] - 2; /* '\r' of the VTG */
+            size_t star = vtg_end - 3;
+            uint8_t vtg_crc = (uint8_t)strtol(t + star + 1, NULL, 16);
+            size_t head = 1 + (size_t)(nmea_sim_uniform(&rng) * (at[DR_RMC] - 6 < 50 ? at[DR_RMC] - 6 : 50));
+            size_t tail = at[DR_VTG] + 1 + (size_t)(nmea_sim_uniform(&rng) * (star - at[DR_VTG] - 1));
+            while ((dr_crc(t + 1, head - 1) ^ dr_crc(t + tail, star - tail)) == vtg_crc) {
+                if (tail < star) {
+                    tail++;
+                } else {
+                    head++;
+                }
+            }
+            memcpy(log + len, t, head);
+            len += head;
+            memcpy(log + len, t + tail, at[DR_END] - tail);
+            len += at[DR_END] - tail;
+            burst_bytes += tail - head;
+            expected_lost += head + (vtg_end - tail + 1);
+            expected_crc++;
+            bursts++;
+            damaged++;
+        } else {
+            memcpy(log + len, t, at[DR_END]);
+            len += at[DR_END];
+        }
+    }
+
+    uint32_t decoded = 0;
+    static nmea_decoder_t decoder;
+    nmea_decoder_cb_t cb = {.epoch = dr_count_epoch, .ctx = &decoded};
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC) | (1 << STATEMENT_GSA) |
+                      (1 << STATEMENT_VTG), &cb);
+    for (size_t pos = 0; pos < len;) {
+        size_t n = 1 + (size_t)(nmea_sim_uniform(&rng) * DR_READ_MAX);
+        n = n < len - pos ? n : len - pos;
+        nmea_decoder_feed(&decoder, (const uint8_t *)log + pos, n);
+        pos += n;
+    }
+    free(log);
+
+    int failures = 0;
+    printf("%u truncated statements, %u overflow bursts dropping %zu bytes, reads of 1 to %d bytes\n", truncated,
+           bursts, burst_bytes, DR_READ_MAX);
+    printf("  lost bytes %u (expected %u), checksum errors %u (expected %u), epochs %u of %u\n",
+           (unsigned)decoder.lost_bytes, expected_lost, (unsigned)decoder.crc_error, expected_crc, decoded, epochs);
+    if (decoder.lost_bytes != expected_lost || decoder.crc_error != expected_crc) {
+        printf("FAIL: lost bytes and checksum errors differ from the damaged statements\n");
+        failures++;
+    }
+    /* A damaged epoch leaves its statements to the next GGA, which completes it: that epoch is lost too */
+    if (decoded + 2 * damaged < epochs) {
+        printf("FAIL: %u epochs decoded, %u expected at least\n", decoded, epochs - 2 * damaged);
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t epochs = 4000;
+    uint64_t seed = 7;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-e")) {
+            epochs = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    if (argc % 2 == 0 || epochs < DR_PHASES) {
+        fprintf(stderr, "usage: %s [-e EPOCHS] [-s SEED]\n", argv[0]);
+        return 1;
+    }
+
+    nmea_sim_drive_t drive;
+    size_t lap_ms = 0;
+    for (size_t i = 0; i < sizeof(dr_lap) / sizeof(dr_lap[0]); i++) {
+        lap_ms += dr_lap[i].duration * 1000;
+    }
+    if (nmea_sim_drive(&drive, dr_lap, sizeof(dr_lap) / sizeof(dr_lap[0]),
+                       (epochs * DR_PERIOD_MS + lap_ms - 1) / lap_ms, 90, 48.8566, 2.3522)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    static dr_replay_t replay;
+    nmea_decoder_cb_t cb = {.epoch = dr_epoch, .ctx = &replay};
+    nmea_decoder_init(&replay.decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC) | (1 << STATEMENT_GSA) |
+                      (1 << STATEMENT_VTG), &cb);
+    uint64_t rng = seed;
+    for (uint32_t k = 0; k < epochs; k++) {
+        replay.cur = k * DR_PHASES / epochs;
+        dr_phase_t *phase = &replay.phase[replay.cur];
+        bool gga = replay.cur != 1 && replay.cur != 2;
+        bool rmc = replay.cur != 2;
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+        uint32_t skipped = replay.decoder.field_skipped;
+#endif
+        static dr_statements_t st;
+        dr_statements(&drive, k, &rng, &st);
+        if (gga) {
+            dr_feed(&replay, st.text, st.start[DR_RMC]);
+        }
+        if (rmc) {
+            dr_feed(&replay, st.text + st.start[DR_RMC], st.start[DR_GSA] - st.start[DR_RMC]);
+            replay.rmc_speed = replay.decoder.gps.speed;
+            replay.rmc_course = replay.decoder.gps.cog;
+        }
+        dr_feed(&replay, st.text + st.start[DR_GSA], st.start[DR_VTG] - st.start[DR_GSA]);
+        dr_feed(&replay, st.text + st.start[DR_VTG], st.start[DR_END] - st.start[DR_VTG]);
+        if (!rmc) {
+            /* Nothing else fills speed and course: VTG must set them */
+            phase->vtg++;
+            if (fabs(replay.decoder.gps.speed - st.vtg_speed) > DR_SPEED_ERR ||
+                    fabs(replay.decoder.gps.cog - st.vtg_course) > DR_COURSE_ERR) {
+                phase->stale++;
+            }
+        }
+        phase->epochs_sent += gga && rmc;
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+        phase->skipped += replay.decoder.field_skipped - skipped;
+#endif
+    }
+
+    int failures = 0;
+    printf("%u epochs of GGA, RMC, GSA and VTG at %u Hz, %u per phase\n", epochs, 1000 / DR_PERIOD_MS,
+           epochs / DR_PHASES);
+    printf("  phase     epochs   mismatch   VTG alone   stale   skipped\n");
+    for (int i = 0; i < DR_PHASES; i++) {
+        const dr_phase_t *phase = &replay.phase[i];
+        printf("  %-8s %7u %10u %11u %7u %9u\n", dr_phase_name[i], phase->epochs, phase->mismatch, phase->vtg,
+               phase->stale, phase->skipped);
+        if (phase->stale) {
+            printf("FAIL: %u VTG statements of phase %s not decoded\n", phase->stale, dr_phase_name[i]);
+            failures++;
+        }
+    }
+    const dr_phase_t *first = &replay.phase[0], *last = &replay.phase[DR_PHASES - 1];
+    if (first->epochs != first->epochs_sent || last->epochs != last->epochs_sent) {
+        printf("FAIL: %u of %u and %u of %u epochs decoded in the first and last phase\n", first->epochs,
+               first->epochs_sent, last->epochs, last->epochs_sent);
+        failures++;
+    }
+#if CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS
+    /* RMC is the authority of speed and course, the VTG of the same epoch is skipped. The first epoch of the last
+     * phase completes the one left open since GGA was dropped, with the speed of the last VTG alone */
+    if (first->mismatch || last->mismatch > 1 || !first->skipped) {
+        printf("FAIL: %u and %u epochs without the speed and course of RMC, %u items skipped in the first phase\n",
+               first->mismatch, last->mismatch, first->skipped);
+        failures++;
+    }
+#endif
+    failures += dr_resync(&drive, epochs, seed);
+    nmea_sim_drive_free(&drive);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,458 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Position filter urban replay, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_filter_replay tools/nmea_filter_replay.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c main/nmea_filter.c -lm
+ *
+ * nmea_filter_replay [-p PERIOD_MS] [-l LAPS] [-u UERE_CM] [-v SPEED_ERROR_CMS] [-a ACCEL_CMS2] [-g GATE]
+ *                    [-r RESET_MS] [-s SEED]
+ *     Generate an urban log: laps of 10 minutes on a street grid with stops and turns, a fix every PERIOD_MS with
+ *     a slowly varying bias and white noise scaled by HDOP, multipath episodes (offsets of 10 to 60 m lasting 1
+ *     to 8 s, with raised HDOP in half of them) and single-fix spikes of 20 to 80 m in 1% of the other fixes.
+ *     Decode the GGA and RMC statements and feed each fix to nmea_filter_update() as the parser does, with the
+ *     default configuration of NMEA Parser Position Filter unless changed.
+ *     Then run the filter on extreme inputs: a drive across the antimeridian, and 2 million random fixes with
+ *     jumps across the globe, time gaps, invalid fixes, HDOP and speed up to their largest values.
+ *
+ * Reported: error of the raw and filtered positions (rms, p50, p95, max, share beyond 10 m), the outliers rejected
+ * by kind and the clean fixes rejected, the restarts, and the time of the filter and of the decoder per fix.
+ *
+ * Regression checks of the default log and configuration (exit 1 on failure): filtered error within 2.5 m rms,
+ * 5 m p95 and 10 m at most, 90% of the spikes rejected, under 1% of the clean fixes rejected, no restart; on the
+ * extreme inputs, positions within range and the antimeridian crossed without rejection. The times are not checked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "nmea_decoder.h"
+#include "nmea_filter.h"
+#include "nmea_sim.h"
+
+#define FR_BIAS_TAU_S (30)      /* Gauss-Markov bias of the receiver */
+#define FR_BIAS_SIGMA (1.5)     /* m */
+#define FR_MULTIPATH_EVERY_S (20)
+#define FR_SPIKES (0.01)
+#define FR_RMS_MAX (2.5)        /* Limits of the regression check */
+#define FR_P95_MAX (5.0)
+#define FR_ERR_MAX (10.0)
+#define FR_SPIKES_REJECTED (0.9)
+#define FR_CLEAN_REJECTED (0.01)
+#define FR_RANDOM_FIXES (2000000)
+#define FR_TIMING_RUNS (20)
+
+static const nmea_sim_segment_t fr_lap[] = {
+    {60, 0, 0}, {6, 2, 0}, {25, 0, 0}, {5, -2.4, 0}, {20, 0, 0}, {6, 2, 0}, {10, 0, 0}, {6, 0, 15}, {20, 0, 0},
+    {4, -2, 0}, {15, 0, 0}, {4, 2, 0}, {6, 0, -15}, {40, 0, 0}, {5, -2.4, 0}, {45, 0, 0}, {6, 2, 0}, {30, 0, 0},
+    {6, 0, 15}, {25, 0, 0}, {6, 0, 15}, {30, 0, 0}, {4, 1, 0}, {60, 0, 0}, {6, 0, -15}, {20, 0, 0}, {8, -2.25, 0},
+    {120, 0, 0},
+};
+
+/**
+ * @brief Kind of receiver error of a fix
+ *
+ */
+typedef enum {
+    FR_CLEAN,     /*!< Bias and noise */
+    FR_MULTIPATH, /*!< In a multipath episode */
+    FR_SPIKE,     /*!< Single-fix spike */
+    FR_KIND_MAX,
+} fr_kind_t;
+
+/**
+ * @brief Replay state
+ *
+ */
+typedef struct {
+    const nmea_sim_drive_t *drive;
+    nmea_filter_t filter;
+    gps_fix_core_t *fixes;          /*!< Decoded fixes, before the filter */
+    size_t fix_count;
+    double *err_raw;
+    double *err_filtered;
+} fr_replay_t;
+
+static double fr_error(const fr_replay_t *replay, const gps_fix_core_t *fix)
+{
+    double east;
+    double north;
+    nmea_sim_local(replay->drive, fix->latitude, fix->longitude, &east, &north);
+    const nmea_sim_truth_t *truth = nmea_sim_at(replay->drive, fix->time_ms);
+    return hypot(east - truth->east, north - truth->north);
+}
+
+static void fr_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    fr_replay_t *replay = ctx;
+    gps_fix_core_t *fix = &replay->fixes[replay->fix_count];
+    (void)data;
+    (void)len;
+    nmea_decoder_fix_core(gps, fix);
+    gps_fix_core_t core = *fix;
+    replay->err_raw[replay->fix_count] = fr_error(replay, &core);
+    nmea_filter_update(&replay->filter, &core);
+    replay->err_filtered[replay->fix_count] = fr_error(replay, &core);
+    replay->fix_count++;
+}
+
+/**
+ * @brief Generate the urban log
+ *
+ * @return char* statements, NUL terminated, free with free()
+ */
+static char *fr_generate(const nmea_sim_drive_t *drive, uint32_t period_ms, uint64_t seed, uint8_t *kinds,
+                         size_t *count)
+{
+    uint64_t rng = seed;
+    size_t epochs = drive->count / period_ms;
+    char *log = malloc(epochs * 256 + 1);
+    if (!log) {
+        return NULL;
+    }
+    double ps = period_ms / 1000.0;
+    double a = exp(-ps / FR_BIAS_TAU_S);
+    double q = FR_BIAS_SIGMA * sqrt(1 - a * a);
+    double bias_east = 0;
+    double bias_north = 0;
+    double mp_east = 0;
+    double mp_north = 0;
+    double mp_left = 0;
+    double mp_hdop = 0;
+    size_t len = 0;
+    for (size_t k = 0; k < epochs; k++) {
+        uint32_t ms = (uint32_t)(k * period_ms);
+        const nmea_sim_truth_t *truth = nmea_sim_at(drive, ms);
+        bias_east = a * bias_east + nmea_sim_gauss(&rng, q);
+        bias_north = a * bias_north + nmea_sim_gauss(&rng, q);
+        if (mp_left <= 0 && nmea_sim_uniform(&rng) < ps / FR_MULTIPATH_EVERY_S) {
+            double d = 10 + 50 * nmea_sim_uniform(&rng);
+            double th = 2 * M_PI * nmea_sim_uniform(&rng);
+            mp_east = d * sin(th);
+            mp_north = d * cos(th);
+            mp_left = 1 + 7 * nmea_sim_uniform(&rng);
+            mp_hdop = nmea_sim_uniform(&rng) < 0.5 ? 2 + 2 * nmea_sim_uniform(&rng) : 0;
+        }
+        double hdop = 0.9 + 0.3 * sin(ms / 40000.0);
+        double east = truth->east + bias_east + nmea_sim_gauss(&rng, 0.6 * hdop);
+        double north = truth->north + bias_north + nmea_sim_gauss(&rng, 0.6 * hdop);
+        double speed_noise = 0.08;
+        kinds[k] = FR_CLEAN;
+        if (mp_left > 0) {
+            east += mp_east + nmea_sim_gauss(&rng, 2);
+            north += mp_north + nmea_sim_gauss(&rng, 2);
+            mp_left -= ps;
+            speed_noise = 0.3;
+            hdop = mp_hdop ? mp_hdop : hdop;
+            kinds[k] = FR_MULTIPATH;
+        } else if (nmea_sim_uniform(&rng) < FR_SPIKES) {
+            double d = 20 + 60 * nmea_sim_uniform(&rng);
+            double th = 2 * M_PI * nmea_sim_uniform(&rng);
+            east += d * sin(th);
+            north += d * cos(th);
+            kinds[k] = FR_SPIKE;
+        }
+        nmea_sim_fix_t fix = {
+            .time_ms = ms,
+            .east = east,
+            .north = north,
+            .speed = fmax(0, truth->speed + nmea_sim_gauss(&rng, speed_noise)),
+            /* Course over ground is noise when slow */
+            .course = truth->speed > 0.5 ? truth->heading + nmea_sim_gauss(&rng, speed_noise * 10) :
+                      360 * nmea_sim_uniform(&rng),
+            .hdop = hdop,
+            .sats = kinds[k] == FR_MULTIPATH ? 6 : 11,
+            .valid = 1,
+        };
+        len += nmea_sim_epoch(drive, &fix, log + len);
+    }
+    *count = epochs;
+    return log;
+}
+
+static int fr_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Print the statistics of errors
+ *
+ * @return double p95 (m), the errors are sorted
+ */
+static double fr_report(const char *name, double *err, size_t count, double *rms, double *max)
+{
+    double sum2 = 0;
+    size_t over = 0;
+    *max = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum2 += err[i] * err[i];
+        *max = fmax(*max, err[i]);
+        over += err[i] > 10;
+    }
+    qsort(err, count, sizeof(double), fr_cmp);
+    *rms = sqrt(sum2 / count);
+    double p95 = err[count * 95 / 100];
+    printf("  %-9s rms %6.2f m  p50 %5.2f m  p95 %6.2f m  max %6.2f m  beyond 10 m %5.2f%%\n", name, *rms,
+           err[count / 2], p95, *max, 100.0 * over / count);
+    return p95;
+}
+
+static double fr_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Filter time per fix, best of several runs over the decoded fixes
+ *
+ */
+static double fr_time_filter(const nmea_filter_config_t *config, const gps_fix_core_t *fixes, size_t count)
+{
+    gps_fix_core_t *work = malloc(count * sizeof(gps_fix_core_t));
+    double best = INFINITY;
+    volatile int32_t sink = 0;
+    if (!work) {
+        return NAN;
+    }
+    for (int run = 0; run < FR_TIMING_RUNS; run++) {
+        nmea_filter_t filter;
+        nmea_filter_init(&filter, config);
+        memcpy(work, fixes, count * sizeof(gps_fix_core_t));
+        double start = fr_now_ns();
+        for (size_t i = 0; i < count; i++) {
+            nmea_filter_update(&filter, &work[i]);
+        }
+        best = fmin(best, (fr_now_ns() - start) / count);
+        sink += work[count - 1].latitude;
+    }
+    free(work);
+    return best;
+}
+
+static void fr_count_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)gps;
+    (void)data;
+    (void)len;
+    (*(size_t *)ctx)++;
+}
+
+/**
+ * @brief Decoder time per fix, best of several runs over the log
+ *
+ */
+static double fr_time_decoder(const char *log, size_t len)
+{
+    double best = INFINITY;
+    for (int run = 0; run < FR_TIMING_RUNS / 4; run++) {
+        size_t count = 0;
+        static nmea_decoder_t decoder;
+        nmea_decoder_cb_t cb = {.epoch = fr_count_epoch, .ctx = &count};
+        nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC), &cb);
+        double start = fr_now_ns();
+        nmea_decoder_feed(&decoder, (const uint8_t *)log, len);
+        best = fmin(best, (fr_now_ns() - start) / count);
+    }
+    return best;
+}
+
+/**
+ * @brief Extreme inputs, the antimeridian and random fixes
+ *
+ * @return int number of failures
+ */
+static int fr_extreme(const nmea_filter_config_t *config, uint64_t seed)
+{
+    nmea_filter_t filter;
+    int fail = 0;
+    /* Eastward across the antimeridian at 60 m/s, latitude 10 degrees */
+    nmea_filter_init(&filter, config);
+    uint32_t wrong = 0;
+    for (int i = 0; i < 400; i++) {
+        int64_t lon = 1799990000LL + (int64_t)(i * 6.0 / (NMEA_SIM_M_PER_DEGREE * cos(10 * M_PI / 180)) * 1e7);
+        if (lon >= 1800000000) {
+            lon -= 3600000000LL;
+        }
+        gps_fix_core_t fix = {
+            .latitude = 100000000,
+            .longitude = (int32_t)lon,
+            .time_ms = (86390000 + i * 100) % 86400000,
+            .speed = 6000,
+            .cog = 9000,
+            .dop_h = 100,
+            .valid = 1,
+        };
+        gps_fix_core_t in = fix;
+        nmea_filter_update(&filter, &fix);
+        int64_t d = (int64_t)fix.longitude - in.longitude;
+        d = d > 1800000000 ? d - 3600000000LL : d < -1800000000 ? d + 3600000000LL : d;
+        wrong += llabs(d) > 200 || abs(fix.latitude - in.latitude) > 200;
+    }
+    printf("antimeridian: %u of 400 fixes moved by more than 2 cm, %u rejected, %u restarts\n", wrong,
+           (unsigned)filter.rejected, (unsigned)filter.resets);
+    if (wrong || filter.rejected || filter.resets) {
+        printf("FAIL: the antimeridian must be crossed without rejection\n");
+        fail++;
+    }
+
+    /* Near the poles, jumps across the globe, gaps, invalid fixes, HDOP and speed up to their largest values */
+    uint64_t rng = seed;
+    nmea_filter_init(&filter, config);
+    gps_fix_core_t fix = {0};
+    uint32_t out_of_range = 0;
+    for (uint32_t i = 0; i < FR_RANDOM_FIXES; i++) {
+        uint32_t r = (uint32_t)(nmea_sim_uniform(&rng) * 1000);
+        fix.valid = r % 50 != 0;
+        fix.time_ms = (fix.time_ms + (r % 20 ? 100 : (uint32_t)(nmea_sim_uniform(&rng) * 5000))) % 86400000;
+        fix.dop_h = r % 10 ? 80 + r % 200 : (uint16_t)(nmea_sim_uniform(&rng) * 65536);
+        fix.speed = r % 7 ? (uint16_t)(nmea_sim_uniform(&rng) * 4000) : (uint16_t)(nmea_sim_uniform(&rng) * 65536);
+        fix.cog = (uint16_t)(nmea_sim_uniform(&rng) * 36000);
+        if (r % 100 == 0) {
+            fix.latitude = (int32_t)(nmea_sim_uniform(&rng) * 1800000001) - 900000000;
+            fix.longitude = (int32_t)((int64_t)(nmea_sim_uniform(&rng) * 3600000000.0) - 1800000000);
+        } else {
+            fix.latitude += (int32_t)(nmea_sim_uniform(&rng) * 2001) - 1000;
+            fix.longitude += (int32_t)(nmea_sim_uniform(&rng) * 2001) - 1000;
+            fix.latitude = fix.latitude > 900000000 ? 900000000 : fix.latitude < -900000000 ? -900000000 : fix.latitude;
+            fix.longitude = fix.longitude >= 1800000000 ? fix.longitude - 1800000000 : fix.longitude;
+        }
+        gps_fix_core_t out = fix;
+        nmea_filter_update(&filter, &out);
+        out_of_range += out.latitude > 900001000 || out.latitude < -900001000 || out.longitude < -1800000000 ||
+                        out.longitude >= 1800000000;
+    }
+    printf("random: %u fixes, %u filtered, %u rejected, %u restarts, %u out of range\n", FR_RANDOM_FIXES,
+           (unsigned)filter.filtered, (unsigned)filter.rejected, (unsigned)filter.resets, out_of_range);
+    if (out_of_range) {
+        printf("FAIL: %u positions out of range\n", out_of_range);
+        fail++;
+    }
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    nmea_filter_config_t config = {.uere = 300, .speed_error = 20, .accel = 300, .gate = 3, .reset_ms = 10000};
+    uint32_t period_ms = 200;
+    uint32_t laps = 6;
+    uint64_t seed = 7;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-p")) {
+            period_ms = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-l")) {
+            laps = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-u")) {
+            config.uere = (uint16_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-v")) {
+            config.speed_error = (uint16_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-a")) {
+            config.accel = (uint16_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-g")) {
+            config.gate = (uint8_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-r")) {
+            config.reset_ms = (uint16_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    if (argc % 2 == 0 || !period_ms || !laps) {
+        fprintf(stderr, "usage: %s [-p PERIOD_MS] [-l LAPS] [-u UERE_CM] [-v SPEED_ERROR_CMS] [-a ACCEL_CMS2] "
+                "[-g GATE] [-r RESET_MS] [-s SEED]\n", argv[0]);
+        return 1;
+    }
+    bool defaults = config.uere == 300 && config.speed_error == 20 && config.accel == 300 && config.gate == 3 &&
+                    config.reset_ms == 10000 && period_ms == 200 && laps == 6 && seed == 7;
+
+    nmea_sim_drive_t drive;
+    if (nmea_sim_drive(&drive, fr_lap, sizeof(fr_lap) / sizeof(fr_lap[0]), laps, 90, 37.5665, 126.978)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    size_t epochs = drive.count / period_ms;
+    uint8_t *kinds = malloc(epochs);
+    fr_replay_t replay = {
+        .drive = &drive,
+        .fixes = malloc(epochs * sizeof(gps_fix_core_t)),
+        .err_raw = malloc(epochs * sizeof(double)),
+        .err_filtered = malloc(epochs * sizeof(double)),
+    };
+    char *log = kinds ? fr_generate(&drive, period_ms, seed, kinds, &epochs) : NULL;
+    if (!log || !replay.fixes || !replay.err_raw || !replay.err_filtered) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    size_t log_len = strlen(log);
+    nmea_filter_init(&replay.filter, &config);
+    static nmea_decoder_t decoder;
+    nmea_decoder_cb_t cb = {.epoch = fr_epoch, .ctx = &replay};
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC), &cb);
+    /* Rejections of each fix, from the counter of the filter */
+    size_t kind_count[FR_KIND_MAX] = {0};
+    size_t kind_rejected[FR_KIND_MAX] = {0};
+    const char *line = log;
+    for (size_t k = 0; k < epochs; k++) {
+        const char *end = strchr(strchr(line, '\n') + 1, '\n') + 1;
+        uint32_t rejected = replay.filter.rejected;
+        nmea_decoder_feed(&decoder, (const uint8_t *)line, end - line);
+        kind_count[kinds[k]]++;
+        kind_rejected[kinds[k]] += replay.filter.rejected != rejected;
+        line = end;
+    }
+
+    printf("%zu fixes every %u ms, uere %u cm, speed error %u cm/s, accel %u cm/s^2, gate %u, reset %u ms\n",
+           replay.fix_count, period_ms, (unsigned)config.uere, (unsigned)config.speed_error, (unsigned)config.accel,
+           (unsigned)config.gate, (unsigned)config.reset_ms);
+    double rms;
+    double max;
+    fr_report("raw", replay.err_raw, replay.fix_count, &rms, &max);
+    double p95 = fr_report("filtered", replay.err_filtered, replay.fix_count, &rms, &max);
+    printf("  rejected: %zu of %zu spikes, %zu of %zu multipath fixes, %zu of %zu clean fixes, %u restarts\n",
+           kind_rejected[FR_SPIKE], kind_count[FR_SPIKE], kind_rejected[FR_MULTIPATH], kind_count[FR_MULTIPATH],
+           kind_rejected[FR_CLEAN], kind_count[FR_CLEAN], (unsigned)replay.filter.resets);
+    printf("  filter %.0f ns per fix, decoder %.0f ns per fix\n",
+           fr_time_filter(&config, replay.fixes, replay.fix_count), fr_time_decoder(log, log_len));
+
+    int fail = 0;
+    if (defaults) {
+        if (rms > FR_RMS_MAX || p95 > FR_P95_MAX || max > FR_ERR_MAX) {
+            printf("FAIL: limits are %.1f m rms, %.1f m p95 and %.1f m max\n", FR_RMS_MAX, FR_P95_MAX, FR_ERR_MAX);
+            fail++;
+        }
+        if (kind_rejected[FR_SPIKE] < FR_SPIKES_REJECTED * kind_count[FR_SPIKE] ||
+                kind_rejected[FR_CLEAN] > FR_CLEAN_REJECTED * kind_count[FR_CLEAN] || replay.filter.resets) {
+            printf("FAIL: limits are %.0f%% of the spikes and %.0f%% of the clean fixes rejected, no restart\n",
+                   FR_SPIKES_REJECTED * 100, FR_CLEAN_REJECTED * 100);
+            fail++;
+        }
+    }
+    fail += fr_extreme(&config, seed);
+    free(log);
+    free(kinds);
+    free(replay.fixes);
+    free(replay.err_raw);
+    free(replay.err_filtered);
+    nmea_sim_drive_free(&drive);
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,424 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Fix log replay, host tool and regression check
+ *
+ * Build:  cc -O2 -pthread -Itools/host -Imain -o nmea_fix_log_replay tools/nmea_fix_log_replay.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c main/nmea_fix_log.c -lm
+ *
+ * nmea_fix_log_replay [-l LAPS] [-n NOISE_CM] [-r MIN_RATIO] [-s SEED]
+ *     Drive laps of one minute with turns at 10 Hz (600 fixes a lap), decode the GGA and RMC statements and
+ *     append each fix to a fix log in a file (nmea_fix_log_storage_file()), as the parser does. The drive must
+ *     fill more than FL_WRAP_BLOCKS blocks (2 laps or more).
+ *
+ * Reported: bytes per fix in the log, block headers included, against the bytes of the statements.
+ *
+ * Regression checks (exit 1 on failure):
+ *     - round trip: every fix read back from a log holding the whole drive is the fix appended, also after
+ *       reopening the log, and the log is at least MIN_RATIO (10) times smaller than the statements
+ *     - wrap: on a log of FL_WRAP_BLOCKS blocks, the oldest blocks are dropped, and random time ranges and seeks
+ *       return exactly the fixes of the range still held, ranges before the oldest block included
+ *     - torn record: a record cut by a reset is not read back after reopening, and the next fixes follow it
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nmea_decoder.h"
+#include "nmea_fix_log.h"
+#include "nmea_sim.h"
+
+#define FL_PERIOD_MS (100)
+#define FL_START_MS (8 * 3600000) /* UTC time of the start of the drive */
+#define FL_WRAP_BLOCKS (4)        /* Blocks of the log of the wrap check, less than the drive needs */
+#define FL_SEEKS (500)            /* Random ranges read from the wrapped log */
+
+static const nmea_sim_segment_t fl_lap[] = {
+    {5, 3, 0}, {10, 0, 0}, {6, 0, 15}, {8, 0, 0}, {4, 0, -20}, {10, 0, 3}, {9, 0, -8}, {5, 0, 0}, {3, -5, 0},
+};
+
+/**
+ * @brief Fixes of the drive, as decoded from the statements
+ *
+ */
+typedef struct {
+    gps_fix_core_t *fixes; /*!< Valid fixes */
+    int64_t *utc_ms;       /*!< Time of each fix */
+    uint32_t count;
+} fl_fixes_t;
+
+/**
+ * @brief Fixes read back from a log
+ *
+ */
+typedef struct {
+    fl_fixes_t read;
+    uint32_t max;          /*!< Stop reading after this number of fixes */
+} fl_reader_t;
+
+/**
+ * @brief File storage tearing the next write, as a reset in the middle of a write would
+ *
+ */
+typedef struct {
+    nmea_fix_log_storage_t file; /*!< Storage the writes go to */
+    size_t torn;                 /*!< Bytes written by the torn write, 0 until torn */
+    int tear;                    /*!< Tear the next write */
+} fl_torn_storage_t;
+
+static void fl_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    fl_fixes_t *drive = ctx;
+    gps_fix_core_t core;
+    (void)data;
+    (void)len;
+    nmea_decoder_fix_core(gps, &core);
+    if (core.valid) {
+        drive->fixes[drive->count] = core;
+        drive->utc_ms[drive->count++] = nmea_fix_utc_ms(&core);
+    }
+}
+
+static bool fl_read_cb(const gps_fix_core_t *fix, int64_t utc_ms, void *arg)
+{
+    fl_reader_t *reader = arg;
+    reader->read.fixes[reader->read.count] = *fix;
+    reader->read.utc_ms[reader->read.count++] = utc_ms;
+    return reader->read.count < reader->max;
+}
+
+static esp_err_t fl_torn_read(void *ctx, uint32_t offset, void *data, size_t size)
+{
+    fl_torn_storage_t *storage = ctx;
+    return storage->file.read(storage->file.ctx, offset, data, size);
+}
+
+static esp_err_t fl_torn_write(void *ctx, uint32_t offset, const void *data, size_t size)
+{
+    fl_torn_storage_t *storage = ctx;
+    if (storage->tear) {
+        storage->tear = 0;
+        storage->torn = size / 2;
+        storage->file.write(storage->file.ctx, offset, data, size / 2);
+        return ESP_FAIL;
+    }
+    return storage->file.write(storage->file.ctx, offset, data, size);
+}
+
+static esp_err_t fl_torn_erase(void *ctx, uint32_t offset, size_t size)
+{
+    fl_torn_storage_t *storage = ctx;
+    return storage->file.erase(storage->file.ctx, offset, size);
+}
+
+/**
+ * @brief Open a log on a file of a number of blocks
+ *
+ * @param torn storage tearing writes on demand, NULL to open the file directly
+ */
+static nmea_fix_log_handle_t fl_open(FILE *file, uint32_t blocks, fl_torn_storage_t *torn)
+{
+    nmea_fix_log_storage_t storage;
+    nmea_fix_log_handle_t log = NULL;
+    if (nmea_fix_log_storage_file(file, blocks * CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE, &storage) != ESP_OK) {
+        return NULL;
+    }
+    if (torn) {
+        torn->file = storage;
+        storage.read = fl_torn_read;
+        storage.write = fl_torn_write;
+        storage.erase = fl_torn_erase;
+        storage.ctx = torn;
+    }
+    if (nmea_fix_log_open(&storage, &log) != ESP_OK) {
+        return NULL;
+    }
+    return log;
+}
+
+/**
+ * @brief Read a time range, and compare it with the expected fixes
+ *
+ * @param reader reader, its buffers large enough for the whole drive
+ * @param max number of fixes to read at most
+ * @return uint32_t number of fixes read back different from the expected ones, or missing, or in excess
+ */
+static uint32_t fl_check_range(nmea_fix_log_handle_t log, fl_reader_t *reader, int64_t from_ms, int64_t to_ms,
+                               uint32_t max, const gps_fix_core_t *fixes, const int64_t *utc_ms, uint32_t count)
+{
+    reader->read.count = 0;
+    reader->max = max;
+    esp_err_t err = nmea_fix_log_read(log, from_ms, to_ms, fl_read_cb, reader);
+    if ((err == ESP_ERR_NOT_FOUND && count) || (err != ESP_OK && err != ESP_ERR_NOT_FOUND)) {
+        return count ? count : 1;
+    }
+    uint32_t diff = reader->read.count > count ? reader->read.count - count : count - reader->read.count;
+    for (uint32_t i = 0; i < reader->read.count && i < count; i++) {
+        diff += memcmp(&reader->read.fixes[i], &fixes[i], sizeof(gps_fix_core_t)) != 0 ||
+                reader->read.utc_ms[i] != utc_ms[i];
+    }
+    return diff;
+}
+
+/**
+ * @brief Log the whole drive, read it back before and after reopening, and measure the bytes per fix
+ *
+ * @return int 0 if the checks pass
+ */
+static int fl_round_trip(const fl_fixes_t *drive, fl_reader_t *reader, size_t nmea_bytes, double min_ratio)
+{
+    /* Room for 16 bytes per fix, more than twice the expected size */
+    uint32_t blocks = drive->count * 16 / CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE + 2;
+    FILE *file = tmpfile();
+    nmea_fix_log_handle_t log = file ? fl_open(file, blocks, NULL) : NULL;
+    if (!log) {
+        fprintf(stderr, "open fix log failed\n");
+        exit(1);
+    }
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < drive->count; i++) {
+        failed += nmea_fix_log_append(log, &drive->fixes[i]) != ESP_OK;
+    }
+    nmea_fix_log_stats_t stats;
+    nmea_fix_log_get_stats(log, &stats);
+    uint32_t diff = fl_check_range(log, reader, INT64_MIN, INT64_MAX, UINT32_MAX, drive->fixes, drive->utc_ms,
+                                   drive->count);
+    nmea_fix_log_close(log);
+    log = fl_open(file, blocks, NULL);
+    uint32_t diff_reopen = log ? fl_check_range(log, reader, INT64_MIN, INT64_MAX, UINT32_MAX, drive->fixes,
+                                                drive->utc_ms, drive->count) : drive->count;
+    double per_fix = (double)stats.bytes / drive->count;
+    double nmea_per_fix = (double)nmea_bytes / drive->count;
+    int fail = failed || stats.fixes != drive->count || stats.first_utc_ms != drive->utc_ms[0] ||
+               stats.last_utc_ms != drive->utc_ms[drive->count - 1] || diff || diff_reopen ||
+               nmea_per_fix < min_ratio * per_fix;
+    printf("round trip: %u fixes in %u of %u blocks, %.2f bytes per fix against %.1f bytes of statements "
+           "(%.1f times smaller), %u fixes read back different, %u after reopening%s\n", (unsigned)drive->count,
+           (unsigned)stats.blocks_used, (unsigned)stats.blocks, per_fix, nmea_per_fix, nmea_per_fix / per_fix,
+           (unsigned)diff, (unsigned)diff_reopen, fail ? "  FAIL" : "");
+    if (failed) {
+        printf("FAIL: %u fixes not appended\n", (unsigned)failed);
+    }
+    if (log) {
+        nmea_fix_log_close(log);
+    }
+    fclose(file);
+    return fail;
+}
+
+/**
+ * @brief Log the whole drive on a log too small for it, then read random ranges of the fixes still held
+ *
+ * @return int 0 if the checks pass
+ */
+static int fl_wrap(const fl_fixes_t *drive, fl_reader_t *reader, uint64_t seed)
+{
+    FILE *file = tmpfile();
+    nmea_fix_log_handle_t log = file ? fl_open(file, FL_WRAP_BLOCKS, NULL) : NULL;
+    if (!log) {
+        fprintf(stderr, "open fix log failed\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < drive->count; i++) {
+        nmea_fix_log_append(log, &drive->fixes[i]);
+    }
+    nmea_fix_log_stats_t stats;
+    nmea_fix_log_get_stats(log, &stats);
+    /* The oldest block held starts with a fix of the drive */
+    uint32_t first = 0;
+    while (first < drive->count && drive->utc_ms[first] != stats.first_utc_ms) {
+        first++;
+    }
+    int fail = first == 0 || first == drive->count || stats.blocks_used != FL_WRAP_BLOCKS;
+    if (fail) {
+        printf("wrap: FAIL, %u of %u blocks used, oldest fix %u of %u\n", (unsigned)stats.blocks_used,
+               (unsigned)stats.blocks, (unsigned)first, (unsigned)drive->count);
+        nmea_fix_log_close(log);
+        fclose(file);
+        return fail;
+    }
+    const gps_fix_core_t *held = &drive->fixes[first];
+    const int64_t *held_ms = &drive->utc_ms[first];
+    uint32_t held_count = drive->count - first;
+    uint32_t diff_all = fl_check_range(log, reader, INT64_MIN, INT64_MAX, UINT32_MAX, held, held_ms, held_count);
+
+    /* Ranges from before the oldest block to after the last fix, seeks stop at the first fix */
+    uint64_t rng = seed;
+    uint32_t ranges_diff = 0, seeks_diff = 0, empty = 0;
+    int64_t span = held_ms[held_count - 1] - held_ms[0];
+    for (uint32_t k = 0; k < FL_SEEKS; k++) {
+        int64_t from = held_ms[0] - 5000 + (int64_t)(nmea_sim_uniform(&rng) * (span + 6000));
+        int64_t to = from + (int64_t)(nmea_sim_uniform(&rng) * 3000);
+        uint32_t lo = 0;
+        while (lo < held_count && held_ms[lo] < from) {
+            lo++;
+        }
+        uint32_t hi = lo;
+        while (hi < held_count && held_ms[hi] <= to) {
+            hi++;
+        }
+        empty += hi == lo;
+        ranges_diff += fl_check_range(log, reader, from, to, UINT32_MAX, held + lo, held_ms + lo, hi - lo) != 0;
+        seeks_diff += fl_check_range(log, reader, from, INT64_MAX, 1, held + lo, held_ms + lo,
+                                     lo < held_count ? 1 : 0) != 0;
+    }
+    /* Ranges entirely before the oldest block were erased */
+    uint32_t erased_diff = fl_check_range(log, reader, drive->utc_ms[0], held_ms[0] - 1, UINT32_MAX, NULL, NULL, 0);
+    fail = diff_all || ranges_diff || seeks_diff || erased_diff;
+    printf("wrap: %u blocks hold fixes %u to %u of %u, %u fixes read back different, %u of %u ranges (%u empty) "
+           "and %u seeks wrong, erased range %s%s\n", (unsigned)FL_WRAP_BLOCKS, (unsigned)first,
+           (unsigned)drive->count - 1, (unsigned)drive->count, (unsigned)diff_all, (unsigned)ranges_diff,
+           (unsigned)FL_SEEKS, (unsigned)empty, (unsigned)seeks_diff, erased_diff ? "read" : "not found",
+           fail ? "  FAIL" : "");
+    nmea_fix_log_close(log);
+    fclose(file);
+    return fail;
+}
+
+/**
+ * @brief Tear a record in the middle of the drive, reopen the log and log the rest of the drive
+ *
+ * @return int 0 if the checks pass
+ */
+static int fl_torn(const fl_fixes_t *drive, fl_reader_t *reader)
+{
+    uint32_t blocks = drive->count * 16 / CONFIG_NMEA_PARSER_FIX_LOG_BLOCK_SIZE + 2;
+    uint32_t half = drive->count / 2;
+    fl_torn_storage_t torn = {0};
+    FILE *file = tmpfile();
+    nmea_fix_log_handle_t log = file ? fl_open(file, blocks, &torn) : NULL;
+    if (!log) {
+        fprintf(stderr, "open fix log failed\n");
+        exit(1);
+    }
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < half; i++) {
+        failed += nmea_fix_log_append(log, &drive->fixes[i]) != ESP_OK;
+    }
+    torn.tear = 1;
+    esp_err_t err = nmea_fix_log_append(log, &drive->fixes[half]);
+    nmea_fix_log_close(log);
+
+    /* Reset: the torn record is not read back, the next fixes are appended after it */
+    log = fl_open(file, blocks, NULL);
+    if (!log) {
+        printf("torn record: FAIL, reopen failed\n");
+        fclose(file);
+        return 1;
+    }
+    uint32_t diff_reopen = fl_check_range(log, reader, INT64_MIN, INT64_MAX, UINT32_MAX, drive->fixes,
+                                          drive->utc_ms, half);
+    for (uint32_t i = half + 1; i < drive->count; i++) {
+        failed += nmea_fix_log_append(log, &drive->fixes[i]) != ESP_OK;
+    }
+    uint32_t diff_before = fl_check_range(log, reader, INT64_MIN, drive->utc_ms[half], UINT32_MAX, drive->fixes,
+                                          drive->utc_ms, half);
+    uint32_t diff_after = fl_check_range(log, reader, drive->utc_ms[half], INT64_MAX, UINT32_MAX,
+                                         drive->fixes + half + 1, drive->utc_ms + half + 1, drive->count - half - 1);
+    int fail = err == ESP_OK || !torn.torn || failed || diff_reopen || diff_before || diff_after;
+    printf("torn record: %u of the bytes of fix %u written, %u fixes read back different after reopening, "
+           "%u before and %u after the torn record once the drive is logged%s\n", (unsigned)torn.torn,
+           (unsigned)half, (unsigned)diff_reopen, (unsigned)diff_before, (unsigned)diff_after, fail ? "  FAIL" : "");
+    if (failed) {
+        printf("FAIL: %u fixes not appended\n", (unsigned)failed);
+    }
+    nmea_fix_log_close(log);
+    fclose(file);
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t laps = 10;
+    double noise_cm = 1;
+    double min_ratio = 10;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "-l")) {
+            laps = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-n")) {
+            noise_cm = atof(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-r")) {
+            min_ratio = atof(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-l LAPS] [-n NOISE_CM] [-r MIN_RATIO] [-s SEED]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!laps) {
+        fprintf(stderr, "laps must not be 0\n");
+        return 1;
+    }
+
+    nmea_sim_drive_t sim;
+    if (nmea_sim_drive(&sim, fl_lap, sizeof(fl_lap) / sizeof(fl_lap[0]), laps, 30, 48.1, 11.6)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    uint32_t epochs = (uint32_t)((sim.count - 1) / FL_PERIOD_MS);
+    fl_fixes_t drive = {
+        .fixes = malloc(epochs * sizeof(gps_fix_core_t)),
+        .utc_ms = malloc(epochs * sizeof(int64_t)),
+    };
+    fl_reader_t reader = {
+        .read = {
+            .fixes = malloc(epochs * sizeof(gps_fix_core_t)),
+            .utc_ms = malloc(epochs * sizeof(int64_t)),
+        },
+    };
+    if (!drive.fixes || !drive.utc_ms || !reader.read.fixes || !reader.read.utc_ms) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    nmea_decoder_t decoder;
+    nmea_decoder_cb_t cb = {.epoch = fl_epoch, .ctx = &drive};
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC), &cb);
+    char text[256];
+    size_t nmea_bytes = 0;
+    uint64_t rng = seed;
+    for (uint32_t i = 0; i < epochs; i++) {
+        int64_t ms = (int64_t)i * FL_PERIOD_MS;
+        const nmea_sim_truth_t *truth = nmea_sim_at(&sim, ms);
+        nmea_sim_fix_t fix = {
+            .time_ms = (uint32_t)(FL_START_MS + ms),
+            .east = truth->east + nmea_sim_gauss(&rng, noise_cm / 100),
+            .north = truth->north + nmea_sim_gauss(&rng, noise_cm / 100),
+            .speed = truth->speed,
+            .course = truth->heading,
+            .hdop = 0.8,
+            .sats = 12,
+            .valid = 1,
+        };
+        size_t len = nmea_sim_epoch(&sim, &fix, text);
+        nmea_bytes += len;
+        nmea_decoder_feed(&decoder, (const uint8_t *)text, len);
+    }
+    nmea_sim_drive_free(&sim);
+    if (drive.count < 2) {
+        fprintf(stderr, "no fix decoded\n");
+        return 1;
+    }
+
+    int fail = fl_round_trip(&drive, &reader, nmea_bytes, min_ratio);
+    fail |= fl_wrap(&drive, &reader, seed);
+    fail |= fl_torn(&drive, &reader);
+    free(drive.fixes);
+    free(drive.utc_ms);
+    free(reader.read.fixes);
+    free(reader.read.utc_ms);
+    return fail;
+}
@@ -0,0 +1,435 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Sentence forwarding replay, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_forward_replay tools/nmea_forward_replay.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c main/nmea_forward.c -lm
+ *
+ * nmea_forward_replay [-e EPOCHS] [-s SEED]
+ *     Feed lines to nmea_forward_feed() as the parser does, with three sinks: all sentences written straight
+ *     from the line, "GP" talkers of GGA and RMC written straight from the line, and GSA and PUBX batched.
+ *
+ * Regression checks (exit 1 on failure), on the bytes and the number of writes of each sink:
+ *     - split: an epoch cut into three lines at every pair of positions gives the same output
+ *     - carry: sentences split across lines and longer than NMEA_MAX_STATEMENT_LENGTH, or truncated by the
+ *       next '$', are dropped without losing the next sentences; a split sentence of exactly that length is not
+ *     - runs: adjacent sentences of a line are written at once, a sentence filtered out or other bytes between
+ *       them end the run
+ *     - timed flush: a batch is written NMEA_FORWARD_FLUSH_MS after its first sentence when no epoch ends, at the
+ *       end of the epoch otherwise, and when the buffer is full
+ *     - replay: EPOCHS (2000) epochs with UBX frames between sentences, read in lines of random length
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nmea_forward.h"
+#include "nmea_sim.h"
+
+#define FW_SINKS (3)
+#define FW_PERIOD_MS (100)
+#define FW_READ_MAX (96)      /* Longest line of the replay */
+#define FW_OUT_SIZE (1 << 20) /* Output kept per sink */
+
+#define FW_GGA "$GPGGA,081500.00,4806.00000,N,01136.00000,E,1,12,0.8,520.0,M,47.0,M,,*5A\r\n"
+#define FW_RMC "$GPRMC,081500.00,A,4806.00000,N,01136.00000,E,10.500,30.00,181026,,,A*6B\r\n"
+#define FW_GSA "$GNGSA,A,3,01,02,03,04,05,06,,,,,,,1.5,0.8,1.2,1*2E\r\n"
+#define FW_GSV "$GPGSV,3,1,12,01,40,083,46,02,17,308,41,03,07,344,39,04,22,228,45*75\r\n"
+#define FW_PUBX "$PUBX,00,081500.00,4806.00000,N,01136.00000,E,520.0,G3,2.1,2.0,0.5,30.0,0.0,,0.8,1.2,0.9,12,0,0*5D\r\n"
+
+static const nmea_forward_config_t fw_configs[FW_SINKS] = {
+    {.talkers = NULL, .sentences = NULL, .batch = false},
+    {.talkers = "GP", .sentences = "GGA,RMC", .batch = false},
+    {.talkers = NULL, .sentences = "GSA,PUBX", .batch = true},
+};
+
+/**
+ * @brief Output of a sink
+ *
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    uint32_t writes;
+} fw_out_t;
+
+static fw_out_t fw_out[FW_SINKS];
+static nmea_forward_t fw_forward;
+
+static void fw_write(void *arg, const uint8_t *data, size_t len)
+{
+    fw_out_t *out = arg;
+    if (out->len + len <= FW_OUT_SIZE) {
+        memcpy(out->data + out->len, data, len);
+    }
+    out->len += len;
+    out->writes++;
+}
+
+static void fw_append(fw_out_t *out, const char *text, size_t len)
+{
+    if (out->len + len <= FW_OUT_SIZE) {
+        memcpy(out->data + out->len, text, len);
+    }
+    out->len += len;
+}
+
+/**
+ * @brief Start over with empty sinks, as added by nmea_parser_add_forward_sink()
+ *
+ */
+static void fw_reset(void)
+{
+    memset(&fw_forward, 0, sizeof(fw_forward));
+    for (int i = 0; i < FW_SINKS; i++) {
+        nmea_forward_sink_t *sink = &fw_forward.sinks[i];
+        sink->write = fw_write;
+        sink->arg = &fw_out[i];
+        sink->batch = fw_configs[i].batch;
+        if (nmea_forward_filter_init(&fw_configs[i], &sink->filter) != ESP_OK) {
+            fprintf(stderr, "bad filter of sink %d\n", i);
+            exit(1);
+        }
+        fw_out[i].len = 0;
+        fw_out[i].writes = 0;
+    }
+}
+
+static void fw_feed(const char *line, size_t len, uint32_t now_ms)
+{
+    nmea_forward_feed(&fw_forward, (const uint8_t *)line, len, now_ms);
+}
+
+static void fw_feed_str(const char *line, uint32_t now_ms)
+{
+    fw_feed(line, strlen(line), now_ms);
+}
+
+/**
+ * @brief Compare the output of the sinks, NULL writes to skip the count of writes, NULL name to not print
+ *
+ * @return int 1 if an output differs
+ */
+static int fw_expect(const char *name, const char *const expected[FW_SINKS], const uint32_t *writes)
+{
+    int fail = 0;
+    for (int i = 0; i < FW_SINKS; i++) {
+        size_t len = strlen(expected[i]);
+        if (fw_out[i].len != len || memcmp(fw_out[i].data, expected[i], len) ||
+                (writes && fw_out[i].writes != writes[i])) {
+            fail = 1;
+            if (!name) {
+                continue;
+            }
+            printf("FAIL: %s, sink %d wrote %u bytes in %u writes, expected %u bytes", name, i,
+                   (unsigned)fw_out[i].len, (unsigned)fw_out[i].writes, (unsigned)len);
+            if (writes) {
+                printf(" in %u writes", (unsigned)writes[i]);
+            }
+            printf("\n");
+        }
+    }
+    return fail;
+}
+
+/**
+ * @brief An epoch cut into three lines at every pair of positions
+ *
+ */
+static int fw_split(void)
+{
+    static const char epoch[] = FW_GGA FW_GSV FW_RMC FW_GSA FW_PUBX;
+    static const char *const expected[FW_SINKS] = {epoch, FW_GGA FW_RMC, FW_GSA FW_PUBX};
+    size_t len = sizeof(epoch) - 1;
+    uint32_t cuts = 0, wrong = 0;
+    for (size_t a = 1; a < len; a++) {
+        for (size_t b = a; b < len; b++) {
+            fw_reset();
+            fw_feed(epoch, a, 0);
+            fw_feed(epoch + a, b - a, 0);
+            fw_feed(epoch + b, len - b, 0);
+            nmea_forward_flush(&fw_forward);
+            /* One run per line and one carried sentence per cut at most, one batch */
+            int fail = fw_expect(wrong ? NULL : "split", expected, NULL) || fw_out[0].writes > 5 || fw_out[1].writes > 4 ||
+                       fw_out[2].writes != 1 || fw_forward.forwarded != 9;
+            wrong += fail;
+            cuts++;
+            if (fail && wrong == 1) {
+                printf("FAIL: split at %u and %u\n", (unsigned)a, (unsigned)b);
+            }
+        }
+    }
+    printf("split: %u cuts of a %u byte epoch, %u with a different output%s\n", (unsigned)cuts, (unsigned)len,
+           (unsigned)wrong, wrong ? "  FAIL" : "");
+    return wrong != 0;
+}
+
+/**
+ * @brief Sentence of a given length, line ending included
+ *
+ */
+static void fw_long_sentence(char *out, size_t len)
+{
+    strcpy(out, "$GPTXT,01,01,02,");
+    size_t n = strlen(out);
+    memset(out + n, 'X', len - n - 5);
+    strcpy(out + len - 5, "*00\r\n");
+}
+
+/**
+ * @brief Sentences split across lines that do not fit the carry, or truncated
+ *
+ */
+static int fw_carry(void)
+{
+    char text[512];
+    char longest[NMEA_MAX_STATEMENT_LENGTH + 1];
+    int fail = 0;
+
+    /* Split in three lines, too long once the second line is appended */
+    fw_reset();
+    fw_long_sentence(text, 200);
+    fw_feed(text, 50, 0);
+    fw_feed(text + 50, 100, 0);
+    strcpy(text + 200, FW_GGA);
+    fw_feed_str(text + 150, 0);
+    fail |= fw_expect("carry overflow", (const char *const[]) {FW_GGA, FW_GGA, ""}, (const uint32_t[]) {1, 1, 0});
+
+    /* Start of a line already too long for the carry */
+    fw_reset();
+    fw_long_sentence(text, 200);
+    fw_feed(text, 150, 0);
+    strcpy(text + 200, FW_RMC);
+    fw_feed_str(text + 150, 0);
+    fail |= fw_expect("carry too long", (const char *const[]) {FW_RMC, FW_RMC, ""}, (const uint32_t[]) {1, 1, 0});
+
+    /* Split sentence truncated by the next one */
+    fw_reset();
+    fw_feed_str(FW_GSV FW_GGA "$GPRMC,0815", 0);
+    fw_feed_str(FW_GSA, 0);
+    nmea_forward_flush(&fw_forward);
+    fail |= fw_expect("carry truncated", (const char *const[]) {FW_GSV FW_GGA FW_GSA, FW_GGA, FW_GSA},
+                      (const uint32_t[]) {2, 1, 1});
+
+    /* Longest sentence the carry holds, and one byte more */
+    fw_reset();
+    fw_long_sentence(longest, NMEA_MAX_STATEMENT_LENGTH);
+    fw_feed(longest, 60, 0);
+    fw_feed(longest + 60, NMEA_MAX_STATEMENT_LENGTH - 60, 0);
+    fw_long_sentence(text, NMEA_MAX_STATEMENT_LENGTH + 1);
+    fw_feed(text, 60, 0);
+    fw_feed(text + 60, NMEA_MAX_STATEMENT_LENGTH + 1 - 60, 0);
+    fail |= fw_expect("carry longest", (const char *const[]) {longest, "", ""}, (const uint32_t[]) {1, 0, 0});
+
+    printf("carry: overflow, too long, truncated and longest split sentences%s\n", fail ? "  FAIL" : "");
+    return fail;
+}
+
+/**
+ * @brief Runs of adjacent sentences written at once by the sinks without batching
+ *
+ */
+static int fw_runs(void)
+{
+    int fail = 0;
+
+    fw_reset();
+    fw_feed_str(FW_GGA FW_RMC FW_GSV FW_GSA, 0);
+    fail |= fw_expect("runs adjacent", (const char *const[]) {FW_GGA FW_RMC FW_GSV FW_GSA, FW_GGA FW_RMC, ""},
+                      (const uint32_t[]) {1, 1, 0});
+
+    /* A sentence filtered out ends the run of the sink */
+    fw_reset();
+    fw_feed_str(FW_GGA FW_GSV FW_RMC, 0);
+    fail |= fw_expect("runs filtered", (const char *const[]) {FW_GGA FW_GSV FW_RMC, FW_GGA FW_RMC, ""},
+                      (const uint32_t[]) {1, 2, 0});
+
+    /* So do other bytes, a UBX frame between two sentences */
+    fw_reset();
+    fw_feed_str(FW_GGA "\xb5\x62\x01\x07\x02\x01\x11\x22\x3c\x8b" FW_RMC, 0);
+    fail |= fw_expect("runs ubx", (const char *const[]) {FW_GGA FW_RMC, FW_GGA FW_RMC, ""},
+                      (const uint32_t[]) {2, 2, 0});
+
+    /* A carried sentence is written alone, the sentences after it as one run */
+    static const char carried[] = FW_GGA FW_RMC FW_GSV;
+    fw_reset();
+    fw_feed(carried, 5, 0);
+    fw_feed_str(carried + 5, 0);
+    fail |= fw_expect("runs carried", (const char *const[]) {FW_GGA FW_RMC FW_GSV, FW_GGA FW_RMC, ""},
+                      (const uint32_t[]) {2, 2, 0});
+
+    printf("runs: adjacent, filtered, UBX and carried sentences%s\n", fail ? "  FAIL" : "");
+    return fail;
+}
+
+/**
+ * @brief Batches written by the flush timeout, at the end of the epoch and when full
+ *
+ */
+static int fw_timed(void)
+{
+    char text[4096] = "";
+    int fail = 0;
+
+    /* No epoch ends: written once the first sentence is NMEA_FORWARD_FLUSH_MS old */
+    fw_reset();
+    fw_feed_str(FW_GSA, 1000);
+    fw_feed_str(FW_PUBX, 1000 + NMEA_FORWARD_FLUSH_MS - 50);
+    fw_feed_str(FW_GGA, 1000 + NMEA_FORWARD_FLUSH_MS - 1);
+    fail |= fw_out[2].writes != 0;
+    nmea_forward_poll(&fw_forward, 1000 + NMEA_FORWARD_FLUSH_MS);
+    fail |= fw_expect("timed poll", (const char *const[]) {FW_GSA FW_PUBX FW_GGA, FW_GGA, FW_GSA FW_PUBX},
+                      (const uint32_t[]) {3, 1, 1}) || fw_forward.timed_flushes != 1;
+
+    /* A line received late writes the old batch before its own sentences */
+    fw_feed_str(FW_GSA, 2000);
+    fw_feed_str(FW_PUBX, 2000 + NMEA_FORWARD_FLUSH_MS);
+    fail |= fw_out[2].writes != 2 || fw_forward.timed_flushes != 2 || fw_forward.sinks[2].fill != strlen(FW_PUBX);
+
+    /* The end of the epoch writes the batch before the timeout */
+    nmea_forward_flush(&fw_forward);
+    fw_feed_str(FW_GSA, 3000);
+    nmea_forward_flush(&fw_forward);
+    nmea_forward_poll(&fw_forward, 3000 + NMEA_FORWARD_FLUSH_MS);
+    fail |= fw_expect("timed epoch", (const char *const[]) {FW_GSA FW_PUBX FW_GGA FW_GSA FW_PUBX FW_GSA,
+                                                            FW_GGA, FW_GSA FW_PUBX FW_GSA FW_PUBX FW_GSA},
+                      (const uint32_t[]) {6, 1, 4}) || fw_forward.timed_flushes != 2;
+
+    /* A full buffer is written before the sentence that does not fit */
+    fw_reset();
+    uint32_t per_buffer = NMEA_FORWARD_BUFFER_SIZE / strlen(FW_PUBX);
+    uint32_t count = 3 * per_buffer + 1;
+    for (uint32_t i = 0; i < count; i++) {
+        fw_feed_str(FW_PUBX, 5000);
+        strcat(text, FW_PUBX);
+    }
+    nmea_forward_flush(&fw_forward);
+    fail |= fw_expect("timed full", (const char *const[]) {text, "", text},
+                      (const uint32_t[]) {count, 0, (count + per_buffer - 1) / per_buffer}) ||
+            fw_forward.timed_flushes != 0;
+
+    printf("timed flush: after %u ms, at the end of the epoch and on a full buffer (%u sentences of %u)%s\n",
+           (unsigned)NMEA_FORWARD_FLUSH_MS, (unsigned)per_buffer, (unsigned)strlen(FW_PUBX), fail ? "  FAIL" : "");
+    return fail;
+}
+
+/**
+ * @brief Epochs with UBX frames between sentences, read in lines of random length
+ *
+ */
+static int fw_replay(uint32_t epochs, uint64_t seed)
+{
+    static fw_out_t expected[FW_SINKS];
+    char text[1024];
+    char body[160];
+    uint64_t rng = seed;
+    uint32_t sentences = 0, lines = 0;
+    for (int i = 0; i < FW_SINKS; i++) {
+        expected[i].data = malloc(FW_OUT_SIZE);
+        expected[i].len = 0;
+        if (!expected[i].data) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    fw_reset();
+    for (uint32_t e = 0; e < epochs; e++) {
+        uint32_t t = 8 * 3600 + e / 10;
+        char utc[16];
+        sprintf(utc, "%02u%02u%02u.%02u", t / 3600, t / 60 % 60, t % 60, (e % 10) * 10);
+        size_t len = 0;
+        for (int s = 0; s < 5; s++) {
+            if (nmea_sim_uniform(&rng) < 0.3) {
+                /* UBX frame, without '$' so that it does not start a sentence */
+                size_t frame = 8 + (size_t)(nmea_sim_uniform(&rng) * 40);
+                for (size_t k = 0; k < frame; k++) {
+                    uint8_t byte = (uint8_t)(nmea_sim_uniform(&rng) * 256);
+                    text[len++] = byte == '$' ? 0 : byte;
+                }
+            }
+            static const char *const formats[] = {
+                "GPGGA,%s,4806.%05u,N,01136.%05u,E,1,12,0.8,520.0,M,47.0,M,,",
+                "GNRMC,%s,A,4806.%05u,N,01136.%05u,E,10.500,30.00,181026,,,A",
+                "GPRMC,%s,A,4806.%05u,N,01136.%05u,E,10.500,30.00,181026,,,A",
+                "GNGSA,A,3,01,02,03,04,05,06,,,,,,,1.5,0.8,1.2,1",
+                "PUBX,00,%s,4806.%05u,N,01136.%05u,E,520.0,G3,2.1,2.0,0.5,30.0,0.0,,0.8,1.2,0.9,12,0,0",
+            };
+            unsigned minutes = e % 100000;
+            snprintf(body, sizeof(body), formats[s], utc, minutes, minutes);
+            size_t n = nmea_sim_statement(text + len, body);
+            fw_append(&expected[0], text + len, n);
+            sentences++;
+            if (s == 0 || s == 2) {
+                fw_append(&expected[1], text + len, n);
+                sentences++;
+            } else if (s >= 3) {
+                fw_append(&expected[2], text + len, n);
+                sentences++;
+            }
+            len += n;
+        }
+        for (size_t pos = 0; pos < len; lines++) {
+            size_t n = 1 + (size_t)(nmea_sim_uniform(&rng) * FW_READ_MAX);
+            n = n < len - pos ? n : len - pos;
+            fw_feed(text + pos, n, e * FW_PERIOD_MS);
+            pos += n;
+        }
+        nmea_forward_flush(&fw_forward);
+    }
+    int fail = fw_forward.forwarded != sentences || fw_out[2].writes != epochs || fw_forward.timed_flushes != 0;
+    for (int i = 0; i < FW_SINKS; i++) {
+        fail |= fw_out[i].len != expected[i].len || memcmp(fw_out[i].data, expected[i].data, expected[i].len);
+    }
+    printf("replay: %u epochs in %u lines, %u sentences forwarded in %u writes (%u, %u and %u per sink)%s\n",
+           (unsigned)epochs, (unsigned)lines, (unsigned)fw_forward.forwarded, (unsigned)fw_forward.writes,
+           (unsigned)fw_out[0].writes, (unsigned)fw_out[1].writes, (unsigned)fw_out[2].writes, fail ? "  FAIL" : "");
+    for (int i = 0; i < FW_SINKS; i++) {
+        free(expected[i].data);
+    }
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t epochs = 2000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "-e")) {
+            epochs = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-e EPOCHS] [-s SEED]\n", argv[0]);
+            return 1;
+        }
+    }
+    for (int i = 0; i < FW_SINKS; i++) {
+        fw_out[i].data = malloc(FW_OUT_SIZE);
+        if (!fw_out[i].data) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+    int fail = fw_split();
+    fail |= fw_carry();
+    fail |= fw_runs();
+    fail |= fw_timed();
+    fail |= fw_replay(epochs, seed);
+    for (int i = 0; i < FW_SINKS; i++) {
+        free(fw_out[i].data);
+    }
+    return fail;
+}
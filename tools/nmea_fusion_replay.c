@@ -0,0 +1,531 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Dual receiver fusion paired replay, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_fusion_replay tools/nmea_fusion_replay.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c main/nmea_fusion.c main/nmea_predictor.c -lm
+ *
+ * nmea_fusion_replay [-t TIMEOUT_MS] [-k TICK_MS] [-l LATENCY_MS] [-s SEED]
+ *     Generate the paired logs of two 10 Hz receivers on a 10 minute drive: GGA, GSA and RMC statements with a
+ *     slowly varying bias and white noise, arriving line by line at 115200 baud after the latency of each
+ *     receiver (A 45 ms + 3 ms jitter, B 35 ms + 20 ms jitter). A stops its output for 5 s and is degraded to 2D
+ *     for 40 s, B loses its fix for 20 s and stops for 1.5 s, each loses 0.5% of its epochs on the line.
+ *     The logs are replayed through one decoder per receiver as the parser task does: each receiver alone, then
+ *     both through nmea_fusion_push() in select and weight mode, nmea_fusion_poll() running at the next tick of
+ *     TICK_MS after a timeout. Each published fix is fed to nmea_predictor_update(), valid at the epoch time passed
+ *     with it minus LATENCY_MS.
+ *
+ * Reported: availability (UTC times published with a valid fix), latency from the UTC time of a fix to its
+ * publication, position error and largest jump of the error, the receivers the epochs come from, and the error of
+ * the displacement predicted from the fix to its publication, with the epoch time of the receiver published and
+ * with the one of the primary receiver (the parser before the epoch time went through the fusion stage).
+ *
+ * Regression checks of select and weight mode (exit 1 on failure): the epoch time passed with each epoch is the
+ * first statement of that epoch on its receiver (the earlier one for an average), every UTC time delivered with a
+ * fix by a receiver is published with a fix, the error is at most 10% above receiver A alone, preferred by its
+ * HDOP (and weight below select), no epoch is published later than the timeout after the slowest receiver, and the predictions stay
+ * within 1.5 m.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nmea_decoder.h"
+#include "nmea_fusion.h"
+#include "nmea_predictor.h"
+#include "nmea_sim.h"
+
+#define FU_PERIOD_MS (100)
+#define FU_BAUD (115200)
+#define FU_LINE_MAX (128)
+#define FU_BIAS_TAU_S (60)        /* Gauss-Markov bias of each receiver */
+#define FU_BIAS_SIGMA (0.7)       /* m */
+#define FU_LOSS (0.005)           /* Epochs lost on the line */
+#define FU_HIST_MS (1000)
+#define FU_ERR_MARGIN (1.1)       /* Limits of the regression check */
+#define FU_PREDICTED_MAX (1.5)    /* m */
+
+static const nmea_sim_segment_t fu_route[] = {
+    {20, 0, 0}, {6, 2.5, 0}, {40, 0, 0}, {5, 0, 18}, {30, 0, 0}, {5, -3, 0}, {30, 0, 0}, {5, 3, 0}, {20, 0, 0},
+    {4, 0, -22.5}, {15, 0, 0}, {3, 0, 30}, {10, 0, 0}, {5, 1, 0}, {60, 0, 0}, {2, 0, 4}, {2, 0, -4}, {60, 0, 0},
+    {4, -2.5, 0}, {10, 0, 0}, {4, 0, 22.5}, {4, -2.5, 0}, {254, 0, 0},
+};
+
+/**
+ * @brief Output of a receiver at a time
+ *
+ */
+typedef enum {
+    FU_SILENT,   /*!< No output */
+    FU_NO_FIX,   /*!< Statements without fix */
+    FU_2D,       /*!< 2D fix, few satellites */
+    FU_3D,       /*!< 3D fix */
+} fu_output_t;
+
+/**
+ * @brief Simulated receiver
+ *
+ */
+typedef struct {
+    double white;       /*!< White position noise at HDOP 1 (m) */
+    double latency_ms;  /*!< Time from the fix to its first statement */
+    double jitter_ms;
+    double hdop;        /*!< HDOP of a 3D fix */
+    uint8_t sats;       /*!< Satellites in use in a 3D fix */
+    double bias_east;
+    double bias_north;
+} fu_receiver_t;
+
+static fu_output_t fu_output(int rx, double t)
+{
+    if (!rx) {
+        if (t >= 300 && t < 305) {
+            return FU_SILENT;
+        }
+        return t >= 500 && t < 540 ? FU_2D : FU_3D;
+    }
+    if (t >= 600 && t < 620) {
+        return FU_NO_FIX;
+    }
+    return t >= 700 && t < 701.5 ? FU_SILENT : FU_3D;
+}
+
+/**
+ * @brief Line of the paired logs
+ *
+ */
+typedef struct {
+    double at_ms;            /*!< Local time its line end arrives */
+    uint8_t rx;
+    char text[FU_LINE_MAX];
+} fu_line_t;
+
+/**
+ * @brief Paired logs and what the receivers delivered
+ *
+ */
+typedef struct {
+    nmea_sim_drive_t drive;
+    fu_line_t *lines;
+    size_t line_count;
+    size_t epochs;                      /*!< UTC times of the drive */
+    double *first_ms[NMEA_FUSION_RX_NUM]; /*!< Arrival of the first statement of each epoch, NAN if not sent */
+    uint8_t *has_fix;                   /*!< A receiver sent the epoch with a fix */
+} fu_logs_t;
+
+static void fu_add_line(fu_logs_t *logs, uint8_t rx, double at_ms, const char *text, size_t len)
+{
+    fu_line_t *line = &logs->lines[logs->line_count++];
+    line->at_ms = at_ms;
+    line->rx = rx;
+    memcpy(line->text, text, len);
+    line->text[len] = '\0';
+}
+
+/* Order of arrival, receiver A first at the same time */
+static int fu_line_cmp(const void *a, const void *b)
+{
+    const fu_line_t *x = a;
+    const fu_line_t *y = b;
+    if (x->at_ms != y->at_ms) {
+        return x->at_ms < y->at_ms ? -1 : 1;
+    }
+    return x->rx - y->rx;
+}
+
+/**
+ * @brief Generate the statements of both receivers, ordered by arrival
+ *
+ */
+static void fu_generate(fu_logs_t *logs, uint64_t seed)
+{
+    fu_receiver_t receivers[NMEA_FUSION_RX_NUM] = {
+        {.white = 0.3, .latency_ms = 45, .jitter_ms = 3, .hdop = 0.8, .sats = 11},
+        {.white = 0.4, .latency_ms = 35, .jitter_ms = 20, .hdop = 1.1, .sats = 9},
+    };
+    uint64_t rng = seed;
+    logs->epochs = logs->drive.count / FU_PERIOD_MS;
+    logs->lines = malloc(logs->epochs * NMEA_FUSION_RX_NUM * 3 * sizeof(fu_line_t));
+    logs->has_fix = calloc(logs->epochs, 1);
+    for (int rx = 0; rx < NMEA_FUSION_RX_NUM; rx++) {
+        logs->first_ms[rx] = malloc(logs->epochs * sizeof(double));
+    }
+    if (!logs->lines || !logs->has_fix || !logs->first_ms[0] || !logs->first_ms[1]) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    double a = exp(-FU_PERIOD_MS / 1000.0 / FU_BIAS_TAU_S);
+    double q = FU_BIAS_SIGMA * sqrt(1 - a * a);
+    char text[384];
+    for (size_t k = 0; k < logs->epochs; k++) {
+        uint32_t ms = (uint32_t)(k * FU_PERIOD_MS);
+        const nmea_sim_truth_t *truth = nmea_sim_at(&logs->drive, ms);
+        for (int rx = 0; rx < NMEA_FUSION_RX_NUM; rx++) {
+            fu_receiver_t *r = &receivers[rx];
+            r->bias_east = a * r->bias_east + nmea_sim_gauss(&rng, q);
+            r->bias_north = a * r->bias_north + nmea_sim_gauss(&rng, q);
+            logs->first_ms[rx][k] = NAN;
+            fu_output_t output = fu_output(rx, ms / 1000.0);
+            if (output == FU_SILENT || nmea_sim_uniform(&rng) < FU_LOSS) {
+                continue;
+            }
+            double hdop = output == FU_3D ? r->hdop : 2.6;
+            double scale = output == FU_3D ? 1 : 4;
+            nmea_sim_fix_t fix = {
+                .time_ms = ms,
+                .east = truth->east + scale * (r->bias_east + nmea_sim_gauss(&rng, r->white * hdop)),
+                .north = truth->north + scale * (r->bias_north + nmea_sim_gauss(&rng, r->white * hdop)),
+                .speed = fmax(0, truth->speed + nmea_sim_gauss(&rng, 0.05)),
+                .course = truth->heading + nmea_sim_gauss(&rng, 0.3),
+                .hdop = hdop,
+                .sats = output == FU_3D ? r->sats : 5,
+                .valid = output != FU_NO_FIX,
+            };
+            logs->has_fix[k] |= fix.valid;
+            size_t len = nmea_sim_epoch(&logs->drive, &fix, text);
+            /* GSA between GGA and RMC, for the fix mode */
+            size_t gga_len = strchr(text, '\n') - text + 1;
+            char gsa[FU_LINE_MAX];
+            char body[96];
+            sprintf(body, "GPGSA,A,%d,01,02,03,04,05,,,,,,,,%.1f,%.1f,%.1f", output == FU_3D ? 3 : output == FU_2D ? 2 : 1,
+                    hdop * 1.3, hdop, hdop);
+            size_t gsa_len = nmea_sim_statement(gsa, body);
+            memmove(text + gga_len + gsa_len, text + gga_len, len - gga_len + 1);
+            memcpy(text + gga_len, gsa, gsa_len);
+            len += gsa_len;
+            /* Line by line at the baud rate, after the latency of the receiver */
+            double at_ms = ms + r->latency_ms + fabs(nmea_sim_gauss(&rng, r->jitter_ms));
+            for (size_t off = 0; off < len;) {
+                size_t line = strchr(text + off, '\n') - (text + off) + 1;
+                at_ms += line * 10 * 1000.0 / FU_BAUD;
+                if (!off) {
+                    logs->first_ms[rx][k] = at_ms;
+                }
+                fu_add_line(logs, rx, at_ms, text + off, line);
+                off += line;
+            }
+        }
+    }
+    qsort(logs->lines, logs->line_count, sizeof(fu_line_t), fu_line_cmp);
+}
+
+/**
+ * @brief Replay of the paired logs in one mode
+ *
+ */
+typedef struct {
+    const fu_logs_t *logs;
+    int mode;                          /*!< Receiver alone (0 or 1), or 2 select, 3 weight */
+    nmea_fusion_t fusion;
+    nmea_decoder_t decoder[NMEA_FUSION_RX_NUM];
+    int64_t epoch_us[NMEA_FUSION_RX_NUM]; /*!< First statement of the epoch being decoded, of each receiver */
+    double now_ms;
+    uint32_t latency_ms;               /*!< Receiver latency of the predictor */
+    nmea_predictor_t predictor;        /*!< Fed with the epoch time published with the fix */
+    nmea_predictor_t primary;          /*!< Fed with the epoch time of the primary receiver */
+    uint8_t *published;
+    size_t published_count;
+    size_t available;
+    size_t from[NMEA_FUSION_RX_NUM + 1];
+    uint32_t epoch_time_errors;        /*!< Epoch times which are not the first statement of the epoch */
+    double latency_sum;
+    double latency_max;
+    uint32_t latency_hist[FU_HIST_MS];
+    double err_sum2;
+    double err_max;
+    double jump_max;
+    double last_east;
+    double last_north;
+    size_t err_count;
+    double pred_sum2[2];
+    double pred_max[2];
+    size_t pred_count[2];
+} fu_replay_t;
+
+static void fu_predict(fu_replay_t *replay, int i, nmea_predictor_t *predictor, const gps_fix_core_t *fix,
+                       int64_t epoch_us)
+{
+    gps_fix_core_t predicted;
+    int64_t now_us = llround(replay->now_ms * 1000);
+    if (!nmea_predictor_update(predictor, fix, epoch_us - replay->latency_ms * 1000LL) ||
+            !nmea_predictor_predict(predictor, now_us, &predicted)) {
+        return;
+    }
+    /* Displacement from the fix against the true one, the error of the fix itself left out */
+    const nmea_sim_drive_t *drive = &replay->logs->drive;
+    double fix_east;
+    double fix_north;
+    double east;
+    double north;
+    nmea_sim_local(drive, fix->latitude, fix->longitude, &fix_east, &fix_north);
+    nmea_sim_local(drive, predicted.latitude, predicted.longitude, &east, &north);
+    const nmea_sim_truth_t *from = nmea_sim_at(drive, fix->time_ms);
+    const nmea_sim_truth_t *to = nmea_sim_at(drive, now_us / 1000);
+    double err = hypot(east - fix_east - (to->east - from->east), north - fix_north - (to->north - from->north));
+    replay->pred_sum2[i] += err * err;
+    replay->pred_max[i] = fmax(replay->pred_max[i], err);
+    replay->pred_count[i]++;
+}
+
+static void fu_publish(void *ctx, const gps_t *gps, uint8_t rx, int64_t epoch_us)
+{
+    fu_replay_t *replay = ctx;
+    const fu_logs_t *logs = replay->logs;
+    gps_fix_core_t core;
+    nmea_decoder_fix_core(gps, &core);
+    size_t k = core.time_ms / FU_PERIOD_MS;
+    double latency = replay->now_ms - core.time_ms;
+    replay->published_count++;
+    replay->latency_sum += latency;
+    replay->latency_max = fmax(replay->latency_max, latency);
+    replay->latency_hist[(int)fmin(FU_HIST_MS - 1, latency)]++;
+    replay->from[rx]++;
+    if (k >= logs->epochs) {
+        return;
+    }
+    /* Epoch time of the receiver published, the earlier arrival for an average */
+    double first_ms = rx < NMEA_FUSION_RX_NUM ? logs->first_ms[rx][k] :
+                      fmin(logs->first_ms[0][k], logs->first_ms[1][k]);
+    replay->epoch_time_errors += isnan(first_ms) || llabs(epoch_us - llround(first_ms * 1000)) > 1;
+    if (!core.valid || replay->published[k]) {
+        return;
+    }
+    replay->published[k] = 1;
+    replay->available++;
+    double east;
+    double north;
+    nmea_sim_local(&logs->drive, core.latitude, core.longitude, &east, &north);
+    const nmea_sim_truth_t *truth = nmea_sim_at(&logs->drive, core.time_ms);
+    double de = east - truth->east;
+    double dn = north - truth->north;
+    double err = hypot(de, dn);
+    replay->err_sum2 += err * err;
+    replay->err_max = fmax(replay->err_max, err);
+    if (replay->err_count++) {
+        replay->jump_max = fmax(replay->jump_max, hypot(de - replay->last_east, dn - replay->last_north));
+    }
+    replay->last_east = de;
+    replay->last_north = dn;
+    fu_predict(replay, 0, &replay->predictor, &core, epoch_us);
+    fu_predict(replay, 1, &replay->primary, &core, replay->epoch_us[0]);
+}
+
+static void fu_epoch_start(fu_replay_t *replay, int rx)
+{
+    replay->epoch_us[rx] = llround(replay->now_ms * 1000);
+}
+
+static void fu_epoch_start_a(void *ctx)
+{
+    fu_epoch_start(ctx, 0);
+}
+
+static void fu_epoch_start_b(void *ctx)
+{
+    fu_epoch_start(ctx, 1);
+}
+
+static void fu_epoch(fu_replay_t *replay, int rx, const gps_t *gps)
+{
+    if (replay->mode < NMEA_FUSION_RX_NUM) {
+        fu_publish(replay, gps, rx, replay->epoch_us[rx]);
+    } else {
+        nmea_fusion_push(&replay->fusion, rx, gps, replay->epoch_us[rx], (uint32_t)replay->now_ms);
+    }
+}
+
+static void fu_epoch_a(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    fu_epoch(ctx, 0, gps);
+}
+
+static void fu_epoch_b(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    fu_epoch(ctx, 1, gps);
+}
+
+/**
+ * @brief Replay the logs, the parser task wakes up on each line and at the next tick after a fusion timeout
+ *
+ */
+static void fu_replay(fu_replay_t *replay, const fu_logs_t *logs, int mode, uint16_t timeout_ms, uint32_t tick_ms,
+                      uint32_t latency_ms)
+{
+    memset(replay, 0, sizeof(*replay));
+    replay->logs = logs;
+    replay->mode = mode;
+    replay->latency_ms = latency_ms;
+    replay->published = calloc(logs->epochs, 1);
+    if (!replay->published) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    nmea_predictor_init(&replay->predictor);
+    nmea_predictor_init(&replay->primary);
+    nmea_decoder_cb_t cb[NMEA_FUSION_RX_NUM] = {
+        {.epoch = fu_epoch_a, .epoch_start = fu_epoch_start_a, .ctx = replay},
+        {.epoch = fu_epoch_b, .epoch_start = fu_epoch_start_b, .ctx = replay},
+    };
+    for (int rx = 0; rx < NMEA_FUSION_RX_NUM; rx++) {
+        nmea_decoder_init(&replay->decoder[rx], (1 << STATEMENT_GGA) | (1 << STATEMENT_GSA) | (1 << STATEMENT_RMC),
+                          &cb[rx]);
+    }
+    nmea_fusion_config_t config = {
+        .mode = mode == 3 ? NMEA_FUSION_WEIGHT : NMEA_FUSION_SELECT,
+        .timeout_ms = timeout_ms,
+    };
+    nmea_fusion_init(&replay->fusion, &config, fu_publish, replay);
+    bool fused = mode >= NMEA_FUSION_RX_NUM;
+    double deadline = INFINITY;
+    for (size_t i = 0; i < logs->line_count; i++) {
+        const fu_line_t *line = &logs->lines[i];
+        if (!fused && line->rx != mode) {
+            continue;
+        }
+        while (deadline <= line->at_ms) {
+            replay->now_ms = deadline;
+            uint32_t wait_ms = nmea_fusion_poll(&replay->fusion, (uint32_t)replay->now_ms);
+            deadline = wait_ms == UINT32_MAX ? INFINITY : ceil((replay->now_ms + wait_ms) / tick_ms) * tick_ms;
+        }
+        replay->now_ms = line->at_ms;
+        nmea_decoder_feed(&replay->decoder[line->rx], (const uint8_t *)line->text, strlen(line->text));
+        if (fused) {
+            uint32_t wait_ms = nmea_fusion_poll(&replay->fusion, (uint32_t)replay->now_ms);
+            deadline = wait_ms == UINT32_MAX ? INFINITY : ceil((replay->now_ms + wait_ms) / tick_ms) * tick_ms;
+        }
+    }
+}
+
+static double fu_rms(const fu_replay_t *replay)
+{
+    return sqrt(replay->err_sum2 / replay->err_count);
+}
+
+static void fu_print(const fu_replay_t *replay)
+{
+    static const char *const names[] = {"A alone", "B alone", "select", "weight"};
+    uint32_t count = 0;
+    int p99 = 0;
+    while (p99 < FU_HIST_MS - 1 && (count += replay->latency_hist[p99]) < replay->published_count * 0.99) {
+        p99++;
+    }
+    printf("%-8s availability %6.2f%% (%zu/%zu), latency avg %5.1f p99 %3d max %5.1f ms, "
+           "error rms %.2f max %.2f jump %.2f m\n", names[replay->mode], 100.0 * replay->available / replay->logs->epochs,
+           replay->available, replay->logs->epochs, replay->latency_sum / replay->published_count, p99,
+           replay->latency_max, fu_rms(replay), replay->err_max, replay->jump_max);
+    if (replay->mode >= NMEA_FUSION_RX_NUM) {
+        const nmea_fusion_t *fusion = &replay->fusion;
+        printf("         from A %zu B %zu average %zu, failovers %u timeouts %u late %u, %u epoch times wrong\n",
+               replay->from[0], replay->from[1], replay->from[NMEA_FUSION_RX_NUM], (unsigned)fusion->failovers,
+               (unsigned)fusion->timeouts, (unsigned)fusion->late, replay->epoch_time_errors);
+    }
+    printf("         predicted at publication: rms %.2f max %.2f m", sqrt(replay->pred_sum2[0] / replay->pred_count[0]),
+           replay->pred_max[0]);
+    if (replay->mode >= NMEA_FUSION_RX_NUM) {
+        printf(", with the epoch time of A: rms %.2f max %.2f m", sqrt(replay->pred_sum2[1] / replay->pred_count[1]),
+               replay->pred_max[1]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t timeout_ms = 50;
+    uint32_t tick_ms = 10;
+    uint32_t latency_ms = 45;
+    uint64_t seed = 7;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-t")) {
+            timeout_ms = (uint16_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-k")) {
+            tick_ms = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-l")) {
+            latency_ms = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-t TIMEOUT_MS] [-k TICK_MS] [-l LATENCY_MS] [-s SEED]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || !tick_ms) {
+        fprintf(stderr, "usage: %s [-t TIMEOUT_MS] [-k TICK_MS] [-l LATENCY_MS] [-s SEED]\n", argv[0]);
+        return 1;
+    }
+
+    static fu_logs_t logs;
+    if (nmea_sim_drive(&logs.drive, fu_route, sizeof(fu_route) / sizeof(fu_route[0]), 1, 45, 37.2, 127.0)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    fu_generate(&logs, seed);
+    size_t with_fix = 0;
+    for (size_t k = 0; k < logs.epochs; k++) {
+        with_fix += logs.has_fix[k];
+    }
+
+    static fu_replay_t replays[4];
+    for (int mode = 0; mode < 4; mode++) {
+        fu_replay(&replays[mode], &logs, mode, timeout_ms, tick_ms, latency_ms);
+        fu_print(&replays[mode]);
+    }
+
+    int fail = 0;
+    double primary_rms = fu_rms(&replays[0]);
+    double slowest_ms = fmax(replays[0].latency_max, replays[1].latency_max);
+    for (int mode = 2; mode < 4; mode++) {
+        const fu_replay_t *replay = &replays[mode];
+        if (replay->epoch_time_errors) {
+            printf("FAIL: %u epoch times are not the first statement of their epoch\n", replay->epoch_time_errors);
+            fail++;
+        }
+        if (replay->available < with_fix) {
+            printf("FAIL: %zu UTC times published with a fix, %zu delivered with a fix\n", replay->available, with_fix);
+            fail++;
+        }
+        if (fu_rms(replay) > FU_ERR_MARGIN * primary_rms) {
+            printf("FAIL: error rms %.2f m, receiver A alone %.2f m\n", fu_rms(replay), primary_rms);
+            fail++;
+        }
+        if (replay->latency_max > slowest_ms + timeout_ms + tick_ms) {
+            printf("FAIL: latency max %.1f ms, slowest receiver %.1f ms and timeout %u ms\n", replay->latency_max,
+                   slowest_ms, (unsigned)timeout_ms);
+            fail++;
+        }
+        if (replay->pred_max[0] > FU_PREDICTED_MAX) {
+            printf("FAIL: prediction %.2f m off, limit %.1f m\n", replay->pred_max[0], FU_PREDICTED_MAX);
+            fail++;
+        }
+    }
+    if (fu_rms(&replays[3]) > fu_rms(&replays[2])) {
+        printf("FAIL: weight %.2f m rms above select %.2f m\n", fu_rms(&replays[3]), fu_rms(&replays[2]));
+        fail++;
+    }
+    for (int mode = 0; mode < 4; mode++) {
+        free(replays[mode].published);
+    }
+    free(logs.lines);
+    free(logs.has_fix);
+    free(logs.first_ms[0]);
+    free(logs.first_ms[1]);
+    nmea_sim_drive_free(&logs.drive);
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,504 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Fleet gateway benchmark, host tool
+ *
+ * Build:  cc -O2 -pthread -Itools/nmea_gateway -Imain -o nmea_gateway tools/nmea_gateway/nmea_gateway.c \
+ *            main/nmea_decoder.c main/nmea_ubx.c -lm
+ *
+ * nmea_gateway [-s STREAMS] [-e EPOCHS] [-S SHARDS] [-t THREADS[,THREADS...]]
+ *     Decode STREAMS simulated receivers sending EPOCHS epochs of GGA, GSA and RMC statements each, split in
+ *     packets of random size and interleaved as they would arrive at a gateway, and encode every epoch as
+ *     UBX NAV-PVT. The run is repeated for each number of threads.
+ *
+ * Each stream owns an nmea_decoder_t, decoding needs no lock and no allocation. Streams are sharded by ID:
+ * packets are queued in arrival order on the queue of their shard, and a shard with pending packets is
+ * scheduled on the deque of a worker. Workers pop shards from their own deque (newest first) and steal
+ * from the other deques (oldest first) when it is empty. A shard is on at most one deque and processed by
+ * at most one worker at a time, so the packets of a stream are decoded in arrival order by any number of
+ * threads. This is checked by comparing a hash of the NAV-PVT frames of each stream with a sequential run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include "nmea_decoder.h"
+#include "nmea_ubx.h"
+
+#define GW_MAX_THREADS (256)
+#define GW_STATEMENTS ((1 << STATEMENT_GGA) | (1 << STATEMENT_GSA) | (1 << STATEMENT_RMC))
+#define GW_FNV_OFFSET (14695981039346656037ULL)
+#define GW_FNV_PRIME (1099511628211ULL)
+
+/**
+ * @brief Simulated receiver and its decoding state
+ *
+ */
+typedef struct {
+    nmea_decoder_t decoder; /*!< Decoder of the stream */
+    uint32_t id;            /*!< Stream ID */
+    uint64_t hash;          /*!< FNV-1a of the NAV-PVT frames, in order */
+    uint32_t frames;        /*!< NAV-PVT frames encoded */
+} gw_stream_t;
+
+/**
+ * @brief Packet received from a stream
+ *
+ */
+typedef struct gw_packet {
+    struct gw_packet *next; /*!< Next packet of the shard queue */
+    gw_stream_t *stream;    /*!< Sending stream */
+    const uint8_t *data;    /*!< Payload, in the input arena */
+    uint32_t len;           /*!< Payload length */
+} gw_packet_t;
+
+/**
+ * @brief Shard, queue of the packets of the streams with the same ID modulo the number of shards
+ *
+ */
+typedef struct {
+    pthread_mutex_t lock; /*!< Protects the queue and the scheduled flag */
+    gw_packet_t *head;    /*!< Oldest queued packet */
+    gw_packet_t *tail;    /*!< Newest queued packet */
+    bool scheduled;       /*!< On a worker deque or being processed */
+} gw_shard_t;
+
+/**
+ * @brief Worker deque of scheduled shards
+ *
+ */
+typedef struct {
+    pthread_mutex_t lock; /*!< Protects the ring */
+    gw_shard_t **ring;    /*!< Shards, a shard is on at most one deque */
+    uint32_t mask;        /*!< Ring size - 1 */
+    uint32_t top;         /*!< Next shard to steal */
+    uint32_t bottom;      /*!< Next free slot, owner pops below it */
+    uint64_t stolen;      /*!< Shards stolen by this worker */
+} gw_deque_t;
+
+/**
+ * @brief Gateway, thread pool and shards
+ *
+ */
+typedef struct {
+    gw_shard_t *shards;
+    uint32_t shard_num;
+    gw_deque_t deques[GW_MAX_THREADS];
+    pthread_t threads[GW_MAX_THREADS];
+    uint32_t thread_num;
+    sem_t work;                  /*!< One count per shard on a deque, plus one per worker at shutdown */
+    atomic_bool stop;            /*!< Workers exit on their next wake up */
+    atomic_uint_fast64_t done;   /*!< Packets decoded */
+    pthread_mutex_t idle_lock;   /*!< Protects idle */
+    pthread_cond_t idle;         /*!< Signaled when all submitted packets were decoded */
+    uint64_t submitted;          /*!< Packets submitted */
+} gw_pool_t;
+
+typedef struct {
+    gw_pool_t *pool;
+    uint32_t index;
+} gw_worker_arg_t;
+
+static uint64_t gw_fnv(uint64_t hash, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * GW_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Epoch callback of the decoders, encode the epoch as NAV-PVT
+ *
+ */
+static void gw_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    gw_stream_t *stream = ctx;
+    uint8_t frame[NMEA_UBX_NAV_PVT_SIZE];
+    size_t size = nmea_ubx_encode_nav_pvt(gps, frame, sizeof(frame));
+    stream->hash = gw_fnv(stream->hash, frame, size);
+    stream->frames++;
+}
+
+static void gw_stream_init(gw_stream_t *stream, uint32_t id)
+{
+    nmea_decoder_cb_t cb = {
+        .epoch = gw_epoch,
+        .ctx = stream,
+    };
+    nmea_decoder_init(&stream->decoder, GW_STATEMENTS, &cb);
+    stream->id = id;
+    stream->hash = GW_FNV_OFFSET;
+    stream->frames = 0;
+}
+
+static void gw_deque_push(gw_deque_t *deque, gw_shard_t *shard)
+{
+    pthread_mutex_lock(&deque->lock);
+    deque->ring[deque->bottom++ & deque->mask] = shard;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static gw_shard_t *gw_deque_pop(gw_deque_t *deque)
+{
+    gw_shard_t *shard = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        shard = deque->ring[--deque->bottom & deque->mask];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return shard;
+}
+
+static gw_shard_t *gw_deque_steal(gw_deque_t *deque)
+{
+    gw_shard_t *shard = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        shard = deque->ring[deque->top++ & deque->mask];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return shard;
+}
+
+/**
+ * @brief Decode the queued packets of a shard, then reschedule it on the worker deque if packets arrived meanwhile
+ *
+ */
+static void gw_shard_run(gw_pool_t *pool, uint32_t worker, gw_shard_t *shard)
+{
+    pthread_mutex_lock(&shard->lock);
+    gw_packet_t *packet = shard->head;
+    shard->head = shard->tail = NULL;
+    pthread_mutex_unlock(&shard->lock);
+
+    uint64_t count = 0;
+    for (; packet; packet = packet->next, count++) {
+        nmea_decoder_feed(&packet->stream->decoder, packet->data, packet->len);
+    }
+
+    bool again;
+    pthread_mutex_lock(&shard->lock);
+    again = shard->head != NULL;
+    shard->scheduled = again;
+    pthread_mutex_unlock(&shard->lock);
+    if (again) {
+        gw_deque_push(&pool->deques[worker], shard);
+        sem_post(&pool->work);
+    }
+
+    if (atomic_fetch_add(&pool->done, count) + count == pool->submitted) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_signal(&pool->idle);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+}
+
+static void *gw_worker(void *arg)
+{
+    gw_worker_arg_t *worker = arg;
+    gw_pool_t *pool = worker->pool;
+    uint32_t self = worker->index;
+    for (;;) {
+        sem_wait(&pool->work);
+        if (atomic_load(&pool->stop)) {
+            break;
+        }
+        /* Each semaphore count stands for a shard on some deque, keep looking until it is found */
+        gw_shard_t *shard = gw_deque_pop(&pool->deques[self]);
+        for (uint32_t i = 1; !shard; i++) {
+            shard = gw_deque_steal(&pool->deques[(self + i) % pool->thread_num]);
+            if (shard) {
+                pool->deques[self].stolen++;
+            }
+        }
+        gw_shard_run(pool, self, shard);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Queue a packet on its shard, schedule the shard if it was idle
+ *
+ */
+static void gw_submit(gw_pool_t *pool, gw_packet_t *packet)
+{
+    gw_shard_t *shard = &pool->shards[packet->stream->id % pool->shard_num];
+    packet->next = NULL;
+    pthread_mutex_lock(&shard->lock);
+    if (shard->tail) {
+        shard->tail->next = packet;
+    } else {
+        shard->head = packet;
+    }
+    shard->tail = packet;
+    bool schedule = !shard->scheduled;
+    shard->scheduled = true;
+    pthread_mutex_unlock(&shard->lock);
+    if (schedule) {
+        gw_deque_push(&pool->deques[(packet->stream->id % pool->shard_num) % pool->thread_num], shard);
+        sem_post(&pool->work);
+    }
+}
+
+static void gw_pool_start(gw_pool_t *pool, uint32_t thread_num, uint32_t shard_num, gw_worker_arg_t *args)
+{
+    uint32_t ring = 1;
+    while (ring < shard_num) {
+        ring <<= 1;
+    }
+    pool->shard_num = shard_num;
+    pool->shards = calloc(shard_num, sizeof(gw_shard_t));
+    for (uint32_t i = 0; i < shard_num; i++) {
+        pthread_mutex_init(&pool->shards[i].lock, NULL);
+    }
+    pool->thread_num = thread_num;
+    sem_init(&pool->work, 0, 0);
+    atomic_store(&pool->stop, false);
+    atomic_store(&pool->done, 0);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (uint32_t i = 0; i < thread_num; i++) {
+        gw_deque_t *deque = &pool->deques[i];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->ring = calloc(ring, sizeof(gw_shard_t *));
+        deque->mask = ring - 1;
+        deque->top = deque->bottom = 0;
+        deque->stolen = 0;
+        args[i].pool = pool;
+        args[i].index = i;
+        pthread_create(&pool->threads[i], NULL, gw_worker, &args[i]);
+    }
+}
+
+static uint64_t gw_pool_stop(gw_pool_t *pool)
+{
+    uint64_t stolen = 0;
+    atomic_store(&pool->stop, true);
+    for (uint32_t i = 0; i < pool->thread_num; i++) {
+        sem_post(&pool->work);
+    }
+    for (uint32_t i = 0; i < pool->thread_num; i++) {
+        pthread_join(pool->threads[i], NULL);
+        stolen += pool->deques[i].stolen;
+        free(pool->deques[i].ring);
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    for (uint32_t i = 0; i < pool->shard_num; i++) {
+        pthread_mutex_destroy(&pool->shards[i].lock);
+    }
+    free(pool->shards);
+    sem_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle);
+    return stolen;
+}
+
+/**
+ * @brief Append a statement with its checksum and line ending
+ *
+ */
+static size_t gw_statement(char *out, const char *body)
+{
+    uint8_t crc = 0;
+    for (const char *c = body; *c; c++) {
+        crc ^= (uint8_t)*c;
+    }
+    return sprintf(out, "$%s*%02X\r\n", body, crc);
+}
+
+/**
+ * @brief NMEA statements of one epoch of a stream, a vehicle driving around its own start point
+ *
+ */
+static size_t gw_epoch_text(char *out, uint32_t id, uint32_t epoch)
+{
+    char body[96];
+    size_t len = 0;
+    double t = epoch + id * 0.37;
+    double lat = 30.0 + (id % 100) * 0.05 + 0.002 * sin(t / 60);
+    double lon = 120.0 + (id / 100 % 100) * 0.05 + 0.002 * cos(t / 60);
+    double speed_kn = 20 + 10 * sin(t / 30 + id);
+    double course = fmod(360 + 90 + t * 3, 360);
+    uint32_t s = 8 * 3600 + epoch;
+    int lat_deg = (int)lat, lon_deg = (int)lon;
+    double lat_min = (lat - lat_deg) * 60, lon_min = (lon - lon_deg) * 60;
+    char utc[16];
+    sprintf(utc, "%02u%02u%02u.00", s / 3600 % 24, s / 60 % 60, s % 60);
+
+    sprintf(body, "GPGGA,%s,%02d%08.5f,N,%03d%08.5f,E,1,%02u,0.9,%.1f,M,8.0,M,,", utc, lat_deg, lat_min,
+            lon_deg, lon_min, 7 + id % 5, 15 + 5 * sin(t / 100));
+    len += gw_statement(out + len, body);
+    sprintf(body, "GPGSA,A,3,04,05,09,12,17,20,,,,,,,1.8,0.9,1.5");
+    len += gw_statement(out + len, body);
+    sprintf(body, "GPRMC,%s,A,%02d%08.5f,N,%03d%08.5f,E,%.2f,%.1f,100324,,,A", utc, lat_deg, lat_min,
+            lon_deg, lon_min, speed_kn, course);
+    len += gw_statement(out + len, body);
+    return len;
+}
+
+static double gw_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t gw_rand(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 33;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t stream_num = 4096;
+    uint32_t epoch_num = 60;
+    uint32_t shard_num = 1024;
+    const char *thread_list = "1,2,4,8,16,32";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-s")) {
+            stream_num = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-e")) {
+            epoch_num = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-S")) {
+            shard_num = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-t")) {
+            thread_list = argv[i + 1];
+        } else {
+            fprintf(stderr, "usage: %s [-s STREAMS] [-e EPOCHS] [-S SHARDS] [-t THREADS[,THREADS...]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!stream_num || !epoch_num || !shard_num) {
+        fprintf(stderr, "streams, epochs and shards must not be 0\n");
+        return 1;
+    }
+
+    /* Generate the input: packets of 16 to 200 bytes, streams interleaved in random order in each epoch */
+    size_t arena_size = (size_t)stream_num * epoch_num * 256;
+    uint8_t *arena = malloc(arena_size);
+    size_t packet_cap = (size_t)stream_num * epoch_num * 8;
+    gw_packet_t *packets = malloc(packet_cap * sizeof(gw_packet_t));
+    gw_stream_t *streams = malloc(stream_num * sizeof(gw_stream_t));
+    uint32_t *order = malloc(stream_num * sizeof(uint32_t));
+    if (!arena || !packets || !streams || !order) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    size_t arena_len = 0, packet_num = 0;
+    uint64_t rng = 1;
+    for (uint32_t i = 0; i < stream_num; i++) {
+        order[i] = i;
+    }
+    for (uint32_t e = 0; e < epoch_num; e++) {
+        for (uint32_t i = stream_num - 1; i > 0; i--) {
+            uint32_t j = gw_rand(&rng) % (i + 1);
+            uint32_t tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        for (uint32_t i = 0; i < stream_num; i++) {
+            uint8_t *text = arena + arena_len;
+            size_t len = gw_epoch_text((char *)text, order[i], e);
+            for (size_t off = 0; off < len;) {
+                uint32_t n = 16 + gw_rand(&rng) % 185;
+                n = n < len - off ? n : len - off;
+                packets[packet_num].stream = &streams[order[i]];
+                packets[packet_num].data = text + off;
+                packets[packet_num].len = n;
+                packet_num++;
+                off += n;
+            }
+            arena_len += len;
+        }
+    }
+    printf("%u streams, %u epochs, %zu packets, %.1f MB, %u shards, decoder %zu bytes per stream\n",
+           stream_num, epoch_num, packet_num, arena_len / 1e6, shard_num, sizeof(nmea_decoder_t));
+
+    /* Reference: sequential decoding without the pool */
+    for (uint32_t i = 0; i < stream_num; i++) {
+        gw_stream_init(&streams[i], i);
+    }
+    double t0 = gw_now();
+    for (size_t i = 0; i < packet_num; i++) {
+        nmea_decoder_feed(&packets[i].stream->decoder, packets[i].data, packets[i].len);
+    }
+    double seq = gw_now() - t0;
+    uint64_t *ref = malloc(stream_num * sizeof(uint64_t));
+    uint64_t frames = 0;
+    for (uint32_t i = 0; i < stream_num; i++) {
+        ref[i] = streams[i].hash;
+        frames += streams[i].frames;
+    }
+    printf("sequential  %8.3f s  %10.0f fixes/s  %7.1f MB/s\n", seq, frames / seq, arena_len / seq / 1e6);
+
+    gw_pool_t *pool = calloc(1, sizeof(gw_pool_t));
+    gw_worker_arg_t args[GW_MAX_THREADS];
+    for (const char *p = thread_list; *p;) {
+        uint32_t thread_num = strtoul(p, (char **)&p, 10);
+        if (*p == ',') {
+            p++;
+        }
+        if (!thread_num || thread_num > GW_MAX_THREADS) {
+            fprintf(stderr, "threads must be 1 to %d\n", GW_MAX_THREADS);
+            return 1;
+        }
+        for (uint32_t i = 0; i < stream_num; i++) {
+            gw_stream_init(&streams[i], i);
+        }
+        gw_pool_start(pool, thread_num, shard_num, args);
+        pool->submitted = packet_num;
+        t0 = gw_now();
+        for (size_t i = 0; i < packet_num; i++) {
+            gw_submit(pool, &packets[i]);
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        while (atomic_load(&pool->done) != packet_num) {
+            pthread_cond_wait(&pool->idle, &pool->idle_lock);
+        }
+        pthread_mutex_unlock(&pool->idle_lock);
+        double run = gw_now() - t0;
+        uint64_t stolen = gw_pool_stop(pool);
+
+        uint32_t mismatch = 0;
+        for (uint32_t i = 0; i < stream_num; i++) {
+            mismatch += streams[i].hash != ref[i];
+        }
+        printf("%3u threads %8.3f s  %10.0f fixes/s  %7.1f MB/s  speedup %5.2f  steals %8llu  %s\n", thread_num, run,
+               frames / run, arena_len / run / 1e6, seq / run, (unsigned long long)stolen,
+               mismatch ? "ORDER MISMATCH" : "order ok");
+        if (mismatch) {
+            return 1;
+        }
+    }
+
+    free(pool);
+    free(ref);
+    free(order);
+    free(streams);
+    free(packets);
+    free(arena);
+    return 0;
+}
@@ -0,0 +1,14 @@
+/*
+ * Configuration of the NMEA decoder built for the host by nmea_gateway,
+ * in place of the sdkconfig.h generated by menuconfig.
+ */
+#pragma once
+
+#define CONFIG_NMEA_STATEMENT_GGA 1
+#define CONFIG_NMEA_STATEMENT_GSA 1
+#define CONFIG_NMEA_STATEMENT_GSV 1
+#define CONFIG_NMEA_STATEMENT_RMC 1
+#define CONFIG_NMEA_STATEMENT_GLL 1
+#define CONFIG_NMEA_STATEMENT_VTG 1
+#define CONFIG_NMEA_PARSER_STATEMENT_PARSER_NUM 0
+#define CONFIG_NMEA_PARSER_SKIP_REDUNDANT_FIELDS 1
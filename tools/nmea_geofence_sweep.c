@@ -0,0 +1,351 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Geofence sweep, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_geofence_sweep tools/nmea_geofence_sweep.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c main/nmea_geofence.c -lm
+ *
+ * nmea_geofence_sweep [-n FENCES] [-q QUERIES] [-s SEED]
+ *     Add FENCES concave 12-vertex stars of 200 to 650 m over 2x2 degrees (by default 10, 100, 1000 and 10000),
+ *     build the index, and test positions near the fences:
+ *     - the fences entered and exited by each nmea_geofence_update() must give the fences a brute-force
+ *       even-odd test over all polygons finds the position in, and nmea_geofence_contains() must agree with it;
+ *     - QUERIES updates are timed against a linear scan of all fences.
+ *     Then a simulated 10 Hz drive is decoded through fences placed on its route, and the events of each fix
+ *     are compared with the brute-force test of the previous and current fix.
+ *
+ * Exits with 1 on any mismatch, or if an update is not 10 times faster than the linear scan from 1000 fences.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "nmea_decoder.h"
+#include "nmea_geofence.h"
+#include "nmea_sim.h"
+
+#define GS_VERTICES (12)
+#define GS_LAT0 (370000000)       /* South-west corner of the fences (degrees * 1e7) */
+#define GS_LON0 (1260000000)
+#define GS_SPAN (20000000)        /* Side of the area of the fences (degrees * 1e7) */
+#define GS_CHECK_OPS (200000000)  /* Polygon edges tested by the brute force check of one set */
+#define GS_MIN_SPEEDUP (10)       /* Update against linear scan, from GS_SPEEDUP_FENCES */
+#define GS_SPEEDUP_FENCES (1000)
+
+/**
+ * @brief Fences entered and exited, as seen through the callback of nmea_geofence_update()
+ *
+ */
+typedef struct {
+    uint8_t *inside;     /*!< Inside flag of each fence id */
+    uint32_t enters;
+    uint32_t exits;
+    uint32_t bad_events; /*!< Enter of a fence already inside, or exit of a fence outside */
+} gs_state_t;
+
+static void gs_event(uint32_t fence_id, bool inside, void *arg)
+{
+    gs_state_t *state = arg;
+    if (state->inside[fence_id] == inside) {
+        state->bad_events++;
+    }
+    state->inside[fence_id] = inside;
+    if (inside) {
+        state->enters++;
+    } else {
+        state->exits++;
+    }
+}
+
+/**
+ * @brief Even-odd test of a position against a polygon, in floating point
+ *
+ */
+static bool gs_brute(const nmea_geofence_point_t *v, size_t count, int32_t lat, int32_t lon)
+{
+    bool in = false;
+    for (size_t i = 0, j = count - 1; i < count; j = i++) {
+        if ((v[i].latitude > lat) != (v[j].latitude > lat)) {
+            double x = v[i].longitude + (double)(lat - v[i].latitude) * (v[j].longitude - v[i].longitude) /
+                       (double)(v[j].latitude - v[i].latitude);
+            if (lon < x) {
+                in = !in;
+            }
+        }
+    }
+    return in;
+}
+
+static double gs_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Concave star around a center, radius in degrees * 1e7
+ *
+ */
+static void gs_star(nmea_geofence_point_t *v, int32_t lat, int32_t lon, int32_t radius)
+{
+    for (int i = 0; i < GS_VERTICES; i++) {
+        double a = i * M_PI / 6;
+        double r = (i & 1) ? radius * 0.45 : radius;
+        v[i].latitude = lat + (int32_t)(r * sin(a));
+        v[i].longitude = lon + (int32_t)(r * cos(a));
+    }
+}
+
+static nmea_geofence_handle_t gs_build(const nmea_geofence_point_t *all, uint32_t count, double *build_ms)
+{
+    nmea_geofence_handle_t geofence;
+    if (nmea_geofence_create(&geofence) != ESP_OK) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (uint32_t k = 0; k < count; k++) {
+        if (nmea_geofence_add(geofence, k, &all[k * GS_VERTICES], GS_VERTICES) != ESP_OK) {
+            fprintf(stderr, "nmea_geofence_add failed\n");
+            exit(1);
+        }
+    }
+    double t0 = gs_now();
+    esp_err_t err = nmea_geofence_build(geofence, 0);
+    *build_ms = (gs_now() - t0) * 1e3;
+    if (err != ESP_OK) {
+        fprintf(stderr, "nmea_geofence_build failed (0x%x)\n", err);
+        exit(1);
+    }
+    return geofence;
+}
+
+/**
+ * @brief Sweep one number of fences
+ *
+ * @return int 0 if the checks pass
+ */
+static int gs_sweep(uint32_t count, uint32_t queries, uint64_t *rng)
+{
+    nmea_geofence_point_t *all = malloc(count * GS_VERTICES * sizeof(nmea_geofence_point_t));
+    int32_t *query = malloc(2 * queries * sizeof(int32_t));
+    gs_state_t state = {.inside = calloc(count, 1)};
+    if (!all || !query || !state.inside) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (uint32_t k = 0; k < count; k++) {
+        int32_t radius = 20000 + (int32_t)(nmea_sim_uniform(rng) * 40000);
+        gs_star(&all[k * GS_VERTICES], GS_LAT0 + (int32_t)(nmea_sim_uniform(rng) * GS_SPAN),
+                GS_LON0 + (int32_t)(nmea_sim_uniform(rng) * GS_SPAN), radius);
+    }
+    /* Positions within 1.5 radius of a random fence, most of them inside or near an edge */
+    for (uint32_t q = 0; q < queries; q++) {
+        const nmea_geofence_point_t *v = &all[(uint32_t)(nmea_sim_uniform(rng) * count) * GS_VERTICES];
+        int32_t radius = v[0].longitude - v[6].longitude;
+        query[2 * q] = (v[0].latitude + v[6].latitude) / 2 + (int32_t)((nmea_sim_uniform(rng) - 0.5) * 1.5 * radius);
+        query[2 * q + 1] = v[6].longitude + radius / 2 + (int32_t)((nmea_sim_uniform(rng) - 0.5) * 1.5 * radius);
+    }
+    double build_ms;
+    nmea_geofence_handle_t geofence = gs_build(all, count, &build_ms);
+
+    /* Correctness: the state kept through the events against brute force over all fences */
+    uint32_t checked = GS_CHECK_OPS / (count * GS_VERTICES);
+    checked = checked < 500 ? 500 : checked > queries ? queries : checked;
+    uint32_t mismatches = 0;
+    uint32_t inside = 0;
+    for (uint32_t q = 0; q < checked; q++) {
+        int32_t lat = query[2 * q];
+        int32_t lon = query[2 * q + 1];
+        nmea_geofence_update(geofence, lat, lon, gs_event, &state);
+        for (uint32_t k = 0; k < count; k++) {
+            bool in = gs_brute(&all[k * GS_VERTICES], GS_VERTICES, lat, lon);
+            mismatches += in != state.inside[k];
+            inside += in;
+        }
+        /* Query of a single fence, one random fence and one the position is in */
+        uint32_t k = (uint32_t)(nmea_sim_uniform(rng) * count);
+        bool in;
+        nmea_geofence_contains(geofence, k, lat, lon, &in);
+        mismatches += in != gs_brute(&all[k * GS_VERTICES], GS_VERTICES, lat, lon);
+    }
+
+    /* Timing: updates without callback, against a linear scan of all fences */
+    double t0 = gs_now();
+    for (uint32_t q = 0; q < queries; q++) {
+        nmea_geofence_update(geofence, query[2 * q], query[2 * q + 1], NULL, NULL);
+    }
+    double update_ns = (gs_now() - t0) * 1e9 / queries;
+    uint32_t linear = count >= 10000 ? 200 : queries / 10;
+    volatile uint32_t sink = 0;
+    t0 = gs_now();
+    for (uint32_t q = 0; q < linear; q++) {
+        for (uint32_t k = 0; k < count; k++) {
+            sink += gs_brute(&all[k * GS_VERTICES], GS_VERTICES, query[2 * q], query[2 * q + 1]);
+        }
+    }
+    double linear_ns = (gs_now() - t0) * 1e9 / linear;
+    (void)sink;
+
+    size_t size = nmea_geofence_get_size(geofence);
+    int slow = count >= GS_SPEEDUP_FENCES && linear_ns < GS_MIN_SPEEDUP * update_ns;
+    int fail = mismatches || state.bad_events || slow;
+    printf("%5u fences: build %6.1f ms, %8zu bytes (%3.0f B/fence), update %5.0f ns, linear %9.0f ns (x%.0f), "
+           "%u positions checked (%u enters, %u exits, %u inside), %u mismatches%s\n", count, build_ms, size,
+           (double)size / count, update_ns, linear_ns, linear_ns / update_ns, checked, state.enters, state.exits,
+           inside, mismatches + state.bad_events, fail ? "  FAIL" : "");
+    nmea_geofence_delete(geofence);
+    free(all);
+    free(query);
+    free(state.inside);
+    return fail;
+}
+
+/**
+ * @brief Drive replay state
+ *
+ */
+typedef struct {
+    nmea_geofence_handle_t geofence;
+    const nmea_geofence_point_t *fences;
+    uint32_t count;
+    gs_state_t state;
+    uint8_t *brute;       /*!< Inside flag of each fence from brute force, previous fix */
+    uint32_t fixes;
+    uint32_t mismatches;  /*!< Fences entered or exited differently from brute force */
+} gs_drive_t;
+
+static void gs_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    gs_drive_t *drive = ctx;
+    gps_fix_core_t core;
+    (void)data;
+    (void)len;
+    nmea_decoder_fix_core(gps, &core);
+    if (!core.valid) {
+        return;
+    }
+    drive->fixes++;
+    nmea_geofence_update(drive->geofence, core.latitude, core.longitude, gs_event, &drive->state);
+    for (uint32_t k = 0; k < drive->count; k++) {
+        uint8_t in = gs_brute(&drive->fences[k * GS_VERTICES], GS_VERTICES, core.latitude, core.longitude);
+        /* Both follow the same fix sequence, their transitions match when their states do */
+        drive->mismatches += in != drive->state.inside[k];
+        drive->brute[k] = in;
+    }
+}
+
+/**
+ * @brief Decode a drive through fences on its route
+ *
+ * @return int 0 if the checks pass
+ */
+static int gs_drive(uint64_t *rng)
+{
+    static const nmea_sim_segment_t lap[] = {
+        {5, 3, 0}, {20, 0, 0}, {6, 0, 15}, {20, 0, 0}, {4, 0, -20}, {20, 0, 3}, {9, 0, -8}, {10, 0, 0},
+    };
+    nmea_sim_drive_t sim;
+    if (nmea_sim_drive(&sim, lap, sizeof(lap) / sizeof(lap[0]), 2, 30, GS_LAT0 / 1e7 + 1, GS_LON0 / 1e7 + 1)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    gs_drive_t drive = {.count = 200};
+    nmea_geofence_point_t *fences = malloc(drive.count * GS_VERTICES * sizeof(nmea_geofence_point_t));
+    drive.state.inside = calloc(drive.count, 1);
+    drive.brute = calloc(drive.count, 1);
+    if (!fences || !drive.state.inside || !drive.brute) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    /* Fences of 20 to 150 m around random points of the route, so that the drive crosses many of them */
+    for (uint32_t k = 0; k < drive.count; k++) {
+        const nmea_sim_truth_t *x = nmea_sim_at(&sim, (int64_t)(nmea_sim_uniform(rng) * sim.count));
+        int32_t lat = (int32_t)((sim.lat0 + x->north / NMEA_SIM_M_PER_DEGREE) * 1e7);
+        int32_t lon = (int32_t)((sim.lon0 + x->east / (NMEA_SIM_M_PER_DEGREE * cos(sim.lat0 * M_PI / 180))) * 1e7);
+        gs_star(&fences[k * GS_VERTICES], lat + (int32_t)((nmea_sim_uniform(rng) - 0.5) * 1000),
+                lon + (int32_t)((nmea_sim_uniform(rng) - 0.5) * 1000), 2000 + (int32_t)(nmea_sim_uniform(rng) * 12000));
+    }
+    double build_ms;
+    drive.geofence = gs_build(fences, drive.count, &build_ms);
+    drive.fences = fences;
+
+    nmea_decoder_t decoder;
+    nmea_decoder_cb_t cb = {.epoch = gs_epoch, .ctx = &drive};
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC), &cb);
+    char text[256];
+    for (int64_t ms = 0; ms < (int64_t)sim.count; ms += 100) {
+        const nmea_sim_truth_t *x = nmea_sim_at(&sim, ms);
+        nmea_sim_fix_t fix = {
+            .time_ms = (uint32_t)(8 * 3600000 + ms),
+            .east = x->east,
+            .north = x->north,
+            .speed = x->speed,
+            .course = x->heading,
+            .hdop = 0.8,
+            .sats = 12,
+            .valid = 1,
+        };
+        size_t len = nmea_sim_epoch(&sim, &fix, text);
+        nmea_decoder_feed(&decoder, (const uint8_t *)text, len);
+    }
+    int fail = drive.mismatches || drive.state.bad_events || !drive.state.enters ||
+               drive.state.enters < drive.state.exits;
+    printf("drive: %u fixes through %u fences, %u enters, %u exits, %u mismatches%s\n", drive.fixes, drive.count,
+           drive.state.enters, drive.state.exits, drive.mismatches + drive.state.bad_events, fail ? "  FAIL" : "");
+    nmea_geofence_delete(drive.geofence);
+    nmea_sim_drive_free(&sim);
+    free(fences);
+    free(drive.state.inside);
+    free(drive.brute);
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = 0;
+    uint32_t queries = 200000;
+    uint64_t rng = 88172645463325252ULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-n")) {
+            count = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-q")) {
+            queries = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            rng = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-n FENCES] [-q QUERIES] [-s SEED]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || queries < 10) {
+        fprintf(stderr, "usage: %s [-n FENCES] [-q QUERIES] [-s SEED], at least 10 queries\n", argv[0]);
+        return 1;
+    }
+    int fail = 0;
+    if (count) {
+        fail |= gs_sweep(count, queries, &rng);
+    } else {
+        static const uint32_t counts[] = {10, 100, 1000, 10000};
+        for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+            fail |= gs_sweep(counts[i], queries, &rng);
+        }
+    }
+    fail |= gs_drive(&rng);
+    return fail;
+}
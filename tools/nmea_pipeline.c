@@ -0,0 +1,565 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Ingestion/decode pipeline benchmark, host tool
+ *
+ * Build:  cc -O2 -pthread -Itools/host -Imain -o nmea_pipeline tools/nmea_pipeline.c main/nmea_decoder.c -lm
+ *
+ * nmea_pipeline [-e EPOCHS] [-r RATE_HZ] [-b BAUD] [-w HANDLER_US] [-s SLOTS] [-R RING_BYTES] [-T TICK_HZ]
+ *     Replay EPOCHS epochs of GGA, GSA, RMC and 3 GSV statements, each line released at the time its line
+ *     end would arrive at BAUD, RATE_HZ epochs per second (0: all lines available at once, for throughput).
+ *     Each epoch runs HANDLER_US of event handler work on the decode side. The run is made twice:
+ *
+ *     single    one thread reads each line and decodes it, as the parser task without the pipeline
+ *     pipeline  an ingestion thread reads lines into a ring of SLOTS line slots, a decode thread drains
+ *               it; same single producer single consumer ring and hand-off as CONFIG_NMEA_PARSER_PIPELINE,
+ *               a full ring makes ingestion wait one tick of TICK_HZ (vTaskDelay(1))
+ *
+ * Each decoded epoch is dispatched as gps_dispatch() does: to a direct handler called in place, then posted to an
+ * event loop run by the decode side once the line is decoded, as the parser task runs esp_event_loop_run() after
+ * each read. The post copies the epoch into a heap block and a locked queue of NMEA_EVENT_LOOP_QUEUE_SIZE events,
+ * the loop looks up the handler by event id, as esp_event does. The handler work runs in the event handler.
+ *
+ * Reported per run: throughput, latency from the arrival of the last line end of an epoch to its decoding
+ * (p50, p99, p99.9, max), the largest backlog of the UART Rx ring buffer (bytes arrived but not read yet) and
+ * the lines that would have overflowed a ring buffer of RING_BYTES, and the pipeline stalls (ring full).
+ * Then the dispatch latency of both paths (p50, p99, max): from the dispatch of an epoch to the entry of the
+ * direct handler, and from its post to the entry of the event handler.
+ * The epochs of both runs are checked to be identical, and every epoch to reach both handlers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "nmea_decoder.h"
+
+#define PL_SLOT_SIZE (256)
+#define PL_MAX_SLOTS (64)
+#define PL_LINES_PER_EPOCH (6)
+#define PL_STATEMENTS ((1 << STATEMENT_GGA) | (1 << STATEMENT_GSA) | (1 << STATEMENT_RMC) | (1 << STATEMENT_GSV))
+#define PL_FNV_OFFSET (14695981039346656037ULL)
+#define PL_FNV_PRIME (1099511628211ULL)
+#define PL_EVENT_QUEUE_SIZE (16) /* Default of CONFIG_NMEA_PARSER_EVENT_LOOP_QUEUE_SIZE */
+#define PL_EVENT_HANDLER_NUM (4) /* Handlers registered on the loop, the last one for the epoch event */
+#define PL_EPOCH_EVENT (0)
+
+/**
+ * @brief Line of the replay
+ *
+ */
+typedef struct {
+    const char *text; /*!< Statement with its line ending */
+    uint32_t len;     /*!< Length of the statement */
+    int64_t due_ns;   /*!< Time its line end arrives, from the start of the run */
+} pl_line_t;
+
+/**
+ * @brief Line slot, as nmea_line_slot_t
+ *
+ */
+typedef struct {
+    uint8_t data[PL_SLOT_SIZE]; /*!< Line, NUL terminated */
+    uint32_t len;               /*!< Length of the line */
+    int64_t rx_ns;              /*!< Time the line end arrived */
+} pl_slot_t;
+
+/**
+ * @brief Posted event, as the queue item of esp_event
+ *
+ */
+typedef struct {
+    int32_t id;      /*!< Event id */
+    void *data;      /*!< Copy of the event data, owned by the queue */
+    int64_t post_ns; /*!< Time of the post */
+} pl_event_t;
+
+typedef void (*pl_handler_t)(void *ctx, int32_t id, const void *data, size_t len);
+
+/**
+ * @brief Registered event handler
+ *
+ */
+typedef struct {
+    int32_t id;           /*!< Event id, -1 for none */
+    pl_handler_t handler; /*!< Handler */
+} pl_handler_slot_t;
+
+/**
+ * @brief Run of the replay, state of ingestion and decode side
+ *
+ */
+typedef struct {
+    const pl_line_t *lines;
+    uint32_t line_num;
+    uint32_t handler_us;
+    uint32_t baud;
+    uint32_t ring_bytes;
+    int64_t start_ns;
+    /* Ingestion side */
+    int64_t backlog_max;            /*!< Largest UART ring buffer backlog (bytes) */
+    uint32_t overflow;              /*!< Lines read with a backlog larger than the ring buffer */
+    uint32_t stall;                 /*!< Ring full, ingestion waited for decode */
+    uint32_t tick_us;               /*!< Wait of ingestion on a full ring */
+    /* Line ring */
+    pl_slot_t slots[PL_MAX_SLOTS];
+    uint32_t slot_num;
+    uint32_t head;                  /*!< Written by ingestion only */
+    uint32_t tail;                  /*!< Written by decode only */
+    sem_t notify;                   /*!< One count per published line, as xTaskNotifyGive() */
+    /* Decode side */
+    nmea_decoder_t decoder;
+    int64_t decode_line_ns;         /*!< Reception time of the line being decoded */
+    int64_t *latency_ns;            /*!< Per epoch */
+    uint32_t epochs;
+    uint64_t hash;                  /*!< FNV-1a of the decoded epochs, in order */
+    /* Dispatch */
+    pl_handler_t direct;            /*!< Direct handler */
+    pl_handler_slot_t handlers[PL_EVENT_HANDLER_NUM];
+    pthread_mutex_t queue_lock;     /*!< Lock of the event queue, as the FreeRTOS queue of esp_event */
+    pl_event_t queue[PL_EVENT_QUEUE_SIZE];
+    uint32_t queue_head;
+    uint32_t queue_count;
+    int64_t dispatch_ns;            /*!< Time the epoch being dispatched was decoded */
+    int64_t post_ns;                /*!< Time the event being handled was posted */
+    int64_t *direct_ns;             /*!< Dispatch to direct handler, per epoch */
+    int64_t *event_ns;              /*!< Post to event handler, per epoch */
+    uint32_t direct_num;
+    uint32_t event_num;
+    uint32_t event_dropped;         /*!< Posts to a full queue */
+} pl_run_t;
+
+static int64_t pl_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void pl_sleep_until(int64_t ns)
+{
+    struct timespec ts = {.tv_sec = ns / 1000000000LL, .tv_nsec = ns % 1000000000LL};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) {
+    }
+}
+
+static uint64_t pl_fnv(uint64_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * PL_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Direct handler, record the latency from the dispatch
+ *
+ */
+static void pl_direct_handler(void *ctx, int32_t id, const void *data, size_t len)
+{
+    pl_run_t *run = ctx;
+    int64_t now = pl_now();
+    (void)data;
+    (void)len;
+    if (id == PL_EPOCH_EVENT) {
+        run->direct_ns[run->direct_num++] = now - run->dispatch_ns;
+    }
+}
+
+/**
+ * @brief Event handler, record the latency from the post and run the handler work
+ *
+ */
+static void pl_event_handler(void *ctx, int32_t id, const void *data, size_t len)
+{
+    pl_run_t *run = ctx;
+    int64_t now = pl_now();
+    (void)id;
+    (void)len;
+    (void)data;
+    run->event_ns[run->event_num++] = now - run->post_ns;
+    /* Event handlers run on the decode side */
+    while (pl_now() - now < run->handler_us * 1000LL) {
+    }
+}
+
+/**
+ * @brief Post an event, as esp_event_post_to() with no wait: copy the data to the heap and queue it
+ *
+ */
+static void pl_post(pl_run_t *run, int32_t id, const void *data, size_t len)
+{
+    int64_t now = pl_now();
+    void *copy = malloc(len);
+    if (!copy) {
+        run->event_dropped++;
+        return;
+    }
+    memcpy(copy, data, len);
+    pthread_mutex_lock(&run->queue_lock);
+    if (run->queue_count == PL_EVENT_QUEUE_SIZE) {
+        pthread_mutex_unlock(&run->queue_lock);
+        free(copy);
+        run->event_dropped++;
+        return;
+    }
+    pl_event_t *event = &run->queue[(run->queue_head + run->queue_count++) % PL_EVENT_QUEUE_SIZE];
+    event->id = id;
+    event->data = copy;
+    event->post_ns = now;
+    pthread_mutex_unlock(&run->queue_lock);
+}
+
+/**
+ * @brief Run the event loop until its queue is empty, as esp_event_loop_run()
+ *
+ */
+static void pl_loop_run(pl_run_t *run)
+{
+    for (;;) {
+        pthread_mutex_lock(&run->queue_lock);
+        if (!run->queue_count) {
+            pthread_mutex_unlock(&run->queue_lock);
+            return;
+        }
+        pl_event_t event = run->queue[run->queue_head];
+        run->queue_head = (run->queue_head + 1) % PL_EVENT_QUEUE_SIZE;
+        run->queue_count--;
+        pthread_mutex_unlock(&run->queue_lock);
+        run->post_ns = event.post_ns;
+        for (int i = 0; i < PL_EVENT_HANDLER_NUM; i++) {
+            if (run->handlers[i].id == event.id) {
+                run->handlers[i].handler(run, event.id, event.data, sizeof(gps_t));
+            }
+        }
+        free(event.data);
+    }
+}
+
+/**
+ * @brief Epoch callback, record the latency and dispatch the epoch as gps_dispatch()
+ *
+ */
+static void pl_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    pl_run_t *run = ctx;
+    int64_t now = pl_now();
+    run->latency_ns[run->epochs++] = now - run->decode_line_ns;
+    run->hash = pl_fnv(run->hash, &gps->latitude, sizeof(gps->latitude));
+    run->hash = pl_fnv(run->hash, &gps->longitude, sizeof(gps->longitude));
+    run->hash = pl_fnv(run->hash, &gps->tim, sizeof(gps->tim));
+    run->hash = pl_fnv(run->hash, &gps->sats_in_view, sizeof(gps->sats_in_view));
+    run->dispatch_ns = pl_now();
+    run->direct(run, PL_EPOCH_EVENT, gps, sizeof(gps_t));
+    pl_post(run, PL_EPOCH_EVENT, gps, sizeof(gps_t));
+}
+
+/**
+ * @brief Wait for the line end of a line, then account for the bytes left in the UART ring buffer
+ *
+ * @return int64_t time the line end arrived
+ */
+static int64_t pl_receive(pl_run_t *run, uint32_t i, bool paced)
+{
+    const pl_line_t *line = &run->lines[i];
+    if (!paced) {
+        return pl_now();
+    }
+    pl_sleep_until(run->start_ns + line->due_ns);
+    int64_t lag_ns = pl_now() - run->start_ns - line->due_ns;
+    int64_t backlog = line->len + lag_ns * run->baud / 10 / 1000000000LL;
+    if (backlog > run->backlog_max) {
+        run->backlog_max = backlog;
+    }
+    if (backlog > run->ring_bytes) {
+        run->overflow++;
+    }
+    return run->start_ns + line->due_ns;
+}
+
+static void pl_run_init(pl_run_t *run)
+{
+    nmea_decoder_cb_t cb = {
+        .epoch = pl_epoch,
+        .ctx = run,
+    };
+    nmea_decoder_init(&run->decoder, PL_STATEMENTS, &cb);
+    run->backlog_max = 0;
+    run->overflow = 0;
+    run->stall = 0;
+    run->head = run->tail = 0;
+    run->epochs = 0;
+    run->hash = PL_FNV_OFFSET;
+    run->direct = pl_direct_handler;
+    for (int i = 0; i < PL_EVENT_HANDLER_NUM; i++) {
+        run->handlers[i].id = -1;
+    }
+    run->handlers[PL_EVENT_HANDLER_NUM - 1] = (pl_handler_slot_t) {
+        PL_EPOCH_EVENT, pl_event_handler
+    };
+    run->queue_head = run->queue_count = 0;
+    run->direct_num = run->event_num = 0;
+    run->event_dropped = 0;
+}
+
+static void pl_single(pl_run_t *run, bool paced)
+{
+    for (uint32_t i = 0; i < run->line_num; i++) {
+        run->decode_line_ns = pl_receive(run, i, paced);
+        uint8_t buffer[PL_SLOT_SIZE];
+        memcpy(buffer, run->lines[i].text, run->lines[i].len);
+        buffer[run->lines[i].len] = '\0';
+        nmea_decoder_feed(&run->decoder, buffer, run->lines[i].len);
+        pl_loop_run(run);
+    }
+}
+
+/**
+ * @brief Decode thread, as nmea_line_ring_drain() in the decode task
+ *
+ */
+static void *pl_decode_task(void *arg)
+{
+    pl_run_t *run = arg;
+    uint32_t tail = run->tail;
+    for (uint32_t n = 0; n < run->line_num;) {
+        sem_wait(&run->notify);
+        while (tail != __atomic_load_n(&run->head, __ATOMIC_ACQUIRE)) {
+            pl_slot_t *slot = &run->slots[tail];
+            run->decode_line_ns = slot->rx_ns;
+            nmea_decoder_feed(&run->decoder, slot->data, slot->len);
+            pl_loop_run(run);
+            tail = (tail + 1) % run->slot_num;
+            __atomic_store_n(&run->tail, tail, __ATOMIC_RELEASE);
+            n++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Ingestion thread, as nmea_line_ring_acquire() and nmea_line_ring_publish() in the ingestion task
+ *
+ */
+static void pl_pipeline(pl_run_t *run, bool paced)
+{
+    pthread_t decode;
+    sem_init(&run->notify, 0, 0);
+    pthread_create(&decode, NULL, pl_decode_task, run);
+    for (uint32_t i = 0; i < run->line_num; i++) {
+        int64_t rx_ns = pl_receive(run, i, paced);
+        uint32_t next = (run->head + 1) % run->slot_num;
+        if (next == __atomic_load_n(&run->tail, __ATOMIC_ACQUIRE)) {
+            run->stall++;
+            while (next == __atomic_load_n(&run->tail, __ATOMIC_ACQUIRE)) {
+                usleep(run->tick_us);
+            }
+        }
+        pl_slot_t *slot = &run->slots[run->head];
+        memcpy(slot->data, run->lines[i].text, run->lines[i].len);
+        slot->data[run->lines[i].len] = '\0';
+        slot->len = run->lines[i].len;
+        slot->rx_ns = rx_ns;
+        __atomic_store_n(&run->head, next, __ATOMIC_RELEASE);
+        sem_post(&run->notify);
+    }
+    pthread_join(decode, NULL);
+    sem_destroy(&run->notify);
+}
+
+static int pl_cmp(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void pl_report(const char *name, pl_run_t *run, int64_t elapsed_ns, size_t bytes)
+{
+    qsort(run->latency_ns, run->epochs, sizeof(int64_t), pl_cmp);
+    uint32_t n = run->epochs;
+    printf("%-9s %8.0f lines/s %6.1f MB/s  latency us p50 %6.0f p99 %6.0f p99.9 %6.0f max %6.0f  "
+           "backlog %5lld B overflow %u stall %u\n", name, run->line_num * 1e9 / elapsed_ns,
+           bytes * 1e3 / elapsed_ns, run->latency_ns[n / 2] / 1e3, run->latency_ns[n * 99 / 100] / 1e3,
+           run->latency_ns[n * 999 / 1000] / 1e3, run->latency_ns[n - 1] / 1e3, (long long)run->backlog_max,
+           run->overflow, run->stall);
+    qsort(run->direct_ns, run->direct_num, sizeof(int64_t), pl_cmp);
+    qsort(run->event_ns, run->event_num, sizeof(int64_t), pl_cmp);
+    if (run->direct_num && run->event_num) {
+        printf("%-9s direct ns p50 %6lld p99 %6lld max %8lld  event ns p50 %6lld p99 %6lld max %8lld  dropped %u\n",
+               "dispatch", (long long)run->direct_ns[run->direct_num / 2],
+               (long long)run->direct_ns[run->direct_num * 99 / 100], (long long)run->direct_ns[run->direct_num - 1],
+               (long long)run->event_ns[run->event_num / 2], (long long)run->event_ns[run->event_num * 99 / 100],
+               (long long)run->event_ns[run->event_num - 1], run->event_dropped);
+    }
+}
+
+/**
+ * @brief Append a statement with its checksum and line ending
+ *
+ */
+static size_t pl_statement(char *out, const char *body)
+{
+    uint8_t crc = 0;
+    for (const char *c = body; *c; c++) {
+        crc ^= (uint8_t)*c;
+    }
+    return sprintf(out, "$%s*%02X\r\n", body, crc);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t epoch_num = 600;
+    uint32_t rate_hz = 10;
+    uint32_t baud = 115200;
+    uint32_t handler_us = 20000;
+    uint32_t slot_num = 8;
+    uint32_t ring_bytes = 1024;
+    uint32_t tick_hz = 100;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-e")) {
+            epoch_num = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-r")) {
+            rate_hz = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-b")) {
+            baud = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-w")) {
+            handler_us = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            slot_num = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-R")) {
+            ring_bytes = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-T")) {
+            tick_hz = strtoul(argv[i + 1], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-e EPOCHS] [-r RATE_HZ] [-b BAUD] [-w HANDLER_US] [-s SLOTS] [-R RING_BYTES] "
+                    "[-T TICK_HZ]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!epoch_num || slot_num < 2 || slot_num > PL_MAX_SLOTS || !baud || !tick_hz) {
+        fprintf(stderr, "epochs, baud and tick must not be 0, slots must be 2 to %d\n", PL_MAX_SLOTS);
+        return 1;
+    }
+
+    /* Generate the replay: a vehicle circling, 12 satellites in view */
+    uint32_t line_num = epoch_num * PL_LINES_PER_EPOCH;
+    pl_line_t *lines = malloc(line_num * sizeof(pl_line_t));
+    char *arena = malloc((size_t)line_num * 96);
+    int64_t *latency = malloc(epoch_num * sizeof(int64_t));
+    int64_t *direct = malloc(epoch_num * sizeof(int64_t));
+    int64_t *event = malloc(epoch_num * sizeof(int64_t));
+    pl_run_t *run = calloc(1, sizeof(pl_run_t));
+    if (!lines || !arena || !latency || !direct || !event || !run) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    size_t bytes = 0;
+    char body[96];
+    for (uint32_t e = 0, l = 0; e < epoch_num; e++) {
+        double t = (double)e / (rate_hz ? rate_hz : 10);
+        double lat = 31.2 + 0.001 * sin(t / 30), lon = 121.5 + 0.001 * cos(t / 30);
+        int lat_deg = (int)lat, lon_deg = (int)lon;
+        uint32_t cs = (uint32_t)(t * 100) + 8 * 360000;
+        char utc[16];
+        sprintf(utc, "%02u%02u%02u.%02u", cs / 360000 % 24, cs / 6000 % 60, cs / 100 % 60, cs % 100);
+        int n = 0;
+        char *text[PL_LINES_PER_EPOCH];
+        size_t len[PL_LINES_PER_EPOCH];
+        sprintf(body, "GPGGA,%s,%02d%08.5f,N,%03d%08.5f,E,1,12,0.8,%.1f,M,8.0,M,,", utc, lat_deg,
+                (lat - lat_deg) * 60, lon_deg, (lon - lon_deg) * 60, 20 + 3 * sin(t / 10));
+        text[n] = arena + bytes, len[n] = pl_statement(text[n], body), bytes += len[n], n++;
+        sprintf(body, "GPGSA,A,3,02,05,07,09,13,15,18,20,23,26,29,30,1.4,0.8,1.1");
+        text[n] = arena + bytes, len[n] = pl_statement(text[n], body), bytes += len[n], n++;
+        sprintf(body, "GPRMC,%s,A,%02d%08.5f,N,%03d%08.5f,E,%.2f,%.1f,180326,,,A", utc, lat_deg,
+                (lat - lat_deg) * 60, lon_deg, (lon - lon_deg) * 60, 12.5 + sin(t), fmod(t * 6, 360));
+        text[n] = arena + bytes, len[n] = pl_statement(text[n], body), bytes += len[n], n++;
+        for (int g = 0; g < 3; g++) {
+            char *p = body + sprintf(body, "GPGSV,3,%d,12", g + 1);
+            for (int s = 0; s < 4; s++) {
+                int prn = 2 + g * 8 + s * 2;
+                p += sprintf(p, ",%02d,%02d,%03d,%02d", prn, (prn * 7 + e / 50) % 90, (prn * 29) % 360,
+                             30 + (prn + e) % 20);
+            }
+            text[n] = arena + bytes, len[n] = pl_statement(text[n], body), bytes += len[n], n++;
+        }
+        /* The epoch starts on the second (or its fraction), its lines follow back to back at the baud rate */
+        int64_t due = rate_hz ? (int64_t)e * 1000000000LL / rate_hz : 0;
+        for (int i = 0; i < n; i++, l++) {
+            due += rate_hz ? (int64_t)len[i] * 10 * 1000000000LL / baud : 0;
+            lines[l].text = text[i];
+            lines[l].len = len[i];
+            lines[l].due_ns = due;
+        }
+    }
+    printf("%u epochs, %u lines, %.1f kB, %u Hz, %u baud, handler %u us, %u slots, ring %u B\n", epoch_num,
+           line_num, bytes / 1e3, rate_hz, baud, handler_us, slot_num, ring_bytes);
+
+    bool paced = rate_hz != 0;
+    run->lines = lines;
+    run->line_num = line_num;
+    run->handler_us = handler_us;
+    run->baud = baud;
+    run->ring_bytes = ring_bytes;
+    run->slot_num = slot_num;
+    run->tick_us = 1000000 / tick_hz;
+    run->latency_ns = latency;
+    run->direct_ns = direct;
+    run->event_ns = event;
+    pthread_mutex_init(&run->queue_lock, NULL);
+
+    pl_run_init(run);
+    run->start_ns = pl_now();
+    pl_single(run, paced);
+    int64_t elapsed = pl_now() - run->start_ns;
+    uint64_t ref = run->hash;
+    uint32_t ref_epochs = run->epochs;
+    uint32_t ref_handled = run->direct_num < run->event_num ? run->direct_num : run->event_num;
+    pl_report("single", run, elapsed, bytes);
+
+    pl_run_init(run);
+    run->start_ns = pl_now();
+    pl_pipeline(run, paced);
+    elapsed = pl_now() - run->start_ns;
+    pl_report("pipeline", run, elapsed, bytes);
+
+    int ret = 0;
+    if (run->hash != ref || run->epochs != ref_epochs || ref_epochs != epoch_num) {
+        printf("EPOCH MISMATCH: %u and %u epochs decoded of %u\n", ref_epochs, run->epochs, epoch_num);
+        ret = 1;
+    }
+    if (ref_handled != ref_epochs || run->direct_num != run->epochs || run->event_num != run->epochs) {
+        printf("DISPATCH MISMATCH: %u epochs handled of %u, %u direct and %u event of %u\n", ref_handled, ref_epochs,
+               run->direct_num, run->event_num, run->epochs);
+        ret = 1;
+    }
+    pthread_mutex_destroy(&run->queue_lock);
+    free(run);
+    free(event);
+    free(direct);
+    free(latency);
+    free(arena);
+    free(lines);
+    return ret;
+}
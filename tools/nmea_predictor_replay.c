@@ -0,0 +1,216 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Fix predictor replay, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_predictor_replay tools/nmea_predictor_replay.c \
+ *            tools/host/nmea_sim.c main/nmea_decoder.c main/nmea_predictor.c -lm
+ *
+ * nmea_predictor_replay [-p PERIOD_MS] [-l LATENCY_MS] [-j JITTER_MS] [-n NOISE_CM] [-u UPSAMPLE_HZ] [-s SEED]
+ *     Drive at 30 m/s with turns of 3 to 6 degree/s, and replay the GGA and RMC statements of a receiver with
+ *     a fix every PERIOD_MS. The first statement of an epoch arrives LATENCY_MS (plus up to JITTER_MS) after
+ *     the time of its fix, at 115200 baud. Each fix is fed to nmea_predictor_update() as the parser does,
+ *     valid at the reception of its first statement minus LATENCY_MS, and predicted to the reception of its
+ *     last statement (GPS_FIX_PREDICTED) and to UPSAMPLE_HZ instants until the next fix.
+ *
+ * Reported: the error of each prediction at the time of the next fix (as nmea_parser_get_stats()), and the
+ * distance to the true position of the published predictions against the fix itself (no compensation).
+ * Exits with 1 if an error exceeds the limits of the regression check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nmea_decoder.h"
+#include "nmea_predictor.h"
+#include "nmea_sim.h"
+
+#define PR_BAUD (115200)
+#define PR_START_MS (8 * 3600000) /* UTC time of the start of the drive */
+#define PR_LOCAL_US (123456789)   /* Local time (esp_timer) at the start of the drive */
+#define PR_ONE_AHEAD_AVG_CM (5)   /* Limits of the regression check */
+#define PR_ONE_AHEAD_MAX_CM (15)
+#define PR_PUBLISHED_MAX_CM (50)
+
+static const nmea_sim_segment_t pr_lap[] = {
+    {10, 3, 0}, {20, 0, 0}, {15, 0, 3}, {10, 0, 0}, {10, 0, -6}, {15, 0, 0}, {20, 0, 4.5}, {10, 0, 0},
+    {8, 0, -3}, {12, 0, 0}, {6, 0, 6}, {10, 0, 0}, {10, -3, 0}, {5, 0, 0},
+};
+
+/**
+ * @brief Replay state
+ *
+ */
+typedef struct {
+    nmea_sim_drive_t drive;
+    nmea_predictor_t predictor;
+    uint32_t latency_ms;
+    int64_t now_us;       /*!< Local time of the line being fed */
+    int64_t epoch_us;     /*!< Local time of the first statement of the epoch */
+    double pred_sum2;     /*!< Squared error of the published predictions (m^2) */
+    double pred_max;
+    double raw_sum2;      /*!< Squared error of the fixes at the time they are published (m^2) */
+    double raw_max;
+    uint32_t published;
+} pr_replay_t;
+
+static double pr_error(pr_replay_t *replay, const gps_fix_core_t *fix, int64_t local_us)
+{
+    double east;
+    double north;
+    nmea_sim_local(&replay->drive, fix->latitude, fix->longitude, &east, &north);
+    const nmea_sim_truth_t *truth = nmea_sim_at(&replay->drive, (local_us - PR_LOCAL_US) / 1000);
+    return hypot(east - truth->east, north - truth->north);
+}
+
+/**
+ * @brief Publish a prediction at a local time, and measure it against the true position
+ *
+ */
+static void pr_publish(pr_replay_t *replay, int64_t local_us, const gps_fix_core_t *fix)
+{
+    gps_fix_core_t predicted;
+    if (!nmea_predictor_predict(&replay->predictor, local_us, &predicted)) {
+        return;
+    }
+    double err = pr_error(replay, &predicted, local_us);
+    replay->pred_sum2 += err * err;
+    replay->pred_max = fmax(replay->pred_max, err);
+    if (fix) {
+        err = pr_error(replay, fix, local_us);
+        replay->raw_sum2 += err * err;
+        replay->raw_max = fmax(replay->raw_max, err);
+    }
+    replay->published++;
+}
+
+static void pr_epoch_start(void *ctx)
+{
+    pr_replay_t *replay = ctx;
+    replay->epoch_us = replay->now_us;
+}
+
+static void pr_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    pr_replay_t *replay = ctx;
+    gps_fix_core_t core;
+    (void)data;
+    (void)len;
+    nmea_decoder_fix_core(gps, &core);
+    if (nmea_predictor_update(&replay->predictor, &core, replay->epoch_us - replay->latency_ms * 1000LL)) {
+        pr_publish(replay, replay->now_us, &core);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t period_ms = 100;
+    uint32_t latency_ms = 50;
+    uint32_t jitter_ms = 2;
+    double noise_cm = 0;
+    uint32_t upsample_hz = 20;
+    uint64_t rng = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-p")) {
+            period_ms = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-l")) {
+            latency_ms = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-j")) {
+            jitter_ms = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-n")) {
+            noise_cm = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-u")) {
+            upsample_hz = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            rng = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-p PERIOD_MS] [-l LATENCY_MS] [-j JITTER_MS] [-n NOISE_CM] [-u UPSAMPLE_HZ] "
+                    "[-s SEED]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!period_ms) {
+        fprintf(stderr, "period must not be 0\n");
+        return 1;
+    }
+
+    pr_replay_t replay = {.latency_ms = latency_ms};
+    if (nmea_sim_drive(&replay.drive, pr_lap, sizeof(pr_lap) / sizeof(pr_lap[0]), 3, 30, 31.2, 121.5)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    nmea_predictor_init(&replay.predictor);
+    nmea_decoder_t decoder;
+    nmea_decoder_cb_t cb = {
+        .epoch = pr_epoch,
+        .epoch_start = pr_epoch_start,
+        .ctx = &replay,
+    };
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC), &cb);
+
+    char text[256];
+    uint32_t fixes = 0;
+    int64_t end_ms = (int64_t)replay.drive.count * NMEA_SIM_DT_MS;
+    for (int64_t ms = 0; ms + period_ms + latency_ms + jitter_ms + 50 < end_ms; ms += period_ms, fixes++) {
+        const nmea_sim_truth_t *truth = nmea_sim_at(&replay.drive, ms);
+        nmea_sim_fix_t fix = {
+            .time_ms = (uint32_t)(PR_START_MS + ms),
+            .east = truth->east + nmea_sim_gauss(&rng, noise_cm / 100),
+            .north = truth->north + nmea_sim_gauss(&rng, noise_cm / 100),
+            .speed = truth->speed,
+            .course = truth->heading,
+            .hdop = 0.8,
+            .sats = 12,
+            .valid = 1,
+        };
+        size_t len = nmea_sim_epoch(&replay.drive, &fix, text);
+        /* Feed each statement at the arrival of its line end */
+        int64_t arrival_us = PR_LOCAL_US + (ms + latency_ms) * 1000 + (int64_t)(nmea_sim_uniform(&rng) * jitter_ms * 1000);
+        for (size_t off = 0; off < len;) {
+            size_t line = strchr(text + off, '\n') - (text + off) + 1;
+            arrival_us += (int64_t)line * 10 * 1000000 / PR_BAUD;
+            replay.now_us = off ? arrival_us : arrival_us - (int64_t)line * 10 * 1000000 / PR_BAUD;
+            nmea_decoder_feed(&decoder, (const uint8_t *)text + off, line);
+            off += line;
+        }
+        /* Upsampled predictions until the next fix arrives */
+        for (uint32_t k = 1; upsample_hz && k * 1000 / upsample_hz < period_ms; k++) {
+            pr_publish(&replay, arrival_us + k * 1000000LL / upsample_hz, NULL);
+        }
+    }
+
+    const nmea_predictor_t *p = &replay.predictor;
+    double one_ahead_avg = p->err_count ? (double)p->err_sum_cm / p->err_count : 0;
+    printf("%u fixes every %u ms, latency %u ms (+%u ms jitter), noise %.0f cm, %u predictions published\n", fixes,
+           period_ms, latency_ms, jitter_ms, noise_cm, replay.published);
+    printf("one fix ahead:    avg %6.1f cm  max %6.1f cm  (%u predictions)\n", one_ahead_avg, (double)p->err_max_cm,
+           (unsigned)p->err_count);
+    printf("published:        rms %6.1f cm  max %6.1f cm\n", 100 * sqrt(replay.pred_sum2 / replay.published),
+           100 * replay.pred_max);
+    printf("no compensation:  rms %6.1f cm  max %6.1f cm  (fix position at its publication)\n",
+           100 * sqrt(replay.raw_sum2 / fixes), 100 * replay.raw_max);
+
+    int ret = 0;
+    if (period_ms == 100 && noise_cm == 0 && jitter_ms <= 2 &&
+            (one_ahead_avg > PR_ONE_AHEAD_AVG_CM || p->err_max_cm > PR_ONE_AHEAD_MAX_CM ||
+             100 * replay.pred_max > PR_PUBLISHED_MAX_CM)) {
+        printf("FAIL: limits are avg %d cm and max %d cm one fix ahead, max %d cm published\n", PR_ONE_AHEAD_AVG_CM,
+               PR_ONE_AHEAD_MAX_CM, PR_PUBLISHED_MAX_CM);
+        ret = 1;
+    }
+    nmea_sim_drive_free(&replay.drive);
+    return ret;
+}
@@ -0,0 +1,383 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Adaptive fix rate simulation, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_rate_sim tools/nmea_rate_sim.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c main/nmea_ubx.c main/nmea_rate.c -lm
+ *
+ * nmea_rate_sim [-p PERIOD_MS] [-s SEED]
+ *     Drive 12 minutes (8 minutes parked, starts, turns, braking, lane changes on a highway) and replay the
+ *     GGA and RMC statements of a receiver with 2 cm of position noise and 5 cm/s of speed noise. Its fix period
+ *     is set by the PMTK220 commands of nmea_rate_update(), with the default configuration of the parser
+ *     (1000, 100 and 50 ms, idle below 0.5 m/s, manoeuvre above 8 degree/s or 1.5 m/s^2, 3 s hold), and
+ *     compared with fixed periods of 1000, 100 and 50 ms. -p runs one fixed period only.
+ *
+ * Reported: epochs and bytes decoded, time in each motion state, and per kind of segment the distance between
+ * the true position and the track interpolated between fixes.
+ *
+ * Regression checks of the adaptive run (exit 1 on failure):
+ * - the commands are valid PMTK220 commands, one per period change, and the encoders give the reference bytes;
+ * - a manoeuvre is detected within 1.5 s, the idle and cruise states are reached within the hold time plus 2 s;
+ * - the period changes at most once per segment boundary (no toggling on noise);
+ * - fewer than 60% of the epochs of a fixed 10 Hz, and turns and braking as close as 15 cm.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nmea_decoder.h"
+#include "nmea_rate.h"
+#include "nmea_sim.h"
+
+#define RS_POSITION_NOISE (0.02) /* m */
+#define RS_SPEED_NOISE (0.05)    /* m/s */
+#define RS_DETECT_MS (1500)      /* Limits of the regression check */
+#define RS_SETTLE_MS (2000)
+#define RS_EPOCH_RATIO (0.6)
+#define RS_MANOEUVRE_ERR (0.15)  /* m */
+
+static const nmea_rate_config_t rs_config = {
+    .period_ms = {1000, 100, 50},
+    .idle_speed = 50,
+    .turn_rate = 800,
+    .accel = 150,
+    .hold_ms = 3000,
+};
+
+/**
+ * @brief Kind of segment, and the motion state the controller must reach
+ *
+ */
+typedef enum {
+    RS_PARK, RS_CRUISE, RS_HIGHWAY, RS_LIGHT, RS_START, RS_ACCEL, RS_BRAKE, RS_TURN, RS_LANE, RS_KIND_MAX,
+} rs_kind_t;
+
+static const char *const rs_kind_names[RS_KIND_MAX] = {
+    "park", "cruise", "highway", "light", "start", "accel", "brake", "turn", "lane",
+};
+
+static const nmea_rate_state_t rs_kind_state[RS_KIND_MAX] = {
+    NMEA_RATE_IDLE, NMEA_RATE_CRUISE, NMEA_RATE_CRUISE, NMEA_RATE_IDLE, NMEA_RATE_MANOEUVRE,
+    NMEA_RATE_CRUISE, NMEA_RATE_MANOEUVRE, NMEA_RATE_MANOEUVRE, NMEA_RATE_CRUISE, /* Gentle, under the thresholds */
+};
+
+static const nmea_sim_segment_t rs_route[] = {
+    {120, 0, 0}, {6, 2.5, 0}, {40, 0, 0}, {5, 0, 18}, {30, 0, 0}, {5, -3, 0}, {30, 0, 0}, {5, 3, 0}, {20, 0, 0},
+    {4, 0, -22.5}, {15, 0, 0}, {3, 0, 30}, {10, 0, 0}, {5, 1, 0}, {60, 0, 0}, {2, 0, 4}, {2, 0, -4}, {60, 0, 0},
+    {4, -2.5, 0}, {10, 0, 0}, {4, 0, 22.5}, {4, -2.5, 0}, {300, 0, 0},
+};
+
+static const rs_kind_t rs_route_kind[] = {
+    RS_PARK, RS_START, RS_CRUISE, RS_TURN, RS_CRUISE, RS_BRAKE, RS_LIGHT, RS_START, RS_CRUISE,
+    RS_TURN, RS_CRUISE, RS_TURN, RS_CRUISE, RS_ACCEL, RS_HIGHWAY, RS_LANE, RS_LANE, RS_HIGHWAY,
+    RS_BRAKE, RS_CRUISE, RS_TURN, RS_BRAKE, RS_PARK,
+};
+
+#define RS_SEGMENTS (sizeof(rs_route) / sizeof(rs_route[0]))
+
+/**
+ * @brief Fix in the local frame
+ *
+ */
+typedef struct {
+    int64_t ms;
+    double east;
+    double north;
+} rs_fix_t;
+
+/**
+ * @brief Run of the simulated receiver
+ *
+ */
+typedef struct {
+    const nmea_sim_drive_t *drive;
+    nmea_rate_t rate;
+    bool adaptive;
+    uint32_t period_ms;             /*!< Fix period of the receiver */
+    rs_fix_t *fixes;
+    size_t fix_count;
+    size_t bytes;
+    uint32_t commands;
+    uint32_t bad_commands;
+    uint32_t segment;               /*!< Segment of the fix being decoded */
+    int64_t reached_ms[RS_SEGMENTS]; /*!< Time into each segment its state was applied, -1 if never */
+    double err_max[RS_KIND_MAX];
+    double err_sum2[RS_KIND_MAX];
+    uint32_t err_count[RS_KIND_MAX];
+} rs_run_t;
+
+static void rs_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    rs_run_t *run = ctx;
+    gps_fix_core_t core;
+    (void)data;
+    (void)len;
+    nmea_decoder_fix_core(gps, &core);
+    rs_fix_t *fix = &run->fixes[run->fix_count++];
+    fix->ms = core.time_ms;
+    nmea_sim_local(run->drive, core.latitude, core.longitude, &fix->east, &fix->north);
+    if (!run->adaptive) {
+        return;
+    }
+    uint16_t period_ms = nmea_rate_update(&run->rate, &core);
+    if (period_ms) {
+        /* The receiver side parses the command */
+        uint8_t cmd[NMEA_RATE_COMMAND_MAX_SIZE + 1];
+        size_t cmd_len = nmea_rate_command(NMEA_RATE_PROTOCOL_PMTK, period_ms, cmd, sizeof(cmd));
+        unsigned ms;
+        cmd[cmd_len] = '\0';
+        if (cmd_len && sscanf((char *)cmd, "$PMTK220,%u*", &ms) == 1 && ms == period_ms) {
+            /* Checksum and line ending as the receiver expects them */
+            char body[16];
+            char expected[NMEA_RATE_COMMAND_MAX_SIZE + 1];
+            snprintf(body, sizeof(body), "PMTK220,%u", ms);
+            nmea_sim_statement(expected, body);
+            run->bad_commands += strcmp(expected, (char *)cmd) != 0;
+            run->period_ms = ms;
+        } else {
+            run->bad_commands++;
+        }
+        run->commands++;
+    }
+    uint32_t seg = run->segment;
+    if (run->reached_ms[seg] < 0 && run->rate.state == rs_kind_state[rs_route_kind[seg]]) {
+        int64_t start_ms = 0;
+        for (uint32_t i = 0; i < seg; i++) {
+            start_ms += llround(rs_route[i].duration * 1000);
+        }
+        run->reached_ms[seg] = core.time_ms - start_ms;
+    }
+}
+
+/**
+ * @brief Replay the drive with a fixed period, or an adaptive one if period_ms is 0
+ *
+ */
+static void rs_replay(rs_run_t *run, const nmea_sim_drive_t *drive, uint32_t period_ms, uint64_t seed)
+{
+    memset(run, 0, sizeof(*run));
+    run->drive = drive;
+    run->adaptive = !period_ms;
+    run->period_ms = period_ms ? period_ms : 100; /* Receiver default, 10 Hz */
+    run->fixes = malloc((drive->count / 50 + 2) * sizeof(rs_fix_t));
+    if (!run->fixes) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < RS_SEGMENTS; i++) {
+        run->reached_ms[i] = -1;
+    }
+    nmea_rate_init(&run->rate, &rs_config);
+    nmea_decoder_t decoder;
+    nmea_decoder_cb_t cb = {.epoch = rs_epoch, .ctx = run};
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC), &cb);
+
+    uint64_t rng = seed;
+    char text[256];
+    for (int64_t ms = 0; ms < (int64_t)drive->count; ms = (ms / run->period_ms + 1) * run->period_ms) {
+        const nmea_sim_truth_t *x = nmea_sim_at(drive, ms);
+        double speed = fmax(0, x->speed + nmea_sim_gauss(&rng, RS_SPEED_NOISE));
+        /* Course over ground is noise when stopped */
+        double course = x->speed > 0.3 ? x->heading + nmea_sim_gauss(&rng, 4 * RS_SPEED_NOISE) :
+                        x->heading + nmea_sim_gauss(&rng, 60);
+        nmea_sim_fix_t fix = {
+            .time_ms = (uint32_t)ms,
+            .east = x->east + nmea_sim_gauss(&rng, RS_POSITION_NOISE),
+            .north = x->north + nmea_sim_gauss(&rng, RS_POSITION_NOISE),
+            .speed = speed,
+            .course = course,
+            .hdop = 0.8,
+            .sats = 10,
+            .valid = 1,
+        };
+        run->segment = x->segment;
+        size_t len = nmea_sim_epoch(drive, &fix, text);
+        nmea_decoder_feed(&decoder, (const uint8_t *)text, len);
+        run->bytes += len;
+    }
+
+    /* Distance between the truth and the track interpolated between fixes, every 10 ms */
+    size_t f = 0;
+    for (size_t k = 0; k < drive->count; k += 10) {
+        while (f + 1 < run->fix_count && run->fixes[f + 1].ms <= (int64_t)k) {
+            f++;
+        }
+        if (f + 1 >= run->fix_count || run->fixes[f].ms > (int64_t)k) {
+            continue;
+        }
+        const rs_fix_t *a = &run->fixes[f];
+        const rs_fix_t *b = &run->fixes[f + 1];
+        double u = (double)(k - a->ms) / (b->ms - a->ms);
+        double err = hypot(a->east + u * (b->east - a->east) - drive->state[k].east,
+                           a->north + u * (b->north - a->north) - drive->state[k].north);
+        rs_kind_t kind = rs_route_kind[drive->state[k].segment];
+        run->err_max[kind] = fmax(run->err_max[kind], err);
+        run->err_sum2[kind] += err * err;
+        run->err_count[kind]++;
+    }
+}
+
+/**
+ * @brief Check the encoders against reference commands
+ *
+ * @return int number of failures
+ */
+static int rs_check_commands(void)
+{
+    static const uint8_t ubx_100ms[] = {0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0x64, 0x00, 0x01, 0x00, 0x01, 0x00,
+                                        0x7A, 0x12};
+    uint8_t buf[NMEA_RATE_COMMAND_MAX_SIZE];
+    int fail = 0;
+    size_t len = nmea_rate_command(NMEA_RATE_PROTOCOL_PMTK, 10000, buf, sizeof(buf));
+    fail += len != 19 || memcmp(buf, "$PMTK220,10000*2F\r\n", 19);
+    len = nmea_rate_command(NMEA_RATE_PROTOCOL_UBX, 100, buf, sizeof(buf));
+    fail += len != sizeof(ubx_100ms) || memcmp(buf, ubx_100ms, sizeof(ubx_100ms));
+    /* Too small a buffer gives nothing */
+    fail += nmea_rate_command(NMEA_RATE_PROTOCOL_PMTK, 10000, buf, 19) != 0;
+    fail += nmea_rate_command(NMEA_RATE_PROTOCOL_UBX, 100, buf, sizeof(ubx_100ms) - 1) != 0;
+    if (fail) {
+        printf("FAIL: %d commands differ from the reference\n", fail);
+    }
+    return fail;
+}
+
+/**
+ * @brief Check the motion states of the adaptive run
+ *
+ * @return int number of failures
+ */
+static int rs_check_states(const rs_run_t *run)
+{
+    int fail = 0;
+    for (uint32_t i = 0; i < RS_SEGMENTS; i++) {
+        rs_kind_t kind = rs_route_kind[i];
+        int64_t duration_ms = llround(rs_route[i].duration * 1000);
+        int64_t limit_ms = rs_kind_state[kind] == NMEA_RATE_MANOEUVRE ? RS_DETECT_MS : rs_config.hold_ms + RS_SETTLE_MS;
+        if (limit_ms > duration_ms) {
+            /* Too short to be checked */
+            continue;
+        }
+        if (run->reached_ms[i] < 0) {
+            printf("FAIL: segment %u (%s) never reached its state\n", (unsigned)i, rs_kind_names[kind]);
+            fail++;
+        } else if (run->reached_ms[i] > limit_ms) {
+            printf("FAIL: segment %u (%s) reached its state after %lld ms, limit %lld ms\n", (unsigned)i,
+                   rs_kind_names[kind], (long long)run->reached_ms[i], (long long)limit_ms);
+            fail++;
+        }
+    }
+    if (run->rate.changes > RS_SEGMENTS - 1) {
+        printf("FAIL: %u period changes for %u segment boundaries\n", (unsigned)run->rate.changes,
+               (unsigned)(RS_SEGMENTS - 1));
+        fail++;
+    }
+    if (run->bad_commands || run->commands != run->rate.changes + 1) {
+        printf("FAIL: %u bad commands, %u commands for %u changes\n", run->bad_commands, run->commands,
+               (unsigned)run->rate.changes);
+        fail++;
+    }
+    return fail;
+}
+
+static void rs_print(const rs_run_t *run, double duration_s)
+{
+    if (run->adaptive) {
+        printf("adaptive: ");
+    } else {
+        printf("%4u ms:  ", run->period_ms);
+    }
+    printf("%5zu epochs, %7zu bytes (%4.0f B/s)", run->fix_count, run->bytes, run->bytes / duration_s);
+    if (run->adaptive) {
+        printf(", %u changes, idle %.0f s, cruise %.0f s, manoeuvre %.0f s", (unsigned)run->rate.changes,
+               run->rate.time_ms[NMEA_RATE_IDLE] / 1e3, run->rate.time_ms[NMEA_RATE_CRUISE] / 1e3,
+               run->rate.time_ms[NMEA_RATE_MANOEUVRE] / 1e3);
+    }
+    printf("\n   ");
+    for (int i = 0; i < RS_KIND_MAX; i++) {
+        if (run->err_count[i]) {
+            printf(" %s %.2f/%.2f", rs_kind_names[i], run->err_max[i], sqrt(run->err_sum2[i] / run->err_count[i]));
+        }
+    }
+    printf(" (m, max/rms between fixes)\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t fixed_ms = 0;
+    uint64_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-p")) {
+            fixed_ms = strtoul(argv[i + 1], NULL, 10);
+        } else if (!strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-p PERIOD_MS] [-s SEED]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0) {
+        fprintf(stderr, "usage: %s [-p PERIOD_MS] [-s SEED]\n", argv[0]);
+        return 1;
+    }
+
+    nmea_sim_drive_t drive;
+    if (nmea_sim_drive(&drive, rs_route, RS_SEGMENTS, 1, 45, 37.2, 127.0)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    double duration_s = drive.count / 1000.0;
+    static rs_run_t run;
+    if (fixed_ms) {
+        rs_replay(&run, &drive, fixed_ms, seed);
+        rs_print(&run, duration_s);
+        free(run.fixes);
+        nmea_sim_drive_free(&drive);
+        return 0;
+    }
+
+    int fail = rs_check_commands();
+    static rs_run_t fixed;
+    rs_replay(&fixed, &drive, 100, seed);
+    size_t fixed_epochs = fixed.fix_count;
+    rs_print(&fixed, duration_s);
+    free(fixed.fixes);
+    static const uint32_t others[] = {1000, 50};
+    for (size_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+        rs_replay(&fixed, &drive, others[i], seed);
+        rs_print(&fixed, duration_s);
+        free(fixed.fixes);
+    }
+    rs_replay(&run, &drive, 0, seed);
+    rs_print(&run, duration_s);
+    fail += rs_check_states(&run);
+    if (run.fix_count > RS_EPOCH_RATIO * fixed_epochs) {
+        printf("FAIL: %zu epochs, more than %.0f%% of the %zu of a fixed 10 Hz\n", run.fix_count,
+               RS_EPOCH_RATIO * 100, fixed_epochs);
+        fail++;
+    }
+    static const rs_kind_t manoeuvres[] = {RS_TURN, RS_BRAKE, RS_LANE, RS_ACCEL};
+    for (size_t i = 0; i < sizeof(manoeuvres) / sizeof(manoeuvres[0]); i++) {
+        if (run.err_max[manoeuvres[i]] > RS_MANOEUVRE_ERR) {
+            printf("FAIL: %s %.2f m between fixes, limit %.2f m\n", rs_kind_names[manoeuvres[i]],
+                   run.err_max[manoeuvres[i]], RS_MANOEUVRE_ERR);
+            fail++;
+        }
+    }
+    free(run.fixes);
+    nmea_sim_drive_free(&drive);
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Track simplification replay, host tool and regression check
+ *
+ * Build:  cc -O2 -Itools/host -Imain -o nmea_track_replay tools/nmea_track_replay.c tools/host/nmea_sim.c \
+ *            main/nmea_decoder.c main/nmea_track.c -lm
+ *
+ * nmea_track_replay [-t TOLERANCE_CM] [-w WINDOW] [-i MAX_INTERVAL_S] [-l LAPS] [-n NOISE_CM] [-g] [-r MIN_RATIO]
+ *                   [-s SEED]
+ *     Drive laps of one minute with turns at 10 Hz (600 fixes a lap), decode the GGA and RMC statements and
+ *     feed each fix to nmea_track_update() as the parser does. -g loses the fix for 3 s in each lap.
+ *     Without -t, runs at 1 m and at 5 m tolerance. -r sets the fewest fixes per point (compression ratio).
+ *
+ * Every fix is checked against the published polyline, independently of the simplifier: its distance to the
+ * segment between the points around it must stay within the tolerance (plus 2 cm of coordinate rounding), the
+ * maximum error reported by the simplifier must match, and the end of each piece of track must be published.
+ * Exits with 1 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nmea_decoder.h"
+#include "nmea_track.h"
+#include "nmea_sim.h"
+
+#define TR_PERIOD_MS (100)
+#define TR_START_MS (8 * 3600000) /* UTC time of the start of the drive */
+#define TR_ROUNDING_CM (2)        /* Coordinates are rounded to 1e-7 degree and to cm in the simplifier */
+#define TR_GAP_START_S (32)       /* Fix lost from this time of each lap, with -g */
+#define TR_GAP_S (3)
+
+static const nmea_sim_segment_t tr_lap[] = {
+    {5, 3, 0}, {10, 0, 0}, {6, 0, 15}, {8, 0, 0}, {4, 0, -20}, {10, 0, 3}, {9, 0, -8}, {5, 0, 0}, {3, -5, 0},
+};
+
+/**
+ * @brief Replay state
+ *
+ */
+typedef struct {
+    nmea_track_t track;
+    gps_fix_core_t *fixes;  /*!< Valid fixes fed */
+    uint32_t fix_count;
+    gps_fix_core_t *points; /*!< Track points published */
+    uint32_t point_count;
+    uint32_t ends;          /*!< Pieces of track ended by a lost fix */
+    uint32_t ends_missed;   /*!< Pieces whose last fix was not published */
+} tr_replay_t;
+
+static void tr_point(void *ctx, const gps_fix_core_t *point)
+{
+    tr_replay_t *replay = ctx;
+    replay->points[replay->point_count++] = *point;
+}
+
+static void tr_epoch(void *ctx, const gps_t *gps, const uint8_t *data, size_t len)
+{
+    tr_replay_t *replay = ctx;
+    gps_fix_core_t core;
+    (void)data;
+    (void)len;
+    nmea_decoder_fix_core(gps, &core);
+    if (!core.valid && replay->fix_count && replay->track.has_anchor) {
+        replay->ends++;
+        nmea_track_update(&replay->track, &core);
+        const gps_fix_core_t *last = &replay->fixes[replay->fix_count - 1];
+        const gps_fix_core_t *point = &replay->points[replay->point_count - 1];
+        replay->ends_missed += point->time_ms != last->time_ms;
+        return;
+    }
+    if (core.valid) {
+        replay->fixes[replay->fix_count++] = core;
+    }
+    nmea_track_update(&replay->track, &core);
+}
+
+/**
+ * @brief Distance from a fix to a segment (cm), in a local frame of the start of the segment
+ *
+ */
+static double tr_distance(const gps_fix_core_t *a, const gps_fix_core_t *b, const gps_fix_core_t *p)
+{
+    double m = NMEA_SIM_M_PER_DEGREE * 100 / 1e7;
+    double k = m * cos(a->latitude / 1e7 * M_PI / 180);
+    double bx = (b->longitude - a->longitude) * k;
+    double by = (b->latitude - a->latitude) * m;
+    double px = (p->longitude - a->longitude) * k;
+    double py = (p->latitude - a->latitude) * m;
+    double len2 = bx * bx + by * by;
+    double u = len2 > 0 ? (px * bx + py * by) / len2 : 0;
+    u = fmin(1, fmax(0, u));
+    return hypot(px - u * bx, py - u * by);
+}
+
+/**
+ * @brief Simplify a drive at one tolerance, and check the track
+ *
+ * @return int 0 if the checks pass
+ */
+static int tr_run(const nmea_sim_drive_t *drive, const nmea_track_config_t *config, uint32_t laps, double noise_cm,
+                  int gap, double min_ratio, uint64_t seed)
+{
+    uint32_t epochs = (uint32_t)((drive->count - 1) / TR_PERIOD_MS);
+    tr_replay_t replay = {
+        .fixes = malloc(epochs * sizeof(gps_fix_core_t)),
+        .points = malloc((epochs + 1) * sizeof(gps_fix_core_t)),
+    };
+    if (!replay.fixes || !replay.points) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    nmea_track_init(&replay.track, config, tr_point, &replay);
+    nmea_decoder_t decoder;
+    nmea_decoder_cb_t cb = {.epoch = tr_epoch, .ctx = &replay};
+    nmea_decoder_init(&decoder, (1 << STATEMENT_GGA) | (1 << STATEMENT_RMC), &cb);
+
+    char text[256];
+    uint64_t rng = seed;
+    uint32_t lap_ms = (uint32_t)((drive->count - 1) / laps);
+    for (uint32_t i = 0; i < epochs; i++) {
+        int64_t ms = (int64_t)i * TR_PERIOD_MS;
+        uint32_t in_lap = (uint32_t)(ms % lap_ms);
+        const nmea_sim_truth_t *truth = nmea_sim_at(drive, ms);
+        nmea_sim_fix_t fix = {
+            .time_ms = (uint32_t)(TR_START_MS + ms),
+            .east = truth->east + nmea_sim_gauss(&rng, noise_cm / 100),
+            .north = truth->north + nmea_sim_gauss(&rng, noise_cm / 100),
+            .speed = truth->speed,
+            .course = truth->heading,
+            .hdop = 0.8,
+            .sats = 12,
+            .valid = !gap || in_lap < TR_GAP_START_S * 1000 || in_lap >= (TR_GAP_START_S + TR_GAP_S) * 1000,
+        };
+        size_t len = nmea_sim_epoch(drive, &fix, text);
+        nmea_decoder_feed(&decoder, (const uint8_t *)text, len);
+    }
+    /* End of the drive */
+    gps_fix_core_t end = {0};
+    nmea_track_update(&replay.track, &end);
+
+    /* Each fix against the segment of the polyline around it, pieces of track are cut at the lost fixes */
+    double err_max = 0;
+    uint32_t outside = 0;
+    uint32_t p = 0;
+    for (uint32_t i = 0; i < replay.fix_count; i++) {
+        int64_t t = nmea_fix_utc_ms(&replay.fixes[i]);
+        while (p + 1 < replay.point_count && nmea_fix_utc_ms(&replay.points[p + 1]) <= t) {
+            p++;
+        }
+        const gps_fix_core_t *a = &replay.points[p];
+        const gps_fix_core_t *b = p + 1 < replay.point_count ? &replay.points[p + 1] : a;
+        if (nmea_fix_utc_ms(a) > t) {
+            outside++;
+            continue;
+        }
+        double d = nmea_fix_utc_ms(a) == t ? 0 : tr_distance(a, b, &replay.fixes[i]);
+        err_max = fmax(err_max, d);
+    }
+
+    int fail = err_max > config->tolerance_cm + TR_ROUNDING_CM || outside || replay.ends_missed ||
+               fabs(err_max - replay.track.err_max_cm) > TR_ROUNDING_CM ||
+               replay.track.fixes_in != replay.fix_count || replay.track.points_out != replay.point_count ||
+               replay.fix_count < min_ratio * replay.point_count;
+    printf("tolerance %5u cm, window %3u: %5u fixes -> %4u points (%5.1f:1), error max %5.1f cm "
+           "(reported %u cm), %u of %u track ends published%s\n", (unsigned)config->tolerance_cm,
+           (unsigned)config->window, replay.fix_count, replay.point_count,
+           (double)replay.fix_count / replay.point_count, err_max, (unsigned)replay.track.err_max_cm,
+           replay.ends - replay.ends_missed, replay.ends, fail ? "  FAIL" : "");
+    if (outside) {
+        printf("FAIL: %u fixes before the first point of their track\n", outside);
+    }
+    free(replay.fixes);
+    free(replay.points);
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    nmea_track_config_t config = {.tolerance_cm = 0, .window = 32, .max_interval_s = 60};
+    uint32_t laps = 1;
+    double noise_cm = 0;
+    int gap = 0;
+    double min_ratio = 0;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-g")) {
+            gap = 1;
+        } else if (i + 1 < argc && !strcmp(argv[i], "-t")) {
+            config.tolerance_cm = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-w")) {
+            config.window = (uint16_t)strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-i")) {
+            config.max_interval_s = (uint16_t)strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-l")) {
+            laps = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-n")) {
+            noise_cm = atof(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-r")) {
+            min_ratio = atof(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-t TOLERANCE_CM] [-w WINDOW] [-i MAX_INTERVAL_S] [-l LAPS] [-n NOISE_CM] "
+                    "[-g] [-r MIN_RATIO] [-s SEED]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!laps) {
+        fprintf(stderr, "laps must not be 0\n");
+        return 1;
+    }
+
+    nmea_sim_drive_t drive;
+    if (nmea_sim_drive(&drive, tr_lap, sizeof(tr_lap) / sizeof(tr_lap[0]), laps, 30, 48.1, 11.6)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    int fail = 0;
+    if (config.tolerance_cm) {
+        fail |= tr_run(&drive, &config, laps, noise_cm, gap, min_ratio, seed);
+    } else {
+        static const uint32_t tolerances[] = {100, 500};
+        for (size_t i = 0; i < sizeof(tolerances) / sizeof(tolerances[0]); i++) {
+            config.tolerance_cm = tolerances[i];
+            fail |= tr_run(&drive, &config, laps, noise_cm, gap, min_ratio, seed);
+        }
+    }
+    nmea_sim_drive_free(&drive);
+    return fail;
+}